@@ -0,0 +1,327 @@
+#include <osg/FrameStamp>
+#include <osg/Notify>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BinaryLogFormat.h"
+
+//AsyncLogFileHandler
+//same job as LogFileHandler, but notify() never touches the disk.
+//the emitting thread (cull, draw, database pager...) only copies the message
+//into a slot of a bounded lock-free ring buffer and returns.
+//a background OpenThreads::Thread drains the ring in batches and writes them to the file.
+//if the ring is full the message is dropped and counted instead of blocking the caller.
+//a writer that found the ring empty sleeps on a condition; only the message that finds it
+//asleep, the first one into the emptied ring, takes the lock to wake it.
+//
+//in BINARY mode every message becomes a BinaryLogRecord (severity, monotonic timestamp,
+//thread id, frame number) instead of plain text, see BinaryLogFormat.h and LogReader.
+//messages less severe than the threshold are rejected before they are formatted: the
+//threshold is also osg's notify level, so OSG_NOTIFY skips them without building the text.
+
+class AsyncLogFileHandler : public osg::NotifyHandler
+{
+public:
+	//one ring slot. messages longer than MaxMessage are cut and counted in _truncated
+	enum { MaxMessage = 256 };
+	enum { CacheLine = 64 };
+
+	enum Format
+	{
+		TEXT,
+		BINARY
+	};
+
+	AsyncLogFileHandler( const std::string& file, Format format = TEXT,
+	                     unsigned int capacity = 4096, unsigned int batchSize = 256 )
+		: _mask( roundUpPowerOfTwo( capacity ) - 1 ), _slots( _mask + 1 ),
+		  _enqueuePos( 0 ), _dequeuePos( 0 ), _batchSize( batchSize ), _format( format ),
+		  _threshold( osg::DEBUG_FP ), _frameStamp( 0 ), _frameNumber( 0 ),
+		  _written( 0 ), _dropped( 0 ), _truncated( 0 ), _sleeping( false ), _done( false ), _writer( this )
+	{
+		for ( unsigned int i = 0; i < _slots.size(); ++i )
+			_slots[i].sequence.store( i, std::memory_order_relaxed );
+
+		if ( _format == BINARY )
+		{
+			_log.open( file.c_str(), std::ios::out | std::ios::binary );
+			BinaryLogFileHeader header = BinaryLog::makeHeader();
+			_log.write( (const char*)&header, sizeof(header) );
+		}
+		else
+		{
+			_log.open( file.c_str() );
+		}
+		_writer.start();
+	}
+
+	//messages less severe than this (numerically greater) are discarded. sets the global notify
+	//level too, so OSG_NOTIFY short-circuits them before the message is formatted at all
+	void setSeverityThreshold( osg::NotifySeverity threshold )
+	{
+		_threshold.store( threshold, std::memory_order_relaxed );
+		osg::setNotifyLevel( threshold );
+	}
+	osg::NotifySeverity getSeverityThreshold() const { return (osg::NotifySeverity)_threshold.load( std::memory_order_relaxed ); }
+
+	//records are stamped with the frame number of this frame stamp, usually viewer.getFrameStamp().
+	//not referenced: the viewer owns it, set 0 before it goes away. read by every producer thread
+	void setFrameStamp( const osg::FrameStamp* frameStamp ) { _frameStamp.store( frameStamp, std::memory_order_release ); }
+	//or, without a viewer, with whatever the application sets here
+	void setFrameNumber( unsigned int frameNumber ) { _frameNumber.store( frameNumber, std::memory_order_relaxed ); }
+
+	virtual ~AsyncLogFileHandler()
+	{
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			_done.store( true, std::memory_order_release );
+			_wakeUp.signal();
+		}
+		_writer.join();
+
+		//whatever was still queued when we were asked to stop
+		while ( drain() > 0 ) {}
+
+		if ( _dropped.load() > 0 || _truncated.load() > 0 )
+		{
+			Slot summary;
+			summary.severity = osg::NOTICE;
+			summary.timestamp = now();
+			summary.threadId = OpenThreads::Thread::CurrentThreadId();
+			summary.frameNumber = currentFrameNumber();
+			summary.length = (unsigned short)std::snprintf( summary.text, MaxMessage,
+				"[AsyncLogFileHandler] dropped %lu messages, truncated %lu\n", _dropped.load(), _truncated.load() );
+
+			_batch.clear();
+			if ( _format == BINARY )
+				appendRecord( summary );
+			else
+				_batch.append( summary.text, summary.length );
+			_log.write( _batch.data(), _batch.size() );
+		}
+		_log.close();
+	}
+
+	//producer side, called from any thread
+	virtual void notify( osg::NotifySeverity severity, const char* msg )
+	{
+		//still checked here: the notify level may have been raised after setSeverityThreshold()
+		if ( severity > _threshold.load( std::memory_order_relaxed ) )
+			return;
+
+		size_t length = std::strlen( msg );
+		if ( length > MaxMessage )
+		{
+			length = MaxMessage;
+			_truncated.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		//bounded MPMC queue after D. Vyukov: every slot carries a sequence number
+		//telling producers and the consumer whose turn it is
+		size_t pos = _enqueuePos.load( std::memory_order_relaxed );
+		Slot* slot;
+		for ( ;; )
+		{
+			slot = &_slots[pos & _mask];
+			size_t seq = slot -> sequence.load( std::memory_order_acquire );
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if ( diff == 0 )
+			{
+				if ( _enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+					break;
+			}
+			else if ( diff < 0 )
+			{
+				//ring is full, the writer is behind: drop rather than stall the frame
+				_dropped.fetch_add( 1, std::memory_order_relaxed );
+				return;
+			}
+			else
+			{
+				pos = _enqueuePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		std::memcpy( slot -> text, msg, length );
+		slot -> length = (unsigned short)length;
+		slot -> severity = severity;
+		slot -> timestamp = now();
+		slot -> threadId = OpenThreads::Thread::CurrentThreadId();
+		slot -> frameNumber = currentFrameNumber();
+		slot -> sequence.store( pos + 1, std::memory_order_release );
+
+		//pairs with the fence in waitForMessages(): either the writer sees this message before
+		//it sleeps, or this sees it sleeping
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if ( _sleeping.load( std::memory_order_relaxed ) )
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			if ( _sleeping.load( std::memory_order_relaxed ) )
+			{
+				_sleeping.store( false, std::memory_order_relaxed );
+				_wakeUp.signal();
+			}
+		}
+	}
+
+	unsigned long getNumWritten() const { return _written.load(); }
+	unsigned long getNumDropped() const { return _dropped.load(); }
+	unsigned long getNumTruncated() const { return _truncated.load(); }
+
+protected:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		osg::NotifySeverity severity;
+		uint64_t timestamp;
+		uint64_t threadId;
+		unsigned int frameNumber;
+		unsigned short length;
+		char text[MaxMessage];
+	};
+
+	class WriterThread : public OpenThreads::Thread
+	{
+	public:
+		WriterThread( AsyncLogFileHandler* handler ) : _handler( handler ) {}
+
+		virtual void run()
+		{
+			while ( !_handler -> _done.load( std::memory_order_acquire ) )
+			{
+				//nothing queued: sleep until a producer wakes us
+				if ( _handler -> drain() == 0 )
+					_handler -> waitForMessages();
+			}
+		}
+
+	protected:
+		AsyncLogFileHandler* _handler;
+	};
+
+	//consumer side, only ever called from the writer thread (or the destructor after join)
+	//copies up to _batchSize messages out of the ring, then writes them with a single stream call
+	unsigned int drain()
+	{
+		_batch.clear();
+
+		unsigned int count = 0;
+		size_t pos = _dequeuePos.load( std::memory_order_relaxed );
+		while ( count < _batchSize )
+		{
+			Slot& slot = _slots[pos & _mask];
+			size_t seq = slot.sequence.load( std::memory_order_acquire );
+			if ( (intptr_t)seq - (intptr_t)( pos + 1 ) < 0 )
+				break;
+
+			if ( _format == BINARY )
+				appendRecord( slot );
+			else
+				_batch.append( slot.text, slot.length );
+			slot.sequence.store( pos + _mask + 1, std::memory_order_release );
+			++pos;
+			++count;
+		}
+		_dequeuePos.store( pos, std::memory_order_relaxed );
+
+		if ( count > 0 )
+		{
+			_log.write( _batch.data(), _batch.size() );
+			_log.flush();
+			_written.fetch_add( count, std::memory_order_relaxed );
+		}
+		return count;
+	}
+
+	//writer thread: block until a message is queued or the handler is destroyed
+	void waitForMessages()
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		_sleeping.store( true, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		while ( _sleeping.load( std::memory_order_relaxed ) && !_done.load( std::memory_order_acquire ) && !hasQueued() )
+			_wakeUp.wait( &_mutex );
+		_sleeping.store( false, std::memory_order_relaxed );
+	}
+
+	bool hasQueued() const
+	{
+		size_t pos = _dequeuePos.load( std::memory_order_relaxed );
+		return _slots[pos & _mask].sequence.load( std::memory_order_acquire ) == pos + 1;
+	}
+
+	static uint64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	unsigned int currentFrameNumber() const
+	{
+		const osg::FrameStamp* frameStamp = _frameStamp.load( std::memory_order_acquire );
+		return frameStamp ? frameStamp -> getFrameNumber()
+		                  : _frameNumber.load( std::memory_order_relaxed );
+	}
+
+	void appendRecord( const Slot& slot )
+	{
+		BinaryLogRecord record;
+		record.timestamp = slot.timestamp;
+		record.threadId = slot.threadId;
+		record.frameNumber = slot.frameNumber;
+		record.length = slot.length;
+		record.severity = (uint8_t)slot.severity;
+		record.reserved = 0;
+
+		_batch.append( (const char*)&record, sizeof(record) );
+		_batch.append( slot.text, slot.length );
+		_batch.append( BinaryLog::paddedSize( slot.length ) - sizeof(record) - slot.length, '\0' );
+	}
+
+	static unsigned int roundUpPowerOfTwo( unsigned int value )
+	{
+		unsigned int result = 2;
+		while ( result < value ) result <<= 1;
+		return result;
+	}
+
+	size_t _mask;
+	std::vector<Slot> _slots;
+	//producers hammer _enqueuePos, the writer _dequeuePos: at least a cache line apart
+	//so the two sides do not invalidate each other's line on every message
+	std::atomic<size_t> _enqueuePos;
+	char _enqueuePadding[CacheLine - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> _dequeuePos;
+	char _dequeuePadding[CacheLine - sizeof(std::atomic<size_t>)];
+	unsigned int _batchSize;
+	std::string _batch;
+	Format _format;
+
+	std::atomic<int> _threshold;
+	std::atomic<const osg::FrameStamp*> _frameStamp;
+	std::atomic<unsigned int> _frameNumber;
+
+	std::atomic<unsigned long> _written;
+	std::atomic<unsigned long> _dropped;
+	std::atomic<unsigned long> _truncated;
+
+	//the writer's sleep: set by it under _mutex, cleared by the producer that wakes it
+	OpenThreads::Mutex _mutex;
+	OpenThreads::Condition _wakeUp;
+	std::atomic<bool> _sleeping;
+	std::atomic<bool> _done;
+
+	std::ofstream _log;
+	WriterThread _writer;
+};
@@ -0,0 +1,59 @@
+#ifndef BINARY_LOG_FORMAT_H
+#define BINARY_LOG_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+
+//on-disk layout of the binary log written by AsyncLogFileHandler in BINARY mode
+//and read back by LogReader.
+//
+//	file   := BinaryLogFileHeader record*
+//	record := BinaryLogRecord message[length] padding
+//
+//the padding rounds every record up to 8 bytes so a reader can walk a memory-mapped file
+//and cast each record in place without copying.
+
+struct BinaryLogFileHeader
+{
+	char magic[8];			//"OSGBLOG"
+	uint32_t version;
+	uint32_t recordAlignment;
+};
+
+struct BinaryLogRecord
+{
+	uint64_t timestamp;		//monotonic clock, nanoseconds
+	uint64_t threadId;
+	uint32_t frameNumber;
+	uint16_t length;		//message bytes following this header
+	uint8_t severity;		//osg::NotifySeverity
+	uint8_t reserved;
+};
+
+namespace BinaryLog
+{
+	static const uint32_t Version = 1;
+	static const uint32_t Alignment = 8;
+
+	inline BinaryLogFileHeader makeHeader()
+	{
+		BinaryLogFileHeader header;
+		std::memset( &header, 0, sizeof(header) );
+		std::memcpy( header.magic, "OSGBLOG", 8 );
+		header.version = Version;
+		header.recordAlignment = Alignment;
+		return header;
+	}
+
+	inline bool isValidHeader( const BinaryLogFileHeader& header )
+	{
+		return std::memcmp( header.magic, "OSGBLOG", 8 ) == 0 && header.version == Version;
+	}
+
+	inline uint32_t paddedSize( uint32_t length )
+	{
+		return ( sizeof(BinaryLogRecord) + length + Alignment - 1 ) & ~( Alignment - 1 );
+	}
+}
+
+#endif
@@ -0,0 +1,98 @@
+//microbenchmark: synchronous LogFileHandler vs. AsyncLogFileHandler
+//
+// 1. throughput: how many messages per second the emitting thread can push through notify()
+// 2. frame time: a fake frame loop does a fixed amount of work and logs a burst of INFO lines,
+//    we record every frame time and print the median and the 99th percentile
+//
+//usage: LogBenchmark [--messages N] [--frames N] [--per-frame N]
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "LogFileHandler.h"
+#include "AsyncLogFileHandler.h"
+
+static const char* s_message = "Info: CullVisitor::apply(Geode&) pushed drawable onto the render bin\n";
+
+//seconds the emitting thread spends pushing numMessages through notify()
+double measureSubmit( osg::NotifyHandler* handler, unsigned int numMessages )
+{
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	for ( unsigned int i = 0; i < numMessages; ++i )
+		handler -> notify( osg::INFO, s_message );
+	return osg::Timer::instance() -> delta_s( start, osg::Timer::instance() -> tick() );
+}
+
+//stand-in for update/cull work so the frame is not only logging
+float simulateFrameWork()
+{
+	float sum = 0.0f;
+	for ( int i = 0; i < 20000; ++i )
+		sum += std::sqrt( (float)i );
+	return sum;
+}
+
+void measureFrames( osg::NotifyHandler* handler, unsigned int numFrames, unsigned int perFrame,
+                    double& median, double& p99 )
+{
+	std::vector<double> frameTimes;
+	frameTimes.reserve( numFrames );
+
+	volatile float sink = 0.0f;
+	for ( unsigned int f = 0; f < numFrames; ++f )
+	{
+		osg::Timer_t start = osg::Timer::instance() -> tick();
+		sink = sink + simulateFrameWork();
+		for ( unsigned int i = 0; i < perFrame; ++i )
+			handler -> notify( osg::INFO, s_message );
+		frameTimes.push_back( osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() ) );
+	}
+
+	std::sort( frameTimes.begin(), frameTimes.end() );
+	median = frameTimes[frameTimes.size() / 2];
+	p99 = frameTimes[std::min( frameTimes.size() - 1, (size_t)( frameTimes.size() * 0.99 ) )];
+}
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int numMessages = 1000000, numFrames = 2000, perFrame = 200;
+	arguments.read( "--messages", numMessages );
+	arguments.read( "--frames", numFrames );
+	arguments.read( "--per-frame", perFrame );
+
+	double median = 0.0, p99 = 0.0;
+
+	{
+		osg::ref_ptr<LogFileHandler> sync = new LogFileHandler( "bench_sync.txt" );
+		std::cout << "LogFileHandler (sync)" << std::endl;
+		std::cout << "  messages/s:     " << numMessages / measureSubmit( sync.get(), numMessages ) << std::endl;
+		measureFrames( sync.get(), numFrames, perFrame, median, p99 );
+		std::cout << "  frame median:   " << median << " ms" << std::endl;
+		std::cout << "  frame p99:      " << p99 << " ms" << std::endl;
+	}
+
+	{
+		osg::ref_ptr<AsyncLogFileHandler> async = new AsyncLogFileHandler( "bench_async.txt" );
+		std::cout << "AsyncLogFileHandler" << std::endl;
+		//a full ring drops instead of blocking: only what got into the ring counts as delivered
+		double seconds = measureSubmit( async.get(), numMessages );
+		unsigned long dropped = async -> getNumDropped();
+		std::cout << "  delivered/s:    " << ( numMessages - dropped ) / seconds << std::endl;
+		std::cout << "  dropped:        " << dropped << " of " << numMessages << std::endl;
+		measureFrames( async.get(), numFrames, perFrame, median, p99 );
+		std::cout << "  frame median:   " << median << " ms" << std::endl;
+		std::cout << "  frame p99:      " << p99 << " ms" << std::endl;
+		std::cout << "  frame drops:    " << async -> getNumDropped() - dropped << std::endl;
+	}
+
+	std::remove( "bench_sync.txt" );
+	std::remove( "bench_async.txt" );
+	return 0;
+}
@@ -0,0 +1,187 @@
+//LogReader
+//reads the binary log written by AsyncLogFileHandler in BINARY mode.
+//the file is memory-mapped and the records are walked in place, so filtering
+//or aggregating a multi-gigabyte log only costs one sequential pass over the pages.
+//
+//usage: LogReader output.osglog [options]
+//	--severity N		only records at least this severe (0 = ALWAYS ... 6 = DEBUG_FP)
+//	--frames FIRST LAST	only records stamped with a frame number in [FIRST, LAST]
+//	--thread ID		only records emitted by this thread id
+//	--grep TEXT		only records whose message contains TEXT
+//	--stats			print per-severity / per-thread / per-frame aggregates instead of the records
+
+#include <osg/ArgumentParser>
+#include <osg/Notify>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "BinaryLogFormat.h"
+
+static const char* s_severityNames[] = { "ALWAYS", "FATAL", "WARN", "NOTICE", "INFO", "DEBUG_INFO", "DEBUG_FP" };
+
+struct RecordFilter
+{
+	RecordFilter()
+		: maxSeverity( osg::DEBUG_FP ), firstFrame( 0 ), lastFrame( UINT_MAX ), thread( 0 ), useThread( false ) {}
+
+	bool accept( const BinaryLogRecord& record, const char* message ) const
+	{
+		if ( record.severity > maxSeverity ) return false;
+		if ( record.frameNumber < firstFrame || record.frameNumber > lastFrame ) return false;
+		if ( useThread && record.threadId != thread ) return false;
+		if ( !text.empty() &&
+		     std::search( message, message + record.length, text.begin(), text.end() ) == message + record.length )
+			return false;
+		return true;
+	}
+
+	unsigned int maxSeverity;
+	unsigned int firstFrame, lastFrame;
+	uint64_t thread;
+	bool useThread;
+	std::string text;
+};
+
+struct RecordStats
+{
+	RecordStats() : total( 0 ), firstTimestamp( 0 ), lastTimestamp( 0 ) {}
+
+	void add( const BinaryLogRecord& record )
+	{
+		if ( total == 0 ) firstTimestamp = record.timestamp;
+		lastTimestamp = std::max( lastTimestamp, record.timestamp );
+		++total;
+		++perSeverity[record.severity];
+		++perThread[record.threadId];
+		++perFrame[record.frameNumber];
+	}
+
+	void print() const
+	{
+		std::cout << "records:  " << total << std::endl;
+		std::cout << "duration: " << ( lastTimestamp - firstTimestamp ) * 1e-9 << " s" << std::endl;
+
+		std::cout << "by severity:" << std::endl;
+		for ( std::map<unsigned int, unsigned long>::const_iterator itr = perSeverity.begin(); itr != perSeverity.end(); ++itr )
+		{
+			const char* name = itr -> first <= osg::DEBUG_FP ? s_severityNames[itr -> first] : "?";
+			std::cout << "  " << name << ": " << itr -> second << std::endl;
+		}
+
+		std::cout << "by thread:" << std::endl;
+		for ( std::map<uint64_t, unsigned long>::const_iterator itr = perThread.begin(); itr != perThread.end(); ++itr )
+			std::cout << "  " << itr -> first << ": " << itr -> second << std::endl;
+
+		if ( !perFrame.empty() )
+		{
+			unsigned long busiest = 0, busiestFrame = 0;
+			for ( std::map<unsigned int, unsigned long>::const_iterator itr = perFrame.begin(); itr != perFrame.end(); ++itr )
+			{
+				if ( itr -> second > busiest ) { busiest = itr -> second; busiestFrame = itr -> first; }
+			}
+			std::cout << "frames:   " << perFrame.begin() -> first << " - " << perFrame.rbegin() -> first
+			          << " (" << perFrame.size() << " with records)" << std::endl;
+			std::cout << "busiest:  frame " << busiestFrame << " with " << busiest << " records" << std::endl;
+		}
+	}
+
+	unsigned long total;
+	uint64_t firstTimestamp, lastTimestamp;
+	std::map<unsigned int, unsigned long> perSeverity;
+	std::map<uint64_t, unsigned long> perThread;
+	std::map<unsigned int, unsigned long> perFrame;
+};
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+
+	RecordFilter filter;
+	arguments.read( "--severity", filter.maxSeverity );
+	arguments.read( "--frames", filter.firstFrame, filter.lastFrame );
+	std::string thread;
+	if ( arguments.read( "--thread", thread ) )
+	{
+		filter.thread = std::strtoull( thread.c_str(), 0, 10 );
+		filter.useThread = true;
+	}
+	arguments.read( "--grep", filter.text );
+	bool statsOnly = arguments.read( "--stats" );
+
+	if ( arguments.argc() < 2 )
+	{
+		std::cerr << "usage: " << arguments.getApplicationName()
+		          << " file.osglog [--severity N] [--frames FIRST LAST] [--thread ID] [--grep TEXT] [--stats]" << std::endl;
+		return -1;
+	}
+
+	const char* filename = arguments[1];
+	int fd = open( filename, O_RDONLY );
+	struct stat info;
+	if ( fd < 0 || fstat( fd, &info ) != 0 || (size_t)info.st_size < sizeof(BinaryLogFileHeader) )
+	{
+		std::cerr << filename << ": cannot open binary log" << std::endl;
+		return -1;
+	}
+
+	size_t size = info.st_size;
+	const char* data = (const char*)mmap( 0, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( data == MAP_FAILED )
+	{
+		std::cerr << filename << ": mmap failed" << std::endl;
+		return -1;
+	}
+	madvise( (void*)data, size, MADV_SEQUENTIAL );
+
+	if ( !BinaryLog::isValidHeader( *(const BinaryLogFileHeader*)data ) )
+	{
+		std::cerr << filename << ": not a binary OSG log" << std::endl;
+		munmap( (void*)data, size );
+		return -1;
+	}
+
+	RecordStats stats;
+	const char* pos = data + sizeof(BinaryLogFileHeader);
+	const char* end = data + size;
+	while ( pos + sizeof(BinaryLogRecord) <= end )
+	{
+		const BinaryLogRecord& record = *(const BinaryLogRecord*)pos;
+		const char* message = pos + sizeof(BinaryLogRecord);
+		if ( message + record.length > end )
+			break;	//truncated tail, e.g. the application was killed mid-write
+
+		if ( filter.accept( record, message ) )
+		{
+			if ( statsOnly )
+			{
+				stats.add( record );
+			}
+			else
+			{
+				std::printf( "%u\t%.6f\t%llu\t%s\t%.*s", record.frameNumber, record.timestamp * 1e-9,
+				             (unsigned long long)record.threadId,
+				             record.severity <= osg::DEBUG_FP ? s_severityNames[record.severity] : "?",
+				             (int)record.length, message );
+			}
+		}
+		pos += BinaryLog::paddedSize( record.length );
+	}
+
+	if ( statsOnly )
+		stats.print();
+
+	munmap( (void*)data, size );
+	return 0;
+}
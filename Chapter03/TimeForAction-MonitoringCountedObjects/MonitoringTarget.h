@@ -2,7 +2,14 @@
 #include <osg/Referenced>
 #include <iostream>
 
-class MonitoringTarget : public osg::Referenced
+#include <vector>
+
+#include "ObjectCensus.h"
+#include "ObjectPool.h"
+
+//counted by ObjectCensus: live/peak instances and allocation rate show up in the census report
+//allocated from SmallObjectPool: memory is recycled into a free list once the ref count drops to zero
+class MonitoringTarget : public CensusCounted< MonitoringTarget, PooledReferenced<MonitoringTarget> >
 {
 public:
 	MonitoringTarget( int id ) : _id(id)
@@ -10,12 +17,19 @@ public:
 		std::cout << "Constructing target: " << _id << std::endl;
 	}
 
-	MonitoringTarget* createMonitoringTarget( unsigned int id )
+	static MonitoringTarget* createMonitoringTarget( unsigned int id )
 	{
 		osg::ref_ptr<MonitoringTarget> target = new MonitoringTarget(id);
 		return target.release();
 	}
 
+	//batch version: count targets with ids firstId, firstId+1, ... laid out next to each other in memory
+	static void createMonitoringTargets( unsigned int firstId, unsigned int count,
+	                                     std::vector< osg::ref_ptr<MonitoringTarget> >& targets )
+	{
+		createSequence( count, targets, firstId );
+	}
+
 protected:
 	virtual ~MonitoringTarget()
 	{
@@ -0,0 +1,347 @@
+#ifndef OBJECT_CENSUS_H
+#define OBJECT_CENSUS_H
+
+#include <osg/Drawable>
+#include <osg/FrameStamp>
+#include <osg/Geode>
+#include <osg/NodeCallback>
+#include <osg/NodeVisitor>
+#include <osg/StateSet>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+//ObjectCensus
+//live object-lifetime statistics per class: live count, peak count and allocation rate.
+//
+//two sources feed it:
+//	- classes deriving from CensusCounted<T> report every construction and destruction.
+//	  the hot path only bumps a counter owned by the calling thread, nothing is shared.
+//	- the scene graph is sampled by class name (nodes, drawables, state sets), because
+//	  osg::Referenced itself gives us no hook into the library's own constructors.
+//merge() folds the per-thread counters together once per frame (see CensusCallback),
+//report() prints the classes sorted by live count, with their growth since the first merge,
+//so whatever keeps growing under load ends up at the top.
+
+class ObjectCensus
+{
+public:
+	enum { MaxClasses = 256, OtherClass = MaxClasses - 1 };
+
+	struct ClassStats
+	{
+		ClassStats() : live( 0 ), peak( 0 ), created( 0 ), baseline( 0 ), rate( 0.0 ), sampled( false ) {}
+
+		std::string name;
+		long live;
+		long peak;
+		long created;		//total constructions (instrumented classes only)
+		long baseline;		//live count at the first merge
+		double rate;		//constructions per second (instrumented) or growth per second (sampled)
+		bool sampled;		//counted from the scene graph instead of constructors
+	};
+
+	static ObjectCensus* instance()
+	{
+		static ObjectCensus s_census;
+		return &s_census;
+	}
+
+	unsigned int registerClass( const std::string& name )
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		for ( unsigned int i = 0; i < _names.size(); ++i )
+		{
+			if ( _names[i] == name ) return i;
+		}
+		//the last slot is kept for <other>, real classes never share it
+		if ( _names.size() >= OtherClass )
+		{
+			OSG_WARN << "ObjectCensus: too many classes, " << name << " is counted as <other>" << std::endl;
+			if ( _names.size() == OtherClass ) _names.push_back( "<other>" );
+			return OtherClass;
+		}
+		_names.push_back( name );
+		return _names.size() - 1;
+	}
+
+	//hot path: only the calling thread's own counters are touched. they have a single writer,
+	//so a relaxed load + store is enough and no locked read-modify-write is needed
+	static void constructed( unsigned int classId ) { increment( threadCounters() -> created[classId] ); }
+	static void destroyed( unsigned int classId ) { increment( threadCounters() -> destroyed[classId] ); }
+
+	//sum up the per-thread counters, update peaks and rates. call once per frame.
+	void merge( double time )
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+
+		std::vector<long> created( _names.size(), 0 ), destroyed( _names.size(), 0 );
+		for ( unsigned int t = 0; t < _threads.size(); ++t )
+		{
+			for ( unsigned int i = 0; i < _names.size(); ++i )
+			{
+				created[i] += _threads[t] -> created[i].load( std::memory_order_relaxed );
+				destroyed[i] += _threads[t] -> destroyed[i].load( std::memory_order_relaxed );
+			}
+		}
+
+		double dt = _lastMerge < 0.0 ? 0.0 : time - _lastMerge;
+		for ( unsigned int i = 0; i < _names.size(); ++i )
+		{
+			ClassStats& stats = _stats[_names[i]];
+			bool first = stats.name.empty();
+			stats.name = _names[i];
+			if ( dt > 0.0 ) stats.rate = ( created[i] - stats.created ) / dt;
+			stats.created = created[i];
+			stats.live = created[i] - destroyed[i];
+			stats.peak = std::max( stats.peak, stats.live );
+			if ( first ) stats.baseline = stats.live;
+		}
+		_lastMerge = time;
+	}
+
+	//count the unique nodes, drawables and state sets reachable from root by class name
+	void sampleScene( osg::Node* root, double time );
+
+	void report( std::ostream& out )
+	{
+		std::vector<ClassStats> sorted;
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			for ( std::map<std::string, ClassStats>::const_iterator itr = _stats.begin(); itr != _stats.end(); ++itr )
+				sorted.push_back( itr -> second );
+		}
+		std::sort( sorted.begin(), sorted.end(), sortByLive );
+
+		out << "---- object census ----" << std::endl;
+		out << std::setw(40) << std::left << "class" << std::right
+		    << std::setw(10) << "live" << std::setw(10) << "peak"
+		    << std::setw(10) << "growth" << std::setw(12) << "rate/s" << std::endl;
+		for ( unsigned int i = 0; i < sorted.size(); ++i )
+		{
+			const ClassStats& stats = sorted[i];
+			out << std::setw(40) << std::left << ( stats.sampled ? "(scene) " : "" ) + stats.name << std::right
+			    << std::setw(10) << stats.live << std::setw(10) << stats.peak
+			    << std::setw(10) << stats.live - stats.baseline
+			    << std::setw(12) << std::fixed << std::setprecision(1) << stats.rate << std::endl;
+		}
+	}
+
+	void setReportAtExit( bool flag ) { _reportAtExit = flag; }
+
+protected:
+	struct ThreadCounters
+	{
+		ThreadCounters()
+		{
+			for ( unsigned int i = 0; i < MaxClasses; ++i )
+			{
+				created[i].store( 0, std::memory_order_relaxed );
+				destroyed[i].store( 0, std::memory_order_relaxed );
+			}
+		}
+
+		std::atomic<long> created[MaxClasses];
+		std::atomic<long> destroyed[MaxClasses];
+	};
+
+	ObjectCensus() : _lastMerge( -1.0 ), _lastSample( -1.0 ), _reportAtExit( false ) {}
+
+	~ObjectCensus()
+	{
+		if ( _reportAtExit )
+		{
+			merge( _lastMerge < 0.0 ? 0.0 : _lastMerge );
+			report( std::cout );
+		}
+	}
+
+	//the counters are never freed: objects may still be destroyed during static destruction,
+	//and a thread that exited still has to contribute its totals
+	static ThreadCounters* threadCounters()
+	{
+		static thread_local ThreadCounters* t_counters = 0;
+		if ( !t_counters )
+		{
+			t_counters = new ThreadCounters;
+			ObjectCensus* census = instance();
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( census -> _mutex );
+			census -> _threads.push_back( t_counters );
+		}
+		return t_counters;
+	}
+
+	static void increment( std::atomic<long>& counter )
+	{
+		counter.store( counter.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+	}
+
+	static bool sortByLive( const ClassStats& lhs, const ClassStats& rhs )
+	{
+		return lhs.live > rhs.live;
+	}
+
+	OpenThreads::Mutex _mutex;
+	std::vector<std::string> _names;
+	std::vector<ThreadCounters*> _threads;
+	std::map<std::string, ClassStats> _stats;
+	double _lastMerge;
+	double _lastSample;
+	bool _reportAtExit;
+};
+
+//CensusVisitor
+//collects the unique scene objects below a node by libraryName::className.
+//shared subgraphs, drawables and state sets are only counted once.
+
+class CensusVisitor : public osg::NodeVisitor
+{
+public:
+	CensusVisitor()
+	{
+		setTraversalMode( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN );
+	}
+
+	virtual void apply( osg::Node& node )
+	{
+		if ( !count( &node ) ) return;
+		countStateSet( node.getStateSet() );
+		traverse( node );
+	}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		if ( !count( &geode ) ) return;
+		countStateSet( geode.getStateSet() );
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+		{
+			osg::Drawable* drawable = geode.getDrawable( i );
+			if ( drawable && count( drawable ) )
+				countStateSet( drawable -> getStateSet() );
+		}
+	}
+
+	std::map<std::string, long> counts;
+
+protected:
+	bool count( osg::Object* object )
+	{
+		if ( !_visited.insert( object ).second ) return false;
+		++counts[std::string( object -> libraryName() ) + "::" + object -> className()];
+		return true;
+	}
+
+	void countStateSet( osg::StateSet* stateSet )
+	{
+		if ( stateSet ) count( stateSet );
+	}
+
+	std::set<osg::Object*> _visited;
+};
+
+inline void ObjectCensus::sampleScene( osg::Node* root, double time )
+{
+	CensusVisitor visitor;
+	if ( root ) root -> accept( visitor );
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+	double dt = _lastSample < 0.0 ? 0.0 : time - _lastSample;
+
+	//classes that vanished from the scene are still listed, with a live count of 0
+	for ( std::map<std::string, ClassStats>::iterator itr = _stats.begin(); itr != _stats.end(); ++itr )
+	{
+		if ( itr -> second.sampled && visitor.counts.find( itr -> second.name ) == visitor.counts.end() )
+			visitor.counts[itr -> second.name] = 0;
+	}
+
+	for ( std::map<std::string, long>::const_iterator itr = visitor.counts.begin(); itr != visitor.counts.end(); ++itr )
+	{
+		ClassStats& stats = _stats["(scene) " + itr -> first];
+		if ( stats.name.empty() )
+		{
+			stats.name = itr -> first;
+			stats.sampled = true;
+			stats.baseline = itr -> second;
+		}
+		if ( dt > 0.0 ) stats.rate = ( itr -> second - stats.live ) / dt;
+		stats.live = itr -> second;
+		stats.peak = std::max( stats.peak, stats.live );
+	}
+	_lastSample = time;
+}
+
+//CensusCounted
+//derive from this instead of the real base class to get a class counted by ObjectCensus:
+//	class MonitoringTarget : public CensusCounted<MonitoringTarget> {...};
+//	class DamagedPlane : public CensusCounted<DamagedPlane, osg::Group> {...};
+
+template<class T, class Base = osg::Referenced>
+class CensusCounted : public Base
+{
+public:
+	template<typename... Args>
+	CensusCounted( Args&&... args ) : Base( std::forward<Args>( args )... )
+	{
+		ObjectCensus::constructed( classId() );
+	}
+
+	static unsigned int classId()
+	{
+		static unsigned int s_id = ObjectCensus::instance() -> registerClass( className() );
+		return s_id;
+	}
+
+protected:
+	virtual ~CensusCounted()
+	{
+		ObjectCensus::destroyed( classId() );
+	}
+
+	static std::string className()
+	{
+		int status = 0;
+		char* demangled = abi::__cxa_demangle( typeid(T).name(), 0, 0, &status );
+		std::string name = ( status == 0 && demangled ) ? demangled : typeid(T).name();
+		std::free( demangled );
+		return name;
+	}
+};
+
+//CensusCallback
+//update callback for the scene root: merges the thread-local counters every frame
+//and re-samples the scene graph every sampleInterval frames (a full traversal is not free).
+
+class CensusCallback : public osg::NodeCallback
+{
+public:
+	CensusCallback( unsigned int sampleInterval = 60 )
+		: _sampleInterval( sampleInterval ), _frame( 0 ) {}
+
+	virtual void operator()( osg::Node* node, osg::NodeVisitor* nv )
+	{
+		double time = nv -> getFrameStamp() ? nv -> getFrameStamp() -> getReferenceTime() : 0.0;
+		ObjectCensus::instance() -> merge( time );
+		if ( _sampleInterval > 0 && ( _frame++ % _sampleInterval ) == 0 )
+			ObjectCensus::instance() -> sampleScene( node, time );
+		traverse( node, nv );
+	}
+
+protected:
+	unsigned int _sampleInterval;
+	unsigned int _frame;
+};
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+//SmallObjectPool
+//size-class allocator for small osg::Referenced objects that are created and destroyed
+//at a high rate (entity spawners, per-frame helper objects...).
+//
+//every request up to MaxSize bytes is rounded up to a multiple of Granularity and served
+//from the free list of that size class. each thread keeps its own cache of free blocks
+//per class, so the common case is a pointer pop/push without any lock. only when a
+//cache runs empty or overflows is a batch moved from/to the shared lists under a mutex.
+//memory comes from large slabs that are never handed back to the system, so a churning
+//workload keeps reusing the same pages instead of fragmenting the heap.
+//bigger requests simply go to ::operator new.
+
+class SmallObjectPool
+{
+public:
+	enum
+	{
+		Granularity = 16,
+		MaxSize = 512,
+		NumClasses = MaxSize / Granularity,
+		SlabSize = 64 * 1024,
+		CacheLimit = 128,	//blocks a thread may hold per class before giving half back
+		RefillCount = 32	//blocks fetched from the shared list when a cache is empty
+	};
+
+	static SmallObjectPool* instance()
+	{
+		//never destroyed: objects may still be released during static destruction
+		static SmallObjectPool* s_pool = new SmallObjectPool;
+		return s_pool;
+	}
+
+	static unsigned int sizeClass( size_t size ) { return ( size + Granularity - 1 ) / Granularity - 1; }
+	static size_t classSize( unsigned int sizeClass ) { return ( sizeClass + 1 ) * Granularity; }
+
+	void* allocate( size_t size )
+	{
+		if ( size > MaxSize || size == 0 )
+			return ::operator new( size );
+
+		unsigned int c = sizeClass( size );
+		ThreadCache* cache = threadCache();
+		if ( !cache )
+			return allocateShared( c );
+
+		if ( !cache -> head[c] )
+			refill( *cache, c );
+
+		FreeBlock* block = cache -> head[c];
+		cache -> head[c] = block -> next;
+		--cache -> count[c];
+		return block;
+	}
+
+	void deallocate( void* ptr, size_t size )
+	{
+		if ( !ptr ) return;
+		if ( size > MaxSize || size == 0 )
+		{
+			::operator delete( ptr );
+			return;
+		}
+
+		unsigned int c = sizeClass( size );
+		FreeBlock* block = static_cast<FreeBlock*>( ptr );
+		ThreadCache* cache = threadCache();
+		if ( !cache )
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			block -> next = _shared[c];
+			_shared[c] = block;
+			return;
+		}
+
+		block -> next = cache -> head[c];
+		cache -> head[c] = block;
+		if ( ++cache -> count[c] > CacheLimit )
+			flush( *cache, c, CacheLimit / 2 );
+	}
+
+	//count blocks of one size class (size <= MaxSize) that are adjacent in memory, for createN().
+	//they are carved straight from a slab and later freed one by one like any other block.
+	void* allocateContiguous( size_t size, unsigned int count )
+	{
+		unsigned int c = sizeClass( size );
+		size_t bytes = classSize( c ) * count;
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		Slab& slab = _slabs[c];
+		if ( slab.end - slab.current < (ptrdiff_t)bytes )
+			newSlab( c, bytes );
+		char* result = slab.current;
+		slab.current += bytes;
+		return result;
+	}
+
+	size_t getReservedBytes() const { return _reservedBytes.load( std::memory_order_relaxed ); }
+
+protected:
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct Slab
+	{
+		Slab() : current( 0 ), end( 0 ) {}
+		char* current;
+		char* end;
+	};
+
+	struct ThreadCache
+	{
+		ThreadCache()
+		{
+			for ( unsigned int c = 0; c < NumClasses; ++c )
+			{
+				head[c] = 0;
+				count[c] = 0;
+			}
+		}
+
+		//a finished thread hands everything it still caches back to the shared lists
+		~ThreadCache()
+		{
+			SmallObjectPool* pool = instance();
+			for ( unsigned int c = 0; c < NumClasses; ++c )
+				pool -> flush( *this, c, count[c] );
+			threadCacheDestroyed() = true;
+		}
+
+		FreeBlock* head[NumClasses];
+		unsigned int count[NumClasses];
+	};
+
+	SmallObjectPool() : _reservedBytes( 0 )
+	{
+		for ( unsigned int c = 0; c < NumClasses; ++c )
+			_shared[c] = 0;
+	}
+
+	//0 once the calling thread's cache has been torn down (thread exit, static destruction)
+	static ThreadCache* threadCache()
+	{
+		if ( threadCacheDestroyed() ) return 0;
+		static thread_local ThreadCache t_cache;
+		return &t_cache;
+	}
+
+	static bool& threadCacheDestroyed()
+	{
+		static thread_local bool t_destroyed = false;
+		return t_destroyed;
+	}
+
+	void* allocateShared( unsigned int c )
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		if ( !_shared[c] )
+			carve( c, 1 );
+		FreeBlock* block = _shared[c];
+		_shared[c] = block -> next;
+		return block;
+	}
+
+	void refill( ThreadCache& cache, unsigned int c )
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		unsigned int moved = 0;
+		while ( moved < RefillCount )
+		{
+			if ( !_shared[c] )
+				carve( c, RefillCount - moved );
+
+			FreeBlock* block = _shared[c];
+			_shared[c] = block -> next;
+			block -> next = cache.head[c];
+			cache.head[c] = block;
+			++moved;
+		}
+		cache.count[c] += moved;
+	}
+
+	void flush( ThreadCache& cache, unsigned int c, unsigned int numBlocks )
+	{
+		if ( numBlocks == 0 ) return;
+
+		//unlink the first numBlocks blocks, then splice them into the shared list in one go
+		FreeBlock* first = cache.head[c];
+		FreeBlock* last = first;
+		for ( unsigned int i = 1; i < numBlocks; ++i )
+			last = last -> next;
+		cache.head[c] = last -> next;
+		cache.count[c] -= numBlocks;
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		last -> next = _shared[c];
+		_shared[c] = first;
+	}
+
+	//move up to count fresh blocks from the class slab onto the shared free list (mutex held)
+	void carve( unsigned int c, unsigned int count )
+	{
+		size_t size = classSize( c );
+		Slab& slab = _slabs[c];
+		if ( slab.end - slab.current < (ptrdiff_t)size )
+			newSlab( c, size );
+
+		for ( unsigned int i = 0; i < count && slab.end - slab.current >= (ptrdiff_t)size; ++i )
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>( slab.current );
+			slab.current += size;
+			block -> next = _shared[c];
+			_shared[c] = block;
+		}
+	}
+
+	//start a new slab for class c with room for at least minBytes (mutex held).
+	//whatever is left of the old slab is not wasted but put on the free list.
+	void newSlab( unsigned int c, size_t minBytes )
+	{
+		size_t size = classSize( c );
+		Slab& slab = _slabs[c];
+		while ( slab.end - slab.current >= (ptrdiff_t)size )
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>( slab.current );
+			slab.current += size;
+			block -> next = _shared[c];
+			_shared[c] = block;
+		}
+
+		size_t bytes = SlabSize - SlabSize % size;
+		if ( bytes < minBytes ) bytes = minBytes;
+		slab.current = static_cast<char*>( ::operator new( bytes ) );
+		slab.end = slab.current + bytes;
+		_reservedBytes.fetch_add( bytes, std::memory_order_relaxed );
+	}
+
+	OpenThreads::Mutex _mutex;
+	FreeBlock* _shared[NumClasses];
+	Slab _slabs[NumClasses];
+	std::atomic<size_t> _reservedBytes;
+};
+
+//PooledReferenced
+//derive from this instead of the real base class to allocate a class from SmallObjectPool:
+//	class Entity : public PooledReferenced<Entity> {...};
+//osg::Referenced deletes an object through its virtual destructor once the reference count
+//drops to zero, so the sized operator delete below receives the size of the most derived
+//class and the block goes straight back to the right free list.
+
+template<class T, class Base = osg::Referenced>
+class PooledReferenced : public Base
+{
+public:
+	template<typename... Args>
+	PooledReferenced( Args&&... args ) : Base( std::forward<Args>( args )... ) {}
+
+	static void* operator new( size_t size ) { return SmallObjectPool::instance() -> allocate( size ); }
+	static void operator delete( void* ptr, size_t size ) { SmallObjectPool::instance() -> deallocate( ptr, size ); }
+
+	//construct count objects side by side in one run of pool memory and append them to result.
+	//each one is still reference counted and released on its own.
+	template<typename... Args>
+	static void createN( unsigned int count, std::vector< osg::ref_ptr<T> >& result, const Args&... args )
+	{
+		constructN( count, result, [&]( void* memory, unsigned int ) { return ::new ( memory ) T( args... ); } );
+	}
+
+	//same, but object i is constructed as T( first + i ), e.g. with consecutive ids
+	static void createSequence( unsigned int count, std::vector< osg::ref_ptr<T> >& result, unsigned int first )
+	{
+		constructN( count, result, [&]( void* memory, unsigned int i ) { return ::new ( memory ) T( first + i ); } );
+	}
+
+protected:
+	virtual ~PooledReferenced() {}
+
+	template<class Construct>
+	static void constructN( unsigned int count, std::vector< osg::ref_ptr<T> >& result, Construct construct )
+	{
+		result.reserve( result.size() + count );
+
+		//too big for the pool: every object has to be deletable on its own
+		if ( sizeof(T) > (size_t)SmallObjectPool::MaxSize )
+		{
+			for ( unsigned int i = 0; i < count; ++i )
+				result.push_back( construct( operator new( sizeof(T) ), i ) );
+			return;
+		}
+
+		size_t stride = SmallObjectPool::classSize( SmallObjectPool::sizeClass( sizeof(T) ) );
+		char* memory = static_cast<char*>( SmallObjectPool::instance() -> allocateContiguous( sizeof(T), count ) );
+		for ( unsigned int i = 0; i < count; ++i )
+			result.push_back( construct( memory + i * stride, i ) );
+	}
+};
+
+#endif
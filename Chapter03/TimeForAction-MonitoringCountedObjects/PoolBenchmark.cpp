@@ -0,0 +1,125 @@
+//benchmark: plain new/delete vs. SmallObjectPool for small osg::Referenced objects
+//
+//an entity spawner keeps a working set of live objects of three different sizes and keeps
+//replacing random ones, the way our spawner does at tens of thousands of objects per second.
+//every report interval it prints the allocation throughput and the resident set size,
+//so heap fragmentation shows up as RSS creeping up while the live set stays constant.
+//
+//run it once per allocator, RSS is per process:
+//	PoolBenchmark --seconds 600
+//	PoolBenchmark --seconds 600 --pooled
+//
+//options: --pooled  --seconds N (default 600)  --live N (default 200000)  --interval N (default 10)
+
+#include <osg/ArgumentParser>
+#include <osg/Referenced>
+#include <osg/Timer>
+
+#include <iostream>
+#include <vector>
+
+#include "ObjectPool.h"
+#include "ResidentMemory.h"
+
+template<int Bytes>
+class PlainEntity : public osg::Referenced
+{
+public:
+	PlainEntity( unsigned int id ) { _payload[0] = (char)id; }
+protected:
+	char _payload[Bytes];
+};
+
+template<int Bytes>
+class PooledEntity : public PooledReferenced< PooledEntity<Bytes> >
+{
+public:
+	PooledEntity( unsigned int id ) { _payload[0] = (char)id; }
+protected:
+	char _payload[Bytes];
+};
+
+//cheap deterministic random numbers, so both runs see the same sequence
+struct XorShift
+{
+	XorShift() : state( 2463534242u ) {}
+	unsigned int operator()() { state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; }
+	unsigned int state;
+};
+
+template<template<int> class Entity>
+osg::Referenced* spawn( unsigned int kind, unsigned int id )
+{
+	switch ( kind % 3 )
+	{
+	case 0: return new Entity<24>( id );
+	case 1: return new Entity<80>( id );
+	default: return new Entity<200>( id );
+	}
+}
+
+template<template<int> class Entity>
+void churn( unsigned int numLive, double seconds, double interval )
+{
+	XorShift random;
+	std::vector< osg::ref_ptr<osg::Referenced> > live( numLive );
+	for ( unsigned int i = 0; i < numLive; ++i )
+		live[i] = spawn<Entity>( random(), i );
+
+	std::cout << "after warm-up: " << residentMB() << " MB resident" << std::endl;
+	std::cout << "time[s]\tops/s\t\tRSS[MB]" << std::endl;
+
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	double nextReport = interval;
+	unsigned long ops = 0, opsAtReport = 0;
+	for ( ;; )
+	{
+		//replace a batch of random entities, the old object dies with its last ref_ptr
+		for ( unsigned int i = 0; i < 1024; ++i, ++ops )
+		{
+			unsigned int r = random();
+			live[r % numLive] = spawn<Entity>( r >> 8, (unsigned int)ops );
+		}
+
+		double elapsed = osg::Timer::instance() -> delta_s( start, osg::Timer::instance() -> tick() );
+		if ( elapsed >= nextReport )
+		{
+			std::cout << elapsed << "\t" << ( ops - opsAtReport ) / interval << "\t" << residentMB() << std::endl;
+			opsAtReport = ops;
+			nextReport += interval;
+		}
+		if ( elapsed >= seconds ) break;
+	}
+}
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	bool pooled = arguments.read( "--pooled" );
+	double seconds = 600.0, interval = 10.0;
+	unsigned int numLive = 200000;
+	arguments.read( "--seconds", seconds );
+	arguments.read( "--interval", interval );
+	arguments.read( "--live", numLive );
+
+	if ( pooled )
+	{
+		//batch creation: one contiguous run instead of numLive separate allocations
+		std::vector< osg::ref_ptr< PooledEntity<80> > > batch;
+		osg::Timer_t start = osg::Timer::instance() -> tick();
+		PooledEntity<80>::createSequence( numLive, batch, 0 );
+		std::cout << "createSequence(" << numLive << "): "
+		          << osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() ) << " ms" << std::endl;
+		batch.clear();
+
+		std::cout << "SmallObjectPool churn" << std::endl;
+		churn<PooledEntity>( numLive, seconds, interval );
+		std::cout << "pool slabs reserved: " << SmallObjectPool::instance() -> getReservedBytes() / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+	}
+	else
+	{
+		std::cout << "plain new/delete churn" << std::endl;
+		churn<PlainEntity>( numLive, seconds, interval );
+	}
+	return 0;
+}
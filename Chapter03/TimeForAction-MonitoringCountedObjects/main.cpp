@@ -1,10 +1,29 @@
 #include <osgDB/ReadFile>
+#include <osgGA/GUIEventHandler>
 #include <osgViewer/Viewer>
 
 #include <fstream>
 
 #include "MonitoringTarget.h"
 #include "LogFileHandler.h"
+#include "AsyncLogFileHandler.h"
+#include "ObjectCensus.h"
+#include "ParallelNodeLoader.h"
+
+//press 'c' to print the object census while the viewer is running
+class CensusReportHandler : public osgGA::GUIEventHandler
+{
+public:
+	virtual bool handle( const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa )
+	{
+		if ( ea.getEventType() == osgGA::GUIEventAdapter::KEYDOWN && ea.getKey() == 'c' )
+		{
+			ObjectCensus::instance() -> report( std::cout );
+			return true;
+		}
+		return false;
+	}
+};
 
 int main( int argc, char** argv )
 {
@@ -48,11 +67,27 @@ int main( int argc, char** argv )
 
 	//------------------------------------------------------------------------
 	//p.58 saving the log file
+	//LogFileHandler writes on whichever thread calls notify(), with INFO enabled
+	//that stalls cull and draw on disk I/O, so the messages go through the async ring buffer instead
 	osg::setNotifyLevel( osg::INFO );
-	osg::setNotifyHandler( new LogFileHandler( "output.txt" ) );
+	//osg::setNotifyHandler( new LogFileHandler( "output.txt" ) );
+	//osg::setNotifyHandler( new AsyncLogFileHandler( "output.txt" ) );
 
+	//binary records (severity, timestamp, thread, frame) instead of one big text file,
+	//read them back with: LogReader output.osglog --stats
 	osg::ArgumentParser arguments( &argc, argv );
-	osg::ref_ptr<osg::Node> root = osgDB::readNodeFiles( arguments );
+	osg::NotifySeverity logThreshold = osg::INFO;
+	int severity;
+	if ( arguments.read( "--log-severity", severity ) )
+		logThreshold = (osg::NotifySeverity)severity;
+
+	osg::ref_ptr<AsyncLogFileHandler> logHandler = new AsyncLogFileHandler( "output.osglog", AsyncLogFileHandler::BINARY );
+	logHandler -> setSeverityThreshold( logThreshold );
+	osg::setNotifyHandler( logHandler.get() );
+
+	//all model files on the command line are parsed at the same time, children keep their order
+	//osg::ref_ptr<osg::Node> root = osgDB::readNodeFiles( arguments );
+	osg::ref_ptr<osg::Node> root = readNodeFilesParallel( arguments );
 
 	if( !root )
 	{
@@ -60,8 +95,17 @@ int main( int argc, char** argv )
 		return -1;
 	}
 
+	//live per-class object counts, merged once per frame, sorted report at exit
+	ObjectCensus::instance() -> setReportAtExit( true );
+	root -> addUpdateCallback( new CensusCallback );
+
 	osgViewer::Viewer viewer;
 	viewer.setSceneData( root.get() );
-	return viewer.run();
+	viewer.addEventHandler( new CensusReportHandler );
+	logHandler -> setFrameStamp( viewer.getFrameStamp() );
+	int result = viewer.run();
+	//the handler outlives the viewer (osg keeps it until exit), it must not read its frame stamp
+	logHandler -> setFrameStamp( 0 );
+	return result;
 
 }
@@ -1,9 +1,11 @@
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
 
+#include "SceneCache.h"
+
 int main( int argc, char** argv )
 {
-	osg::ref_ptr<osg::Node> root = osgDB::readNodeFile("cessna.osg" ); 
+	osg::ref_ptr<osg::Node> root = readNodeFileCached("cessna.osg" ); 
 	// root variable, provides rt access to cessna.osg
 	
 	osgViewer::Viewer viewer;
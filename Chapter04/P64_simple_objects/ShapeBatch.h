@@ -0,0 +1,220 @@
+#ifndef SHAPE_BATCH_H
+#define SHAPE_BATCH_H
+
+#include <osg/Geometry>
+#include <osg/Program>
+#include <osg/Shader>
+#include <osg/VertexAttribDivisor>
+
+#include "ShapeMeshCache.h"
+
+//ShapeBatch
+//draws any number of shapes of one type with a single instanced draw call.
+//the unit mesh comes from ShapeMeshCache, every instance only adds its transform
+//(three vec4 rows of the affine matrix) and its colour as per-instance vertex attributes:
+//
+//	osg::ref_ptr<ShapeBatch> spheres = new ShapeBatch( ShapeMeshCache::SPHERE );
+//	spheres -> addShape( new osg::Sphere( pos, 0.5f ), color );
+//	geode -> addDrawable( spheres.get() );
+//
+//a small shader applies the instance transform and a headlight, so this needs GL 3.3 or
+//ARB_instanced_arrays. picking and triangle functors see every instance (see accept()).
+
+class ShapeBatch : public osg::Geometry
+{
+public:
+	enum
+	{
+		//attribute slots, clear of the ones nvidia aliases with the fixed function arrays
+		ROW0_ATTRIB = 10,
+		ROW1_ATTRIB = 11,
+		ROW2_ATTRIB = 12,
+		COLOR_ATTRIB = 13
+	};
+
+	ShapeBatch( ShapeMeshCache::ShapeType type = ShapeMeshCache::SPHERE, const osg::TessellationHints* hints = 0 )
+		: _type( type )
+	{
+		osg::Geometry* mesh = ShapeMeshCache::instance() -> getMesh( type, hints );
+		setUseDisplayList( false );
+		setUseVertexBufferObjects( true );
+		setVertexArray( mesh -> getVertexArray() );
+		setNormalArray( mesh -> getNormalArray(), osg::Array::BIND_PER_VERTEX );
+
+		//the instance count lives on the primitive set, so each batch (not each instance) copies the indices
+		osg::DrawElements* elements = mesh -> getPrimitiveSet( 0 ) -> getDrawElements();
+		addPrimitiveSet( static_cast<osg::PrimitiveSet*>( elements -> clone( osg::CopyOp::SHALLOW_COPY ) ) );
+		getPrimitiveSet( 0 ) -> setNumInstances( 0 );
+
+		for ( unsigned int i = ROW0_ATTRIB; i <= COLOR_ATTRIB; ++i )
+			setVertexAttribArray( i, new osg::Vec4Array, osg::Array::BIND_PER_VERTEX );
+
+		setStateSet( getInstancingStateSet() );
+		_unitBound = mesh -> getBoundingBox();
+	}
+
+	ShapeBatch( const ShapeBatch& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::Geometry( copy, copyop ), _type( copy._type ), _unitBound( copy._unitBound ) {}
+
+	META_Object( osg, ShapeBatch )
+
+	ShapeMeshCache::ShapeType getShapeType() const { return _type; }
+
+	unsigned int addInstance( const osg::Matrix& transform, const osg::Vec4& color )
+	{
+		for ( unsigned int i = ROW0_ATTRIB; i <= COLOR_ATTRIB; ++i )
+			instanceArray( i ) -> push_back( osg::Vec4() );
+		unsigned int index = getNumInstances() - 1;
+		setInstance( index, transform, color );
+		return index;
+	}
+
+	//false if the shape is not of this batch's type
+	bool addShape( const osg::Shape* shape, const osg::Vec4& color )
+	{
+		osg::Matrix transform;
+		if ( ShapeMeshCache::getShapeTransform( shape, transform ) != _type ) return false;
+		addInstance( transform, color );
+		return true;
+	}
+
+	void setInstance( unsigned int index, const osg::Matrix& m, const osg::Vec4& color )
+	{
+		//row j holds what is multiplied with ( x, y, z, 1 ) to get world coordinate j
+		for ( unsigned int j = 0; j < 3; ++j )
+			( *instanceArray( ROW0_ATTRIB + j ) )[index].set( m( 0, j ), m( 1, j ), m( 2, j ), m( 3, j ) );
+		( *instanceArray( COLOR_ATTRIB ) )[index] = color;
+		dirtyInstances();
+	}
+
+	unsigned int getNumInstances() const
+	{
+		return getVertexAttribArray( COLOR_ATTRIB ) -> getNumElements();
+	}
+
+	void clear()
+	{
+		for ( unsigned int i = ROW0_ATTRIB; i <= COLOR_ATTRIB; ++i )
+			instanceArray( i ) -> clear();
+		dirtyInstances();
+	}
+
+	//the union of all instance bounds instead of the unit mesh
+	virtual osg::BoundingBox computeBoundingBox() const
+	{
+		osg::BoundingBox bb;
+		for ( unsigned int i = 0; i < getNumInstances(); ++i )
+		{
+			osg::Matrix m = getInstanceMatrix( i );
+			for ( unsigned int c = 0; c < 8; ++c )
+				bb.expandBy( _unitBound.corner( c ) * m );
+		}
+		return bb;
+	}
+
+	//functors (picking, triangle collection...) get one transformed copy of the mesh per instance
+	virtual void accept( osg::PrimitiveFunctor& functor ) const
+	{
+		const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>( getVertexArray() );
+		std::vector<osg::Vec3> transformed( vertices -> size() );
+		for ( unsigned int i = 0; i < getNumInstances(); ++i )
+		{
+			osg::Matrix m = getInstanceMatrix( i );
+			for ( unsigned int v = 0; v < vertices -> size(); ++v )
+				transformed[v] = ( *vertices )[v] * m;
+			functor.setVertexArray( transformed.size(), &transformed.front() );
+			getPrimitiveSet( 0 ) -> accept( functor );
+		}
+	}
+
+	osg::Matrix getInstanceMatrix( unsigned int index ) const
+	{
+		osg::Matrix m;
+		for ( unsigned int j = 0; j < 3; ++j )
+		{
+			const osg::Vec4& row = ( *instanceArray( ROW0_ATTRIB + j ) )[index];
+			for ( unsigned int i = 0; i < 4; ++i ) m( i, j ) = row[i];
+		}
+		return m;
+	}
+
+	//program and attribute divisors, shared by all batches so they sort into one state
+	static osg::StateSet* getInstancingStateSet()
+	{
+		static osg::ref_ptr<osg::StateSet> s_stateSet = createInstancingStateSet();
+		return s_stateSet.get();
+	}
+
+protected:
+	virtual ~ShapeBatch() {}
+
+	static osg::StateSet* createInstancingStateSet()
+	{
+		static const char* vertexSource =
+			"#version 120\n"
+			"attribute vec4 instanceRow0;\n"
+			"attribute vec4 instanceRow1;\n"
+			"attribute vec4 instanceRow2;\n"
+			"attribute vec4 instanceColor;\n"
+			"varying vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	vec4 v = vec4( gl_Vertex.xyz, 1.0 );\n"
+			"	vec4 world = vec4( dot( instanceRow0, v ), dot( instanceRow1, v ), dot( instanceRow2, v ), 1.0 );\n"
+			//rotation * scale: dividing by the squared scale gives the inverse transpose
+			"	vec3 scale2 = instanceRow0.xyz * instanceRow0.xyz + instanceRow1.xyz * instanceRow1.xyz + instanceRow2.xyz * instanceRow2.xyz;\n"
+			"	vec3 n = gl_Normal / scale2;\n"
+			"	n = vec3( dot( instanceRow0.xyz, n ), dot( instanceRow1.xyz, n ), dot( instanceRow2.xyz, n ) );\n"
+			"	vec3 eyeNormal = normalize( gl_NormalMatrix * n );\n"
+			"	float diffuse = max( eyeNormal.z, 0.0 );\n"
+			"	color = vec4( instanceColor.rgb * ( 0.25 + 0.75 * diffuse ), instanceColor.a );\n"
+			"	gl_Position = gl_ModelViewProjectionMatrix * world;\n"
+			"}\n";
+
+		static const char* fragmentSource =
+			"#version 120\n"
+			"varying vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	gl_FragColor = color;\n"
+			"}\n";
+
+		osg::ref_ptr<osg::Program> program = new osg::Program;
+		program -> setName( "ShapeBatch" );
+		program -> addShader( new osg::Shader( osg::Shader::VERTEX, vertexSource ) );
+		program -> addShader( new osg::Shader( osg::Shader::FRAGMENT, fragmentSource ) );
+		program -> addBindAttribLocation( "instanceRow0", ROW0_ATTRIB );
+		program -> addBindAttribLocation( "instanceRow1", ROW1_ATTRIB );
+		program -> addBindAttribLocation( "instanceRow2", ROW2_ATTRIB );
+		program -> addBindAttribLocation( "instanceColor", COLOR_ATTRIB );
+
+		osg::ref_ptr<osg::StateSet> stateSet = new osg::StateSet;
+		stateSet -> setAttributeAndModes( program.get() );
+		for ( unsigned int i = ROW0_ATTRIB; i <= COLOR_ATTRIB; ++i )
+			stateSet -> setAttribute( new osg::VertexAttribDivisor( i, 1 ) );
+		return stateSet.release();
+	}
+
+	osg::Vec4Array* instanceArray( unsigned int attrib )
+	{
+		return static_cast<osg::Vec4Array*>( getVertexAttribArray( attrib ) );
+	}
+
+	const osg::Vec4Array* instanceArray( unsigned int attrib ) const
+	{
+		return static_cast<const osg::Vec4Array*>( getVertexAttribArray( attrib ) );
+	}
+
+	void dirtyInstances()
+	{
+		for ( unsigned int i = ROW0_ATTRIB; i <= COLOR_ATTRIB; ++i )
+			instanceArray( i ) -> dirty();
+		getPrimitiveSet( 0 ) -> setNumInstances( getNumInstances() );
+		dirtyBound();
+	}
+
+	ShapeMeshCache::ShapeType _type;
+	osg::BoundingBox _unitBound;
+};
+
+#endif
@@ -0,0 +1,196 @@
+//benchmark: 10k debug shapes as separate ShapeDrawables vs. cached meshes vs. instanced batches
+//
+//the same boxes, spheres and cones on a grid are built three ways:
+//	plain    one osg::ShapeDrawable per shape, each tessellating its own mesh (what P64 did)
+//	cached   one MatrixTransform per shape over a geometry sharing ShapeMeshCache's mesh
+//	batched  one ShapeBatch per shape type, drawn with a single instanced call each
+//for every mode it prints the build time, the draw calls per frame, the bytes of vertex and
+//index data actually held by the scene and the growth of the resident set size.
+//with --frames N the scene is also rendered for N frames and the mean frame time printed.
+//
+//run it once per mode, RSS is per process:
+//	ShapeBenchmark --mode plain --frames 500
+//	ShapeBenchmark --mode cached --frames 500
+//	ShapeBenchmark --mode batched --frames 500
+//
+//options: --mode plain|cached|batched (default batched)  --shapes N (default 10000)  --frames N (default 0)
+
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Group>
+#include <osg/NodeVisitor>
+#include <osg/ShapeDrawable>
+#include <osg/Timer>
+#include <osgViewer/Viewer>
+
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "ShapeMeshCache.h"
+#include "ShapeBatch.h"
+#include "ResidentMemory.h"
+
+//counts what the renderer would issue: one draw per primitive set of every drawable
+//on every path (a geometry under 10k transforms is drawn 10k times), and the bytes of
+//the arrays and index lists that exist in memory, each shared buffer only once
+class DrawStatsVisitor : public osg::NodeVisitor
+{
+public:
+	DrawStatsVisitor() : osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), drawCalls( 0 ), instances( 0 ), bytes( 0 ), opaqueDrawables( 0 ) {}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+		{
+			osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+			if ( !geometry )
+			{
+				//a ShapeDrawable of an older OSG draws immediate mode, we cannot see its data
+				++drawCalls;
+				++instances;
+				++opaqueDrawables;
+				continue;
+			}
+
+			for ( unsigned int p = 0; p < geometry -> getNumPrimitiveSets(); ++p )
+			{
+				const osg::PrimitiveSet* primitives = geometry -> getPrimitiveSet( p );
+				++drawCalls;
+				instances += std::max( primitives -> getNumInstances(), 1 );
+				addBuffer( primitives );
+			}
+
+			osg::Geometry::ArrayList arrays;
+			geometry -> getArrayList( arrays );
+			for ( unsigned int a = 0; a < arrays.size(); ++a )
+				addBuffer( arrays[a].get() );
+		}
+	}
+
+	unsigned int drawCalls;
+	unsigned int instances;
+	unsigned long bytes;
+	unsigned int opaqueDrawables;
+
+protected:
+	void addBuffer( const osg::BufferData* buffer )
+	{
+		if ( buffer && _visited.insert( buffer ).second )
+			bytes += buffer -> getTotalDataSize();
+	}
+
+	std::set<const osg::BufferData*> _visited;
+};
+
+//shape i of the grid, the same for every mode
+osg::Shape* createShape( unsigned int i, unsigned int side, osg::Vec4& color )
+{
+	osg::Vec3 pos( ( i % side ) * 1.5f, ( i / side ) * 1.5f, 0.0f );
+	color.set( ( i % 7 ) / 6.0f, ( i % 5 ) / 4.0f, ( i % 3 ) / 2.0f, 1.0f );
+	switch ( i % 3 )
+	{
+	case 0: return new osg::Box( pos, 1.0f, 0.8f, 0.6f );
+	case 1: return new osg::Sphere( pos, 0.5f );
+	default: return new osg::Cone( pos, 0.5f, 1.0f );
+	}
+}
+
+osg::Node* buildPlain( unsigned int numShapes, unsigned int side )
+{
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	osg::Vec4 color;
+	for ( unsigned int i = 0; i < numShapes; ++i )
+	{
+		osg::ref_ptr<osg::ShapeDrawable> drawable = new osg::ShapeDrawable( createShape( i, side, color ) );
+		drawable -> setColor( color );
+		geode -> addDrawable( drawable.get() );
+	}
+	return geode.release();
+}
+
+osg::Node* buildCached( unsigned int numShapes, unsigned int side )
+{
+	osg::ref_ptr<osg::Group> group = new osg::Group;
+	osg::Vec4 color;
+	for ( unsigned int i = 0; i < numShapes; ++i )
+	{
+		osg::ref_ptr<osg::Shape> shape = createShape( i, side, color );
+		group -> addChild( ShapeMeshCache::instance() -> createShapeNode( shape.get(), color ) );
+	}
+	return group.release();
+}
+
+osg::Node* buildBatched( unsigned int numShapes, unsigned int side )
+{
+	osg::ref_ptr<ShapeBatch> batches[3] = {
+		new ShapeBatch( ShapeMeshCache::BOX ), new ShapeBatch( ShapeMeshCache::SPHERE ), new ShapeBatch( ShapeMeshCache::CONE ) };
+
+	osg::Vec4 color;
+	for ( unsigned int i = 0; i < numShapes; ++i )
+	{
+		osg::ref_ptr<osg::Shape> shape = createShape( i, side, color );
+		batches[i % 3] -> addShape( shape.get(), color );
+	}
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	for ( unsigned int b = 0; b < 3; ++b )
+		geode -> addDrawable( batches[b].get() );
+	return geode.release();
+}
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	std::string mode = "batched";
+	unsigned int numShapes = 10000, numFrames = 0;
+	arguments.read( "--mode", mode );
+	arguments.read( "--shapes", numShapes );
+	arguments.read( "--frames", numFrames );
+	unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)numShapes ) );
+
+	double rssBefore = residentMB();
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	osg::ref_ptr<osg::Node> root;
+	if ( mode == "plain" ) root = buildPlain( numShapes, side );
+	else if ( mode == "cached" ) root = buildCached( numShapes, side );
+	else root = buildBatched( numShapes, side );
+	double buildTime = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() );
+
+	DrawStatsVisitor stats;
+	root -> accept( stats );
+
+	std::cout << mode << ", " << numShapes << " shapes" << std::endl;
+	std::cout << "  build:          " << buildTime << " ms" << std::endl;
+	std::cout << "  draw calls:     " << stats.drawCalls << " (" << stats.instances << " shape instances)" << std::endl;
+	std::cout << "  geometry data:  " << stats.bytes / 1024.0 << " KB";
+	if ( stats.opaqueDrawables ) std::cout << " (+ " << stats.opaqueDrawables << " drawables without arrays)";
+	std::cout << std::endl;
+	std::cout << "  RSS growth:     " << residentMB() - rssBefore << " MB" << std::endl;
+	if ( mode != "plain" )
+		std::cout << "  cached meshes:  " << ShapeMeshCache::instance() -> getNumMeshes() << ", "
+		          << ShapeMeshCache::instance() -> getMeshBytes() / 1024.0 << " KB" << std::endl;
+
+	if ( numFrames > 0 )
+	{
+		osgViewer::Viewer viewer;
+		viewer.setUpViewInWindow( 50, 50, 1280, 720 );
+		viewer.setSceneData( root.get() );
+		viewer.realize();
+
+		//look at the whole grid from above at an angle
+		const osg::BoundingSphere& bound = root -> getBound();
+		viewer.getCamera() -> setViewMatrixAsLookAt( bound.center() + osg::Vec3( 0.0f, -bound.radius(), bound.radius() ) * 1.5f,
+		                                             bound.center(), osg::Z_AXIS );
+
+		viewer.frame();
+		start = osg::Timer::instance() -> tick();
+		for ( unsigned int i = 0; i < numFrames && !viewer.done(); ++i )
+			viewer.frame();
+		std::cout << "  frame time:     " << osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() ) / numFrames
+		          << " ms (mean of " << numFrames << " frames)" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,348 @@
+#ifndef SHAPE_MESH_CACHE_H
+#define SHAPE_MESH_CACHE_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/Shape>
+#include <osg/ShapeDrawable>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+//ShapeMeshCache
+//every osg::ShapeDrawable tessellates its own shape, so a thousand spheres mean a thousand
+//copies of the same sphere mesh. the cache builds each unit shape once per type and
+//tessellation hints (detail ratio, body/top/bottom) and hands out that one vertex, normal
+//and index buffer to everybody. the size, position and orientation of a shape become
+//a transform instead of being baked into its vertices:
+//	box       unit cube centred at the origin, scaled by its lengths
+//	sphere    radius 1, scaled by the radius
+//	cone      radius 1, height 1, base at z = -0.25 like osg::Cone, scaled by radius and height
+//	cylinder  radius 1, height 1 centred at the origin, scaled by radius and height
+//
+//	osg::Node* sphere = ShapeMeshCache::instance() -> createShapeNode( new osg::Sphere( pos, 1.0f ), color );
+
+class ShapeMeshCache
+{
+public:
+	enum ShapeType { BOX, SPHERE, CONE, CYLINDER, UNSUPPORTED };
+
+	static ShapeMeshCache* instance()
+	{
+		static ShapeMeshCache s_cache;
+		return &s_cache;
+	}
+
+	//the shape type and the transform that turns the unit mesh into the shape
+	static ShapeType getShapeTransform( const osg::Shape* shape, osg::Matrix& transform )
+	{
+		if ( const osg::Box* box = dynamic_cast<const osg::Box*>( shape ) )
+		{
+			osg::Vec3 lengths = box -> getHalfLengths() * 2.0f;
+			transform = osg::Matrix::scale( lengths ) * osg::Matrix::rotate( box -> getRotation() ) * osg::Matrix::translate( box -> getCenter() );
+			return BOX;
+		}
+		if ( const osg::Sphere* sphere = dynamic_cast<const osg::Sphere*>( shape ) )
+		{
+			float r = sphere -> getRadius();
+			transform = osg::Matrix::scale( r, r, r ) * osg::Matrix::translate( sphere -> getCenter() );
+			return SPHERE;
+		}
+		if ( const osg::Cone* cone = dynamic_cast<const osg::Cone*>( shape ) )
+		{
+			float r = cone -> getRadius();
+			transform = osg::Matrix::scale( r, r, cone -> getHeight() ) * osg::Matrix::rotate( cone -> getRotation() ) * osg::Matrix::translate( cone -> getCenter() );
+			return CONE;
+		}
+		if ( const osg::Cylinder* cylinder = dynamic_cast<const osg::Cylinder*>( shape ) )
+		{
+			float r = cylinder -> getRadius();
+			transform = osg::Matrix::scale( r, r, cylinder -> getHeight() ) * osg::Matrix::rotate( cylinder -> getRotation() ) * osg::Matrix::translate( cylinder -> getCenter() );
+			return CYLINDER;
+		}
+		return UNSUPPORTED;
+	}
+
+	//the shared unit mesh of a type: vertex + normal array, one index list, a state set
+	//with GL_NORMALIZE (the transforms scale). never modify what you get back.
+	osg::Geometry* getMesh( ShapeType type, const osg::TessellationHints* hints = 0 )
+	{
+		if ( type == UNSUPPORTED ) return 0;
+
+		Key key( type, hints );
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		osg::ref_ptr<osg::Geometry>& mesh = _meshes[key];
+		if ( mesh.valid() )
+		{
+			++_numHits;
+			return mesh.get();
+		}
+
+		mesh = buildMesh( key );
+		return mesh.get();
+	}
+
+	//one shape drawn with the shared mesh: a MatrixTransform over a Geode whose geometry
+	//shares all arrays with the cache and only has its own one-element colour array.
+	//shapes of a type we cannot share fall back to a plain ShapeDrawable.
+	osg::Node* createShapeNode( osg::Shape* shape, const osg::Vec4& color = osg::Vec4( 1.0f, 1.0f, 1.0f, 1.0f ),
+	                            osg::TessellationHints* hints = 0 )
+	{
+		osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+
+		osg::Matrix transform;
+		osg::Geometry* mesh = getMesh( getShapeTransform( shape, transform ), hints );
+		if ( !mesh )
+		{
+			osg::ref_ptr<osg::ShapeDrawable> drawable = new osg::ShapeDrawable( shape, hints );
+			drawable -> setColor( color );
+			geode -> addDrawable( drawable.get() );
+			return geode.release();
+		}
+
+		osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry( *mesh, osg::CopyOp::SHALLOW_COPY );
+		geometry -> setColorArray( new osg::Vec4Array( 1, &color ), osg::Array::BIND_OVERALL );
+		geode -> addDrawable( geometry.get() );
+
+		osg::ref_ptr<osg::MatrixTransform> node = new osg::MatrixTransform( transform );
+		node -> addChild( geode.get() );
+		return node.release();
+	}
+
+	unsigned int getNumMeshes() const { return _meshes.size(); }
+	unsigned int getNumHits() const { return _numHits; }
+
+	//bytes held by the vertex, normal and index buffers of all cached meshes
+	unsigned int getMeshBytes() const
+	{
+		unsigned int bytes = 0;
+		for ( std::map<Key, osg::ref_ptr<osg::Geometry> >::const_iterator itr = _meshes.begin(); itr != _meshes.end(); ++itr )
+		{
+			const osg::Geometry* mesh = itr -> second.get();
+			bytes += mesh -> getVertexArray() -> getTotalDataSize() + mesh -> getNormalArray() -> getTotalDataSize()
+			       + mesh -> getPrimitiveSet( 0 ) -> getTotalDataSize();
+		}
+		return bytes;
+	}
+
+protected:
+	struct Key
+	{
+		Key( ShapeType t, const osg::TessellationHints* hints )
+			: type( t ), detail( hints ? hints -> getDetailRatio() : 1.0f ),
+			  body( hints ? hints -> getCreateBody() : true ),
+			  top( hints ? hints -> getCreateTop() : true ),
+			  bottom( hints ? hints -> getCreateBottom() : true ) {}
+
+		bool operator<( const Key& rhs ) const
+		{
+			if ( type != rhs.type ) return type < rhs.type;
+			if ( detail != rhs.detail ) return detail < rhs.detail;
+			if ( body != rhs.body ) return body < rhs.body;
+			if ( top != rhs.top ) return top < rhs.top;
+			return bottom < rhs.bottom;
+		}
+
+		ShapeType type;
+		float detail;
+		bool body, top, bottom;
+	};
+
+	ShapeMeshCache() : _numHits( 0 ) {}
+
+	//segment counts follow osg::ShapeDrawable, so a cached shape looks like the original
+	static unsigned int scaled( unsigned int count, float detail, unsigned int minimum )
+	{
+		unsigned int n = (unsigned int)( count * detail );
+		return n < minimum ? minimum : n;
+	}
+
+	static osg::Geometry* buildMesh( const Key& key )
+	{
+		osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+		osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+		std::vector<unsigned int> indices;
+
+		switch ( key.type )
+		{
+		case BOX: buildBox( *vertices, *normals, indices ); break;
+		case SPHERE: buildSphere( key, *vertices, *normals, indices ); break;
+		case CONE: buildCone( key, *vertices, *normals, indices ); break;
+		default: buildCylinder( key, *vertices, *normals, indices ); break;
+		}
+
+		osg::ref_ptr<osg::DrawElements> elements;
+		if ( vertices -> size() <= 65536 )
+			elements = new osg::DrawElementsUShort( GL_TRIANGLES, indices.begin(), indices.end() );
+		else
+			elements = new osg::DrawElementsUInt( GL_TRIANGLES, indices.begin(), indices.end() );
+
+		osg::ref_ptr<osg::Geometry> mesh = new osg::Geometry;
+		mesh -> setUseDisplayList( false );
+		mesh -> setUseVertexBufferObjects( true );
+		mesh -> setVertexArray( vertices.get() );
+		mesh -> setNormalArray( normals.get(), osg::Array::BIND_PER_VERTEX );
+		mesh -> addPrimitiveSet( elements.get() );
+		mesh -> getOrCreateStateSet() -> setMode( GL_NORMALIZE, osg::StateAttribute::ON );
+		return mesh.release();
+	}
+
+	static void buildBox( osg::Vec3Array& vertices, osg::Vec3Array& normals, std::vector<unsigned int>& indices )
+	{
+		//normal, then two edge directions with u ^ v == normal so every face winds counter-clockwise
+		static const float faces[6][9] = {
+			{  1, 0, 0,   0, 1, 0,   0, 0, 1 },
+			{ -1, 0, 0,   0, 0, 1,   0, 1, 0 },
+			{  0, 1, 0,   0, 0, 1,   1, 0, 0 },
+			{  0,-1, 0,   1, 0, 0,   0, 0, 1 },
+			{  0, 0, 1,   1, 0, 0,   0, 1, 0 },
+			{  0, 0,-1,   0, 1, 0,   1, 0, 0 } };
+
+		for ( unsigned int f = 0; f < 6; ++f )
+		{
+			osg::Vec3 n( faces[f][0], faces[f][1], faces[f][2] );
+			osg::Vec3 u( faces[f][3], faces[f][4], faces[f][5] );
+			osg::Vec3 v( faces[f][6], faces[f][7], faces[f][8] );
+			unsigned int first = vertices.size();
+			vertices.push_back( ( n - u - v ) * 0.5f );
+			vertices.push_back( ( n + u - v ) * 0.5f );
+			vertices.push_back( ( n + u + v ) * 0.5f );
+			vertices.push_back( ( n - u + v ) * 0.5f );
+			for ( unsigned int i = 0; i < 4; ++i ) normals.push_back( n );
+			addQuad( indices, first, first + 1, first + 2, first + 3 );
+		}
+	}
+
+	static void buildSphere( const Key& key, osg::Vec3Array& vertices, osg::Vec3Array& normals, std::vector<unsigned int>& indices )
+	{
+		unsigned int numRows = scaled( 20, key.detail, 3 );
+		unsigned int numSegments = scaled( 40, key.detail, 5 );
+
+		for ( unsigned int r = 0; r <= numRows; ++r )
+		{
+			float phi = osg::PI * r / numRows - osg::PI_2;
+			for ( unsigned int s = 0; s <= numSegments; ++s )
+			{
+				float theta = 2.0f * osg::PI * s / numSegments;
+				osg::Vec3 p( cosf( phi ) * cosf( theta ), cosf( phi ) * sinf( theta ), sinf( phi ) );
+				vertices.push_back( p );
+				normals.push_back( p );
+			}
+		}
+
+		unsigned int stride = numSegments + 1;
+		for ( unsigned int r = 0; r < numRows; ++r )
+		{
+			for ( unsigned int s = 0; s < numSegments; ++s )
+			{
+				//the rows at the poles collapse to one point, they only get one triangle per segment
+				unsigned int a = r * stride + s;
+				if ( r > 0 )
+				{
+					indices.push_back( a ); indices.push_back( a + 1 ); indices.push_back( a + stride + 1 );
+				}
+				if ( r + 1 < numRows )
+				{
+					indices.push_back( a ); indices.push_back( a + stride + 1 ); indices.push_back( a + stride );
+				}
+			}
+		}
+	}
+
+	static void buildCone( const Key& key, osg::Vec3Array& vertices, osg::Vec3Array& normals, std::vector<unsigned int>& indices )
+	{
+		unsigned int numSegments = scaled( 40, key.detail, 5 );
+		const float base = -0.25f, apex = 0.75f;
+
+		if ( key.body )
+		{
+			//one apex vertex per segment, each carrying the normal of its own slope
+			unsigned int first = vertices.size();
+			for ( unsigned int s = 0; s <= numSegments; ++s )
+			{
+				float theta = 2.0f * osg::PI * s / numSegments;
+				osg::Vec3 n( cosf( theta ), sinf( theta ), 1.0f );
+				n.normalize();
+				vertices.push_back( osg::Vec3( cosf( theta ), sinf( theta ), base ) );
+				vertices.push_back( osg::Vec3( 0.0f, 0.0f, apex ) );
+				normals.push_back( n );
+				normals.push_back( n );
+			}
+			for ( unsigned int s = 0; s < numSegments; ++s )
+			{
+				unsigned int a = first + s * 2;
+				indices.push_back( a );
+				indices.push_back( a + 2 );
+				indices.push_back( a + 1 );
+			}
+		}
+
+		if ( key.bottom )
+			addDisk( vertices, normals, indices, numSegments, base, false );
+	}
+
+	static void buildCylinder( const Key& key, osg::Vec3Array& vertices, osg::Vec3Array& normals, std::vector<unsigned int>& indices )
+	{
+		unsigned int numSegments = scaled( 40, key.detail, 5 );
+
+		if ( key.body )
+		{
+			unsigned int first = vertices.size();
+			for ( unsigned int s = 0; s <= numSegments; ++s )
+			{
+				float theta = 2.0f * osg::PI * s / numSegments;
+				osg::Vec3 n( cosf( theta ), sinf( theta ), 0.0f );
+				vertices.push_back( n + osg::Vec3( 0.0f, 0.0f, -0.5f ) );
+				vertices.push_back( n + osg::Vec3( 0.0f, 0.0f, 0.5f ) );
+				normals.push_back( n );
+				normals.push_back( n );
+			}
+			for ( unsigned int s = 0; s < numSegments; ++s )
+			{
+				unsigned int a = first + s * 2;
+				addQuad( indices, a, a + 2, a + 3, a + 1 );
+			}
+		}
+
+		if ( key.top ) addDisk( vertices, normals, indices, numSegments, 0.5f, true );
+		if ( key.bottom ) addDisk( vertices, normals, indices, numSegments, -0.5f, false );
+	}
+
+	//unit disk at height z facing up or down
+	static void addDisk( osg::Vec3Array& vertices, osg::Vec3Array& normals, std::vector<unsigned int>& indices,
+	                     unsigned int numSegments, float z, bool up )
+	{
+		osg::Vec3 n( 0.0f, 0.0f, up ? 1.0f : -1.0f );
+		unsigned int center = vertices.size();
+		vertices.push_back( osg::Vec3( 0.0f, 0.0f, z ) );
+		normals.push_back( n );
+		for ( unsigned int s = 0; s <= numSegments; ++s )
+		{
+			float theta = 2.0f * osg::PI * s / numSegments;
+			vertices.push_back( osg::Vec3( cosf( theta ), sinf( theta ), z ) );
+			normals.push_back( n );
+		}
+		for ( unsigned int s = 0; s < numSegments; ++s )
+		{
+			indices.push_back( center );
+			indices.push_back( center + 1 + ( up ? s : s + 1 ) );
+			indices.push_back( center + 1 + ( up ? s + 1 : s ) );
+		}
+	}
+
+	static void addQuad( std::vector<unsigned int>& indices, unsigned int a, unsigned int b, unsigned int c, unsigned int d )
+	{
+		indices.push_back( a ); indices.push_back( b ); indices.push_back( c );
+		indices.push_back( a ); indices.push_back( c ); indices.push_back( d );
+	}
+
+	OpenThreads::Mutex _mutex;
+	std::map<Key, osg::ref_ptr<osg::Geometry> > _meshes;
+	unsigned int _numHits;
+};
+
+#endif
@@ -1,27 +1,59 @@
+#include <osg/ArgumentParser>
 #include <osg/ShapeDrawable>
 #include <osg/Geode>
+#include <osg/Group>
 #include <osgViewer/Viewer>
 
+#include <cstdlib>
+
+#include "ShapeMeshCache.h"
+#include "ShapeBatch.h"
+
+//a debug overlay of many small boxes and spheres: one instanced draw call per shape type
+osg::Node* createOverlay( unsigned int numShapes )
+{
+	osg::ref_ptr<ShapeBatch> boxes = new ShapeBatch( ShapeMeshCache::BOX );
+	osg::ref_ptr<ShapeBatch> spheres = new ShapeBatch( ShapeMeshCache::SPHERE );
+	for ( unsigned int i = 0; i < numShapes; ++i )
+	{
+		osg::Vec3 pos( std::rand() % 1000 * 0.01f - 5.0f, std::rand() % 1000 * 0.01f - 5.0f, std::rand() % 1000 * 0.005f - 2.5f );
+		osg::Vec4 color( std::rand() % 256 / 255.0f, std::rand() % 256 / 255.0f, std::rand() % 256 / 255.0f, 1.0f );
+		if ( i % 2 )
+			boxes -> addShape( new osg::Box( pos, 0.1f ), color );
+		else
+			spheres -> addShape( new osg::Sphere( pos, 0.05f ), color );
+	}
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	geode -> addDrawable( boxes.get() );
+	geode -> addDrawable( spheres.get() );
+	return geode.release();
+}
+
 int main( int argc, char **argv )
 {
-	osg::ref_ptr<osg::ShapeDrawable> shape1 = new osg::ShapeDrawable;
-	shape1 -> setShape ( new osg::Box( osg::Vec3(-3.0f, 0.0f, 0.0f ), 2.0f, 2.0f, 1.0f) );
-
-	osg::ref_ptr<osg::ShapeDrawable> shape2 = new osg::ShapeDrawable;
-	shape2 -> setShape ( new osg::Sphere( osg::Vec3(3.0f, 0.0f, 0.0f), 1.0f ) );
-	shape2 -> setColor ( osg::Vec4(0.0f, 0.0f, 1.0f, 1.0f ) );
-	
-	osg::ref_ptr<osg::ShapeDrawable> shape3 = new osg::ShapeDrawable;
-	shape3 -> setShape( new osg::Cone(osg::Vec3(0.0f, 0.0f, 0.0f), 1.0f, 1.0f) );
-	shape3 -> setColor( osg::Vec4(0.0f, 1.0f, 0.0f, 1.0f) );
-
-	osg::ref_ptr<osg::Geode> root = new osg::Geode;
-	root -> addDrawable( shape1.get() );
-	root -> addDrawable( shape2.get() );
-	root -> addDrawable( shape3.get() );
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int numOverlayShapes = 0;
+	arguments.read( "--overlay", numOverlayShapes );
+
+	//the shapes share one tessellated mesh per type from the cache instead of tessellating their own
+	ShapeMeshCache* cache = ShapeMeshCache::instance();
+	osg::ref_ptr<osg::Node> shape1 = cache -> createShapeNode( new osg::Box( osg::Vec3(-3.0f, 0.0f, 0.0f ), 2.0f, 2.0f, 1.0f) );
+
+	osg::ref_ptr<osg::Node> shape2 = cache -> createShapeNode( new osg::Sphere( osg::Vec3(3.0f, 0.0f, 0.0f), 1.0f ),
+	                                                           osg::Vec4(0.0f, 0.0f, 1.0f, 1.0f ) );
+
+	osg::ref_ptr<osg::Node> shape3 = cache -> createShapeNode( new osg::Cone(osg::Vec3(0.0f, 0.0f, 0.0f), 1.0f, 1.0f),
+	                                                           osg::Vec4(0.0f, 1.0f, 0.0f, 1.0f) );
+
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	root -> addChild( shape1.get() );
+	root -> addChild( shape2.get() );
+	root -> addChild( shape3.get() );
+	if ( numOverlayShapes > 0 )
+		root -> addChild( createOverlay( numOverlayShapes ) );
 
 	osgViewer::Viewer viewer;
 	viewer.setSceneData( root.get() );
 	return viewer.run();  // :)
 }
-
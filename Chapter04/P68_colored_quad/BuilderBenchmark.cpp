@@ -0,0 +1,113 @@
+//benchmark: building a big procedural grid with push_back vs. GeometryBuilder
+//
+//a side x side height field with per-vertex normals and colours and an index list,
+//built once by growing every array with push_back and once through GeometryBuilder,
+//which allocates every array at its final size and fills it by index.
+//
+//	BuilderBenchmark --side 2048      (4M vertices, 25M indices)
+//
+//options: --side N (default 2048)  --runs N (default 3)
+
+#include <osg/ArgumentParser>
+#include <osg/Geometry>
+#include <osg/Timer>
+
+#include <cmath>
+#include <iostream>
+
+#include "GeometryBuilder.h"
+
+osg::Vec3 heightAt( unsigned int x, unsigned int y )
+{
+	return osg::Vec3( x, y, sinf( x * 0.05f ) * cosf( y * 0.05f ) * 4.0f );
+}
+
+osg::Vec4 colorAt( unsigned int x, unsigned int y )
+{
+	return osg::Vec4( ( x & 255 ) / 255.0f, ( y & 255 ) / 255.0f, 0.5f, 1.0f );
+}
+
+osg::Geometry* buildWithPushBack( unsigned int side )
+{
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array;
+	osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt( GL_TRIANGLES );
+	for ( unsigned int y = 0; y < side; ++y )
+	{
+		for ( unsigned int x = 0; x < side; ++x )
+		{
+			vertices -> push_back( heightAt( x, y ) );
+			normals -> push_back( osg::Vec3( 0.0f, 0.0f, 1.0f ) );
+			colors -> push_back( colorAt( x, y ) );
+			if ( x + 1 < side && y + 1 < side )
+			{
+				unsigned int a = y * side + x;
+				indices -> push_back( a ); indices -> push_back( a + 1 ); indices -> push_back( a + side + 1 );
+				indices -> push_back( a ); indices -> push_back( a + side + 1 ); indices -> push_back( a + side );
+			}
+		}
+	}
+
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry -> setVertexArray( vertices.get() );
+	geometry -> setNormalArray( normals.get(), osg::Array::BIND_PER_VERTEX );
+	geometry -> setColorArray( colors.get(), osg::Array::BIND_PER_VERTEX );
+	geometry -> addPrimitiveSet( indices.get() );
+	return geometry.release();
+}
+
+osg::Geometry* buildWithBuilder( unsigned int side )
+{
+	unsigned int numVertices = side * side;
+	unsigned int numIndices = ( side - 1 ) * ( side - 1 ) * 6;
+	GeometryBuilder builder( numVertices, GeometryBuilder::NORMALS | GeometryBuilder::COLORS, numIndices );
+
+	osg::Vec3* vertices = builder.vertices();
+	osg::Vec3* normals = builder.normals();
+	osg::Vec4* colors = builder.colors();
+	GLuint* indices = builder.indices();
+	for ( unsigned int y = 0; y < side; ++y )
+	{
+		for ( unsigned int x = 0; x < side; ++x )
+		{
+			unsigned int a = y * side + x;
+			vertices[a] = heightAt( x, y );
+			normals[a] = osg::Vec3( 0.0f, 0.0f, 1.0f );
+			colors[a] = colorAt( x, y );
+			if ( x + 1 < side && y + 1 < side )
+			{
+				GLuint* quad = indices + ( y * ( side - 1 ) + x ) * 6;
+				quad[0] = a; quad[1] = a + 1; quad[2] = a + side + 1;
+				quad[3] = a; quad[4] = a + side + 1; quad[5] = a + side;
+			}
+		}
+	}
+	builder.setNumVertices( numVertices );
+	builder.setNumIndices( numIndices );
+	return builder.build( GL_TRIANGLES );
+}
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int side = 2048, runs = 3;
+	arguments.read( "--side", side );
+	arguments.read( "--runs", runs );
+
+	std::cout << side * side << " vertices, " << ( side - 1 ) * ( side - 1 ) * 6 << " indices" << std::endl;
+	for ( unsigned int run = 0; run < runs; ++run )
+	{
+		osg::Timer_t start = osg::Timer::instance() -> tick();
+		osg::ref_ptr<osg::Geometry> pushed = buildWithPushBack( side );
+		double pushTime = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() );
+		pushed = 0;
+
+		start = osg::Timer::instance() -> tick();
+		osg::ref_ptr<osg::Geometry> built = buildWithBuilder( side );
+		double buildTime = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() );
+
+		std::cout << "run " << run << ": push_back " << pushTime << " ms, GeometryBuilder " << buildTime << " ms" << std::endl;
+	}
+	return 0;
+}
@@ -2,40 +2,26 @@
 #include <osg/Geode>
 #include <osgViewer/Viewer>
 
+#include "GeometryBuilder.h"
+
 int main( int argc, char** argv )
 {
-	//create vertex array push_back four corner points
-	osg::ref_ptr <osg::Vec3Array> vertices = new osg::Vec3Array;
-	vertices -> push_back( osg::Vec3( 0.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 1.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 1.0f, 0.0f, 1.0f ) );
-	vertices -> push_back( osg::Vec3( 0.0f, 0.0f, 1.0f ) );
-
-	//indicate normal of each vertex, since default normal can cause lighting problems
-	osg::ref_ptr <osg::Vec3Array> normals = new osg::Vec3Array;
-	normals -> push_back( osg::Vec3( 0.0f, -1.0f, 0.0f ) );
-
-	//indicate color to each vertex, OpenGL default: smooth coloring, blends colors 
-	osg::ref_ptr <osg::Vec4Array> colors = new osg::Vec4Array;
-	colors -> push_back( osg::Vec4 ( 1.0f, 0.0f, 0.0f, 1.0f ) );
-	colors -> push_back( osg::Vec4 ( 0.0f, 1.0f, 0.0f, 1.0f ) );
-	colors -> push_back( osg::Vec4 ( 0.0f, 0.0f, 1.0f, 1.0f ) );
-	colors -> push_back( osg::Vec4 ( 1.0f, 1.0f, 1.0f, 1.0f ) );
-
-	//create osg::Geometry obj, set prepared vertex, normal, color.
-	//indicate that the single normal bounds to entire geometry
-	//and colors bound per vertex
-	osg::ref_ptr <osg::Geometry> quad = new osg::Geometry;
-	quad -> setVertexArray( vertices.get() );
-	quad -> setNormalArray( normals.get() );
-	quad -> setNormalBinding( osg::Geometry::BIND_OVERALL );
-	quad -> setColorArray ( colors.get() );
-	quad -> setColorBinding ( osg::Geometry::BIND_PER_VERTEX );
-
-	//specify the primitive set.
-	//newly allocated osg::Draw Arrays instance w/ drawing mode set to GL_QUADS
+	//create the four corner points with one colour each, in arrays allocated once for 4 vertices
+	//instead of growing separate vertex and colour arrays with push_back.
+	//OpenGL default: smooth coloring, blends colors
+	GeometryBuilder builder( 4, GeometryBuilder::COLORS );
+	builder.addVertex( osg::Vec3( 0.0f, 0.0f, 0.0f ) ).color( osg::Vec4 ( 1.0f, 0.0f, 0.0f, 1.0f ) );
+	builder.addVertex( osg::Vec3( 1.0f, 0.0f, 0.0f ) ).color( osg::Vec4 ( 0.0f, 1.0f, 0.0f, 1.0f ) );
+	builder.addVertex( osg::Vec3( 1.0f, 0.0f, 1.0f ) ).color( osg::Vec4 ( 0.0f, 0.0f, 1.0f, 1.0f ) );
+	builder.addVertex( osg::Vec3( 0.0f, 0.0f, 1.0f ) ).color( osg::Vec4 ( 1.0f, 1.0f, 1.0f, 1.0f ) );
+
+	//indicate normal of the quad, since default normal can cause lighting problems.
+	//the single normal binds to the entire geometry, colors are bound per vertex
+	builder.setOverallNormal( osg::Vec3( 0.0f, -1.0f, 0.0f ) );
+
+	//build the osg::Geometry obj with a GL_QUADS primitive set
 	//to render four vertices as quad corners in counter-clockwise order:
-	quad -> addPrimitiveSet( new osg::DrawArrays( GL_QUADS, 0, 4 ) );
+	osg::ref_ptr <osg::Geometry> quad = builder.build( GL_QUADS );
 
 	//add geometry to osg::Geode obj and render
 	osg::ref_ptr <osg::Geode> root = new osg::Geode;
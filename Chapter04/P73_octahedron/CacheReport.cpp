@@ -0,0 +1,93 @@
+//report: vertex cache efficiency of a scene before and after VertexCacheOptimizer
+//
+//loads the models given on the command line, prints ACMR (cache misses per triangle)
+//and ATVR (cache misses per vertex) of every geometry and of the whole scene, optimises
+//all geometries and prints the numbers again. the optimised scene can be written out.
+//
+//	CacheReport cow.osg
+//	CacheReport cow.osg --overdraw -o cow_optimized.osgb
+//
+//options: --cache N (simulated FIFO size, default 16)  --overdraw  --no-fetch  -o file  --quiet
+
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+
+#include <iomanip>
+#include <iostream>
+
+#include "VertexCacheOptimizer.h"
+
+std::ostream& operator << ( std::ostream& out, const VertexCacheOptimizer::Statistics& stats )
+{
+	return out << std::fixed << std::setprecision( 3 ) << "ACMR " << stats.getACMR() << "  ATVR " << stats.getATVR()
+	           << "  (" << stats.numTriangles << " triangles, " << stats.numVertices << " vertices)";
+}
+
+//prints one line per geometry while optimising it
+class ReportVisitor : public VertexCacheVisitor
+{
+public:
+	ReportVisitor( const VertexCacheOptimizer& optimizer, unsigned int cacheSize )
+		: VertexCacheVisitor( optimizer, cacheSize ) {}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+		{
+			osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+			if ( !geometry ) continue;
+			VertexCacheOptimizer::Statistics before = VertexCacheOptimizer::measure( *geometry, _cacheSize );
+			_optimizer.apply( *geometry );
+			VertexCacheOptimizer::Statistics after = VertexCacheOptimizer::measure( *geometry, _cacheSize );
+			std::cout << "geometry " << _numGeometries << " '" << geometry -> getName() << "'" << std::endl
+			          << "  before: " << before << std::endl
+			          << "  after:  " << after << std::endl;
+			_before += before;
+			_after += after;
+			++_numGeometries;
+		}
+	}
+};
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int cacheSize = 16;
+	std::string output;
+	arguments.read( "--cache", cacheSize );
+	arguments.read( "-o", output );
+	unsigned int passes = VertexCacheOptimizer::DEFAULT;
+	if ( arguments.read( "--overdraw" ) ) passes |= VertexCacheOptimizer::OVERDRAW;
+	if ( arguments.read( "--no-fetch" ) ) passes &= ~VertexCacheOptimizer::VERTEX_FETCH;
+	bool quiet = arguments.read( "--quiet" );
+
+	osg::ref_ptr<osg::Node> scene = osgDB::readNodeFiles( arguments );
+	if ( !scene )
+	{
+		std::cout << arguments.getApplicationName() << ": no model loaded" << std::endl;
+		return 1;
+	}
+
+	osg::ref_ptr<VertexCacheVisitor> visitor = quiet ? new VertexCacheVisitor( VertexCacheOptimizer( passes ), cacheSize )
+	                                                 : new ReportVisitor( VertexCacheOptimizer( passes ), cacheSize );
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	scene -> accept( *visitor );
+	double time = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() );
+
+	std::cout << "scene, " << visitor -> getNumGeometries() << " geometries, FIFO cache of " << cacheSize << std::endl
+	          << "  before: " << visitor -> getBefore() << std::endl
+	          << "  after:  " << visitor -> getAfter() << std::endl
+	          << "  optimised in " << time << " ms" << std::endl;
+
+	if ( !output.empty() && !osgDB::writeNodeFile( *scene, output ) )
+	{
+		std::cout << "could not write " << output << std::endl;
+		return 1;
+	}
+	return 0;
+}
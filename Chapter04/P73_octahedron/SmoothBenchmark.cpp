@@ -0,0 +1,123 @@
+//benchmark: osgUtil::SmoothingVisitor::smooth() vs. ParallelSmoother on big meshes
+//
+//a wavy terrain split into tiles, each tile one primitive set with its own vertices,
+//so the tile borders have duplicated positions the smoothers have to weld. for every size
+//both smoothers run on their own copy, the times and the largest angle between their
+//normals are printed.
+//
+//	SmoothBenchmark                        (1M, 5M and 20M triangles)
+//	SmoothBenchmark --triangles 20 --no-reference
+//
+//options: --triangles N (millions, may be repeated)  --threads N  --crease degrees  --no-reference
+
+#include <osg/ArgumentParser>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osgUtil/SmoothingVisitor>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "ParallelSmoother.h"
+
+//about numTriangles triangles in tiles of tileSize x tileSize quads
+osg::Geometry* createTerrain( unsigned int numTriangles, unsigned int tileSize = 256 )
+{
+	unsigned int side = (unsigned int)std::sqrt( numTriangles / 2.0 );
+	unsigned int tiles = ( side + tileSize - 1 ) / tileSize;
+
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry -> setVertexArray( vertices.get() );
+	for ( unsigned int ty = 0; ty < tiles; ++ty )
+	{
+		for ( unsigned int tx = 0; tx < tiles; ++tx )
+		{
+			unsigned int x0 = tx * tileSize, y0 = ty * tileSize;
+			unsigned int w = std::min( tileSize, side - x0 ) + 1, h = std::min( tileSize, side - y0 ) + 1;
+			unsigned int first = vertices -> size();
+			for ( unsigned int y = 0; y < h; ++y )
+			{
+				for ( unsigned int x = 0; x < w; ++x )
+				{
+					float fx = x0 + x, fy = y0 + y;
+					vertices -> push_back( osg::Vec3( fx, fy, sinf( fx * 0.07f ) * cosf( fy * 0.05f ) * 3.0f + sinf( fx * fy * 0.001f ) ) );
+				}
+			}
+
+			osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt( GL_TRIANGLES );
+			indices -> reserve( ( w - 1 ) * ( h - 1 ) * 6 );
+			for ( unsigned int y = 0; y + 1 < h; ++y )
+			{
+				for ( unsigned int x = 0; x + 1 < w; ++x )
+				{
+					unsigned int a = first + y * w + x;
+					indices -> push_back( a ); indices -> push_back( a + 1 ); indices -> push_back( a + w + 1 );
+					indices -> push_back( a ); indices -> push_back( a + w + 1 ); indices -> push_back( a + w );
+				}
+			}
+			geometry -> addPrimitiveSet( indices.get() );
+		}
+	}
+	return geometry.release();
+}
+
+//largest angle in degrees between two normal arrays
+double maxAngle( const osg::Vec3Array& a, const osg::Vec3Array& b )
+{
+	double worst = 0.0;
+	for ( unsigned int i = 0; i < a.size() && i < b.size(); ++i )
+	{
+		double c = osg::clampTo( (double)( a[i] * b[i] ), -1.0, 1.0 );
+		worst = std::max( worst, std::acos( c ) * 180.0 / osg::PI );
+	}
+	return worst;
+}
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	std::vector<unsigned int> sizes;
+	unsigned int millions, numThreads = 0;
+	while ( arguments.read( "--triangles", millions ) ) sizes.push_back( millions );
+	if ( sizes.empty() )
+	{
+		sizes.push_back( 1 );
+		sizes.push_back( 5 );
+		sizes.push_back( 20 );
+	}
+	float crease = 180.0f;
+	arguments.read( "--threads", numThreads );
+	arguments.read( "--crease", crease );
+	bool reference = !arguments.read( "--no-reference" );
+
+	for ( unsigned int s = 0; s < sizes.size(); ++s )
+	{
+		osg::ref_ptr<osg::Geometry> mesh = createTerrain( sizes[s] * 1000000 );
+		osg::ref_ptr<osg::Geometry> copy = new osg::Geometry( *mesh, osg::CopyOp::DEEP_COPY_ALL );
+		std::cout << sizes[s] << "M triangles, " << mesh -> getVertexArray() -> getNumElements() << " vertices in "
+		          << mesh -> getNumPrimitiveSets() << " primitive sets" << std::endl;
+
+		osg::Timer_t start = osg::Timer::instance() -> tick();
+		ParallelSmoother( 0.0f, osg::DegreesToRadians( crease ), numThreads ).apply( *mesh );
+		double parallelTime = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() );
+		std::cout << "  ParallelSmoother:  " << parallelTime << " ms" << std::endl;
+
+		if ( !reference ) continue;
+
+		start = osg::Timer::instance() -> tick();
+		osgUtil::SmoothingVisitor::smooth( *copy, osg::DegreesToRadians( crease ) );
+		double referenceTime = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() );
+		std::cout << "  SmoothingVisitor:  " << referenceTime << " ms, speedup " << referenceTime / parallelTime << "x" << std::endl;
+
+		//with creases both split vertices, but not necessarily into the same order
+		const osg::Vec3Array* a = static_cast<const osg::Vec3Array*>( mesh -> getNormalArray() );
+		const osg::Vec3Array* b = static_cast<const osg::Vec3Array*>( copy -> getNormalArray() );
+		if ( a -> size() == b -> size() )
+			std::cout << "  max normal difference: " << maxAngle( *a, *b ) << " degrees" << std::endl;
+		else
+			std::cout << "  normal counts differ (" << a -> size() << " vs " << b -> size() << "), not compared" << std::endl;
+	}
+	return 0;
+}
@@ -1,8 +1,13 @@
 #include <osg/Geometry>
 #include <osg/Geode>
-#include <osgUtil/SmoothingVisitor>
 #include <osgViewer/Viewer>
 
+#include <iostream>
+
+#include "IndexNarrowing.h"
+#include "ParallelSmoother.h"
+#include "VertexCacheOptimizer.h"
+
 int main( int argc, char** argv )
 {
 	osg::ref_ptr <osg::Vec3Array> vertices = new osg::Vec3Array(6);
@@ -32,12 +37,23 @@ int main( int argc, char** argv )
 	osg::ref_ptr <osg::Geometry> geom = new osg::Geometry;
 	geom -> setVertexArray( vertices.get() );
 	geom -> addPrimitiveSet( indices.get() );
-	osgUtil::SmoothingVisitor::smooth( *geom );
+	//the geometry holds them now; handles kept here would count as sharing and keep the
+	//optimizer from renumbering the vertices
+	vertices = 0;
+	indices = 0;
+	//the faces above are listed in no particular order, let the optimizer sort them for the vertex cache
+	VertexCacheOptimizer( VertexCacheOptimizer::ALL ).apply( *geom );
+	ParallelSmoother::smooth( *geom );
 
 	//add the geometry to osg::Geode object and make it scene root
 	osg::ref_ptr <osg::Geode> root = new osg::Geode;
 	root -> addDrawable( geom.get() );
 
+	//a handful of vertices needs no 32 bit indices
+	IndexNarrowingVisitor narrowing;
+	root -> accept( narrowing );
+	narrowing.getStatistics().report( std::cout );
+
 	osgViewer::Viewer viewer;
 	viewer.setSceneData( root.get() );
 	return viewer.run();
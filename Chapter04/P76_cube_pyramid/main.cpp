@@ -1,8 +1,13 @@
 #include <osg/Geometry>
 #include <osg/Geode>
-#include <osgUtil/SmoothingVisitor>
 #include <osgViewer/Viewer>
 
+#include <iostream>
+
+#include "IndexNarrowing.h"
+#include "ParallelSmoother.h"
+#include "VertexCacheOptimizer.h"
+
 int main( int argc, char** argv )
 {
 	//cube vertices
@@ -63,18 +68,32 @@ int main( int argc, char** argv )
 	osg::ref_ptr <osg::Geometry> geomCube = new osg::Geometry;
 	geomCube -> setVertexArray( verticesCube.get() );
 	geomCube -> addPrimitiveSet( indicesCube.get() );
-	osgUtil::SmoothingVisitor::smooth( *geomCube );
+	//the geometry holds them now; handles kept here would count as sharing and keep the
+	//optimizer from renumbering the vertices
+	verticesCube = 0;
+	indicesCube = 0;
+	//reorder the corner-by-corner index list for the vertex cache
+	VertexCacheOptimizer( VertexCacheOptimizer::ALL ).apply( *geomCube );
+	ParallelSmoother::smooth( *geomCube );
 	
 	//pyramid: attach vertices and index
 	osg::ref_ptr <osg::Geometry> geomPyr = new osg::Geometry;
 	geomPyr -> setVertexArray( verticesPyr.get() );
 	geomPyr -> addPrimitiveSet( indicesPyr.get() );
-	osgUtil::SmoothingVisitor::smooth( *geomPyr );
+	verticesPyr = 0;
+	indicesPyr = 0;
+	VertexCacheOptimizer( VertexCacheOptimizer::ALL ).apply( *geomPyr );
+	ParallelSmoother::smooth( *geomPyr );
 
 	osg::ref_ptr <osg::Geode> root = new osg::Geode;
 	//root -> addDrawable( geomCube.get() );
 	root -> addDrawable( geomPyr.get() );
 
+	//a handful of vertices needs no 32 bit indices
+	IndexNarrowingVisitor narrowing;
+	root -> accept( narrowing );
+	narrowing.getStatistics().report( std::cout );
+
 	osgViewer::Viewer viewer;
 	viewer.setSceneData( root.get() );
 	return viewer.run();
@@ -0,0 +1,125 @@
+//benchmark: osgUtil::Tessellator (GLU) vs. PolygonTessellator on many footprints
+//
+//every footprint is its own geometry: a star-shaped concave outline and up to two square
+//holes, all as GL_POLYGON contours, the way building footprints come out of importers.
+//both tessellators get an identical set, the times and the triangles per second are printed.
+//
+//	TessellatorBenchmark
+//	TessellatorBenchmark --polygons 500000 --threads 4
+//
+//options: --polygons N (footprints, default 100000)  --vertices N (outline, default 24)  --threads N
+
+#include <osg/ArgumentParser>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osg/TriangleIndexFunctor>
+#include <osgUtil/Tessellator>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "PolygonTessellator.h"
+
+//same sequence for the same seed on every platform
+struct Random
+{
+	Random( unsigned int seed ) : state( seed ) {}
+	float next() { state = state * 1664525u + 1013904223u; return ( state >> 8 ) / 16777216.0f; }
+	unsigned int state;
+};
+
+osg::Geometry* createFootprint( Random& random, unsigned int numVertices )
+{
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry -> setVertexArray( vertices.get() );
+
+	//outline: radii between 0.6 and 1 keep the inner disc of radius 0.6 free for the holes
+	for ( unsigned int i = 0; i < numVertices; ++i )
+	{
+		float angle = ( i + random.next() * 0.8f ) * 2.0f * osg::PI / numVertices;
+		float radius = 0.6f + random.next() * 0.4f;
+		vertices -> push_back( osg::Vec3( cosf( angle ) * radius, sinf( angle ) * radius, 0.0f ) );
+	}
+	geometry -> addPrimitiveSet( new osg::DrawArrays( GL_POLYGON, 0, numVertices ) );
+
+	unsigned int numHoles = (unsigned int)( random.next() * 3.0f );
+	for ( unsigned int h = 0; h < numHoles; ++h )
+	{
+		float x = h ? 0.05f : -0.35f, y = -0.15f + random.next() * 0.1f, size = 0.15f + random.next() * 0.1f;
+		unsigned int first = vertices -> size();
+		vertices -> push_back( osg::Vec3( x, y, 0.0f ) );
+		vertices -> push_back( osg::Vec3( x + size, y, 0.0f ) );
+		vertices -> push_back( osg::Vec3( x + size, y + size, 0.0f ) );
+		vertices -> push_back( osg::Vec3( x, y + size, 0.0f ) );
+		geometry -> addPrimitiveSet( new osg::DrawArrays( GL_POLYGON, first, 4 ) );
+	}
+	return geometry.release();
+}
+
+struct TriangleCounter
+{
+	TriangleCounter() : count( 0 ) {}
+	void operator() ( unsigned int, unsigned int, unsigned int ) { ++count; }
+	unsigned int count;
+};
+
+unsigned int countTriangles( const std::vector< osg::ref_ptr<osg::Geometry> >& footprints )
+{
+	unsigned int total = 0;
+	for ( unsigned int i = 0; i < footprints.size(); ++i )
+	{
+		osg::TriangleIndexFunctor<TriangleCounter> counter;
+		footprints[i] -> accept( counter );
+		total += counter.count;
+	}
+	return total;
+}
+
+std::vector< osg::ref_ptr<osg::Geometry> > createFootprints( unsigned int numPolygons, unsigned int numVertices )
+{
+	Random random( 1234 );
+	std::vector< osg::ref_ptr<osg::Geometry> > footprints( numPolygons );
+	for ( unsigned int i = 0; i < numPolygons; ++i )
+		footprints[i] = createFootprint( random, numVertices );
+	return footprints;
+}
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int numPolygons = 100000, numVertices = 24, numThreads = 0;
+	arguments.read( "--polygons", numPolygons );
+	arguments.read( "--vertices", numVertices );
+	arguments.read( "--threads", numThreads );
+	numVertices = std::max( numVertices, 8u );	//fewer leave gaps wide enough to cut into the holes
+
+	std::cout << numPolygons << " footprints of " << numVertices << " vertices with up to 2 holes" << std::endl;
+
+	std::vector< osg::ref_ptr<osg::Geometry> > reference = createFootprints( numPolygons, numVertices );
+	osg::ref_ptr<osgUtil::Tessellator> tessellator = new osgUtil::Tessellator;
+	tessellator -> setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
+	tessellator -> setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	for ( unsigned int i = 0; i < reference.size(); ++i )
+		tessellator -> retessellatePolygons( *reference[i] );
+	double referenceTime = osg::Timer::instance() -> delta_s( start, osg::Timer::instance() -> tick() );
+	unsigned int referenceTriangles = countTriangles( reference );
+	std::cout << "  osgUtil::Tessellator: " << referenceTime * 1000.0 << " ms, " << referenceTriangles << " triangles, "
+	          << referenceTriangles / referenceTime / 1e6 << " M triangles/s" << std::endl;
+	reference.clear();
+
+	std::vector< osg::ref_ptr<osg::Geometry> > footprints = createFootprints( numPolygons, numVertices );
+	std::vector<osg::Geometry*> batch( footprints.size() );
+	for ( unsigned int i = 0; i < footprints.size(); ++i )
+		batch[i] = footprints[i].get();
+	start = osg::Timer::instance() -> tick();
+	PolygonTessellator::Statistics stats = PolygonTessellator( PolygonTessellator::TESS_TYPE_GEOMETRY, numThreads ).tessellate( batch );
+	double time = osg::Timer::instance() -> delta_s( start, osg::Timer::instance() -> tick() );
+	unsigned int triangles = countTriangles( footprints );
+	std::cout << "  PolygonTessellator:   " << time * 1000.0 << " ms, " << triangles << " triangles, "
+	          << triangles / time / 1e6 << " M triangles/s, " << stats.numFallbacks << " fallbacks" << std::endl
+	          << "  speedup " << referenceTime / time << "x" << std::endl;
+	return 0;
+}
@@ -1,32 +1,29 @@
 #include <osg/Geometry>
 #include <osg/Geode>
-#include <osgUtil/Tessellator>
 #include <osgViewer/Viewer>
 
+#include "GeometryBuilder.h"
+#include "PolygonTessellator.h"
+
 int main ( int argc, char** argv )
 {
-	osg::ref_ptr <osg::Vec3Array> vertices = new osg::Vec3Array;
-	vertices -> push_back( osg::Vec3( 0.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 2.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 2.0f, 0.0f, 1.0f ) );
-	vertices -> push_back( osg::Vec3( 1.0f, 0.0f, 1.0f ) );
-	vertices -> push_back( osg::Vec3( 1.0f, 0.0f, 2.0f ) );
-	vertices -> push_back( osg::Vec3( 2.0f, 0.0f, 2.0f ) );
-	vertices -> push_back( osg::Vec3( 2.0f, 0.0f, 3.0f ) );
-	vertices -> push_back( osg::Vec3( 0.0f, 0.0f, 3.0f ) );
-
-	osg::ref_ptr <osg::Vec3Array> normals = new osg::Vec3Array;
-	normals -> push_back( osg::Vec3( 0.0f, -1.0f, 0.0f ) );
+	//the concave outline, 8 vertices in one preallocated array
+	GeometryBuilder builder( 8 );
+	builder.addVertex( osg::Vec3( 0.0f, 0.0f, 0.0f ) );
+	builder.addVertex( osg::Vec3( 2.0f, 0.0f, 0.0f ) );
+	builder.addVertex( osg::Vec3( 2.0f, 0.0f, 1.0f ) );
+	builder.addVertex( osg::Vec3( 1.0f, 0.0f, 1.0f ) );
+	builder.addVertex( osg::Vec3( 1.0f, 0.0f, 2.0f ) );
+	builder.addVertex( osg::Vec3( 2.0f, 0.0f, 2.0f ) );
+	builder.addVertex( osg::Vec3( 2.0f, 0.0f, 3.0f ) );
+	builder.addVertex( osg::Vec3( 0.0f, 0.0f, 3.0f ) );
+	builder.setOverallNormal( osg::Vec3( 0.0f, -1.0f, 0.0f ) );
 
-	osg::ref_ptr <osg::Geometry> geom = new osg::Geometry;
-	geom -> setVertexArray( vertices.get() );
-	geom -> setNormalArray( normals.get() );
-	geom -> setNormalBinding( osg::Geometry::BIND_OVERALL );
-	geom -> addPrimitiveSet( new osg::DrawArrays( GL_POLYGON, 0, 8 ) );
+	osg::ref_ptr <osg::Geometry> geom = builder.build( GL_POLYGON );
 	
-	//essentially this lesson's important code:
-	osgUtil::Tessellator tessellator;
-	tessellator.retessellatePolygons( *geom );
+	//essentially this lesson's important code: ear clipping for simple outlines,
+	//osgUtil::Tessellator takes over for self-intersecting ones
+	PolygonTessellator().tessellate( *geom );
 
 	osg::ref_ptr <osg::Geode> root = new osg::Geode;
 	root -> addDrawable ( (  geom.get() ));
@@ -0,0 +1,205 @@
+//benchmark: osg::TriangleFunctor collector vs. TriangleExtractor blocks
+//
+//a grid of tiles under translating MatrixTransforms, every tile 128 x 128 quads in one of
+//four layouts: indexed triangles, indexed triangle strips, quads from DrawArrays and
+//fans from DrawArrayLengths. the old way collects every triangle through a TriangleFunctor
+//into growing x/y/z arrays, the new way streams them through one reused block; both then sum
+//the coordinates, the sums must agree. times and triangles per second are printed.
+//
+//	ExtractBenchmark                       (20M triangles)
+//	ExtractBenchmark --triangles 50 --block 16384 --local
+//
+//options: --triangles N (millions)  --block N (triangles per read)  --local (no world matrices)
+
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/Timer>
+#include <osg/TriangleFunctor>
+
+#include <iostream>
+#include <vector>
+
+#include "TriangleExtractor.h"
+
+const unsigned int tileSize = 128;
+
+osg::Vec3 gridVertex( unsigned int x, unsigned int y )
+{
+	return osg::Vec3( x * 0.1f, y * 0.1f, ( ( x * 7 + y * 13 ) % 17 ) * 0.01f );
+}
+
+osg::Geometry* createTile( unsigned int layout )
+{
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry -> setVertexArray( vertices.get() );
+	const unsigned int w = tileSize + 1;
+
+	if ( layout < 2 )
+	{
+		//shared vertices, indexed
+		for ( unsigned int y = 0; y < w; ++y )
+			for ( unsigned int x = 0; x < w; ++x )
+				vertices -> push_back( gridVertex( x, y ) );
+		if ( layout == 0 )
+		{
+			osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt( GL_TRIANGLES );
+			for ( unsigned int y = 0; y < tileSize; ++y )
+			{
+				for ( unsigned int x = 0; x < tileSize; ++x )
+				{
+					unsigned int a = y * w + x;
+					triangles -> push_back( a ); triangles -> push_back( a + 1 ); triangles -> push_back( a + w + 1 );
+					triangles -> push_back( a ); triangles -> push_back( a + w + 1 ); triangles -> push_back( a + w );
+				}
+			}
+			geometry -> addPrimitiveSet( triangles.get() );
+		}
+		else
+		{
+			for ( unsigned int y = 0; y < tileSize; ++y )
+			{
+				osg::ref_ptr<osg::DrawElementsUShort> strip = new osg::DrawElementsUShort( GL_TRIANGLE_STRIP );
+				for ( unsigned int x = 0; x < w; ++x )
+				{
+					strip -> push_back( ( y + 1 ) * w + x );
+					strip -> push_back( y * w + x );
+				}
+				geometry -> addPrimitiveSet( strip.get() );
+			}
+		}
+	}
+	else
+	{
+		//four vertices per quad, either as GL_QUADS or as one fan per quad
+		for ( unsigned int y = 0; y < tileSize; ++y )
+		{
+			for ( unsigned int x = 0; x < tileSize; ++x )
+			{
+				vertices -> push_back( gridVertex( x, y ) );
+				vertices -> push_back( gridVertex( x + 1, y ) );
+				vertices -> push_back( gridVertex( x + 1, y + 1 ) );
+				vertices -> push_back( gridVertex( x, y + 1 ) );
+			}
+		}
+		if ( layout == 2 )
+			geometry -> addPrimitiveSet( new osg::DrawArrays( GL_QUADS, 0, vertices -> size() ) );
+		else
+		{
+			osg::ref_ptr<osg::DrawArrayLengths> fans = new osg::DrawArrayLengths( GL_TRIANGLE_FAN );
+			fans -> assign( tileSize * tileSize, 4 );
+			geometry -> addPrimitiveSet( fans.get() );
+		}
+	}
+	return geometry.release();
+}
+
+osg::Node* createScene( unsigned long long numTriangles )
+{
+	unsigned int numTiles = (unsigned int)( ( numTriangles + 2 * tileSize * tileSize - 1 ) / ( 2 * tileSize * tileSize ) );
+	std::vector< osg::ref_ptr<osg::Geode> > layouts( 4 );
+	for ( unsigned int l = 0; l < layouts.size(); ++l )
+	{
+		layouts[l] = new osg::Geode;
+		layouts[l] -> addDrawable( createTile( l ) );
+	}
+
+	//tiles share their geometry per layout, like instanced scenery
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	for ( unsigned int t = 0; t < numTiles; ++t )
+	{
+		osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform( osg::Matrix::translate( ( t % 64 ) * 13.0, ( t / 64 ) * 13.0, 0.0 ) );
+		transform -> addChild( layouts[t % layouts.size()].get() );
+		root -> addChild( transform.get() );
+	}
+	return root.release();
+}
+
+//the old way: one call per triangle, the matrix applied per corner
+struct ArrayCollector
+{
+	ArrayCollector() : matrix( 0 ) {}
+
+	void operator() ( const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3 )
+	{
+		add( matrix ? v1 * *matrix : v1 );
+		add( matrix ? v2 * *matrix : v2 );
+		add( matrix ? v3 * *matrix : v3 );
+	}
+
+	void add( const osg::Vec3& v )
+	{
+		x.push_back( v.x() );
+		y.push_back( v.y() );
+		z.push_back( v.z() );
+	}
+
+	const osg::Matrix* matrix;
+	std::vector<float> x, y, z;
+};
+
+class FunctorVisitor : public osg::NodeVisitor
+{
+public:
+	FunctorVisitor( bool world ) : osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), _world( world ) {}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		osg::Matrix matrix = osg::computeLocalToWorld( getNodePath() );
+		functor.matrix = _world ? &matrix : 0;
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+			geode.getDrawable( i ) -> accept( functor );
+		functor.matrix = 0;
+	}
+
+	osg::TriangleFunctor<ArrayCollector> functor;
+
+protected:
+	bool _world;
+};
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int millions = 20, blockSize = 65536;
+	arguments.read( "--triangles", millions );
+	arguments.read( "--block", blockSize );
+	bool world = !arguments.read( "--local" );
+	blockSize = std::max( blockSize, 1u );
+
+	osg::ref_ptr<osg::Node> scene = createScene( millions * 1000000ull );
+
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	FunctorVisitor visitor( world );
+	scene -> accept( visitor );
+	const ArrayCollector& collected = visitor.functor;
+	double collectedSum = 0.0;
+	for ( size_t i = 0; i < collected.x.size(); ++i )
+		collectedSum += collected.x[i] + collected.y[i] + collected.z[i];
+	unsigned long long collectedCount = collected.x.size() / 3;
+	double functorTime = osg::Timer::instance() -> delta_s( start, osg::Timer::instance() -> tick() );
+	std::cout << collectedCount << " triangles" << ( world ? " in world space" : "" ) << std::endl
+	          << "  TriangleFunctor:   " << functorTime * 1000.0 << " ms, " << collectedCount / functorTime / 1e6
+	          << " M triangles/s, sum " << collectedSum << std::endl;
+
+	std::vector<float> x( 3 * blockSize ), y( 3 * blockSize ), z( 3 * blockSize );
+	TriangleExtractor::Buffers buffers( &x[0], &y[0], &z[0], blockSize );
+	start = osg::Timer::instance() -> tick();
+	TriangleExtractor extractor;
+	extractor.addScene( *scene, world );
+	double sum = 0.0;
+	unsigned long long count = 0;
+	while ( unsigned int n = extractor.read( buffers ) )
+	{
+		for ( unsigned int i = 0; i < 3 * n; ++i )
+			sum += x[i] + y[i] + z[i];
+		count += n;
+	}
+	double extractTime = osg::Timer::instance() -> delta_s( start, osg::Timer::instance() -> tick() );
+	std::cout << "  TriangleExtractor: " << extractTime * 1000.0 << " ms, " << count / extractTime / 1e6
+	          << " M triangles/s, sum " << sum << ", blocks of " << blockSize << std::endl
+	          << "  speedup " << functorTime / extractTime << "x" << std::endl;
+	return count == collectedCount ? 0 : 1;
+}
@@ -1,60 +1,66 @@
 
 #include <osg/Geometry>
 #include <osg/Geode>
-#include <osg/TriangleFunctor>
 #include <osgUtil/Tessellator>
 #include <osgViewer/Viewer>
 #include <iostream>
 
-void outVec3 ( osg::Vec3 vec3 )
-{
-	for( int i {0}; i < vec3.length(); ++i )
-	{
-		std::cout << vec3[i] << " ";
-	}
-}
+#include "GeometryBuilder.h"
+#include "ParallelTriangleFunctor.h"
+#include "TriangleExtractor.h"
 
-struct FaceCollector
+//a TriangleFunctor payload that can be split over threads: ParallelTriangleFunctor gives every
+//worker its own copy and merges them in order at the end
+struct AreaCollector
 {
-	//TODO: Nani the fuck is this bool there?
-	//let's comment it out for now
-	void operator() ( const osg::Vec3 &v1, const osg::Vec3 &v2, const osg::Vec3 &v3) // ,bool )
+	AreaCollector() : area( 0.0 ) {}
+
+	void operator() ( const osg::Vec3 &v1, const osg::Vec3 &v2, const osg::Vec3 &v3 )
 	{
-		std::cout << "Face vertices: " << std::endl;
-		outVec3(v1);
-		std::cout << std::endl;
-		outVec3(v2);
-		std::cout << std::endl;
-		outVec3(v3);
-		std::cout << std::endl;
+		area += ( ( v2 - v1 ) ^ ( v3 - v1 ) ).length() * 0.5;
 	}
+
+	void merge( const AreaCollector& other ) { area += other.area; }
+
+	double area;
 };
 
 int main( int argc, char** argv )
 {
-	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
-	vertices -> push_back( osg::Vec3( 0.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 0.0f, 0.0f, 1.0f ) );
-	vertices -> push_back( osg::Vec3( 1.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 1.0f, 0.0f, 1.5f ) );
-	vertices -> push_back( osg::Vec3( 2.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 2.0f, 0.0f, 1.0f ) );
-	vertices -> push_back( osg::Vec3( 3.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 3.0f, 0.0f, 1.5f ) );
-	vertices -> push_back( osg::Vec3( 4.0f, 0.0f, 0.0f ) );
-	vertices -> push_back( osg::Vec3( 4.0f, 0.0f, 1.0f ) );
-
-	osg::ref_ptr <osg::Vec3Array> normals = new osg::Vec3Array;
-	normals -> push_back( osg::Vec3( 0.0f, -1.0f, 0.0f ) );
+	GeometryBuilder builder( 10 );
+	builder.addVertex( osg::Vec3( 0.0f, 0.0f, 0.0f ) );
+	builder.addVertex( osg::Vec3( 0.0f, 0.0f, 1.0f ) );
+	builder.addVertex( osg::Vec3( 1.0f, 0.0f, 0.0f ) );
+	builder.addVertex( osg::Vec3( 1.0f, 0.0f, 1.5f ) );
+	builder.addVertex( osg::Vec3( 2.0f, 0.0f, 0.0f ) );
+	builder.addVertex( osg::Vec3( 2.0f, 0.0f, 1.0f ) );
+	builder.addVertex( osg::Vec3( 3.0f, 0.0f, 0.0f ) );
+	builder.addVertex( osg::Vec3( 3.0f, 0.0f, 1.5f ) );
+	builder.addVertex( osg::Vec3( 4.0f, 0.0f, 0.0f ) );
+	builder.addVertex( osg::Vec3( 4.0f, 0.0f, 1.0f ) );
+	builder.setOverallNormal( osg::Vec3( 0.0f, -1.0f, 0.0f ) );
 
-	osg::ref_ptr <osg::Geometry> geom = new osg::Geometry;
-	geom -> setVertexArray( vertices.get() );
-	geom -> setNormalArray( normals.get() );
-	geom -> setNormalBinding( osg::Geometry::BIND_OVERALL );
-	geom -> addPrimitiveSet( new osg::DrawArrays( GL_QUAD_STRIP, 0, 10 ) );
+	osg::ref_ptr <osg::Geometry> geom = builder.build( GL_QUAD_STRIP );
 	
-	osg::TriangleFunctor <FaceCollector> functor;
-	geom -> accept(functor);
+	//the triangles of the strip, streamed into flat x/y/z arrays a few at a time
+	//(real exports use blocks of tens of thousands)
+	const unsigned int blockSize = 4;
+	float x[3 * blockSize], y[3 * blockSize], z[3 * blockSize];
+	TriangleExtractor extractor;
+	extractor.addGeometry( *geom );
+	TriangleExtractor::Buffers buffers( x, y, z, blockSize );
+	while ( unsigned int n = extractor.read( buffers ) )
+	{
+		for ( unsigned int i = 0; i < 3 * n; ++i )
+		{
+			if ( i % 3 == 0 ) std::cout << "Face vertices: " << std::endl;
+			std::cout << x[i] << " " << y[i] << " " << z[i] << " " << std::endl;
+		}
+	}
+
+	ParallelTriangleFunctor<AreaCollector> parallel;
+	parallel.addGeometry( *geom );
+	std::cout << "Surface area: " << parallel.reduce( AreaCollector() ).area << std::endl;
 
 	osg::ref_ptr <osg::Geode> root = new osg::Geode;
 	root -> addDrawable( geom.get() );	
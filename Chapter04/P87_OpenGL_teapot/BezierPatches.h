@@ -0,0 +1,228 @@
+#ifndef BEZIER_PATCHES_H
+#define BEZIER_PATCHES_H
+
+#include <osg/BoundingBox>
+#include <osg/Geometry>
+#include <osg/Referenced>
+
+#include <atomic>
+#include <vector>
+
+#include "GeometryBuilder.h"
+
+//BezierPatches
+//a surface made of bicubic bezier patches (4 x 4 control points, rows of constant v) and
+//its tessellations. tessellate( detail ) evaluates every patch on a ( detail + 1 )^2 grid
+//into one indexed triangle mesh with normals and (u, v) texture coordinates, wound
+//counter-clockwise around du x dv. the basis functions are tabulated once per detail, and a
+//mesh of half the detail can be handed in: its grid points are copied instead of evaluated.
+//
+//on top of that the patches keep a ladder of levels, level l has 2^(l+1) steps per patch
+//side. a level is built once, by whoever calls buildLevel() (PatchDrawable leaves that to
+//its worker thread), and published with a release store, so getLevel() never waits.
+
+class BezierPatches : public osg::Referenced
+{
+public:
+	static const unsigned int numLevels = 6;
+
+	struct Patch
+	{
+		osg::Vec3 points[4][4];
+	};
+
+	BezierPatches() : _sumOfDiagonals( 0.0f )
+	{
+		for ( unsigned int l = 0; l < numLevels; ++l )
+		{
+			_ready[l] = false;
+			_requested[l] = false;
+		}
+	}
+
+	//patches can only be added before the first level is built
+	void addPatch( const osg::Vec3 points[4][4] )
+	{
+		Patch patch;
+		osg::BoundingBox box;
+		for ( unsigned int j = 0; j < 4; ++j )
+		{
+			for ( unsigned int k = 0; k < 4; ++k )
+			{
+				patch.points[j][k] = points[j][k];
+				box.expandBy( points[j][k] );
+			}
+		}
+		_patches.push_back( patch );
+		_bound.expandBy( box );
+		_sumOfDiagonals += ( box._max - box._min ).length();
+	}
+
+	unsigned int getNumPatches() const { return _patches.size(); }
+	const Patch& getPatch( unsigned int i ) const { return _patches[i]; }
+
+	//box of the control points, the surface never leaves it
+	const osg::BoundingBox& getBound() const { return _bound; }
+
+	//average patch extent as a fraction of the whole surface's
+	float getPatchFraction() const
+	{
+		float diagonal = ( _bound._max - _bound._min ).length();
+		return _patches.empty() || diagonal <= 0.0f ? 1.0f : _sumOfDiagonals / _patches.size() / diagonal;
+	}
+
+	static unsigned int getDetail( unsigned int level ) { return 2u << level; }
+
+	//the mesh of a level, 0 while it is not built yet
+	osg::Geometry* getLevel( unsigned int level ) const
+	{
+		return _ready[level].load( std::memory_order_acquire ) ? _levels[level].get() : 0;
+	}
+
+	//true for the one caller that should build the level, false once it is claimed
+	bool claimLevel( unsigned int level ) { return !isClaimed( level ) && !_requested[level].exchange( true ); }
+	bool isClaimed( unsigned int level ) const { return _requested[level].load( std::memory_order_acquire ); }
+
+	//tessellate a level, refined from the level below if that one is there; call once per
+	//level and from one thread at a time, after claimLevel()
+	void buildLevel( unsigned int level )
+	{
+		_levels[level] = tessellate( getDetail( level ), level > 0 ? getLevel( level - 1 ) : 0 );
+		_ready[level].store( true, std::memory_order_release );
+	}
+
+	osg::Geometry* tessellate( unsigned int detail, const osg::Geometry* half = 0 ) const
+	{
+		detail = std::max( detail, 1u );
+		unsigned int side = detail + 1, numVertices = side * side;
+		std::vector<float> basis( 4 * side ), derivatives( 4 * side );
+		for ( unsigned int s = 0; s < side; ++s )
+			bernstein( (float)s / detail, &basis[4 * s], &derivatives[4 * s] );
+
+		//every other grid point of this detail is a grid point of the half detail
+		unsigned int halfSide = detail / 2 + 1;
+		const osg::Vec3Array* halfVertices = half ? dynamic_cast<const osg::Vec3Array*>( half -> getVertexArray() ) : 0;
+		const osg::Vec3Array* halfNormals = half ? dynamic_cast<const osg::Vec3Array*>( half -> getNormalArray() ) : 0;
+		bool refine = detail % 2 == 0 && halfVertices && halfNormals
+		           && halfVertices -> size() == _patches.size() * halfSide * halfSide && halfNormals -> size() == halfVertices -> size();
+
+		GeometryBuilder builder( _patches.size() * numVertices, GeometryBuilder::NORMALS | GeometryBuilder::TEXCOORDS,
+		                         _patches.size() * detail * detail * 6 );
+		builder.setNarrowIndices( true );
+		osg::Vec3* vertices = builder.vertices();
+		osg::Vec3* normals = builder.normals();
+		osg::Vec2* texCoords = builder.texCoords();
+
+		for ( unsigned int i = 0; i < _patches.size(); ++i )
+		{
+			const osg::Vec3 ( &points )[4][4] = _patches[i].points;
+			unsigned int first = i * numVertices;
+			for ( unsigned int a = 0; a < side; ++a )
+			{
+				for ( unsigned int b = 0; b < side; ++b )
+				{
+					unsigned int v = first + a * side + b;
+					texCoords[v].set( (float)b / detail, (float)a / detail );
+					if ( refine && a % 2 == 0 && b % 2 == 0 )
+					{
+						unsigned int h = i * halfSide * halfSide + a / 2 * halfSide + b / 2;
+						vertices[v] = ( *halfVertices )[h];
+						normals[v] = ( *halfNormals )[h];
+						continue;
+					}
+
+					osg::Vec3 du, dv;
+					vertices[v] = evaluate( points, &basis[4 * b], &derivatives[4 * b], &basis[4 * a], &derivatives[4 * a], &du, &dv );
+					normals[v] = du ^ dv;
+					//the lid knob and the bottom centre collapse a whole row into one point,
+					//there the normal is taken a little way into the patch
+					if ( normals[v].length2() < 1e-12f )
+					{
+						float u = (float)b / detail, t = (float)a / detail;
+						normals[v] = normal( points, u, t < 0.5f ? t + 1e-3f : t - 1e-3f );
+					}
+					normals[v].normalize();
+				}
+			}
+			//edges collapsed into a point would give slivers of zero area
+			bool firstRow = collapsed( points, 0, 0, 0, 1 ), lastRow = collapsed( points, 3, 0, 0, 1 );
+			bool firstColumn = collapsed( points, 0, 0, 1, 0 ), lastColumn = collapsed( points, 0, 3, 1, 0 );
+			for ( unsigned int a = 0; a < detail; ++a )
+			{
+				for ( unsigned int b = 0; b < detail; ++b )
+				{
+					unsigned int q = first + a * side + b;
+					if ( !( a == 0 && firstRow ) && !( b + 1 == detail && lastColumn ) )
+						builder.addTriangle( q, q + 1, q + side + 1 );
+					if ( !( a + 1 == detail && lastRow ) && !( b == 0 && firstColumn ) )
+						builder.addTriangle( q, q + side + 1, q + side );
+				}
+			}
+		}
+		builder.setNumVertices( _patches.size() * numVertices );
+		return builder.build( GL_TRIANGLES );
+	}
+
+	//position and derivatives at (u, v) from tabulated basis values of u and of v
+	static osg::Vec3 evaluate( const osg::Vec3 points[4][4], const float* bu, const float* dbu, const float* bv, const float* dbv,
+	                           osg::Vec3* du = 0, osg::Vec3* dv = 0 )
+	{
+		osg::Vec3 p;
+		if ( du ) du -> set( 0.0f, 0.0f, 0.0f );
+		if ( dv ) dv -> set( 0.0f, 0.0f, 0.0f );
+		for ( unsigned int j = 0; j < 4; ++j )
+		{
+			osg::Vec3 row = points[j][0] * bu[0] + points[j][1] * bu[1] + points[j][2] * bu[2] + points[j][3] * bu[3];
+			p += row * bv[j];
+			if ( dv ) *dv += row * dbv[j];
+			if ( du ) *du += ( points[j][0] * dbu[0] + points[j][1] * dbu[1] + points[j][2] * dbu[2] + points[j][3] * dbu[3] ) * bv[j];
+		}
+		return p;
+	}
+
+	//true if the 4 control points from (j, k) in steps of (dj, dk) are one point
+	static bool collapsed( const osg::Vec3 points[4][4], unsigned int j, unsigned int k, unsigned int dj, unsigned int dk )
+	{
+		for ( unsigned int n = 1; n < 4; ++n )
+			if ( points[j + n * dj][k + n * dk] != points[j][k] ) return false;
+		return true;
+	}
+
+	//unnormalized du x dv at (u, v)
+	static osg::Vec3 normal( const osg::Vec3 points[4][4], float u, float v )
+	{
+		float bu[4], dbu[4], bv[4], dbv[4];
+		bernstein( u, bu, dbu );
+		bernstein( v, bv, dbv );
+		osg::Vec3 du, dv;
+		evaluate( points, bu, dbu, bv, dbv, &du, &dv );
+		return du ^ dv;
+	}
+
+	//cubic bernstein polynomials and their derivatives at t
+	static void bernstein( float t, float* b, float* d )
+	{
+		float s = 1.0f - t;
+		b[0] = s * s * s;
+		b[1] = 3.0f * t * s * s;
+		b[2] = 3.0f * t * t * s;
+		b[3] = t * t * t;
+		d[0] = -3.0f * s * s;
+		d[1] = 3.0f * s * s - 6.0f * t * s;
+		d[2] = 6.0f * t * s - 3.0f * t * t;
+		d[3] = 3.0f * t * t;
+	}
+
+protected:
+	virtual ~BezierPatches() {}
+
+	std::vector<Patch> _patches;
+	osg::BoundingBox _bound;
+	float _sumOfDiagonals;
+
+	osg::ref_ptr<osg::Geometry> _levels[numLevels];
+	std::atomic<bool> _ready[numLevels];
+	std::atomic<bool> _requested[numLevels];
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef PATCH_DRAWABLE_H
+#define PATCH_DRAWABLE_H
+
+#include <osg/Drawable>
+#include <osg/Geometry>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+#include <osgUtil/CullVisitor>
+
+#include <atomic>
+#include <deque>
+
+#include "BezierPatches.h"
+
+//PatchTessellatorThread
+//the one background thread that builds BezierPatches levels. requests are queued coarse
+//level first, so every level can be refined from the one below it. started on the first
+//request, asleep on a condition while the queue is empty, stopped when the program exits.
+
+class PatchTessellatorThread : public OpenThreads::Thread
+{
+public:
+	static PatchTessellatorThread* instance()
+	{
+		static PatchTessellatorThread s_thread;
+		return &s_thread;
+	}
+
+	//queue a level and all coarser ones nobody has claimed yet; returns at once
+	void request( BezierPatches* patches, unsigned int level )
+	{
+		//a claimed level had its coarser ones claimed with it
+		if ( patches -> isClaimed( level ) ) return;
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		for ( unsigned int l = 0; l <= level; ++l )
+			if ( patches -> claimLevel( l ) ) _queue.push_back( Request( patches, l ) );
+		if ( !isRunning() ) start();
+		_wakeUp.signal();
+	}
+
+	virtual void run()
+	{
+		for ( ;; )
+		{
+			Request request;
+			{
+				//nothing queued: sleep until request() or the destructor signals
+				OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+				while ( _queue.empty() && !_done ) _wakeUp.wait( &_mutex );
+				if ( _done ) return;
+				request = _queue.front();
+				_queue.pop_front();
+			}
+			request.first -> buildLevel( request.second );
+		}
+	}
+
+protected:
+	typedef std::pair< osg::ref_ptr<BezierPatches>, unsigned int > Request;
+
+	PatchTessellatorThread() : _done( false ) {}
+
+	virtual ~PatchTessellatorThread()
+	{
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			_done = true;
+		}
+		_wakeUp.signal();
+		if ( isRunning() ) join();
+	}
+
+	std::deque<Request> _queue;
+	OpenThreads::Mutex _mutex;
+	OpenThreads::Condition _wakeUp;
+	bool _done;		//guarded by _mutex
+};
+
+//PatchDrawable
+//draws a BezierPatches surface at the level its screen size asks for. in the cull traversal
+//the projected pixel size of the bound is turned into grid steps per patch, so that one step
+//covers about pixelsPerStep pixels, and the smallest level with that many steps is chosen.
+//a level that is not built yet is requested from PatchTessellatorThread and the nearest
+//built one is drawn meanwhile: cull never waits for a tessellation. level 0 is built when
+//the patches are set, so there is always something to draw.
+//
+//many drawables may share one BezierPatches, they share its levels then. with several
+//cameras the level of the last cull is drawn.
+//
+//	osg::ref_ptr<BezierPatches> patches = TeapotMesh::createPatches( 1.0f );
+//	geode -> addDrawable( new PatchDrawable( patches.get() ) );
+
+class PatchDrawable : public osg::Drawable
+{
+public: PatchDrawable( BezierPatches* patches = 0, float pixelsPerStep = 8.0f )
+		: _pixelsPerStep( pixelsPerStep ), _level( 0 )
+	{
+		//the level changes from frame to frame, a display list would freeze the first one
+		setUseDisplayList( false );
+		setUseVertexBufferObjects( true );
+		setCullCallback( new LevelCallback );
+		setPatches( patches );
+	}
+
+	PatchDrawable( const PatchDrawable &copy, const osg::CopyOp &copyop = osg::CopyOp::SHALLOW_COPY )
+		:osg::Drawable( copy, copyop ), _patches( copy._patches ), _pixelsPerStep( copy._pixelsPerStep ),
+		 _level( copy._level.load() ) {}
+
+	META_Object( osg, PatchDrawable );
+
+	void setPatches( BezierPatches* patches )
+	{
+		_patches = patches;
+		if ( _patches.valid() && _patches -> claimLevel( 0 ) ) _patches -> buildLevel( 0 );
+		_level = 0;
+		dirtyBound();
+	}
+
+	BezierPatches* getPatches() { return _patches.get(); }
+	const BezierPatches* getPatches() const { return _patches.get(); }
+
+	void setPixelsPerStep( float pixels ) { _pixelsPerStep = pixels; }
+	float getPixelsPerStep() const { return _pixelsPerStep; }
+
+	//the level drawn last
+	unsigned int getLevel() const { return _level.load( std::memory_order_relaxed ); }
+
+	//the level a bound pixelSize pixels across asks for
+	unsigned int computeLevel( float pixelSize ) const
+	{
+		float steps = pixelSize * _patches -> getPatchFraction() / std::max( _pixelsPerStep, 1.0f );
+		unsigned int level = 0;
+		while ( level + 1 < BezierPatches::numLevels && BezierPatches::getDetail( level ) < steps ) ++level;
+		return level;
+	}
+
+	//the control points' box, it holds every level
+	virtual osg::BoundingBox computeBoundingBox() const
+	{
+		return _patches.valid() ? _patches -> getBound() : osg::BoundingBox();
+	}
+
+	virtual void drawImplementation( osg::RenderInfo &renderInfo ) const
+	{
+		osg::Geometry* mesh = getMesh();
+		if ( mesh ) mesh -> drawImplementation( renderInfo );
+	}
+
+	//intersections and statistics see the level drawn last
+	virtual bool supports( const osg::PrimitiveFunctor& ) const { return true; }
+	virtual void accept( osg::PrimitiveFunctor& functor ) const
+	{
+		osg::Geometry* mesh = getMesh();
+		if ( mesh ) mesh -> accept( functor );
+	}
+
+	//the levels are drawn from here, not from the scene graph: their buffer objects are
+	//compiled, resized and released through this drawable. levels built later compile on first draw
+	virtual void compileGLObjects( osg::RenderInfo& renderInfo ) const
+	{
+		for ( unsigned int l = 0; _patches.valid() && l < BezierPatches::numLevels; ++l )
+			if ( _patches -> getLevel( l ) ) _patches -> getLevel( l ) -> compileGLObjects( renderInfo );
+	}
+
+	virtual void resizeGLObjectBuffers( unsigned int maxSize )
+	{
+		osg::Drawable::resizeGLObjectBuffers( maxSize );
+		for ( unsigned int l = 0; _patches.valid() && l < BezierPatches::numLevels; ++l )
+			if ( _patches -> getLevel( l ) ) _patches -> getLevel( l ) -> resizeGLObjectBuffers( maxSize );
+	}
+
+	virtual void releaseGLObjects( osg::State* state = 0 ) const
+	{
+		osg::Drawable::releaseGLObjects( state );
+		for ( unsigned int l = 0; _patches.valid() && l < BezierPatches::numLevels; ++l )
+			if ( _patches -> getLevel( l ) ) _patches -> getLevel( l ) -> releaseGLObjects( state );
+	}
+
+	virtual bool supports( const osg::PrimitiveIndexFunctor& ) const { return true; }
+	virtual void accept( osg::PrimitiveIndexFunctor& functor ) const
+	{
+		osg::Geometry* mesh = getMesh();
+		if ( mesh ) mesh -> accept( functor );
+	}
+
+protected:
+	class LevelCallback : public osg::DrawableCullCallback
+	{
+	public:
+		virtual bool cull( osg::NodeVisitor* nv, osg::Drawable* drawable, osg::RenderInfo* ) const
+		{
+			PatchDrawable* patch = static_cast<PatchDrawable*>( drawable );
+			osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>( nv );
+			if ( cv && patch -> _patches.valid() )
+				patch -> selectLevel( patch -> computeLevel( cv -> clampedPixelSize( drawable -> getBound() ) ) );
+			return false;
+		}
+	};
+
+	//draw the wanted level if it is built, else ask for it and draw the finest built one
+	//below it, or the coarsest one above
+	void selectLevel( unsigned int wanted )
+	{
+		if ( _patches -> getLevel( wanted ) )
+		{
+			_level.store( wanted, std::memory_order_relaxed );
+			return;
+		}
+		PatchTessellatorThread::instance() -> request( _patches.get(), wanted );
+		for ( unsigned int l = wanted; l-- > 0; )
+		{
+			if ( _patches -> getLevel( l ) )
+			{
+				_level.store( l, std::memory_order_relaxed );
+				return;
+			}
+		}
+		for ( unsigned int l = wanted + 1; l < BezierPatches::numLevels; ++l )
+		{
+			if ( _patches -> getLevel( l ) )
+			{
+				_level.store( l, std::memory_order_relaxed );
+				return;
+			}
+		}
+	}
+
+	osg::Geometry* getMesh() const
+	{
+		return _patches.valid() ? _patches -> getLevel( _level.load( std::memory_order_relaxed ) ) : 0;
+	}
+
+	osg::ref_ptr<BezierPatches> _patches;
+	float _pixelsPerStep;
+	std::atomic<unsigned int> _level;
+};
+
+#endif
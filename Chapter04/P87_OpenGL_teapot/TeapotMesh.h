@@ -0,0 +1,169 @@
+#ifndef TEAPOT_MESH_H
+#define TEAPOT_MESH_H
+
+#include <osg/Geometry>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <map>
+#include <utility>
+
+#include "BezierPatches.h"
+
+//TeapotMesh
+//the Utah teapot of glutSolidTeapot() (Newell's bezier patches as GLUT ships them: ten
+//patches, the first six mirrored into four quadrants, the handle and spout into two)
+//evaluated once on the CPU into an indexed triangle mesh with normals and texture
+//coordinates, in GLUT's placement: rotated to y up, scaled by half the size, the base at
+//y = -0.75 * size. detail is the number of grid steps per patch side, glutSolidTeapot uses 7.
+//
+//the cache hands out one mesh per size and detail; TeapotDrawable shares its arrays, so
+//thousands of teapots need one vertex buffer.
+//
+//	osg::Geometry* mesh = TeapotMesh::instance() -> getMesh( 1.0f, 7 );
+
+class TeapotMesh
+{
+public:
+	static TeapotMesh* instance()
+	{
+		static TeapotMesh s_cache;
+		return &s_cache;
+	}
+
+	//never modify what you get back
+	osg::Geometry* getMesh( float size, unsigned int detail = 7 )
+	{
+		detail = std::max( detail, 1u );
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		osg::ref_ptr<osg::Geometry>& mesh = _meshes[std::make_pair( size, detail )];
+		if ( !mesh.valid() ) mesh = build( size, detail );
+		return mesh.get();
+	}
+
+	unsigned int getNumMeshes() const { return _meshes.size(); }
+
+	//vertices of one mesh: 32 patches of ( detail + 1 )^2
+	static unsigned int getNumVertices( unsigned int detail ) { return numPatches * ( detail + 1 ) * ( detail + 1 ); }
+
+	static const unsigned int numPatches = 6 * 4 + 4 * 2;
+
+	//the 16 control points of patch copy c (see getNumCopies) of patch i, rows of constant v,
+	//in GLUT's patch space (z up, before its rotation, scale and translation)
+	static void getControlPoints( unsigned int i, unsigned int c, osg::Vec3 points[4][4] )
+	{
+		for ( unsigned int j = 0; j < 4; ++j )
+		{
+			for ( unsigned int k = 0; k < 4; ++k )
+			{
+				//copies 1 and 2 are mirrored once, so they walk the row backwards to keep their winding
+				const float* p = controlPoints()[patches()[i][j * 4 + ( c == 1 || c == 2 ? 3 - k : k )]];
+				points[j][k].set( c >= 2 ? -p[0] : p[0], c == 1 || c == 3 ? -p[1] : p[1], p[2] );
+			}
+		}
+	}
+
+	static unsigned int getNumPatches() { return 10; }
+	static unsigned int getNumCopies( unsigned int i ) { return i < 6 ? 4 : 2; }
+
+	//GLUT's glRotatef( 270, 1, 0, 0 ), glScalef( 0.5 * size ), glTranslatef( 0, 0, -1.5 )
+	static osg::Vec3 toModel( const osg::Vec3& p, float size )
+	{
+		return osg::Vec3( p.x(), p.z() - 1.5f, -p.y() ) * ( 0.5f * size );
+	}
+
+	//all 32 patches in GLUT's placement; the mapping is a rotation and a uniform scale,
+	//so the patches of the model are the transformed control points
+	static BezierPatches* createPatches( float size )
+	{
+		osg::ref_ptr<BezierPatches> patches = new BezierPatches;
+		osg::Vec3 points[4][4];
+		for ( unsigned int i = 0; i < getNumPatches(); ++i )
+		{
+			for ( unsigned int c = 0; c < getNumCopies( i ); ++c )
+			{
+				getControlPoints( i, c, points );
+				for ( unsigned int j = 0; j < 4; ++j )
+					for ( unsigned int k = 0; k < 4; ++k )
+						points[j][k] = toModel( points[j][k], size );
+				patches -> addPatch( points );
+			}
+		}
+		return patches.release();
+	}
+
+protected:
+	TeapotMesh() {}
+
+	typedef std::pair<float, unsigned int> Key;
+
+	static osg::Geometry* build( float size, unsigned int detail )
+	{
+		osg::ref_ptr<BezierPatches> patches = createPatches( size );
+		return patches -> tessellate( detail );
+	}
+
+	//patch rows of 4 control point indices: rim, body (2), lid (2), bottom, handle (2), spout (2)
+	static const int ( *patches() )[16]
+	{
+		static const int s_patches[10][16] =
+		{
+			{ 102, 103, 104, 105, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+			{ 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 },
+			{ 24, 25, 26, 27, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40 },
+			{ 96, 96, 96, 96, 97, 98, 99, 100, 101, 101, 101, 101, 0, 1, 2, 3 },
+			{ 0, 1, 2, 3, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117 },
+			{ 118, 118, 118, 118, 124, 122, 119, 121, 123, 126, 125, 120, 40, 39, 38, 37 },
+			{ 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56 },
+			{ 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 28, 65, 66, 67 },
+			{ 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83 },
+			{ 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95 }
+		};
+		return s_patches;
+	}
+
+	static const float ( *controlPoints() )[3]
+	{
+		static const float s_points[127][3] =
+		{
+			{ 0.2f, 0.0f, 2.7f }, { 0.2f, -0.112f, 2.7f }, { 0.112f, -0.2f, 2.7f }, { 0.0f, -0.2f, 2.7f },
+			{ 1.3375f, 0.0f, 2.53125f }, { 1.3375f, -0.749f, 2.53125f }, { 0.749f, -1.3375f, 2.53125f }, { 0.0f, -1.3375f, 2.53125f },
+			{ 1.4375f, 0.0f, 2.53125f }, { 1.4375f, -0.805f, 2.53125f }, { 0.805f, -1.4375f, 2.53125f }, { 0.0f, -1.4375f, 2.53125f },
+			{ 1.5f, 0.0f, 2.4f }, { 1.5f, -0.84f, 2.4f }, { 0.84f, -1.5f, 2.4f }, { 0.0f, -1.5f, 2.4f },
+			{ 1.75f, 0.0f, 1.875f }, { 1.75f, -0.98f, 1.875f }, { 0.98f, -1.75f, 1.875f }, { 0.0f, -1.75f, 1.875f },
+			{ 2.0f, 0.0f, 1.35f }, { 2.0f, -1.12f, 1.35f }, { 1.12f, -2.0f, 1.35f }, { 0.0f, -2.0f, 1.35f },
+			{ 2.0f, 0.0f, 0.9f }, { 2.0f, -1.12f, 0.9f }, { 1.12f, -2.0f, 0.9f }, { 0.0f, -2.0f, 0.9f },
+			{ -2.0f, 0.0f, 0.9f }, { 2.0f, 0.0f, 0.45f }, { 2.0f, -1.12f, 0.45f }, { 1.12f, -2.0f, 0.45f },
+			{ 0.0f, -2.0f, 0.45f }, { 1.5f, 0.0f, 0.225f }, { 1.5f, -0.84f, 0.225f }, { 0.84f, -1.5f, 0.225f },
+			{ 0.0f, -1.5f, 0.225f }, { 1.5f, 0.0f, 0.15f }, { 1.5f, -0.84f, 0.15f }, { 0.84f, -1.5f, 0.15f },
+			{ 0.0f, -1.5f, 0.15f }, { -1.6f, 0.0f, 2.025f }, { -1.6f, -0.3f, 2.025f }, { -1.5f, -0.3f, 2.25f },
+			{ -1.5f, 0.0f, 2.25f }, { -2.3f, 0.0f, 2.025f }, { -2.3f, -0.3f, 2.025f }, { -2.5f, -0.3f, 2.25f },
+			{ -2.5f, 0.0f, 2.25f }, { -2.7f, 0.0f, 2.025f }, { -2.7f, -0.3f, 2.025f }, { -3.0f, -0.3f, 2.25f },
+			{ -3.0f, 0.0f, 2.25f }, { -2.7f, 0.0f, 1.8f }, { -2.7f, -0.3f, 1.8f }, { -3.0f, -0.3f, 1.8f },
+			{ -3.0f, 0.0f, 1.8f }, { -2.7f, 0.0f, 1.575f }, { -2.7f, -0.3f, 1.575f }, { -3.0f, -0.3f, 1.35f },
+			{ -3.0f, 0.0f, 1.35f }, { -2.5f, 0.0f, 1.125f }, { -2.5f, -0.3f, 1.125f }, { -2.65f, -0.3f, 0.9375f },
+			{ -2.65f, 0.0f, 0.9375f }, { -2.0f, -0.3f, 0.9f }, { -1.9f, -0.3f, 0.6f }, { -1.9f, 0.0f, 0.6f },
+			{ 1.7f, 0.0f, 1.425f }, { 1.7f, -0.66f, 1.425f }, { 1.7f, -0.66f, 0.6f }, { 1.7f, 0.0f, 0.6f },
+			{ 2.6f, 0.0f, 1.425f }, { 2.6f, -0.66f, 1.425f }, { 3.1f, -0.66f, 0.825f }, { 3.1f, 0.0f, 0.825f },
+			{ 2.3f, 0.0f, 2.1f }, { 2.3f, -0.25f, 2.1f }, { 2.4f, -0.25f, 2.025f }, { 2.4f, 0.0f, 2.025f },
+			{ 2.7f, 0.0f, 2.4f }, { 2.7f, -0.25f, 2.4f }, { 3.3f, -0.25f, 2.4f }, { 3.3f, 0.0f, 2.4f },
+			{ 2.8f, 0.0f, 2.475f }, { 2.8f, -0.25f, 2.475f }, { 3.525f, -0.25f, 2.49375f }, { 3.525f, 0.0f, 2.49375f },
+			{ 2.9f, 0.0f, 2.475f }, { 2.9f, -0.15f, 2.475f }, { 3.45f, -0.15f, 2.5125f }, { 3.45f, 0.0f, 2.5125f },
+			{ 2.8f, 0.0f, 2.4f }, { 2.8f, -0.15f, 2.4f }, { 3.2f, -0.15f, 2.4f }, { 3.2f, 0.0f, 2.4f },
+			{ 0.0f, 0.0f, 3.15f }, { 0.8f, 0.0f, 3.15f }, { 0.8f, -0.45f, 3.15f }, { 0.45f, -0.8f, 3.15f },
+			{ 0.0f, -0.8f, 3.15f }, { 0.0f, 0.0f, 2.85f }, { 1.4f, 0.0f, 2.4f }, { 1.4f, -0.784f, 2.4f },
+			{ 0.784f, -1.4f, 2.4f }, { 0.0f, -1.4f, 2.4f }, { 0.4f, 0.0f, 2.55f }, { 0.4f, -0.224f, 2.55f },
+			{ 0.224f, -0.4f, 2.55f }, { 0.0f, -0.4f, 2.55f }, { 1.3f, 0.0f, 2.55f }, { 1.3f, -0.728f, 2.55f },
+			{ 0.728f, -1.3f, 2.55f }, { 0.0f, -1.3f, 2.55f }, { 1.3f, 0.0f, 2.4f }, { 1.3f, -0.728f, 2.4f },
+			{ 0.728f, -1.3f, 2.4f }, { 0.0f, -1.3f, 2.4f }, { 0.0f, 0.0f, 0.0f }, { 1.425f, -0.798f, 0.0f },
+			{ 1.5f, 0.0f, 0.075f }, { 1.425f, 0.0f, 0.0f }, { 0.798f, -1.425f, 0.0f }, { 0.0f, -1.5f, 0.075f },
+			{ 0.0f, -1.425f, 0.0f }, { 1.5f, -0.84f, 0.075f }, { 0.84f, -1.5f, 0.075f }
+		};
+		return s_points;
+	}
+
+	std::map< Key, osg::ref_ptr<osg::Geometry> > _meshes;
+	OpenThreads::Mutex _mutex;
+};
+
+#endif
@@ -1,55 +1,92 @@
+#include <osg/ArgumentParser>
 #include <osg/Geometry>
 #include <osg/Geode>
+#include <osg/MatrixTransform>
 #include <osgViewer/Viewer>
 
-#include <GL/freeglut.h>
-#include <GL/glut.h>
-#include <GL/gl.h> //might be unnecessary
-#include <GL/freeglut_ext.h> // might be unnecessary
-#include <GL/freeglut_std.h>  // might be unnecessary
-#include <GL/freeglut_ucall.h> // might be unnecessary
-
-
+#include <cmath>
 #include <iostream>
 
+#include "PatchDrawable.h"
+#include "TeapotMesh.h"
+
 //TeapotDrawable.h
-class TeapotDrawable : public osg::Drawable
+//the teapot glutSolidTeapot() draws, as a plain geometry: the patches are tessellated once
+//per size and detail by TeapotMesh, every TeapotDrawable shares those arrays and indices,
+//so the bound is exact and many teapots go through one vertex buffer.
+class TeapotDrawable : public osg::Geometry
 {
-public: TeapotDrawable( float size = 1.0f )
-		: _size(size) {}
+public: TeapotDrawable( float size = 1.0f, unsigned int detail = 7 )
+		: _size(size), _detail(detail) { setMesh(); }
 
 	TeapotDrawable( const TeapotDrawable &copy, const osg::CopyOp &copyop = osg::CopyOp::SHALLOW_COPY )
-		:osg::Drawable( copy, copyop ), _size( copy._size ) {}
+		:osg::Geometry( copy, copyop ), _size( copy._size ), _detail( copy._detail ) {}
 
 	META_Object( osg, TeapotDrawable );
 
-	virtual osg::BoundingSphere computeBound() const;
-	virtual void drawImplementation( osg::RenderInfo & ) const;
+	float getSize() const { return _size; }
+	unsigned int getDetail() const { return _detail; }
 
 protected:
+	void setMesh();
+
 	float _size;
+	unsigned int _detail;
 };
 
 //TeapotDrawable.cpp
-osg::BoundingSphere TeapotDrawable::computeBound() const
+void TeapotDrawable::setMesh()
 {
-	osg::Vec3 min(-_size, -_size, -_size ), max( _size, _size, _size );
-	return osg::BoundingBox( min, max );
+	osg::Geometry* mesh = TeapotMesh::instance() -> getMesh( _size, _detail );
+	setUseDisplayList( false );
+	setUseVertexBufferObjects( true );
+	setVertexArray( mesh -> getVertexArray() );
+	setNormalArray( mesh -> getNormalArray(), osg::Array::BIND_PER_VERTEX );
+	setTexCoordArray( 0, mesh -> getTexCoordArray( 0 ) );
+	addPrimitiveSet( mesh -> getPrimitiveSet( 0 ) );
 }
 
-void TeapotDrawable::drawImplementation( osg::RenderInfo &renderInfo ) const
-{	
-	glFrontFace( GL_CW );
-	glutSolidTeapot( _size );
-	glFrontFace( GL_CCW );
+osg::Drawable* createTeapot( BezierPatches* patches, unsigned int detail )
+{
+	if ( patches ) return new PatchDrawable( patches );
+	return new TeapotDrawable( 1.0f, detail );
 }
 
 int main ( int argc, char** argv )
 {	
-	argc = 1;
-	glutInit( &argc, argv);	
-	osg::ref_ptr <osg::Geode> root = new osg::Geode;
-	root -> addDrawable( new TeapotDrawable( 1.0f ) );
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int instances = 1, detail = 7;
+	arguments.read( "--instances", instances );
+	arguments.read( "--detail", detail );
+	//--adaptive: the tessellation follows the screen size instead of --detail
+	bool adaptive = arguments.read( "--adaptive" );
+	osg::ref_ptr<BezierPatches> patches = adaptive ? TeapotMesh::createPatches( 1.0f ) : 0;
+
+	osg::ref_ptr <osg::Group> root = new osg::Group;
+	if ( instances <= 1 )
+	{
+		osg::ref_ptr <osg::Geode> geode = new osg::Geode;
+		geode -> addDrawable( createTeapot( patches.get(), detail ) );
+		root -> addChild( geode.get() );
+	}
+	else
+	{
+		//a square grid of teapots, all drawing the same cached mesh
+		unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)instances ) );
+		for ( unsigned int i = 0; i < instances; ++i )
+		{
+			osg::ref_ptr <osg::Geode> geode = new osg::Geode;
+			geode -> addDrawable( createTeapot( patches.get(), detail ) );
+			osg::ref_ptr <osg::MatrixTransform> transform = new osg::MatrixTransform(
+				osg::Matrix::translate( ( i % side ) * 4.0, 0.0, ( i / side ) * 3.0 ) );
+			transform -> addChild( geode.get() );
+			root -> addChild( transform.get() );
+		}
+		if ( adaptive )
+			std::cout << instances << " teapots, sharing up to " << BezierPatches::numLevels << " levels" << std::endl;
+		else
+			std::cout << instances << " teapots, " << TeapotMesh::getNumVertices( detail ) << " shared vertices" << std::endl;
+	}
 
 	osgViewer::Viewer viewer;
 	viewer.setSceneData( root.get() );
@@ -0,0 +1,127 @@
+//benchmark: a fleet of one model as MatrixTransforms vs. one InstancedGroup
+//
+//the same grid of aircraft is built both ways for every fleet size, then rendered for a
+//number of frames single threaded while the camera slowly circles the fleet, so part of it
+//is always outside the frustum. the mean cull traversal time (from the camera's statistics)
+//and the mean frame time are printed per size and mode.
+//
+//	InstanceBenchmark
+//	InstanceBenchmark --sizes 1000,10000,100000 --frames 300 glider.osg
+//
+//options: --sizes N,N,... (default 1000,5000,10000,50000,100000)  --frames N (default 200)  [model, default cessna.osg]
+
+#include <osg/ArgumentParser>
+#include <osg/MatrixTransform>
+#include <osg/Stats>
+#include <osg/Timer>
+#include <osgDB/ReadFile>
+#include <osgViewer/Viewer>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "InstancedGroup.h"
+
+const float spacing = 25.0f;
+
+osg::Matrix placement( unsigned int i, unsigned int side )
+{
+	return osg::Matrix::rotate( ( i % 16 ) * osg::PI / 8.0, osg::Z_AXIS ) * osg::Matrix::translate( ( i % side ) * spacing, ( i / side ) * spacing, 0.0f );
+}
+
+osg::Node* buildTransforms( osg::Node* model, unsigned int count )
+{
+	unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)count ) );
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	for ( unsigned int i = 0; i < count; ++i )
+	{
+		osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform( placement( i, side ) );
+		transform -> addChild( model );
+		root -> addChild( transform.get() );
+	}
+	return root.release();
+}
+
+osg::Node* buildInstanced( osg::Node* model, unsigned int count )
+{
+	unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)count ) );
+	osg::ref_ptr<InstancedGroup> fleet = new InstancedGroup( model );
+	for ( unsigned int i = 0; i < count; ++i )
+		fleet -> addInstance( placement( i, side ) );
+	return fleet.release();
+}
+
+//mean frame time and cull time in ms over numFrames frames
+void run( osgViewer::Viewer& viewer, osg::Node* scene, unsigned int numFrames, double& frameTime, double& cullTime )
+{
+	viewer.setSceneData( scene );
+	const osg::BoundingSphere& bound = scene -> getBound();
+
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	for ( unsigned int f = 0; f <= numFrames && !viewer.done(); ++f )
+	{
+		//a low circle over the fleet, looking at its centre: the far side of the grid is left
+		//and right of the frustum
+		double angle = 2.0 * osg::PI * f / std::max( numFrames, 1u );
+		osg::Vec3 eye = bound.center() + osg::Vec3( cos( angle ), sin( angle ), 0.25f ) * bound.radius() * 0.6f;
+		viewer.getCamera() -> setViewMatrixAsLookAt( eye, bound.center(), osg::Z_AXIS );
+		viewer.frame();
+		//the first frame compiles the GL objects, it does not count
+		if ( f == 0 ) start = osg::Timer::instance() -> tick();
+	}
+	frameTime = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() ) / std::max( numFrames, 1u );
+
+	osg::Stats* stats = viewer.getCamera() -> getStats();
+	unsigned int last = viewer.getFrameStamp() -> getFrameNumber() - 1;
+	unsigned int first = std::max( stats -> getEarliestFrameNumber(), last + 1 - std::min( numFrames, last ) );
+	cullTime = 0.0;
+	if ( stats -> getAveragedAttribute( first, last, "Cull traversal time taken", cullTime ) )
+		cullTime *= 1000.0;
+}
+
+int main( int argc, char** argv )
+{
+	osg::ArgumentParser arguments( &argc, argv );
+	std::string sizeList = "1000,5000,10000,50000,100000";
+	unsigned int numFrames = 200;
+	arguments.read( "--sizes", sizeList );
+	arguments.read( "--frames", numFrames );
+
+	std::vector<unsigned int> sizes;
+	std::stringstream list( sizeList );
+	std::string item;
+	while ( std::getline( list, item, ',' ) )
+		if ( std::atoi( item.c_str() ) > 0 ) sizes.push_back( std::atoi( item.c_str() ) );
+
+	osg::ref_ptr<osg::Node> model = osgDB::readNodeFiles( arguments );
+	if ( !model ) model = osgDB::readNodeFile( "cessna.osg" );
+	if ( !model )
+	{
+		std::cout << "no model" << std::endl;
+		return 1;
+	}
+
+	osgViewer::Viewer viewer;
+	viewer.setThreadingModel( osgViewer::Viewer::SingleThreaded );
+	viewer.setUpViewInWindow( 50, 50, 1280, 720 );
+	viewer.realize();
+	viewer.getCamera() -> getStats() -> collectStats( "rendering", true );
+
+	std::cout << "instances   mode         cull ms   frame ms" << std::endl;
+	for ( unsigned int s = 0; s < sizes.size() && !viewer.done(); ++s )
+	{
+		for ( unsigned int mode = 0; mode < 2; ++mode )
+		{
+			osg::ref_ptr<osg::Node> scene = mode == 0 ? buildTransforms( model.get(), sizes[s] ) : buildInstanced( model.get(), sizes[s] );
+			double frameTime, cullTime;
+			run( viewer, scene.get(), numFrames, frameTime, cullTime );
+			std::cout << sizes[s] << "\t    " << ( mode == 0 ? "transforms" : "instanced " ) << "   "
+			          << cullTime << "\t  " << frameTime << std::endl;
+		}
+	}
+	return 0;
+}
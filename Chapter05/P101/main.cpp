@@ -1,24 +1,48 @@
+#include <osg/ArgumentParser>
 #include <osg/MatrixTransform>
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
 
+#include <cmath>
+
+#include "InstancedGroup.h"
+
 int main ( int argc, char **argv )
 {
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int instances = 0;
+	arguments.read( "--instances", instances );
+
 	osg::ref_ptr <osg::Node> model = osgDB::readNodeFile ( "cessna.osg" );
 
-	//load model twice to obtain two instances displayed separately at the same time:
-	osg::ref_ptr <osg::MatrixTransform> transform1 = new osg::MatrixTransform;
-	transform1 -> setMatrix ( osg::Matrix::translate ( -25.0f, 0.0f, 0.0f ) );
-	transform1 -> addChild ( model.get() );
+	osg::ref_ptr <osg::Group> root = new osg::Group;
+	if ( instances > 0 )
+	{
+		//--instances N: a fleet on a square grid, one InstancedGroup instead of N transforms
+		osg::ref_ptr <InstancedGroup> fleet = new InstancedGroup( model.get() );
+		unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)instances ) );
+		for ( unsigned int i = 0; i < instances; ++i )
+		{
+			osg::Vec4 color( 0.6f + 0.4f * ( i % 3 ) / 2.0f, 0.6f + 0.4f * ( i % 5 ) / 4.0f, 0.6f + 0.4f * ( i % 7 ) / 6.0f, 1.0f );
+			fleet -> addInstance( osg::Matrix::translate( ( i % side ) * 25.0f, ( i / side ) * 25.0f, 0.0f ), color );
+		}
+		root -> addChild( fleet.get() );
+	}
+	else
+	{
+		//load model twice to obtain two instances displayed separately at the same time:
+		osg::ref_ptr <osg::MatrixTransform> transform1 = new osg::MatrixTransform;
+		transform1 -> setMatrix ( osg::Matrix::translate ( -25.0f, 0.0f, 0.0f ) );
+		transform1 -> addChild ( model.get() );
 
-	osg::ref_ptr <osg::MatrixTransform> transform2 = new osg::MatrixTransform;
-	transform2 -> setMatrix (osg::Matrix::translate ( 25.0f, 0.0f, 0.0f ) );
-	transform2 -> addChild ( model.get() );
+		osg::ref_ptr <osg::MatrixTransform> transform2 = new osg::MatrixTransform;
+		transform2 -> setMatrix (osg::Matrix::translate ( 25.0f, 0.0f, 0.0f ) );
+		transform2 -> addChild ( model.get() );
 
-	//add both transformation nodes to the root node, start viewer
-	osg::ref_ptr <osg::Group> root = new osg::Group;
-	root -> addChild( transform1.get() );
-	root -> addChild( transform2.get() );
+		//add both transformation nodes to the root node, start viewer
+		root -> addChild( transform1.get() );
+		root -> addChild( transform2.get() );
+	}
 
 	osgViewer::Viewer viewer;
 	viewer.setSceneData ( root.get() );
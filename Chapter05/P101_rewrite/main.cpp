@@ -1,12 +1,45 @@
-#include <osg/PositionAttitudeTransform> //change
 #include <osg/Quat> // for some reason not really needed ??
 
+#include <osg/ArgumentParser>
 #include <osg/MatrixTransform>
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
 
+#include <cmath>
+#include <vector>
+
+#include "TransformHierarchy.h"
+
+//moves the formation along a circle and lets every aircraft in it roll a little; only the
+//local transforms are written here, the hierarchy turns them into world matrices afterwards
+class FleetCallback : public osg::NodeCallback
+{
+public:
+	FleetCallback( HierarchyTransform* formation, const std::vector< osg::ref_ptr<HierarchyTransform> >& aircraft )
+		: _formation( formation ), _aircraft( aircraft ) {}
+
+	virtual void operator()( osg::Node* node, osg::NodeVisitor* nv )
+	{
+		double t = nv -> getFrameStamp() ? nv -> getFrameStamp() -> getSimulationTime() : 0.0;
+		_formation -> setPosition( osg::Vec3d( cos( t * 0.2 ) * 200.0, sin( t * 0.2 ) * 200.0, 50.0 ) );
+		_formation -> setAttitude( osg::Quat( t * 0.2 + osg::PI_2, osg::Z_AXIS ) );
+		for ( unsigned int i = 0; i < _aircraft.size(); ++i )
+			_aircraft[i] -> setAttitude( osg::Quat( sin( t + i * 0.1 ) * 0.3, osg::Y_AXIS ) );
+		traverse( node, nv );
+	}
+
+protected:
+	osg::ref_ptr<HierarchyTransform> _formation;
+	std::vector< osg::ref_ptr<HierarchyTransform> > _aircraft;
+};
+
 int main ( int argc, char **argv )
 {
+	//--fleet N adds a formation of N aircraft that follow one moving parent
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int fleetSize = 0;
+	arguments.read( "--fleet", fleetSize );
+
 	osg::ref_ptr <osg::Node> model = osgDB::readNodeFile ( "cessna.osg" );
 
 	//load model twice to obtain two instances displayed separately at the same time:
@@ -14,14 +47,15 @@ int main ( int argc, char **argv )
 	//transform1 -> setMatrix ( osg::Matrix::translate ( -25.0f, 0.0f, 0.0f ) );
 	//transform1 -> addChild ( model.get() );
 	
-	//new
-	osg::ref_ptr <osg::PositionAttitudeTransform> pat1 = new osg::PositionAttitudeTransform;
+	//new: the transforms live in one hierarchy, which computes all world matrices once per frame
+	osg::ref_ptr <TransformHierarchy> hierarchy = new TransformHierarchy;
+	osg::ref_ptr <HierarchyTransform> pat1 = new HierarchyTransform ( hierarchy.get() );
 	osg::Vec3d pos1 = osg::Vec3d( -25.0, 0.0, 0.0 );
 	osg::Quat quat1 ( 0.0f, osg::X_AXIS,
   			  3.1415f, osg::Y_AXIS,
 			  0.0f, osg::Z_AXIS );
-	pat1 -> osg::PositionAttitudeTransform::setPosition ( pos1 );
-	pat1 -> osg::PositionAttitudeTransform::setAttitude ( quat1 );
+	pat1 -> setPosition ( pos1 );
+	pat1 -> setAttitude ( quat1 );
 	pat1 -> addChild ( model.get() );
 
 	osg::ref_ptr <osg::MatrixTransform> transform2 = new osg::MatrixTransform;
@@ -33,6 +67,27 @@ int main ( int argc, char **argv )
 	root -> addChild( pat1.get() );
 	root -> addChild( transform2.get() );
 
+	//the aircraft are children of the formation in the hierarchy, in the scene graph they
+	//sit next to it below root
+	if ( fleetSize > 0 )
+	{
+		osg::ref_ptr <HierarchyTransform> formation = new HierarchyTransform ( hierarchy.get() );
+		root -> addChild( formation.get() );
+		unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)fleetSize ) );
+		std::vector< osg::ref_ptr<HierarchyTransform> > aircraft;
+		for ( unsigned int i = 0; i < fleetSize; ++i )
+		{
+			osg::ref_ptr <HierarchyTransform> plane = new HierarchyTransform ( hierarchy.get(), formation.get() );
+			plane -> setPosition( osg::Vec3d( ( i % side ) * 20.0, ( i / side ) * 20.0, 0.0 ) );
+			plane -> addChild( model.get() );
+			root -> addChild( plane.get() );
+			aircraft.push_back( plane );
+		}
+		root -> addUpdateCallback( new FleetCallback( formation.get(), aircraft ) );
+	}
+	//after the callbacks that move things, before anything reads a bound
+	root -> addUpdateCallback( new TransformHierarchy::UpdateCallback( hierarchy.get() ) );
+
 	osgViewer::Viewer viewer;
 	viewer.setSceneData ( root.get() );
 	return viewer.run();
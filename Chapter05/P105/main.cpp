@@ -1,9 +1,45 @@
+#include <osg/ArgumentParser>
+#include <osg/MatrixTransform>
 #include <osg/Switch>
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
 
+#include <cmath>
+#include <cstdlib>
+
+#include "BitsetSwitch.h"
+
+//damages a few random aircraft of the grid each frame: child 2i is aircraft i intact, 2i + 1 on fire
+class DamageCallback : public osg::NodeCallback
+{
+public:
+	DamageCallback( unsigned int perFrame ) : _perFrame( perFrame ) {}
+
+	virtual void operator()( osg::Node* node, osg::NodeVisitor* nv )
+	{
+		BitsetSwitch* grid = static_cast <BitsetSwitch*>( node );
+		unsigned int numAircraft = grid -> getNumChildren() / 2;
+		for ( unsigned int n = 0; n < _perFrame && numAircraft > 0; ++n )
+		{
+			unsigned int i = rand() % numAircraft;
+			grid -> setValue( 2 * i, false );
+			grid -> setValue( 2 * i + 1, true );
+		}
+		traverse( node, nv );
+	}
+
+protected:
+	unsigned int _perFrame;
+};
+
 int main ( int argc, char** argv )
 {
+	//--aircraft N shows a grid of N aircraft below one BitsetSwitch instead, one child per
+	//damage state, and sets a few of them on fire every frame
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int numAircraft = 0;
+	arguments.read( "--aircraft", numAircraft );
+
 	osg::ref_ptr <osg::Node> model1 = osgDB::readNodeFile ( "cessna.osg" );
 	osg::ref_ptr <osg::Node> model2 = osgDB::readNodeFile ( "cessnafire.osg" );
 
@@ -21,5 +57,25 @@ int main ( int argc, char** argv )
 
 	osgViewer::Viewer viewer;
 	viewer.setSceneData( root.get() );
+
+	if ( numAircraft > 0 )
+	{
+		osg::ref_ptr <BitsetSwitch> grid = new BitsetSwitch;
+		unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)numAircraft ) );
+		for ( unsigned int i = 0; i < numAircraft; ++i )
+		{
+			osg::Matrix placement = osg::Matrix::translate( ( i % side ) * 25.0f, ( i / side ) * 25.0f, 0.0f );
+			osg::ref_ptr <osg::MatrixTransform> intact = new osg::MatrixTransform( placement );
+			intact -> addChild( model1.get() );
+			osg::ref_ptr <osg::MatrixTransform> damaged = new osg::MatrixTransform( placement );
+			damaged -> addChild( model2.get() );
+			grid -> addChild( intact.get() );
+			grid -> addChild( damaged.get() );
+		}
+		//all intact at first: every even bit
+		grid -> setMask( BitsetSwitch::Mask( ( 2 * numAircraft + 63 ) / 64, 0x5555555555555555ull ) );
+		grid -> setUpdateCallback( new DamageCallback( 10 ) );
+		viewer.setSceneData( grid.get() );
+	}
 	return viewer.run();
 }
@@ -1,8 +1,17 @@
+#include <osg/ArgumentParser>
 #include <osg/LOD>
+#include <osg/MatrixTransform>
 #include <osgDB/ReadFile>
 #include <osgUtil/Simplifier>
 #include <osgViewer/Viewer>
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "ErrorLOD.h"
+#include "LodBuilder.h"
+
 //create "discrete LOD node" with set of predefined objectr to represent the same model.
 //these objects are used as child nodes of the osg::LOD node and sidplayed at different distances.
 //We will use the internal polygon reduction technique class osgUtil::Simplifier
@@ -10,37 +19,72 @@
 
 int main ( int argc, char** argv )
 {
-	//we build three levels of model details.
-	//we create three copies of the original model. 
-	//we read the cessna from the file three times which is ok,
-	//but we call clone() to duplicate the loaded model for immediate uses:
-	osg::ref_ptr <osg::Node> modelL3 = osgDB::readNodeFile( "cessna.osg" );
-	osg::ref_ptr <osg::Node> modelL2 = dynamic_cast <osg::Node*> ( modelL3 -> clone( osg::CopyOp::DEEP_COPY_ALL ) );
-	osg::ref_ptr <osg::Node> modelL1 = dynamic_cast <osg::Node*> ( modelL3 -> clone( osg::CopyOp::DEEP_COPY_ALL ) );
-
+	//we build the levels of model details.
+	//instead of cloning the cessna and running osgUtil::Simplifier with fixed sample ratios on
+	//every launch, the levels are built once by LodBuilder (all geometries simplified in
+	//parallel) and stored next to the model; later launches just read them back.
+	//
 	//lvl 3 will be original cessna with max num of polygons
-	//lvl 2 has fewer polygons 
-	//lvl 1 is least detailed only displayed at very far distance
-	//osgUtil::Simplifier class is used here to reduce the certices and faces.
-	//setSampleRatio() to lvl 1 and lvl 2 model with different values which results in different simplifying rates:
-	osgUtil::Simplifier simplifier;
-	simplifier.setSampleRatio( 0.5 );
-	modelL2 -> accept( simplifier );
-	
-	simplifier.setSampleRatio( 0.1 );
-	modelL1 -> accept( simplifier );
-
-	//add level models to the LOD node and set their visible range in descending order
-	//don't make overlapping ranges when you are configuring min and max range values
-	//with addChild() or setRange(), otherwise mor than one lvl of model will be shown at same pos
-	//results in incorrect behaviours
-	osg::ref_ptr <osg::LOD> root = new osg::LOD;
-	root -> addChild( modelL1.get(), 200.0f, FLT_MAX );
-	root -> addChild( modelL2.get(), 50.0f, 200.0f );
-	root -> addChild( modelL3.get(), 0.0f, 50.f);
-
-	//app might need more time to compute and reduce model faces
+	//lvl 2 and lvl 1 have fewer polygons, each allowed a given geometric error
+	//(fraction of the model's size) rather than a sample ratio.
+	//a level is displayed once its error covers less than --pixel-error pixels on screen:
+	osg::ArgumentParser arguments( &argc, argv );
+	LodBuilder::Options options;
+	arguments.read( "--pixel-error", options.pixelError );
+	float hysteresis = 0.1f;
+	double fadeTime = 0.3;
+	unsigned int fieldSize = 0;
+	arguments.read( "--hysteresis", hysteresis );
+	arguments.read( "--fade", fadeTime );
+	arguments.read( "--field", fieldSize );
+	//the levels share the cessna's vertex arrays and state, each owns only its index list;
+	//--no-sharing gives every level its own arrays, to compare the memory
+	if ( arguments.read( "--no-sharing" ) ) options.shareVertices = false;
+	options.errors.clear();
+	options.errors.push_back( 0.005 );
+	options.errors.push_back( 0.03 );
+
+	//the ranges come out in descending order of detail and never overlap, as
+	//addChild() / setRange() need them: otherwise more than one lvl would be shown at same pos
+	osg::ref_ptr <osg::LOD> levels = readLODFileCached( "cessna.osg", options );
+	if ( !levels ) return 1;
+
+	unsigned long long original = LodBuilder::countBytes( levels -> getChild( 0 ) ), total = LodBuilder::countBytes( levels.get() );
+	std::cout << levels -> getNumChildren() << " levels: " << total / 1024.0 << " KB, the model alone "
+	          << original / 1024.0 << " KB (" << (double)total / std::max( original, 1ull ) << "x)" << std::endl;
+
+	//those ranges only fit one field of view and window size, so the levels are switched by
+	//ErrorLOD instead: by the pixels their error covers with the actual camera, a band of
+	//--hysteresis around the threshold against flickering, and a --fade seconds dissolve
+	osg::ref_ptr <ErrorLOD> root = new ErrorLOD( *levels );
+	root -> setPixelError( options.pixelError );
+	root -> setHysteresis( hysteresis );
+	root -> setFadeTime( fadeTime );
+
+	//--field N: N cessnas on a grid, all selected in one pass by an ErrorLODGroup
+	osg::ref_ptr <osg::Group> scene = root.get();
+	if ( fieldSize > 0 )
+	{
+		osg::ref_ptr <ErrorLODGroup> field = new ErrorLODGroup;
+		unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)fieldSize ) );
+		for ( unsigned int i = 0; i < fieldSize; ++i )
+		{
+			//the levels stay shared, each copy puts them somewhere else
+			osg::ref_ptr <ErrorLOD> copy = new ErrorLOD( *root );
+			osg::Matrix placement = osg::Matrix::translate( ( i % side ) * 40.0f, ( i / side ) * 40.0f, 0.0f );
+			for ( unsigned int l = 0; l < root -> getNumChildren(); ++l )
+			{
+				osg::ref_ptr <osg::MatrixTransform> transform = new osg::MatrixTransform( placement );
+				transform -> addChild( root -> getChild( l ) );
+				copy -> setChild( l, transform.get() );
+			}
+			field -> addChild( copy.get() );
+		}
+		scene = field.get();
+	}
+
+	//only the first launch needs time to compute and reduce model faces
 	osgViewer::Viewer viewer;
-	viewer.setSceneData( root.get() );
+	viewer.setSceneData( scene.get() );
 	return viewer.run();
 }
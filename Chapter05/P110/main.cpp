@@ -2,9 +2,16 @@
 //proxy will record the filename of original model,
 //and defer loading it until the viewer is running and sending corresponding requests.
 
+#include <osg/ArgumentParser>
+#include <osg/MatrixTransform>
 #include <osg/ProxyNode>
 #include <osgViewer/Viewer>
 
+#include <cmath>
+#include <iostream>
+
+#include "ProxyLoader.h"
+
 int main ( int argc, char** argv )
 {
 	//instead of just loading model files as child nodes,
@@ -12,11 +19,48 @@ int main ( int argc, char** argv )
 	//This is similar to the insertChild() method,
 	//which puts a node into the specified position of the children list,
 	//but the list will not be filled until the dynamic loading process has finished.
-	
-	osg::ref_ptr <osg::ProxyNode> root = new osg::ProxyNode;
-	root -> setFileName( 0, "cow.osg" );
+	//
+	//a plain osg::ProxyNode loads in whatever order the requests arrive. here the files are
+	//loaded by a ProxyLoader: --load-threads workers, the largest proxies on screen first,
+	//requests dropped once their proxy is out of sight, and at most --budget MB kept loaded.
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int numThreads = 0, siteSize = 0;
+	double budget = 256.0;
+	arguments.read( "--load-threads", numThreads );
+	arguments.read( "--budget", budget );
+	arguments.read( "--site", siteSize );
+	ProxyLoader::Priority priority = arguments.read( "--by-distance" ) ? ProxyLoader::BY_DISTANCE : ProxyLoader::BY_SCREEN_SIZE;
+
+	osg::ref_ptr <ProxyLoader> loader = new ProxyLoader( numThreads, (unsigned long long)( budget * 1024.0 * 1024.0 ), priority );
+
+	osg::ref_ptr <osg::Group> root = new osg::Group;
+	root -> addUpdateCallback( new ProxyLoader::UpdateCallback( loader.get() ) );
+
+	//--site N: N cows on a grid, each its own proxy. an unloaded proxy has no bound to cull
+	//by, so every one is given where it stands and how large it is
+	unsigned int count = siteSize > 0 ? siteSize : 1;
+	unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)count ) );
+	for ( unsigned int i = 0; i < count; ++i )
+	{
+		osg::ref_ptr <ManagedProxyNode> proxy = new ManagedProxyNode( loader.get() );
+		proxy -> setFileName( 0, "cow.osg" );
+		if ( siteSize > 0 )
+		{
+			osg::ref_ptr <osg::MatrixTransform> transform = new osg::MatrixTransform(
+				osg::Matrix::translate( ( i % side ) * 20.0f, ( i / side ) * 20.0f, 0.0f ) );
+			transform -> addChild( proxy.get() );
+			root -> addChild( transform.get() );
+		}
+		else
+			root -> addChild( proxy.get() );
+		proxy -> setCenter( osg::Vec3() );
+		proxy -> setRadius( 8.0f );
+	}
 
 	osgViewer::Viewer viewer;
 	viewer.setSceneData( root.get() );
-	return viewer.run();
+	int result = viewer.run();
+
+	loader -> getStatistics().report( std::cout );
+	return result;
 }
@@ -5,65 +5,103 @@
 //which displays it's children at one time
 //and reverse the switch state to a user-defined internal counter
 
+#include <osg/ArgumentParser>
+#include <osg/MatrixTransform>
 #include <osg/Switch>
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
-#include <osgUtil/CullVisitor>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "AnimationTimeline.h"
+#include "BitsetSwitch.h"
 
 // class AnimatingSwitch
-//derived from osg::Switch to use setValue() method
+//derived from BitsetSwitch (same setValue() / getValue() as osg::Switch, values kept in a bitset)
+//to use setValue() method
 //macro META_Node used to define basic properties (library and class name) of node
+//
+//it used to count its own cull traversals and swap its children every so many: faster with a
+//faster frame rate, and once per camera. now the swaps are events on an AnimationTimeline,
+//which runs them by simulation time for every switch at once; the node has no traverse().
 
-class AnimatingSwitch :public osg::Switch
+class AnimatingSwitch :public BitsetSwitch
 {
 public:
 	AnimatingSwitch()
-		: osg::Switch(), _count( 0 ) 
+		: BitsetSwitch()
 	{}
 
 	AnimatingSwitch( const AnimatingSwitch& copy,
 			 const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY
 		       )
-		: osg::Switch( copy, copyop ), _count( copy._count)
+		: BitsetSwitch( copy, copyop )
 	{}
 
 	META_Node( osg, AnimatingSwitch );
 
-	virtual void traverse( osg::NodeVisitor& nv );
-
-protected:
-	unsigned int _count;
+	void animate( AnimationTimeline* timeline, double interval, double phase = 0.0 );
 };
 
-// traverse() 
-// increase the internal counter and see if it reaches a multiple of 60
-// and reverse the states of the first and second child nodes
+// animate()
+// every interval seconds (from phase on) reverse the states of the first and second child nodes
 
-void AnimatingSwitch::traverse( osg::NodeVisitor& nv )
-{	
-	osgUtil::CullVisitor* cv = dynamic_cast <osgUtil::CullVisitor*> ( &nv );
-	if( cv )
-	{
-
-		if( !( ( ++_count ) ) % 14400 )
-		{
-			setValue( 0, !getValue(0) );
-			setValue( 1, !getValue(1) );
-		}
-	}
-	osg::Switch::traverse( nv );
+void AnimatingSwitch::animate( AnimationTimeline* timeline, double interval, double phase )
+{
+	unsigned int target = timeline -> addTarget( this );
+	timeline -> schedule( phase + interval, target, AnimationTimeline::TOGGLE_CHILD, 0, interval );
+	timeline -> schedule( phase + interval, target, AnimationTimeline::TOGGLE_CHILD, 1, interval );
 }
 
 int main ( int argc, char** argv )
 {
+	//--switches N: N cessnas on a grid, each swapping at its own phase, some blinking too
+	osg::ArgumentParser arguments( &argc, argv );
+	unsigned int numSwitches = 0;
+	double interval = 1.0;
+	arguments.read( "--switches", numSwitches );
+	arguments.read( "--interval", interval );
+
 	osg::ref_ptr <osg::Node> model1 = osgDB::readNodeFile("cessna.osg");
 	osg::ref_ptr <osg::Node> model2 = osgDB::readNodeFile("cessnafire.osg");
-	
+
+	osg::ref_ptr <AnimationTimeline> timeline = new AnimationTimeline;
+
 	osg::ref_ptr <AnimatingSwitch> root = new AnimatingSwitch;
 	root -> addChild( model1.get(), true );
 	root -> addChild( model2.get(), false );
 
+	osg::ref_ptr <osg::Group> scene = root.get();
+	if ( numSwitches == 0 )
+		root -> animate( timeline.get(), interval );
+	else
+	{
+		scene = new osg::Group;
+		unsigned int side = (unsigned int)std::ceil( std::sqrt( (double)numSwitches ) );
+		for ( unsigned int i = 0; i < numSwitches; ++i )
+		{
+			osg::ref_ptr <AnimatingSwitch> animated = new AnimatingSwitch;
+			animated -> addChild( model1.get(), true );
+			animated -> addChild( model2.get(), false );
+			animated -> animate( timeline.get(), interval, interval * rand() / RAND_MAX );
+
+			osg::ref_ptr <osg::MatrixTransform> transform = new osg::MatrixTransform(
+				osg::Matrix::translate( ( i % side ) * 40.0f, ( i / side ) * 40.0f, 0.0f ) );
+			transform -> addChild( animated.get() );
+			scene -> addChild( transform.get() );
+
+			//every tenth one blinks, four times as fast
+			if ( i % 10 == 0 )
+				timeline -> schedule( interval * 0.25, timeline -> addTarget( transform.get() ),
+				                      AnimationTimeline::TOGGLE_VISIBLE, 0, interval * 0.25 );
+		}
+	}
+
+	//one update callback advances every animation, once per frame
+	scene -> addUpdateCallback( new AnimationTimeline::UpdateCallback( timeline.get() ) );
+
 	osgViewer::Viewer viewer;
-	viewer.setSceneData( root.get() );
+	viewer.setSceneData( scene.get() );
 	return viewer.run();
-}	
+}
@@ -1,7 +1,11 @@
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
+#include <fstream>
 #include <iostream>
 
+#include "ParallelNodeLoader.h"
+#include "SceneStatistics.h"
+
 //InfoVisitor class
 //define necessary virtual methods
 //we only handle leaf nodes and common osg::Node objects.
@@ -70,7 +74,14 @@ void InfoVisitor::apply( osg::Geode& geode ) //InfoVisitor:: might be missing in
 int main ( int argc, char** argv )
 {
 	osg::ArgumentParser arguments( &argc, argv );
-	osg::ref_ptr <osg::Node> root = osgDB::readNodeFiles( arguments );
+	//--stats file.json: instead of the class names, write node / drawable / vertex counts,
+	//primitives, bytes and sharing of the scene and of each subtree, see SceneStatistics.h
+	//("-" writes to the console)
+	std::string statsFile;
+	arguments.read( "--stats", statsFile );
+	//load the files given on the command line concurrently, see ParallelNodeLoader.h
+	//osg::ref_ptr <osg::Node> root = osgDB::readNodeFiles( arguments );
+	osg::ref_ptr <osg::Node> root = readNodeFilesParallel( arguments );
 
 	if( !root )
 	{
@@ -78,6 +89,26 @@ int main ( int argc, char** argv )
 		return -1;
 	}
 
+	if ( !statsFile.empty() )
+	{
+		//the subtrees are counted in parallel
+		std::vector<SceneStatistics> subtrees;
+		SceneStatistics total = collectSceneStatistics( root.get(), subtrees );
+		if ( statsFile == "-" )
+			total.writeJSON( std::cout, subtrees );
+		else
+		{
+			std::ofstream out( statsFile.c_str() );
+			total.writeJSON( out, subtrees );
+			if ( !out )
+			{
+				OSG_FATAL << arguments.getApplicationName() << ": could not write " << statsFile << std::endl;
+				return -1;
+			}
+		}
+		return 0;
+	}
+
 	//use InfoVisitor to visit the loaded model now
 	//notice that setTraversalMode*( is called in the constructor of the visitor
 	//in order to enable the traversal of all its children
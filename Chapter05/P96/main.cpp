@@ -2,11 +2,14 @@
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
 
+#include "SceneCache.h"
+
 int main ( int argc, char** argv )
 {
 	//load two models and assign them to Node pointers
-	osg::ref_ptr <osg::Node> model1 = osgDB::readNodeFile ( "cessna.osg" );
-	osg::ref_ptr <osg::Node> model2 = osgDB::readNodeFile ( "cow.osg" );
+	//the first launch parses the .osg text, later ones read the binary copy from the scene cache
+	osg::ref_ptr <osg::Node> model1 = readNodeFileCached ( "cessna.osg" );
+	osg::ref_ptr <osg::Node> model2 = readNodeFileCached ( "cow.osg" );
 
 	//add two models to Group node by using addChild()
 	osg::ref_ptr <osg::Group> root = new osg::Group;
@@ -12,6 +12,8 @@
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
 
+#include "BitsetSwitch.h"
+
 // declare the SwitchingCallback class.
 // it is an osg::NodeCallback based class, which can soon be used as update, event,
 // or cull callbacks of scene nodes.
@@ -33,14 +35,14 @@ protected:
 // 	-> node associated w/ the callback
 // 	-> node visitor calling the function during traversals.
 // to animate the state switching of the two child nodes,
-// we have to convert the node pointer to the type osg::Switch.
+// we have to convert the node pointer to the type BitsetSwitch (the osg::Switch interface, values in a bitset).
 // A static_cast<> is used here because we are sure that the associated node is a switch node.
 // 
 // NOTE:	traverse(0 method should be executed in a certain location,
 // 		to ensure that the update traversal visitor can continure traversing the scene graph.
 void SwitchingCallback::operator()( osg::Node* node, osg::NodeVisitor* nv )
 {
-	osg::Switch* switchNode = static_cast <osg::Switch*>( node );
+	BitsetSwitch* switchNode = static_cast <BitsetSwitch*>( node );
 	if ( ! ( (++_count) %60 ) && switchNode )
 	{
 		switchNode -> setValue( 0, !switchNode -> getValue(0) );
@@ -59,7 +61,7 @@ int main( int argc, char** argv )
 {
 osg::ref_ptr <osg::Node> model1 = osgDB::readNodeFile( "cessna.osg" );
 osg::ref_ptr <osg::Node> model2 = osgDB::readNodeFile( "cessnafire.osg" );
-osg::ref_ptr <osg::Switch> root = new osg::Switch;
+osg::ref_ptr <BitsetSwitch> root = new BitsetSwitch;
 root -> addChild( model1.get(), false );
 root -> addChild( model2.get(), true );
 
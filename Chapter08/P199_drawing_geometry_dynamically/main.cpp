@@ -15,6 +15,8 @@ the X axis, which results in a simple animation effect.
 #include <osg/NodeVisitor>
 #include <osgViewer/Viewer>
 
+#include "GeometryBuilder.h"
+
 /*
  *
  * The creation of a quad is familiar to us. Specify the vertex, normal, and color array,
@@ -25,28 +27,14 @@ the type of GL_QUADS . Finally, return the newly-allocated geometry object:
 
 osg::Geometry* createQuad()
 {
-	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
-	vertices->push_back( osg::Vec3(0.0f, 0.0f, 0.0f) );
-	vertices->push_back( osg::Vec3(1.0f, 0.0f, 0.0f) );
-	vertices->push_back( osg::Vec3(1.0f, 0.0f, 1.0f) );
-	vertices->push_back( osg::Vec3(0.0f, 0.0f, 1.0f) );
-
-	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
-	normals->push_back( osg::Vec3(0.0f,-1.0f, 0.0f) );
-
-	osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array;
-	colors->push_back( osg::Vec4(1.0f, 0.0f, 0.0f, 1.0f) );
-	colors->push_back( osg::Vec4(0.0f, 1.0f, 0.0f, 1.0f) );
-	colors->push_back( osg::Vec4(0.0f, 0.0f, 1.0f, 1.0f) );
-	colors->push_back( osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f) );
-
-	osg::ref_ptr<osg::Geometry> quad = new osg::Geometry;
-	quad->setVertexArray( vertices.get() );
-	quad->setNormalArray( normals.get() );
-	quad->setNormalBinding( osg::Geometry::BIND_OVERALL );
-	quad->setColorArray( colors.get() );
-	quad->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
-	quad->addPrimitiveSet( new osg::DrawArrays(GL_QUADS, 0, 4) );
+	GeometryBuilder builder( 4, GeometryBuilder::COLORS );
+	builder.addVertex( osg::Vec3(0.0f, 0.0f, 0.0f) ).color( osg::Vec4(1.0f, 0.0f, 0.0f, 1.0f) );
+	builder.addVertex( osg::Vec3(1.0f, 0.0f, 0.0f) ).color( osg::Vec4(0.0f, 1.0f, 0.0f, 1.0f) );
+	builder.addVertex( osg::Vec3(1.0f, 0.0f, 1.0f) ).color( osg::Vec4(0.0f, 0.0f, 1.0f, 1.0f) );
+	builder.addVertex( osg::Vec3(0.0f, 0.0f, 1.0f) ).color( osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f) );
+	builder.setOverallNormal( osg::Vec3(0.0f,-1.0f, 0.0f) );
+
+	osg::ref_ptr<osg::Geometry> quad = builder.build( GL_QUADS );
 
 	return quad.release();
 }
@@ -92,6 +80,8 @@ void DynamicQuadCallback::update( osg::NodeVisitor*, osg::Drawable* drawable )
 	osg::Quat quat( osg::PI * 0.01, osg::X_AXIS);
 	vertices -> back() = quat * vertices -> back();
 
+	//the quad is drawn from a vertex buffer object, the changed array has to be uploaded again
+	vertices -> dirty();
 	quad -> dirtyDisplayList();
 	quad -> dirtyBound();
 }
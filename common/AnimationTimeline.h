@@ -0,0 +1,197 @@
+#ifndef ANIMATION_TIMELINE_H
+#define ANIMATION_TIMELINE_H
+
+#include <osg/FrameStamp>
+#include <osg/Node>
+#include <osg/NodeCallback>
+#include <osg/NodeVisitor>
+#include <osg/observer_ptr>
+
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "BitsetSwitch.h"
+
+//AnimationTimeline
+//one schedule of discrete state changes (switch children toggled, nodes blinking) for any
+//number of nodes, keyed on simulation time. events wait in a min-heap by due time; a frame
+//pops only the events that are due, so it costs O(due log n) and nothing at all for the
+//nodes whose next change is still ahead, and the animated nodes need no traversal of their own.
+//
+//the timeline is advanced once per frame from the update traversal (UpdateCallback), by
+//simulation time: the same speed at any frame rate, and one step per frame however many
+//cameras cull the scene. a repeating event that fell behind (a long frame, a pause) is
+//caught up in one go rather than once per missed period.
+//
+//targets are only observed, not owned: the callback often sits on a node it animates. the
+//events of a target that has been deleted are dropped when they come due.
+//
+//	osg::ref_ptr<AnimationTimeline> timeline = new AnimationTimeline;
+//	unsigned int light = timeline -> addTarget( trafficLight.get() );
+//	timeline -> schedule( 0.5, light, AnimationTimeline::TOGGLE_CHILD, 0, 1.0 );
+//	timeline -> schedule( 0.5, light, AnimationTimeline::TOGGLE_CHILD, 1, 1.0 );
+//	root -> addUpdateCallback( new AnimationTimeline::UpdateCallback( timeline.get() ) );
+
+class AnimationTimeline : public osg::Referenced
+{
+public:
+	enum Action
+	{
+		TOGGLE_CHILD,		//BitsetSwitch targets: child on/off
+		CHILD_ON,
+		CHILD_OFF,
+		TOGGLE_VISIBLE,		//any target: node mask off / back to what it was
+		SHOW,
+		HIDE
+	};
+
+	AnimationTimeline() : _time( 0.0 ), _started( false ), _serial( 0 ) {}
+
+	//a node events can refer to, by the returned index. switch actions need a BitsetSwitch,
+	//visibility actions restore the node mask the node had when added
+	unsigned int addTarget( osg::Node* node )
+	{
+		Target target;
+		target.node = node;
+		target.isSwitch = dynamic_cast<BitsetSwitch*>( node ) != 0;
+		target.nodeMask = node -> getNodeMask();
+		_targets.push_back( target );
+		return _targets.size() - 1;
+	}
+
+	unsigned int getNumTargets() const { return _targets.size(); }
+	//0 once the node is gone
+	osg::Node* getTarget( unsigned int target ) { return _targets[target].node.get(); }
+
+	//action on target (child, for switch actions) at time, then every period seconds if period > 0
+	void schedule( double time, unsigned int target, Action action, unsigned int child = 0, double period = 0.0 )
+	{
+		if ( target >= _targets.size() ) return;
+		Event event;
+		event.time = time;
+		event.period = period;
+		event.serial = ++_serial;
+		event.target = target;
+		event.child = child;
+		event.action = action;
+		_events.push( event );
+	}
+
+	unsigned int getNumEvents() const { return _events.size(); }
+	double getTime() const { return _time; }
+
+	void clear()
+	{
+		_events = EventQueue();
+		_targets.clear();
+	}
+
+	//apply every event due by time; calls with a time not after the last one do nothing
+	void advance( double time )
+	{
+		if ( _started && time <= _time ) return;
+		_started = true;
+		_time = time;
+
+		while ( !_events.empty() && _events.top().time <= time )
+		{
+			Event event = _events.top();
+			_events.pop();
+
+			//all the periods that fell due since, at once: a toggle only needs their parity
+			unsigned long long count = 1;
+			if ( event.period > 0.0 )
+				count += (unsigned long long)std::floor( ( time - event.time ) / event.period );
+			if ( !apply( event, count ) ) continue;
+
+			if ( event.period > 0.0 )
+			{
+				event.time += count * event.period;
+				event.serial = ++_serial;
+				_events.push( event );
+			}
+		}
+	}
+
+	class UpdateCallback : public osg::NodeCallback
+	{
+	public:
+		UpdateCallback( AnimationTimeline* timeline ) : _timeline( timeline ) {}
+
+		virtual void operator()( osg::Node* node, osg::NodeVisitor* nv )
+		{
+			if ( nv -> getFrameStamp() ) _timeline -> advance( nv -> getFrameStamp() -> getSimulationTime() );
+			traverse( node, nv );
+		}
+
+	protected:
+		osg::ref_ptr<AnimationTimeline> _timeline;
+	};
+
+protected:
+	virtual ~AnimationTimeline() {}
+
+	struct Target
+	{
+		osg::observer_ptr<osg::Node> node;
+		bool isSwitch;				//node is a BitsetSwitch
+		unsigned int nodeMask;		//restored by SHOW
+	};
+
+	struct Event
+	{
+		double time;
+		double period;
+		unsigned int serial;	//events due together run in the order they were scheduled
+		unsigned int target;
+		unsigned int child;
+		Action action;
+
+		//std::priority_queue keeps the greatest on top: the latest is the "least"
+		bool operator>( const Event& other ) const
+		{
+			return time != other.time ? time > other.time : serial > other.serial;
+		}
+	};
+
+	typedef std::priority_queue< Event, std::vector<Event>, std::greater<Event> > EventQueue;
+
+	//count is how many times the event fell due; false if the target is gone
+	bool apply( const Event& event, unsigned long long count )
+	{
+		Target& target = _targets[event.target];
+		osg::ref_ptr<osg::Node> node;
+		if ( !target.node.lock( node ) ) return false;
+		BitsetSwitch* bitset = target.isSwitch ? static_cast<BitsetSwitch*>( node.get() ) : 0;
+		switch ( event.action )
+		{
+		case TOGGLE_CHILD:
+			if ( bitset && count % 2 ) bitset -> setValue( event.child, !bitset -> getValue( event.child ) );
+			break;
+		case CHILD_ON:
+		case CHILD_OFF:
+			if ( bitset ) bitset -> setValue( event.child, event.action == CHILD_ON );
+			break;
+		case TOGGLE_VISIBLE:
+			if ( count % 2 ) node -> setNodeMask( node -> getNodeMask() ? 0 : target.nodeMask );
+			break;
+		case SHOW:
+			node -> setNodeMask( target.nodeMask );
+			break;
+		case HIDE:
+			node -> setNodeMask( 0 );
+			break;
+		}
+		return true;
+	}
+
+	double _time;
+	bool _started;
+	unsigned int _serial;
+	std::vector<Target> _targets;
+	EventQueue _events;
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef BITSET_SWITCH_H
+#define BITSET_SWITCH_H
+
+#include <osg/BoundingBox>
+#include <osg/Group>
+#include <osg/NodeVisitor>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//BitsetSwitch
+//a switch for many children (thousands of damage states, one per building). the on/off
+//values are bits packed 64 to a word, and the indices of the children that are on are kept
+//in a compact list next to them, with each child's position in that list. switching one
+//child on or off is constant time (append, or swap with the last entry and pop), switching
+//a range or a mask works a word at a time and rebuilds the list from the bits.
+//
+//cull and update traversals, and any visitor asking for the active children, walk only the
+//list, so children that are off cost nothing; other visitors see all children, like they
+//do below an osg::Switch. the list is in no particular child order.
+//
+//	osg::ref_ptr<BitsetSwitch> damage = new BitsetSwitch;
+//	damage -> addChild( intact.get(), true );
+//	damage -> addChild( destroyed.get(), false );
+//	damage -> setValues( 0, 5000, false );
+
+class BitsetSwitch : public osg::Group
+{
+public:
+	typedef unsigned long long Word;
+	typedef std::vector<Word> Mask;
+
+	enum
+	{
+		bitsPerWord = 64,
+		notEnabled = ~0u
+	};
+
+	BitsetSwitch() : _newChildDefaultValue( true ) {}
+
+	BitsetSwitch( const BitsetSwitch& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::Group( copy, copyop ), _newChildDefaultValue( copy._newChildDefaultValue ),
+		  _bits( copy._bits ), _enabled( copy._enabled ), _positions( copy._positions ) {}
+
+	META_Node( osg, BitsetSwitch );
+
+	void setNewChildDefaultValue( bool value ) { _newChildDefaultValue = value; }
+	bool getNewChildDefaultValue() const { return _newChildDefaultValue; }
+
+	virtual bool addChild( osg::Node* child ) { return addChild( child, _newChildDefaultValue ); }
+
+	bool addChild( osg::Node* child, bool value )
+	{
+		if ( !osg::Group::addChild( child ) ) return false;
+		unsigned int index = getNumChildren() - 1;
+		_bits.resize( wordCount( getNumChildren() ), 0 );
+		_positions.push_back( notEnabled );
+		if ( value ) enable( index );
+		return true;
+	}
+
+	virtual bool insertChild( unsigned int index, osg::Node* child ) { return insertChild( index, child, _newChildDefaultValue ); }
+
+	//inserting before the end renumbers the children behind it, that is linear in the children
+	bool insertChild( unsigned int index, osg::Node* child, bool value )
+	{
+		if ( index >= getNumChildren() ) return addChild( child, value );
+		if ( !osg::Group::insertChild( index, child ) ) return false;
+
+		std::vector<unsigned int> enabled( _enabled );
+		for ( unsigned int i = 0; i < enabled.size(); ++i )
+			if ( enabled[i] >= index ) ++enabled[i];
+		if ( value ) enabled.push_back( index );
+		_positions.push_back( notEnabled );
+		setEnabled( enabled );
+		return true;
+	}
+
+	//removing renumbers the children behind the removed ones as well
+	virtual bool removeChildren( unsigned int pos, unsigned int numChildrenToRemove )
+	{
+		if ( pos >= getNumChildren() || numChildrenToRemove == 0 ) return false;
+		unsigned int end = std::min( pos + numChildrenToRemove, getNumChildren() );
+		std::vector<unsigned int> enabled;
+		enabled.reserve( _enabled.size() );
+		for ( unsigned int i = 0; i < _enabled.size(); ++i )
+		{
+			if ( _enabled[i] < pos ) enabled.push_back( _enabled[i] );
+			else if ( _enabled[i] >= end ) enabled.push_back( _enabled[i] - ( end - pos ) );
+		}
+		setEnabled( enabled );
+		_positions.resize( getNumChildren() - ( end - pos ) );
+		_bits.resize( wordCount( _positions.size() ) );
+		return osg::Group::removeChildren( pos, end - pos );
+	}
+
+	void setValue( unsigned int index, bool value )
+	{
+		if ( index >= getNumChildren() ) return;
+		if ( value ? enable( index ) : disable( index ) ) dirtyBound();
+	}
+
+	bool getValue( unsigned int index ) const
+	{
+		return index < getNumChildren() && ( _bits[index / bitsPerWord] >> ( index % bitsPerWord ) & 1 );
+	}
+
+	void setChildValue( const osg::Node* child, bool value ) { setValue( getChildIndex( child ), value ); }
+	bool getChildValue( const osg::Node* child ) const { return getValue( getChildIndex( child ) ); }
+
+	//children [begin, end) on or off
+	void setValues( unsigned int begin, unsigned int end, bool value )
+	{
+		end = std::min( end, getNumChildren() );
+		if ( begin >= end ) return;
+		unsigned int first = begin / bitsPerWord, last = ( end - 1 ) / bitsPerWord;
+		for ( unsigned int w = first; w <= last; ++w )
+		{
+			Word mask = ~Word( 0 );
+			if ( w == first ) mask &= ~Word( 0 ) << ( begin % bitsPerWord );
+			if ( w == last && end % bitsPerWord ) mask &= ~( ~Word( 0 ) << ( end % bitsPerWord ) );
+			_bits[w] = value ? _bits[w] | mask : _bits[w] & ~mask;
+		}
+		updateEnabled();
+	}
+
+	void setAllChildrenOn() { setValues( 0, getNumChildren(), true ); }
+	void setAllChildrenOff() { setValues( 0, getNumChildren(), false ); }
+
+	void setSingleChildOn( unsigned int index )
+	{
+		setAllChildrenOff();
+		setValue( index, true );
+	}
+
+	//bit i of the mask (word i / 64, bit i % 64) is the value of child i; missing words are off
+	void setMask( const Mask& mask )
+	{
+		for ( unsigned int w = 0; w < _bits.size(); ++w )
+			_bits[w] = w < mask.size() ? mask[w] : 0;
+		updateEnabled();
+	}
+
+	//switch on the children whose bits are set, leave the others
+	void enableMask( const Mask& mask )
+	{
+		for ( unsigned int w = 0; w < _bits.size() && w < mask.size(); ++w )
+			_bits[w] |= mask[w];
+		updateEnabled();
+	}
+
+	//switch off the children whose bits are set, leave the others
+	void disableMask( const Mask& mask )
+	{
+		for ( unsigned int w = 0; w < _bits.size() && w < mask.size(); ++w )
+			_bits[w] &= ~mask[w];
+		updateEnabled();
+	}
+
+	//the values as a mask, bits past the last child are 0
+	const Mask& getMask() const { return _bits; }
+
+	//the children that are on, in no particular order
+	const std::vector<unsigned int>& getEnabledChildren() const { return _enabled; }
+	unsigned int getNumEnabled() const { return _enabled.size(); }
+
+	virtual void traverse( osg::NodeVisitor& nv )
+	{
+		if ( !activeOnly( nv ) )
+		{
+			osg::Group::traverse( nv );
+			return;
+		}
+		//indexed, not iterated: a child may switch its siblings from its own callback
+		for ( unsigned int i = 0; i < _enabled.size(); ++i )
+			_children[_enabled[i]] -> accept( nv );
+	}
+
+	//the bound of the children that are on, as osg::Switch does
+	virtual osg::BoundingSphere computeBound() const
+	{
+		osg::BoundingSphere bsphere;
+		if ( _enabled.empty() ) return bsphere;
+
+		osg::BoundingBox bb;
+		for ( unsigned int i = 0; i < _enabled.size(); ++i )
+		{
+			const osg::BoundingSphere& bound = _children[_enabled[i]] -> getBound();
+			if ( bound.valid() ) bb.expandBy( bound );
+		}
+		if ( !bb.valid() ) return bsphere;
+
+		bsphere._center = bb.center();
+		bsphere._radius = 0.0f;
+		for ( unsigned int i = 0; i < _enabled.size(); ++i )
+		{
+			const osg::BoundingSphere& bound = _children[_enabled[i]] -> getBound();
+			if ( bound.valid() ) bsphere.expandRadiusBy( bound );
+		}
+		return bsphere;
+	}
+
+protected:
+	virtual ~BitsetSwitch() {}
+
+	static unsigned int wordCount( unsigned int bits ) { return ( bits + bitsPerWord - 1 ) / bitsPerWord; }
+
+	static unsigned int lowestBit( Word word )
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64( &index, word );
+		return index;
+#else
+		return __builtin_ctzll( word );
+#endif
+	}
+
+	//the update visitor asks for all children, but below a switch it only needs the ones on
+	static bool activeOnly( const osg::NodeVisitor& nv )
+	{
+		return nv.getTraversalMode() == osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN
+		    || nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR
+		    || nv.getVisitorType() == osg::NodeVisitor::UPDATE_VISITOR;
+	}
+
+	//false if the child was on already
+	bool enable( unsigned int index )
+	{
+		Word& word = _bits[index / bitsPerWord];
+		Word bit = Word( 1 ) << ( index % bitsPerWord );
+		if ( word & bit ) return false;
+		word |= bit;
+		_positions[index] = _enabled.size();
+		_enabled.push_back( index );
+		return true;
+	}
+
+	//false if the child was off already
+	bool disable( unsigned int index )
+	{
+		Word& word = _bits[index / bitsPerWord];
+		Word bit = Word( 1 ) << ( index % bitsPerWord );
+		if ( !( word & bit ) ) return false;
+		word &= ~bit;
+		unsigned int position = _positions[index];
+		unsigned int moved = _enabled.back();
+		_enabled[position] = moved;
+		_positions[moved] = position;
+		_enabled.pop_back();
+		_positions[index] = notEnabled;
+		return true;
+	}
+
+	//the list from the bits, after a bulk change; touches the words and the old and new lists only
+	void updateEnabled()
+	{
+		if ( !_bits.empty() && getNumChildren() % bitsPerWord )
+			_bits.back() &= ~( ~Word( 0 ) << ( getNumChildren() % bitsPerWord ) );
+
+		for ( unsigned int i = 0; i < _enabled.size(); ++i )
+			_positions[_enabled[i]] = notEnabled;
+		_enabled.clear();
+		for ( unsigned int w = 0; w < _bits.size(); ++w )
+		{
+			for ( Word word = _bits[w]; word; word &= word - 1 )
+			{
+				unsigned int index = w * bitsPerWord + lowestBit( word );
+				_positions[index] = _enabled.size();
+				_enabled.push_back( index );
+			}
+		}
+		dirtyBound();
+	}
+
+	//the bits from a list, after children were renumbered; _positions must be sized already
+	void setEnabled( const std::vector<unsigned int>& enabled )
+	{
+		for ( unsigned int i = 0; i < _enabled.size(); ++i )
+		{
+			_bits[_enabled[i] / bitsPerWord] = 0;
+			_positions[_enabled[i]] = notEnabled;
+		}
+		_bits.resize( wordCount( _positions.size() ), 0 );
+		_enabled = enabled;
+		for ( unsigned int i = 0; i < _enabled.size(); ++i )
+		{
+			_bits[_enabled[i] / bitsPerWord] |= Word( 1 ) << ( _enabled[i] % bitsPerWord );
+			_positions[_enabled[i]] = i;
+		}
+		dirtyBound();
+	}
+
+	bool _newChildDefaultValue;
+	Mask _bits;
+	std::vector<unsigned int> _enabled;
+	std::vector<unsigned int> _positions;	//index into _enabled per child, notEnabled if off
+};
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef ERROR_LOD_H
+#define ERROR_LOD_H
+
+#include <osg/Group>
+#include <osg/LOD>
+#include <osg/PolygonStipple>
+#include <osg/StateSet>
+#include <osg/ValueObject>
+#include <osg/Viewport>
+#include <osgUtil/CullVisitor>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//ErrorLOD
+//an osg::LOD that chooses its level by how many pixels the level's geometric error covers,
+//instead of by fixed eye distances: with the projection and viewport of the camera at hand,
+//level i would be off the true surface by error(i) * pixelsPerUnit / distance pixels, and
+//the coarsest level below the pixel threshold is drawn. this holds for any field of view,
+//window size and LOD scale.
+//
+//children are ordered fine to coarse, error(0) is usually 0. the errors come from the
+//children's "geometricError" user values (LodBuilder sets them) or from setError().
+//
+//to stop levels thrashing at a boundary there is a hysteresis band: the node only goes
+//coarser when the coarser level is below threshold * ( 1 - band ), and only finer when the
+//current level is above threshold * ( 1 + band ). with a fade time, a change of level is
+//blended over that many seconds: both levels are drawn, each through one half of a pair of
+//complementary 4 x 4 ordered dither patterns (polygon stipple), the new level taking over
+//more pixels as time goes on. shaders that ignore the stipple see both levels at once.
+//
+//	osg::ref_ptr<ErrorLOD> lod = new ErrorLOD( *readLODFileCached( "cessna.osg" ) );
+//	lod -> setPixelError( 1.0f );
+//	lod -> setFadeTime( 0.5 );
+//
+//the selection state is shared by all cameras, with several views the last cull wins.
+//many ErrorLODs below one ErrorLODGroup are selected together, see there.
+
+class ErrorLOD : public osg::LOD
+{
+public:
+	ErrorLOD()
+		: _pixelError( 1.0f ), _hysteresis( 0.1f ), _fadeTime( 0.0 ), _current( ~0u ), _previous( ~0u ), _fadeStart( 0.0 ),
+		  _selectedBy( 0 ), _selectedTraversal( ~0u ), _preselected( ~0u ) {}
+
+	//from an LOD whose children carry "geometricError" user values
+	ErrorLOD( const osg::LOD& lod, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::LOD( lod, copyop ), _pixelError( 1.0f ), _hysteresis( 0.1f ), _fadeTime( 0.0 ), _current( ~0u ), _previous( ~0u ),
+		  _fadeStart( 0.0 ), _selectedBy( 0 ), _selectedTraversal( ~0u ), _preselected( ~0u )
+	{
+		for ( unsigned int i = 0; i < getNumChildren(); ++i )
+		{
+			double error = 0.0;
+			if ( getChild( i ) -> getUserValue( "geometricError", error ) ) setError( i, error );
+		}
+	}
+
+	ErrorLOD( const ErrorLOD& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::LOD( copy, copyop ), _errors( copy._errors ), _pixelError( copy._pixelError ), _hysteresis( copy._hysteresis ),
+		  _fadeTime( copy._fadeTime ), _current( ~0u ), _previous( ~0u ), _fadeStart( 0.0 ), _selectedBy( 0 ), _selectedTraversal( ~0u ), _preselected( ~0u ) {}
+
+	META_Node( osg, ErrorLOD );
+
+	//geometric error of level i in model units, levels without one count as 0
+	void setError( unsigned int i, float error )
+	{
+		if ( i >= _errors.size() ) _errors.resize( i + 1, 0.0f );
+		_errors[i] = error;
+	}
+
+	float getError( unsigned int i ) const { return i < _errors.size() ? _errors[i] : 0.0f; }
+
+	//the most pixels a level's error may cover on screen
+	void setPixelError( float pixels ) { _pixelError = pixels; }
+	float getPixelError() const { return _pixelError; }
+
+	//relative width of the band around the threshold in which the level is kept
+	void setHysteresis( float band ) { _hysteresis = band; }
+	float getHysteresis() const { return _hysteresis; }
+
+	//seconds a change of level is cross-faded over, 0 switches at once
+	void setFadeTime( double seconds ) { _fadeTime = seconds; }
+	double getFadeTime() const { return _fadeTime; }
+
+	//the level drawn last, ~0u before the first cull
+	unsigned int getCurrentLevel() const { return _current; }
+
+	//where the level is measured from, in the node's coordinates
+	osg::Vec3 getSelectionCenter() const
+	{
+		return _centerMode == USER_DEFINED_CENTER ? getCenter() : getBound().center();
+	}
+
+	//pixels per model unit at distance 1 for the projection and viewport of a cull, and
+	//whether that number is to be divided by the distance (false for orthographic views)
+	static float pixelsPerUnit( osgUtil::CullVisitor& cv, bool& perspective )
+	{
+		const osg::Matrix& projection = *cv.getProjectionMatrix();
+		float height = cv.getViewport() ? cv.getViewport() -> height() : 1024.0f;
+		perspective = projection( 3, 3 ) == 0.0;
+		return 0.5f * height * std::fabs( projection( 1, 1 ) );
+	}
+
+	//the level for a given number of pixels per unit of error, starting from the current one
+	unsigned int chooseLevel( float pixelsPerUnitHere ) const
+	{
+		unsigned int numLevels = getNumChildren();
+		if ( numLevels == 0 ) return ~0u;
+
+		//no level yet: plainly the coarsest one under the threshold
+		if ( _current >= numLevels )
+		{
+			unsigned int level = 0;
+			while ( level + 1 < numLevels && getError( level + 1 ) * pixelsPerUnitHere <= _pixelError ) ++level;
+			return level;
+		}
+
+		unsigned int level = _current;
+		float coarser = _pixelError * ( 1.0f - _hysteresis ), finer = _pixelError * ( 1.0f + _hysteresis );
+		while ( level + 1 < numLevels && getError( level + 1 ) * pixelsPerUnitHere <= coarser ) ++level;
+		while ( level > 0 && getError( level ) * pixelsPerUnitHere > finer ) --level;
+		return level;
+	}
+
+	//take a level chosen for this cull by an ErrorLODGroup
+	void preselect( unsigned int level, const osgUtil::CullVisitor& cv )
+	{
+		_preselected = level;
+		_selectedBy = &cv;
+		_selectedTraversal = cv.getTraversalNumber();
+	}
+
+	virtual void traverse( osg::NodeVisitor& nv )
+	{
+		osgUtil::CullVisitor* cv = nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR ? dynamic_cast<osgUtil::CullVisitor*>( &nv ) : 0;
+		if ( !cv )
+		{
+			//other visitors that want the active children get the current level
+			if ( nv.getTraversalMode() == osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN && _current < getNumChildren() )
+				_children[_current] -> accept( nv );
+			else
+				osg::Group::traverse( nv );
+			return;
+		}
+
+		unsigned int level;
+		if ( _selectedBy == cv && _selectedTraversal == cv -> getTraversalNumber() )
+			level = _preselected;
+		else
+		{
+			bool perspective;
+			float pixels = pixelsPerUnit( *cv, perspective );
+			if ( perspective )
+			{
+				float distance = ( getSelectionCenter() - cv -> getViewPointLocal() ).length() * cv -> getLODScale();
+				pixels /= std::max( distance, 1e-6f );
+			}
+			level = chooseLevel( pixels );
+		}
+		if ( level >= getNumChildren() ) return;
+
+		double now = nv.getFrameStamp() ? nv.getFrameStamp() -> getReferenceTime() : 0.0;
+		if ( level != _current )
+		{
+			_previous = _current < getNumChildren() && _fadeTime > 0.0 ? _current : ~0u;
+			_current = level;
+			_fadeStart = now;
+		}
+
+		float t = _previous < getNumChildren() ? (float)( ( now - _fadeStart ) / _fadeTime ) : 1.0f;
+		if ( t >= 1.0f )
+		{
+			_previous = ~0u;
+			_children[_current] -> accept( nv );
+			return;
+		}
+
+		//the new level in the pixels whose dither threshold is below t, the old one in the rest
+		unsigned int step = std::min( (unsigned int)( t * 16.0f ), 15u ) + 1;
+		cv -> pushStateSet( getDitherStateSet( step, false ) );
+		_children[_current] -> accept( nv );
+		cv -> popStateSet();
+		cv -> pushStateSet( getDitherStateSet( step, true ) );
+		_children[_previous] -> accept( nv );
+		cv -> popStateSet();
+	}
+
+	//polygon stipple that lets through the pixels whose 4 x 4 Bayer value is below step
+	//(0..16), or with complement the other ones; shared by all ErrorLODs
+	static osg::StateSet* getDitherStateSet( unsigned int step, bool complement )
+	{
+		static std::vector< osg::ref_ptr<osg::StateSet> > s_stateSets = createDitherStateSets();
+		return s_stateSets[2 * std::min( step, 16u ) + ( complement ? 1 : 0 )].get();
+	}
+
+protected:
+	virtual ~ErrorLOD() {}
+
+	static std::vector< osg::ref_ptr<osg::StateSet> > createDitherStateSets()
+	{
+		static const unsigned int bayer[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+		std::vector< osg::ref_ptr<osg::StateSet> > stateSets;
+		for ( unsigned int step = 0; step <= 16; ++step )
+		{
+			for ( unsigned int complement = 0; complement < 2; ++complement )
+			{
+				GLubyte mask[128];
+				for ( unsigned int y = 0; y < 32; ++y )
+				{
+					for ( unsigned int b = 0; b < 4; ++b )
+					{
+						GLubyte byte = 0;
+						for ( unsigned int x = 0; x < 8; ++x )
+						{
+							bool on = bayer[y % 4][x % 4] < step;
+							if ( on != ( complement == 1 ) ) byte |= 0x80 >> x;
+						}
+						mask[4 * y + b] = byte;
+					}
+				}
+				osg::ref_ptr<osg::StateSet> stateSet = new osg::StateSet;
+				stateSet -> setAttributeAndModes( new osg::PolygonStipple( mask ), osg::StateAttribute::ON );
+				stateSets.push_back( stateSet );
+			}
+		}
+		return stateSets;
+	}
+
+	std::vector<float> _errors;
+	float _pixelError;
+	float _hysteresis;
+	double _fadeTime;
+
+	unsigned int _current;
+	unsigned int _previous;
+	double _fadeStart;
+
+	const osgUtil::CullVisitor* _selectedBy;
+	unsigned int _selectedTraversal;
+	unsigned int _preselected;
+};
+
+//ErrorLODGroup
+//selects the levels of all ErrorLOD children in one pass at the start of its cull, instead
+//of one node at a time: the children's centres are kept in flat arrays, the view point and
+//the pixels per unit of the projection are computed once, and every child is handed its
+//level before the children are traversed. the ErrorLODs must be direct children (nothing
+//that moves them in between); other children are traversed as usual.
+//
+//	osg::ref_ptr<ErrorLODGroup> field = new ErrorLODGroup;
+//	for ( ... ) field -> addChild( new ErrorLOD( *levels ) );
+//
+//call dirtyBatch() after moving a child's centre.
+
+class ErrorLODGroup : public osg::Group
+{
+public:
+	ErrorLODGroup() : _batchDirty( true ) {}
+
+	ErrorLODGroup( const ErrorLODGroup& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::Group( copy, copyop ), _batchDirty( true ) {}
+
+	META_Node( osg, ErrorLODGroup );
+
+	virtual bool addChild( osg::Node* child ) { _batchDirty = true; return osg::Group::addChild( child ); }
+	virtual bool insertChild( unsigned int index, osg::Node* child ) { _batchDirty = true; return osg::Group::insertChild( index, child ); }
+	virtual bool removeChildren( unsigned int pos, unsigned int numChildrenToRemove )
+	{
+		_batchDirty = true;
+		return osg::Group::removeChildren( pos, numChildrenToRemove );
+	}
+	virtual bool setChild( unsigned int index, osg::Node* child ) { _batchDirty = true; return osg::Group::setChild( index, child ); }
+
+	void dirtyBatch() { _batchDirty = true; }
+
+	virtual void traverse( osg::NodeVisitor& nv )
+	{
+		osgUtil::CullVisitor* cv = nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR ? dynamic_cast<osgUtil::CullVisitor*>( &nv ) : 0;
+		if ( cv ) select( *cv );
+		osg::Group::traverse( nv );
+	}
+
+protected:
+	virtual ~ErrorLODGroup() {}
+
+	void rebuildBatch()
+	{
+		_lods.clear();
+		_x.clear(); _y.clear(); _z.clear();
+		for ( unsigned int i = 0; i < getNumChildren(); ++i )
+		{
+			ErrorLOD* lod = dynamic_cast<ErrorLOD*>( getChild( i ) );
+			if ( !lod ) continue;
+			osg::Vec3 center = lod -> getSelectionCenter();
+			_lods.push_back( lod );
+			_x.push_back( center.x() );
+			_y.push_back( center.y() );
+			_z.push_back( center.z() );
+		}
+		_pixels.resize( _lods.size() );
+		_batchDirty = false;
+	}
+
+	void select( osgUtil::CullVisitor& cv )
+	{
+		if ( _batchDirty ) rebuildBatch();
+
+		bool perspective;
+		float pixels = ErrorLOD::pixelsPerUnit( cv, perspective );
+		osg::Vec3 eye = cv.getViewPointLocal();
+		float scale = cv.getLODScale();
+		unsigned int count = _lods.size();
+
+		//distances first, in one tight loop over the flat arrays
+		if ( perspective )
+		{
+			const float ex = eye.x(), ey = eye.y(), ez = eye.z();
+			for ( unsigned int i = 0; i < count; ++i )
+			{
+				float dx = _x[i] - ex, dy = _y[i] - ey, dz = _z[i] - ez;
+				_pixels[i] = pixels / std::max( std::sqrt( dx * dx + dy * dy + dz * dz ) * scale, 1e-6f );
+			}
+		}
+		else
+			std::fill( _pixels.begin(), _pixels.end(), pixels );
+
+		for ( unsigned int i = 0; i < count; ++i )
+			_lods[i] -> preselect( _lods[i] -> chooseLevel( _pixels[i] ), cv );
+	}
+
+	std::vector<ErrorLOD*> _lods;	//children, kept alive by _children
+	std::vector<float> _x, _y, _z;
+	std::vector<float> _pixels;
+	bool _batchDirty;
+};
+
+#endif
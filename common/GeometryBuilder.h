@@ -0,0 +1,177 @@
+#ifndef GEOMETRY_BUILDER_H
+#define GEOMETRY_BUILDER_H
+
+#include <osg/BufferObject>
+#include <osg/Geometry>
+#include <osg/PrimitiveSet>
+
+#include <algorithm>
+
+#include "IndexNarrowing.h"
+
+//GeometryBuilder
+//fills the attribute arrays of an osg::Geometry from known counts instead of growing
+//every array with push_back. each array is allocated once at its final size, vertices
+//are written by index, and at the end all vertex attribute arrays are bound to one
+//shared vertex buffer object, so the driver sees a single buffer per geometry.
+//
+//	GeometryBuilder builder( 4, GeometryBuilder::COLORS );
+//	builder.addVertex( osg::Vec3( 0.0f, 0.0f, 0.0f ) ).color( osg::Vec4( 1.0f, 0.0f, 0.0f, 1.0f ) );
+//	...
+//	builder.setOverallNormal( osg::Vec3( 0.0f, -1.0f, 0.0f ) );
+//	osg::ref_ptr<osg::Geometry> quad = builder.build( GL_QUADS );
+//
+//generators that know their layout can skip addVertex() and write straight through
+//vertices(), normals()... (several threads may fill disjoint ranges), then call setNumVertices().
+//with setNarrowIndices( true ) build() stores the indices as ubyte or ushort when they fit.
+
+class GeometryBuilder
+{
+public:
+	enum Attributes
+	{
+		NORMALS = 1 << 0,	//per-vertex normals
+		COLORS = 1 << 1,	//per-vertex colours
+		TEXCOORDS = 1 << 2	//per-vertex texture coordinates, unit 0
+	};
+
+	GeometryBuilder( unsigned int numVertices, unsigned int attributes = 0, unsigned int numIndices = 0 )
+		: _numVertices( 0 ), _numIndices( 0 ), _narrowIndices( false )
+	{
+		_vertices = new osg::Vec3Array( numVertices );
+		if ( attributes & NORMALS ) _normals = new osg::Vec3Array( numVertices );
+		if ( attributes & COLORS ) _colors = new osg::Vec4Array( numVertices );
+		if ( attributes & TEXCOORDS ) _texCoords = new osg::Vec2Array( numVertices );
+		if ( numIndices > 0 ) _indices = new osg::DrawElementsUInt( GL_TRIANGLES, numIndices );
+	}
+
+	//append a vertex, the per-vertex setters below apply to it. an estimate that was too low
+	//grows every array (doubling, like push_back), it is only slower, never out of bounds
+	GeometryBuilder& addVertex( const osg::Vec3& v )
+	{
+		if ( _numVertices >= _vertices -> size() ) reserveVertices( std::max( 2 * _numVertices, 16u ) );
+		( *_vertices )[_numVertices++] = v;
+		return *this;
+	}
+
+	//for the vertex added last; attributes not requested in the constructor are ignored
+	GeometryBuilder& normal( const osg::Vec3& n ) { if ( _normals.valid() && _numVertices > 0 ) ( *_normals )[_numVertices - 1] = n; return *this; }
+	GeometryBuilder& color( const osg::Vec4& c ) { if ( _colors.valid() && _numVertices > 0 ) ( *_colors )[_numVertices - 1] = c; return *this; }
+	GeometryBuilder& texCoord( const osg::Vec2& t ) { if ( _texCoords.valid() && _numVertices > 0 ) ( *_texCoords )[_numVertices - 1] = t; return *this; }
+
+	void addIndex( unsigned int i )
+	{
+		if ( !_indices ) _indices = new osg::DrawElementsUInt( GL_TRIANGLES );
+		if ( _numIndices >= _indices -> size() ) _indices -> resize( std::max( 2 * _numIndices, 48u ) );
+		( *_indices )[_numIndices++] = i;
+	}
+
+	//make room for n vertices in every per-vertex array, before writing through vertices()...
+	void reserveVertices( unsigned int n )
+	{
+		if ( n <= _vertices -> size() ) return;
+		_vertices -> resize( n );
+		if ( _normals.valid() ) _normals -> resize( n );
+		if ( _colors.valid() ) _colors -> resize( n );
+		if ( _texCoords.valid() ) _texCoords -> resize( n );
+	}
+
+	void reserveIndices( unsigned int n )
+	{
+		if ( !_indices ) _indices = new osg::DrawElementsUInt( GL_TRIANGLES );
+		if ( n > _indices -> size() ) _indices -> resize( n );
+	}
+
+	void addTriangle( unsigned int a, unsigned int b, unsigned int c )
+	{
+		addIndex( a );
+		addIndex( b );
+		addIndex( c );
+	}
+
+	//one normal or colour for the whole geometry, for attributes not requested per vertex
+	void setOverallNormal( const osg::Vec3& n ) { _overallNormal = new osg::Vec3Array( 1, &n ); }
+	void setOverallColor( const osg::Vec4& c ) { _overallColor = new osg::Vec4Array( 1, &c ); }
+
+	//direct access to the preallocated storage for bulk generators, 0 when there is none.
+	//room for getVertexCapacity() vertices and getIndexCapacity() indices, no more
+	osg::Vec3* vertices() { return _vertices -> empty() ? 0 : &_vertices -> front(); }
+	osg::Vec3* normals() { return _normals.valid() && !_normals -> empty() ? &_normals -> front() : 0; }
+	osg::Vec4* colors() { return _colors.valid() && !_colors -> empty() ? &_colors -> front() : 0; }
+	osg::Vec2* texCoords() { return _texCoords.valid() && !_texCoords -> empty() ? &_texCoords -> front() : 0; }
+	GLuint* indices() { return _indices.valid() && !_indices -> empty() ? &_indices -> front() : 0; }
+
+	unsigned int getVertexCapacity() const { return _vertices -> size(); }
+	unsigned int getIndexCapacity() const { return _indices.valid() ? _indices -> size() : 0; }
+
+	//counts written directly; never more than the storage holds
+	void setNumVertices( unsigned int n ) { _numVertices = std::min<unsigned int>( n, _vertices -> size() ); }
+	void setNumIndices( unsigned int n ) { _numIndices = std::min( n, getIndexCapacity() ); }
+	unsigned int getNumVertices() const { return _numVertices; }
+	unsigned int getNumIndices() const { return _numIndices; }
+
+	//emit DrawElementsUByte/UShort instead of DrawElementsUInt when the largest index allows it
+	void setNarrowIndices( bool narrow ) { _narrowIndices = narrow; }
+	bool getNarrowIndices() const { return _narrowIndices; }
+
+	//bind everything to a new geometry. with indices the primitive is DrawElements( mode ),
+	//otherwise DrawArrays( mode ) over all vertices. arrays that were not filled completely
+	//are shrunk to what was written, which never reallocates.
+	osg::Geometry* build( GLenum mode )
+	{
+		osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+		geometry -> setUseDisplayList( false );
+		geometry -> setUseVertexBufferObjects( true );
+
+		osg::ref_ptr<osg::VertexBufferObject> vbo = new osg::VertexBufferObject;
+		geometry -> setVertexArray( bind( _vertices.get(), vbo.get() ) );
+
+		if ( _normals.valid() )
+			geometry -> setNormalArray( bind( _normals.get(), vbo.get() ), osg::Array::BIND_PER_VERTEX );
+		else if ( _overallNormal.valid() )
+			geometry -> setNormalArray( _overallNormal.get(), osg::Array::BIND_OVERALL );
+
+		if ( _colors.valid() )
+			geometry -> setColorArray( bind( _colors.get(), vbo.get() ), osg::Array::BIND_PER_VERTEX );
+		else if ( _overallColor.valid() )
+			geometry -> setColorArray( _overallColor.get(), osg::Array::BIND_OVERALL );
+
+		if ( _texCoords.valid() )
+			geometry -> setTexCoordArray( 0, bind( _texCoords.get(), vbo.get() ), osg::Array::BIND_PER_VERTEX );
+
+		if ( _indices.valid() )
+		{
+			_indices -> resize( std::min<unsigned int>( _numIndices, _indices -> size() ) );
+			_indices -> setMode( mode );
+			osg::ref_ptr<osg::DrawElements> narrowed;
+			if ( _narrowIndices ) narrowed = IndexNarrowing::narrow( *_indices );
+			geometry -> addPrimitiveSet( narrowed.valid() ? narrowed.get() : _indices.get() );
+		}
+		else
+			geometry -> addPrimitiveSet( new osg::DrawArrays( mode, 0, _numVertices ) );
+
+		return geometry.release();
+	}
+
+protected:
+	template<class ArrayType>
+	ArrayType* bind( ArrayType* array, osg::VertexBufferObject* vbo )
+	{
+		array -> resize( std::min<unsigned int>( _numVertices, array -> size() ) );
+		array -> setVertexBufferObject( vbo );
+		return array;
+	}
+
+	osg::ref_ptr<osg::Vec3Array> _vertices;
+	osg::ref_ptr<osg::Vec3Array> _normals;
+	osg::ref_ptr<osg::Vec4Array> _colors;
+	osg::ref_ptr<osg::Vec2Array> _texCoords;
+	osg::ref_ptr<osg::DrawElementsUInt> _indices;
+	osg::ref_ptr<osg::Vec3Array> _overallNormal;
+	osg::ref_ptr<osg::Vec4Array> _overallColor;
+	unsigned int _numVertices;
+	unsigned int _numIndices;
+	bool _narrowIndices;
+};
+
+#endif
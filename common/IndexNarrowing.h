@@ -0,0 +1,337 @@
+#ifndef INDEX_NARROWING_H
+#define INDEX_NARROWING_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/PrimitiveSet>
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+//IndexNarrowing
+//stores every DrawElements in the smallest index type its largest index fits in:
+//DrawElementsUByte for indices below 255, DrawElementsUShort below 65535 (the all-ones value
+//of each type stays free for primitive restart), which quarters or halves index memory and
+//the bandwidth the GPU spends on fetching indices.
+//
+//geometries with more vertices than a ushort can address are first split into several
+//geometries of at most maxVertices vertices each (default 65535, which keeps 0xFFFF free
+//as primitive restart index). vertices used by more than one piece are duplicated. only
+//lists (points, lines, triangles) can be split, geometries with strips, fans or DrawArrays
+//keep their wide indices.
+//
+//	IndexNarrowingVisitor narrowing;
+//	scene -> accept( narrowing );
+//	narrowing.getStatistics().report( std::cout );
+
+class IndexNarrowing
+{
+public:
+	struct Statistics
+	{
+		Statistics() : numNarrowed( 0 ), numSplit( 0 ), numPieces( 0 ), numLeftWide( 0 ),
+		               indexBytesBefore( 0 ), indexBytesAfter( 0 ), vertexBytesAdded( 0 ) {}
+
+		//index bytes saved minus the bytes of the vertices duplicated by splitting
+		long long getBytesSaved() const { return (long long)indexBytesBefore - indexBytesAfter - vertexBytesAdded; }
+
+		void report( std::ostream& out ) const
+		{
+			out << "index narrowing: " << numNarrowed << " primitive sets narrowed, "
+			    << numSplit << " geometries split into " << numPieces << ", " << numLeftWide << " left 32 bit" << std::endl
+			    << "  index bytes " << indexBytesBefore << " -> " << indexBytesAfter
+			    << ", duplicated vertex bytes " << vertexBytesAdded << ", saved " << getBytesSaved() << " bytes" << std::endl;
+		}
+
+		unsigned int numNarrowed;			//DrawElements replaced by a smaller type
+		unsigned int numSplit;				//geometries split because they had too many vertices
+		unsigned int numPieces;				//geometries the split ones became
+		unsigned int numLeftWide;			//geometries that needed 32 bit indices but could not be split
+		unsigned long long indexBytesBefore;
+		unsigned long long indexBytesAfter;
+		unsigned long long vertexBytesAdded;
+	};
+
+	//the smallest DrawElements holding the same indices, or 0 if elements already is that type
+	static osg::DrawElements* narrow( const osg::DrawElements& elements, bool allowUByte = true )
+	{
+		unsigned int maxIndex = 0;
+		for ( unsigned int i = 0; i < elements.getNumIndices(); ++i )
+			maxIndex = std::max( maxIndex, elements.index( i ) );
+
+		osg::PrimitiveSet::Type type = osg::PrimitiveSet::DrawElementsUIntPrimitiveType;
+		//0xFF and 0xFFFF are the restart indices of their types, never real ones
+		if ( maxIndex < 255 && allowUByte ) type = osg::PrimitiveSet::DrawElementsUBytePrimitiveType;
+		else if ( maxIndex < 65535 ) type = osg::PrimitiveSet::DrawElementsUShortPrimitiveType;
+		if ( type == elements.getType() || type == osg::PrimitiveSet::DrawElementsUIntPrimitiveType ) return 0;
+
+		if ( type == osg::PrimitiveSet::DrawElementsUBytePrimitiveType )
+			return copyIndices( elements, new osg::DrawElementsUByte( elements.getMode() ) );
+		return copyIndices( elements, new osg::DrawElementsUShort( elements.getMode() ) );
+	}
+
+	//narrow every DrawElements of the geometry in place
+	static void narrowPrimitiveSets( osg::Geometry& geometry, Statistics& stats, bool allowUByte = true )
+	{
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			osg::DrawElements* elements = geometry.getPrimitiveSet( i ) -> getDrawElements();
+			if ( !elements ) continue;
+
+			stats.indexBytesBefore += elements -> getTotalDataSize();
+			osg::ref_ptr<osg::DrawElements> narrowed = narrow( *elements, allowUByte );
+			if ( narrowed.valid() )
+			{
+				geometry.setPrimitiveSet( i, narrowed.get() );
+				elements = narrowed.get();
+				++stats.numNarrowed;
+			}
+			stats.indexBytesAfter += elements -> getTotalDataSize();
+		}
+		geometry.dirtyDisplayList();
+	}
+
+	//true if some index does not fit in a ushort
+	static bool needsSplit( const osg::Geometry& geometry, unsigned int maxVertices = 65535 )
+	{
+		const osg::Array* vertices = geometry.getVertexArray();
+		return vertices && vertices -> getNumElements() > maxVertices && maxIndex( geometry ) >= maxVertices;
+	}
+
+	//lists only, and no arrays bound per primitive set, which would lose their meaning
+	static bool canSplit( const osg::Geometry& geometry )
+	{
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			const osg::PrimitiveSet* primitives = geometry.getPrimitiveSet( i );
+			if ( !primitives -> getDrawElements() || primitiveSize( primitives -> getMode() ) == 0 ) return false;
+		}
+
+		osg::Geometry::ArrayList arrays;
+		geometry.getArrayList( arrays );
+		for ( unsigned int i = 0; i < arrays.size(); ++i )
+		{
+			if ( arrays[i] -> getBinding() == osg::Array::BIND_PER_PRIMITIVE_SET ) return false;
+		}
+		return true;
+	}
+
+	//cut the geometry into pieces of at most maxVertices vertices, each a shallow copy of the
+	//original (same state set, name...) with its own compacted per-vertex arrays
+	static void split( const osg::Geometry& geometry, std::vector< osg::ref_ptr<osg::Geometry> >& pieces,
+	                   Statistics& stats, unsigned int maxVertices = 65535 )
+	{
+		unsigned int numVertices = geometry.getVertexArray() -> getNumElements();
+		std::vector<unsigned int> remap( numVertices ), stamp( numVertices, ~0u );
+		std::vector<unsigned int> pieceVertices;	//old index of every vertex of the current piece
+		std::vector< osg::ref_ptr<osg::DrawElementsUInt> > pieceSets;
+		unsigned int numUsed = 0;
+
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			const osg::DrawElements* elements = geometry.getPrimitiveSet( i ) -> getDrawElements();
+			unsigned int size = primitiveSize( elements -> getMode() );
+			osg::DrawElementsUInt* current = 0;
+
+			for ( unsigned int p = 0; p + size <= elements -> getNumIndices(); p += size )
+			{
+				//close the piece if this primitive could overflow it
+				if ( pieceVertices.size() + size > maxVertices )
+				{
+					addPiece( geometry, pieceVertices, pieceSets, pieces );
+					current = 0;
+				}
+				if ( !current )
+				{
+					pieceSets.push_back( new osg::DrawElementsUInt( elements -> getMode() ) );
+					pieceSets.back() -> setNumInstances( elements -> getNumInstances() );
+					current = pieceSets.back().get();
+				}
+
+				for ( unsigned int k = 0; k < size; ++k )
+				{
+					unsigned int v = elements -> index( p + k );
+					if ( stamp[v] != pieces.size() )
+					{
+						stamp[v] = pieces.size();
+						remap[v] = pieceVertices.size();
+						pieceVertices.push_back( v );
+						++numUsed;
+					}
+					current -> push_back( remap[v] );
+				}
+			}
+		}
+		if ( !pieceVertices.empty() ) addPiece( geometry, pieceVertices, pieceSets, pieces );
+
+		//vertices that landed in more than one piece
+		osg::Geometry::ArrayList arrays;
+		geometry.getArrayList( arrays );
+		unsigned int vertexSize = 0;
+		for ( unsigned int i = 0; i < arrays.size(); ++i )
+		{
+			if ( isPerVertex( geometry, arrays[i].get() ) ) vertexSize += arrays[i] -> getElementSize();
+		}
+		unsigned int numDistinct = 0;
+		for ( unsigned int v = 0; v < numVertices; ++v )
+		{
+			if ( stamp[v] != ~0u ) ++numDistinct;
+		}
+		stats.vertexBytesAdded += (unsigned long long)( numUsed - numDistinct ) * vertexSize;
+	}
+
+protected:
+	template<class DrawElementsType>
+	static DrawElementsType* copyIndices( const osg::DrawElements& from, DrawElementsType* to )
+	{
+		to -> reserve( from.getNumIndices() );
+		for ( unsigned int i = 0; i < from.getNumIndices(); ++i )
+			to -> push_back( from.index( i ) );
+		to -> setNumInstances( from.getNumInstances() );
+		return to;
+	}
+
+	static unsigned int primitiveSize( GLenum mode )
+	{
+		switch ( mode )
+		{
+		case GL_POINTS: return 1;
+		case GL_LINES: return 2;
+		case GL_TRIANGLES: return 3;
+		default: return 0;
+		}
+	}
+
+	static unsigned int maxIndex( const osg::Geometry& geometry )
+	{
+		unsigned int result = 0;
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			const osg::PrimitiveSet* primitives = geometry.getPrimitiveSet( i );
+			for ( unsigned int j = 0; j < primitives -> getNumIndices(); ++j )
+				result = std::max( result, primitives -> index( j ) );
+		}
+		return result;
+	}
+
+	static bool isPerVertex( const osg::Geometry& geometry, const osg::Array* array )
+	{
+		return array && array -> getNumElements() == geometry.getVertexArray() -> getNumElements() &&
+		       ( array == geometry.getVertexArray() || array -> getBinding() == osg::Array::BIND_PER_VERTEX );
+	}
+
+	//the elements of array listed in vertices, as a new array of the same type
+	static osg::Array* compact( const osg::Array* array, const std::vector<unsigned int>& vertices )
+	{
+		osg::Array* result = static_cast<osg::Array*>( array -> cloneType() );
+		result -> resizeArray( vertices.size() );
+		result -> setBinding( array -> getBinding() );
+		unsigned int size = array -> getElementSize();
+		const char* from = (const char*)array -> getDataPointer();
+		char* to = (char*)result -> getDataPointer();
+		for ( unsigned int i = 0; i < vertices.size(); ++i )
+			std::memcpy( to + i * size, from + vertices[i] * size, size );
+		return result;
+	}
+
+	//per-vertex arrays are compacted, overall ones shared with the original
+	static osg::Array* pieceArray( const osg::Geometry& geometry, const osg::Array* array, const std::vector<unsigned int>& vertices )
+	{
+		if ( !array ) return 0;
+		if ( isPerVertex( geometry, array ) ) return compact( array, vertices );
+		return const_cast<osg::Array*>( array );
+	}
+
+	static void addPiece( const osg::Geometry& geometry, std::vector<unsigned int>& vertices,
+	                      std::vector< osg::ref_ptr<osg::DrawElementsUInt> >& sets,
+	                      std::vector< osg::ref_ptr<osg::Geometry> >& pieces )
+	{
+		osg::ref_ptr<osg::Geometry> piece = new osg::Geometry( geometry, osg::CopyOp::SHALLOW_COPY );
+		piece -> setVertexArray( pieceArray( geometry, geometry.getVertexArray(), vertices ) );
+		piece -> setNormalArray( pieceArray( geometry, geometry.getNormalArray(), vertices ) );
+		piece -> setColorArray( pieceArray( geometry, geometry.getColorArray(), vertices ) );
+		piece -> setSecondaryColorArray( pieceArray( geometry, geometry.getSecondaryColorArray(), vertices ) );
+		piece -> setFogCoordArray( pieceArray( geometry, geometry.getFogCoordArray(), vertices ) );
+		for ( unsigned int i = 0; i < geometry.getNumTexCoordArrays(); ++i )
+			piece -> setTexCoordArray( i, pieceArray( geometry, geometry.getTexCoordArray( i ), vertices ) );
+		for ( unsigned int i = 0; i < geometry.getNumVertexAttribArrays(); ++i )
+			piece -> setVertexAttribArray( i, pieceArray( geometry, geometry.getVertexAttribArray( i ), vertices ) );
+
+		piece -> removePrimitiveSet( 0, piece -> getNumPrimitiveSets() );
+		for ( unsigned int i = 0; i < sets.size(); ++i )
+			piece -> addPrimitiveSet( sets[i].get() );
+		piece -> dirtyBound();
+
+		pieces.push_back( piece );
+		vertices.clear();
+		sets.clear();
+	}
+};
+
+//IndexNarrowingVisitor
+//splits and narrows every geometry below a node, and counts what it saved.
+
+class IndexNarrowingVisitor : public osg::NodeVisitor
+{
+public:
+	IndexNarrowingVisitor( bool allowUByte = true, unsigned int maxVertices = 65535 )
+		: osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), _allowUByte( allowUByte ), _maxVertices( maxVertices ) {}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		std::vector< osg::ref_ptr<osg::Geometry> > geometries;
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+		{
+			osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+			if ( geometry ) geometries.push_back( geometry );
+		}
+
+		for ( unsigned int i = 0; i < geometries.size(); ++i )
+		{
+			osg::Geometry* geometry = geometries[i].get();
+			if ( !IndexNarrowing::needsSplit( *geometry, _maxVertices ) )
+			{
+				IndexNarrowing::narrowPrimitiveSets( *geometry, _stats, _allowUByte );
+				continue;
+			}
+			if ( !IndexNarrowing::canSplit( *geometry ) )
+			{
+				IndexNarrowing::narrowPrimitiveSets( *geometry, _stats, _allowUByte );
+				++_stats.numLeftWide;
+				continue;
+			}
+
+			std::vector< osg::ref_ptr<osg::Geometry> > pieces;
+			IndexNarrowing::Statistics splitStats;
+			IndexNarrowing::split( *geometry, pieces, splitStats, _maxVertices );
+			_stats.vertexBytesAdded += splitStats.vertexBytesAdded;
+			for ( unsigned int p = 0; p < geometry -> getNumPrimitiveSets(); ++p )
+				_stats.indexBytesBefore += geometry -> getPrimitiveSet( p ) -> getTotalDataSize();
+
+			//the pieces come out as DrawElementsUInt, narrow them without counting them twice
+			IndexNarrowing::Statistics pieceStats;
+			for ( unsigned int p = 0; p < pieces.size(); ++p )
+				IndexNarrowing::narrowPrimitiveSets( *pieces[p], pieceStats, _allowUByte );
+			_stats.indexBytesAfter += pieceStats.indexBytesAfter;
+			_stats.numNarrowed += pieceStats.numNarrowed;
+
+			geode.replaceDrawable( geometry, pieces[0].get() );
+			for ( unsigned int p = 1; p < pieces.size(); ++p )
+				geode.addDrawable( pieces[p].get() );
+			++_stats.numSplit;
+			_stats.numPieces += pieces.size();
+		}
+	}
+
+	const IndexNarrowing::Statistics& getStatistics() const { return _stats; }
+
+protected:
+	bool _allowUByte;
+	unsigned int _maxVertices;
+	IndexNarrowing::Statistics _stats;
+};
+
+#endif
@@ -0,0 +1,563 @@
+#ifndef INSTANCED_GROUP_H
+#define INSTANCED_GROUP_H
+
+#include <osg/BufferObject>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Group>
+#include <osg/NodeVisitor>
+#include <osg/Program>
+#include <osg/Shader>
+#include <osg/Transform>
+#include <osg/VertexAttribDivisor>
+#include <osgUtil/CullVisitor>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define INSTANCED_GROUP_SSE
+#endif
+
+//InstancedGroup
+//one model drawn at many places without a transform node per copy. the group keeps the
+//model as its only child and a flat array of instance matrices (and colours, white unless
+//given), with the bounding sphere of every instance in separate x, y, z and radius arrays.
+//
+//in the cull traversal the spheres are tested against the frustum planes four at a time
+//(SSE, scalar elsewhere), the matrices and colours of the visible instances are packed into
+//per-instance vertex attributes, and every geometry of the model is drawn once, instanced
+//over that visible set. the model is flattened for this when it is set: the matrices of
+//transforms inside it are baked into copies of the affected vertices, the state sets along
+//each path merged into one per geometry.
+//
+//the visible set, its attribute arrays and the instanced geometries that draw it belong to
+//the cull, not to the scene graph: every cull visitor keeps its own, one per time the group
+//is culled in a frame, so slave cameras, render to texture and shadow passes each draw what
+//they see, and cull threads running side by side never write to the same objects.
+//
+//	osg::ref_ptr<InstancedGroup> fleet = new InstancedGroup( osgDB::readNodeFile( "cessna.osg" ) );
+//	fleet -> addInstance( osg::Matrix::translate( x, y, 0.0 ), osg::Vec4( 1.0f, 0.5f, 0.5f, 1.0f ) );
+//
+//the shader lights with the material's diffuse colour times the instance colour, textures
+//are not applied. other traversals (update, picking...) see the model once, untransformed.
+
+class InstancedGroup : public osg::Group
+{
+public:
+	enum
+	{
+		//the slots ShapeBatch uses, clear of the ones nvidia aliases with the fixed function arrays
+		ROW0_ATTRIB = 10,
+		ROW1_ATTRIB = 11,
+		ROW2_ATTRIB = 12,
+		COLOR_ATTRIB = 13
+	};
+
+	InstancedGroup( osg::Node* model = 0 )
+		: _revision( 0 ), _numVisible( 0 )
+	{
+		setModel( model );
+	}
+
+	InstancedGroup( const InstancedGroup& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::Group( copy, copyop ), _rows( copy._rows ), _colors( copy._colors ), _revision( 0 ), _numVisible( 0 )
+	{
+		prepare();
+	}
+
+	META_Node( osg, InstancedGroup );
+
+	//replaces the model, instances keep their matrices
+	void setModel( osg::Node* model )
+	{
+		removeChildren( 0, getNumChildren() );
+		if ( model ) addChild( model );
+		prepare();
+	}
+
+	osg::Node* getModel() { return getNumChildren() ? getChild( 0 ) : 0; }
+
+	//call after changing the model's geometry or state
+	void dirtyModel() { prepare(); }
+
+	unsigned int addInstance( const osg::Matrix& matrix, const osg::Vec4& color = osg::Vec4( 1.0f, 1.0f, 1.0f, 1.0f ) )
+	{
+		_rows.resize( _rows.size() + 3 );
+		_colors.push_back( color );
+		unsigned int index = getNumInstances() - 1;
+		setInstanceMatrix( index, matrix );
+		return index;
+	}
+
+	void setInstanceMatrix( unsigned int index, const osg::Matrix& m )
+	{
+		//row j holds what is multiplied with ( x, y, z, 1 ) to get world coordinate j
+		for ( unsigned int j = 0; j < 3; ++j )
+			_rows[3 * index + j].set( m( 0, j ), m( 1, j ), m( 2, j ), m( 3, j ) );
+		updateSphere( index );
+		++_revision;
+		dirtyBound();
+	}
+
+	void setInstanceColor( unsigned int index, const osg::Vec4& color )
+	{
+		_colors[index] = color;
+		++_revision;
+	}
+
+	osg::Matrix getInstanceMatrix( unsigned int index ) const
+	{
+		osg::Matrix m;
+		for ( unsigned int j = 0; j < 3; ++j )
+			for ( unsigned int i = 0; i < 4; ++i )
+				m( i, j ) = _rows[3 * index + j][i];
+		return m;
+	}
+
+	const osg::Vec4& getInstanceColor( unsigned int index ) const { return _colors[index]; }
+
+	unsigned int getNumInstances() const { return _colors.size(); }
+
+	void clearInstances()
+	{
+		_rows.clear();
+		_colors.clear();
+		_x.clear(); _y.clear(); _z.clear(); _r.clear();
+		++_revision;
+		dirtyBound();
+	}
+
+	//instances drawn by the last cull, of whichever camera
+	unsigned int getNumVisible() const
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _cullMutex );
+		return _numVisible;
+	}
+
+	//the union of the instances' spheres
+	virtual osg::BoundingSphere computeBound() const
+	{
+		osg::BoundingBox box;
+		for ( unsigned int i = 0; i < getNumInstances(); ++i )
+		{
+			box.expandBy( osg::Vec3( _x[i] - _r[i], _y[i] - _r[i], _z[i] - _r[i] ) );
+			box.expandBy( osg::Vec3( _x[i] + _r[i], _y[i] + _r[i], _z[i] + _r[i] ) );
+		}
+		return osg::BoundingSphere( box );
+	}
+
+	virtual void traverse( osg::NodeVisitor& nv )
+	{
+		osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>( &nv );
+		if ( !cv )
+		{
+			osg::Group::traverse( nv );
+			return;
+		}
+
+		CullData* cull = getCullData( *cv );
+		cullInstances( *cull, cv -> getCurrentCullingSet().getFrustum().getPlaneList() );
+		if ( !cull -> visible.empty() ) cull -> parts -> accept( nv );
+	}
+
+	//the instanced copies the culls made are not children, their buffers go with the group
+	virtual void resizeGLObjectBuffers( unsigned int maxSize )
+	{
+		osg::Group::resizeGLObjectBuffers( maxSize );
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _cullMutex );
+		for ( std::map<osgUtil::CullVisitor*, CullSlots>::iterator s = _cullSlots.begin(); s != _cullSlots.end(); ++s )
+			for ( unsigned int d = 0; d < s -> second.data.size(); ++d )
+				if ( s -> second.data[d] -> parts.valid() ) s -> second.data[d] -> parts -> resizeGLObjectBuffers( maxSize );
+	}
+
+	virtual void releaseGLObjects( osg::State* state = 0 ) const
+	{
+		osg::Group::releaseGLObjects( state );
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _cullMutex );
+		for ( std::map<osgUtil::CullVisitor*, CullSlots>::const_iterator s = _cullSlots.begin(); s != _cullSlots.end(); ++s )
+			for ( unsigned int d = 0; d < s -> second.data.size(); ++d )
+				if ( s -> second.data[d] -> parts.valid() ) s -> second.data[d] -> parts -> releaseGLObjects( state );
+	}
+
+	//program and attribute divisors, shared by all groups so they sort into one state
+	static osg::StateSet* getInstancingStateSet()
+	{
+		static osg::ref_ptr<osg::StateSet> s_stateSet = createInstancingStateSet();
+		return s_stateSet.get();
+	}
+
+protected:
+	//the per-instance attributes of a visible set, shared by the parts drawing it
+	struct InstanceData : public osg::Referenced
+	{
+		InstanceData()
+		{
+			osg::ref_ptr<osg::VertexBufferObject> vbo = new osg::VertexBufferObject;
+			for ( unsigned int a = 0; a < 4; ++a )
+			{
+				arrays[a] = new osg::Vec4Array;
+				arrays[a] -> setVertexBufferObject( vbo.get() );
+			}
+		}
+
+		osg::ref_ptr<osg::Vec4Array> arrays[4];
+		osg::BoundingBox bound;
+	};
+
+	//a geometry of the model, drawn instanced; its bound is that of the visible instances,
+	//so the cull visitor computes near and far from where the copies actually are
+	class InstancedGeometry : public osg::Geometry
+	{
+	public:
+		InstancedGeometry() {}
+
+		InstancedGeometry( const osg::Geometry& source, InstanceData* data )
+			: osg::Geometry( source, osg::CopyOp::SHALLOW_COPY ), _data( data )
+		{
+			setUseDisplayList( false );
+			setUseVertexBufferObjects( true );
+			//the instance arrays change in cull, the next frame must wait until they are drawn
+			setDataVariance( osg::Object::DYNAMIC );
+
+			//the instance count lives on the primitive set, the indices themselves stay shared
+			for ( unsigned int p = 0; p < getNumPrimitiveSets(); ++p )
+				setPrimitiveSet( p, static_cast<osg::PrimitiveSet*>( getPrimitiveSet( p ) -> clone( osg::CopyOp::SHALLOW_COPY ) ) );
+			for ( unsigned int a = 0; a < 4; ++a )
+				setVertexAttribArray( ROW0_ATTRIB + a, data -> arrays[a].get(), osg::Array::BIND_PER_VERTEX );
+		}
+
+		InstancedGeometry( const InstancedGeometry& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+			: osg::Geometry( copy, copyop ), _data( copy._data ) {}
+
+		META_Object( osg, InstancedGeometry );
+
+		void setNumInstances( unsigned int n )
+		{
+			for ( unsigned int p = 0; p < getNumPrimitiveSets(); ++p )
+				getPrimitiveSet( p ) -> setNumInstances( n );
+			dirtyBound();
+		}
+
+		virtual osg::BoundingBox computeBoundingBox() const
+		{
+			return _data.valid() ? _data -> bound : osg::BoundingBox();
+		}
+
+	protected:
+		osg::ref_ptr<InstanceData> _data;
+	};
+
+	//what one cull draws: its visible set and instanced copies of the parts over it
+	struct CullData : public osg::Referenced
+	{
+		CullData() : data( new InstanceData ), revision( 0 ) {}
+
+		osg::ref_ptr<InstanceData> data;
+		osg::ref_ptr<osg::Group> parts;
+		std::vector<unsigned int> visible, lastVisible;
+		unsigned int revision;		//of the instances the arrays were filled from
+		osg::ref_ptr<osg::Group> model;	//the flattened parts the copies were made of
+	};
+
+	//the cull data a cull visitor has used this frame, taken in the order it culls the group
+	struct CullSlots
+	{
+		CullSlots() : frameNumber( ~0u ), used( 0 ) {}
+
+		unsigned int frameNumber;
+		unsigned int used;
+		std::vector< osg::ref_ptr<CullData> > data;
+	};
+
+	//every geometry of the model with the matrix and the state sets above it
+	class PartCollector : public osg::NodeVisitor
+	{
+	public:
+		PartCollector( osg::Group* parts )
+			: osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), _parts( parts )
+		{
+			_matrices.push_back( osg::Matrix::identity() );
+		}
+
+		virtual void apply( osg::Node& node )
+		{
+			pushStateSet( node.getStateSet() );
+			traverse( node );
+			popStateSet( node.getStateSet() );
+		}
+
+		virtual void apply( osg::Transform& transform )
+		{
+			osg::Matrix matrix = _matrices.back();
+			transform.computeLocalToWorldMatrix( matrix, this );
+			_matrices.push_back( matrix );
+			apply( static_cast<osg::Node&>( transform ) );
+			_matrices.pop_back();
+		}
+
+		virtual void apply( osg::Geode& geode )
+		{
+			pushStateSet( geode.getStateSet() );
+			for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+				addPart( *geode.getDrawable( i ) );
+			popStateSet( geode.getStateSet() );
+		}
+
+		//drawables straight under a group
+		virtual void apply( osg::Drawable& drawable ) { addPart( drawable ); }
+
+	protected:
+		void addPart( osg::Drawable& drawable )
+		{
+			osg::Geometry* geometry = drawable.asGeometry();
+			if ( !geometry || !dynamic_cast<osg::Vec3Array*>( geometry -> getVertexArray() ) ) return;
+
+			osg::ref_ptr<osg::Geometry> part = new osg::Geometry( *geometry, osg::CopyOp::SHALLOW_COPY );
+			if ( !_matrices.back().isIdentity() ) bake( *part, _matrices.back() );
+
+			osg::ref_ptr<osg::StateSet> stateSet = new osg::StateSet;
+			for ( unsigned int s = 0; s < _stateSets.size(); ++s )
+				stateSet -> merge( *_stateSets[s] );
+			if ( geometry -> getStateSet() ) stateSet -> merge( *geometry -> getStateSet() );
+			part -> setStateSet( stateSet.get() );
+			_parts -> addChild( part.get() );
+		}
+
+		void pushStateSet( osg::StateSet* stateSet ) { if ( stateSet ) _stateSets.push_back( stateSet ); }
+		void popStateSet( osg::StateSet* stateSet ) { if ( stateSet ) _stateSets.pop_back(); }
+
+		//own copies of the vertices and normals, moved to where the model has them
+		static void bake( osg::Geometry& geometry, const osg::Matrix& matrix )
+		{
+			const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>( geometry.getVertexArray() );
+			osg::ref_ptr<osg::Vec3Array> moved = new osg::Vec3Array( vertices -> size() );
+			for ( unsigned int v = 0; v < vertices -> size(); ++v )
+				( *moved )[v] = ( *vertices )[v] * matrix;
+			geometry.setVertexArray( moved.get() );
+
+			const osg::Vec3Array* normals = dynamic_cast<const osg::Vec3Array*>( geometry.getNormalArray() );
+			if ( normals )
+			{
+				osg::Matrix inverse = osg::Matrix::inverse( matrix );
+				osg::ref_ptr<osg::Vec3Array> turned = new osg::Vec3Array( normals -> size() );
+				for ( unsigned int n = 0; n < normals -> size(); ++n )
+				{
+					( *turned )[n] = osg::Matrix::transform3x3( inverse, ( *normals )[n] );
+					( *turned )[n].normalize();
+				}
+				geometry.setNormalArray( turned.get(), normals -> getBinding() );
+			}
+		}
+
+		osg::Group* _parts;
+		std::vector<osg::Matrix> _matrices;
+		std::vector<osg::StateSet*> _stateSets;
+	};
+
+	virtual ~InstancedGroup() {}
+
+	void prepare()
+	{
+		_parts = new osg::Group;
+		if ( getModel() )
+		{
+			PartCollector collector( _parts.get() );
+			getModel() -> accept( collector );
+		}
+		for ( unsigned int i = 0; i < getNumInstances(); ++i )
+			updateSphere( i );
+		++_revision;
+		dirtyBound();
+	}
+
+	//the next cull data of this cull visitor in this frame, the same ones again every frame
+	//as long as the scene is culled in the same order
+	CullData* getCullData( osgUtil::CullVisitor& cv )
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _cullMutex );
+		CullSlots& slots = _cullSlots[&cv];
+		unsigned int frameNumber = cv.getFrameStamp() ? cv.getFrameStamp() -> getFrameNumber() : ~0u;
+		if ( frameNumber != slots.frameNumber || frameNumber == ~0u )
+		{
+			slots.frameNumber = frameNumber;
+			slots.used = 0;
+		}
+		if ( slots.used == slots.data.size() ) slots.data.push_back( new CullData );
+		return slots.data[slots.used++].get();
+	}
+
+	//the model's bounding sphere under instance i's matrix
+	void updateSphere( unsigned int i )
+	{
+		unsigned int padded = ( getNumInstances() + 3 ) & ~3u;
+		if ( _x.size() != padded )
+		{
+			//padding can never be visible
+			_x.resize( padded, 0.0f ); _y.resize( padded, 0.0f ); _z.resize( padded, 0.0f ); _r.resize( padded );
+			for ( unsigned int p = getNumInstances(); p < padded; ++p ) _r[p] = -1e30f;
+		}
+
+		osg::BoundingSphere model = getNumChildren() ? getChild( 0 ) -> getBound() : osg::BoundingSphere();
+		if ( !model.valid() ) model.set( osg::Vec3(), 0.0f );
+		const osg::Vec4* rows = &_rows[3 * i];
+		osg::Vec4 center( model.center(), 1.0f );
+		_x[i] = rows[0] * center;
+		_y[i] = rows[1] * center;
+		_z[i] = rows[2] * center;
+
+		//the longest axis the matrix stretches the model along
+		float scale = 0.0f;
+		for ( unsigned int k = 0; k < 3; ++k )
+			scale = std::max( scale, osg::Vec3( rows[0][k], rows[1][k], rows[2][k] ).length2() );
+		_r[i] = model.radius() * sqrtf( scale );
+	}
+
+	void cullInstances( CullData& cull, const osg::Polytope::PlaneList& planes )
+	{
+		unsigned int numPlanes = std::min<unsigned int>( planes.size(), 8 );
+		std::vector<unsigned int>& visible = cull.visible;
+		visible.clear();
+
+#ifdef INSTANCED_GROUP_SSE
+		__m128 a[8], b[8], c[8], d[8];
+		for ( unsigned int p = 0; p < numPlanes; ++p )
+		{
+			a[p] = _mm_set1_ps( planes[p][0] );
+			b[p] = _mm_set1_ps( planes[p][1] );
+			c[p] = _mm_set1_ps( planes[p][2] );
+			d[p] = _mm_set1_ps( planes[p][3] );
+		}
+		const __m128 zero = _mm_setzero_ps();
+		for ( unsigned int i = 0; i < _x.size(); i += 4 )
+		{
+			__m128 x = _mm_loadu_ps( &_x[i] ), y = _mm_loadu_ps( &_y[i] ), z = _mm_loadu_ps( &_z[i] ), r = _mm_loadu_ps( &_r[i] );
+			//inside while the signed distance to every plane is at least -radius
+			__m128 inside = _mm_cmpge_ps( r, zero );
+			for ( unsigned int p = 0; p < numPlanes; ++p )
+			{
+				__m128 distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps( a[p], x ), _mm_mul_ps( b[p], y ) ),
+				                              _mm_add_ps( _mm_mul_ps( c[p], z ), _mm_add_ps( d[p], r ) ) );
+				inside = _mm_and_ps( inside, _mm_cmpge_ps( distance, zero ) );
+			}
+			int mask = _mm_movemask_ps( inside );
+			for ( unsigned int k = 0; mask; ++k, mask >>= 1 )
+				if ( mask & 1 ) visible.push_back( i + k );
+		}
+#else
+		for ( unsigned int i = 0; i < getNumInstances(); ++i )
+		{
+			bool inside = true;
+			for ( unsigned int p = 0; p < numPlanes && inside; ++p )
+				inside = planes[p][0] * _x[i] + planes[p][1] * _y[i] + planes[p][2] * _z[i] + planes[p][3] + _r[i] >= 0.0f;
+			if ( inside ) visible.push_back( i );
+		}
+#endif
+
+		unsigned int numVisible = visible.size();
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _cullMutex );
+			_numVisible = numVisible;
+		}
+
+		//the model changed: new instanced copies of its parts
+		bool newParts = cull.model.get() != _parts.get();
+		if ( newParts )
+		{
+			cull.model = _parts;
+			cull.parts = new osg::Group;
+			cull.parts -> setStateSet( getInstancingStateSet() );
+			for ( unsigned int p = 0; p < _parts -> getNumChildren(); ++p )
+				cull.parts -> addChild( new InstancedGeometry( *_parts -> getChild( p ) -> asGeometry(), cull.data.get() ) );
+		}
+
+		//an unchanged set (the camera did not move) keeps the uploaded arrays
+		if ( !newParts && cull.revision == _revision && visible == cull.lastVisible ) return;
+		cull.revision = _revision;
+		cull.lastVisible = visible;
+
+		InstanceData& data = *cull.data;
+		data.bound.init();
+		for ( unsigned int a = 0; a < 4; ++a )
+			data.arrays[a] -> resize( numVisible );
+		for ( unsigned int k = 0; k < numVisible; ++k )
+		{
+			unsigned int i = visible[k];
+			for ( unsigned int j = 0; j < 3; ++j )
+				( *data.arrays[j] )[k] = _rows[3 * i + j];
+			( *data.arrays[3] )[k] = _colors[i];
+			data.bound.expandBy( osg::Vec3( _x[i] - _r[i], _y[i] - _r[i], _z[i] - _r[i] ) );
+			data.bound.expandBy( osg::Vec3( _x[i] + _r[i], _y[i] + _r[i], _z[i] + _r[i] ) );
+		}
+		for ( unsigned int a = 0; a < 4; ++a )
+			data.arrays[a] -> dirty();
+		for ( unsigned int p = 0; p < cull.parts -> getNumChildren(); ++p )
+			static_cast<InstancedGeometry*>( cull.parts -> getChild( p ) ) -> setNumInstances( numVisible );
+	}
+
+	static osg::StateSet* createInstancingStateSet()
+	{
+		static const char* vertexSource =
+			"#version 120\n"
+			"attribute vec4 instanceRow0;\n"
+			"attribute vec4 instanceRow1;\n"
+			"attribute vec4 instanceRow2;\n"
+			"attribute vec4 instanceColor;\n"
+			"varying vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	vec4 v = vec4( gl_Vertex.xyz, 1.0 );\n"
+			"	vec4 world = vec4( dot( instanceRow0, v ), dot( instanceRow1, v ), dot( instanceRow2, v ), 1.0 );\n"
+			"	vec3 scale2 = instanceRow0.xyz * instanceRow0.xyz + instanceRow1.xyz * instanceRow1.xyz + instanceRow2.xyz * instanceRow2.xyz;\n"
+			"	vec3 n = gl_Normal / scale2;\n"
+			"	n = vec3( dot( instanceRow0.xyz, n ), dot( instanceRow1.xyz, n ), dot( instanceRow2.xyz, n ) );\n"
+			"	vec3 eyeNormal = normalize( gl_NormalMatrix * n );\n"
+			//two-sided headlight, models often have faces wound either way
+			"	float diffuse = abs( eyeNormal.z );\n"
+			"	vec4 base = gl_FrontMaterial.diffuse * instanceColor;\n"
+			"	color = vec4( base.rgb * ( 0.25 + 0.75 * diffuse ), base.a );\n"
+			"	gl_Position = gl_ModelViewProjectionMatrix * world;\n"
+			"}\n";
+
+		static const char* fragmentSource =
+			"#version 120\n"
+			"varying vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	gl_FragColor = color;\n"
+			"}\n";
+
+		osg::ref_ptr<osg::Program> program = new osg::Program;
+		program -> setName( "InstancedGroup" );
+		program -> addShader( new osg::Shader( osg::Shader::VERTEX, vertexSource ) );
+		program -> addShader( new osg::Shader( osg::Shader::FRAGMENT, fragmentSource ) );
+		program -> addBindAttribLocation( "instanceRow0", ROW0_ATTRIB );
+		program -> addBindAttribLocation( "instanceRow1", ROW1_ATTRIB );
+		program -> addBindAttribLocation( "instanceRow2", ROW2_ATTRIB );
+		program -> addBindAttribLocation( "instanceColor", COLOR_ATTRIB );
+
+		osg::ref_ptr<osg::StateSet> stateSet = new osg::StateSet;
+		stateSet -> setAttributeAndModes( program.get() );
+		for ( unsigned int i = ROW0_ATTRIB; i <= COLOR_ATTRIB; ++i )
+			stateSet -> setAttribute( new osg::VertexAttribDivisor( i, 1 ) );
+		return stateSet.release();
+	}
+
+	std::vector<osg::Vec4> _rows;		//three per instance
+	std::vector<osg::Vec4> _colors;
+	std::vector<float> _x, _y, _z, _r;	//instance spheres, padded to a multiple of four
+
+	osg::ref_ptr<osg::Group> _parts;		//the model flattened, one geometry per part
+	unsigned int _revision;				//bumped by every change the cull data must follow
+
+	mutable OpenThreads::Mutex _cullMutex;
+	std::map<osgUtil::CullVisitor*, CullSlots> _cullSlots;
+	unsigned int _numVisible;
+};
+
+#endif
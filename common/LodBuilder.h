@@ -0,0 +1,487 @@
+#ifndef LOD_BUILDER_H
+#define LOD_BUILDER_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/LOD>
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+#include <osg/TriangleIndexFunctor>
+#include <osg/ValueObject>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <osgUtil/Simplifier>
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IndexNarrowing.h"
+#include "MemoryCounter.h"
+#include "ParallelFor.h"
+#include "SceneCache.h"
+#include "TriangleExtractor.h"
+
+//LodBuilder
+//the levels of an osg::LOD made offline, once per model version, instead of at every start.
+//
+//a level is asked for by the geometric error it may have, not by a vertex ratio: the
+//simplifier collapses edges until the next collapse would move the surface further than
+//that error (the Simplifier's own point error, in model units). errors are given as
+//fractions of the model's radius, and every level is shown from the distance at which its
+//error covers pixelError pixels on the screen. a level that hardly removes triangles
+//compared to the one before it is dropped. all geometries of all levels are simplified in
+//parallel, each by its own Simplifier. the error of every level is kept on it as the user
+//value "geometricError".
+//
+//the levels share the model's vertex arrays, state sets and textures: a level
+//is a copy of the nodes and geometries only, and each of its geometries owns nothing but an
+//index list into the original arrays. the simplifier works on a private copy of a geometry,
+//every vertex it produces is then snapped to the nearest original vertex (on a tie, the one
+//with the closest texture coordinate and normal) and the triangles are re-indexed, dropping
+//those that snapping collapsed. snapping moves the surface by up to the distance to that
+//vertex, which on thin parts can be the thickness of the part, so the largest such distance
+//of a level is added to its error. geometries whose arrays
+//are not all per vertex or overall get their own simplified arrays, as before. a level that
+//is to be edited later must be given its own data first: detachShared() is the copy on write.
+//
+//readLODFileCached() stores the finished LOD as .osgb next to the model, named by a hash of
+//the model's content and the options, and later runs read that back without simplifying
+//anything. where the model's directory is not writable the cache directory of SceneCache.h
+//is used.
+//
+//	osg::ref_ptr<osg::LOD> lod = readLODFileCached( "cessna.osg" );
+
+namespace LodBuilder
+{
+	struct Options
+	{
+		Options()
+			: pixelError( 1.0 ), fovy( 30.0 ), viewportHeight( 1080.0 ), minimumRatio( 0.01 ), maximumKept( 0.8 ), numThreads( 0 ),
+			  shareVertices( true )
+		{
+			errors.push_back( 0.002 );
+			errors.push_back( 0.01 );
+			errors.push_back( 0.05 );
+		}
+
+		std::vector<double> errors;	//allowed error of each simplified level, fraction of the radius, ascending
+		double pixelError;	//a level is shown once its error is this many pixels or less
+		double fovy;	//degrees, vertical, of the view the distances are computed for
+		double viewportHeight;	//pixels
+		double minimumRatio;	//the simplifier never keeps fewer than this fraction of the vertices
+		double maximumKept;	//a level keeping more of the previous level's triangles than this is dropped
+		unsigned int numThreads;	//0: one per core
+		bool shareVertices;	//false: every level owns its simplified arrays
+
+		//everything the levels depend on besides the model
+		std::string key() const
+		{
+			std::ostringstream key;
+			key.precision( 17 );
+			for ( unsigned int i = 0; i < errors.size(); ++i ) key << errors[i] << ",";
+			key << pixelError << "," << fovy << "," << viewportHeight << "," << minimumRatio << "," << maximumKept << "," << shareVertices;
+			//levels cached before snapping counted towards their error are built again
+			key << ",snap";
+			return key.str();
+		}
+	};
+
+	//every geometry below a node once, however often it is shared
+	class GeometryCollector : public osg::NodeVisitor
+	{
+	public:
+		GeometryCollector() : osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ) {}
+
+		virtual void apply( osg::Geode& geode )
+		{
+			for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+			{
+				osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+				if ( geometry && _seen.insert( geometry ).second ) geometries.push_back( geometry );
+			}
+			traverse( geode );
+		}
+
+		std::vector<osg::Geometry*> geometries;
+
+	protected:
+		std::set<osg::Geometry*> _seen;
+	};
+
+	inline unsigned long long countTriangles( osg::Node* node )
+	{
+		TriangleExtractor extractor;
+		extractor.addScene( *node, false );
+		return extractor.getNumTriangles();
+	}
+
+	//true if every array of the geometry is indexed like its vertices, or not at all
+	inline bool canShare( const osg::Geometry& geometry )
+	{
+		if ( !dynamic_cast<const osg::Vec3Array*>( geometry.getVertexArray() ) ) return false;
+		osg::Geometry::ArrayList arrays;
+		geometry.getArrayList( arrays );
+		for ( unsigned int i = 0; i < arrays.size(); ++i )
+		{
+			osg::Array::Binding binding = arrays[i] -> getBinding();
+			if ( arrays[i].get() != geometry.getVertexArray() && binding != osg::Array::BIND_PER_VERTEX && binding != osg::Array::BIND_OVERALL )
+				return false;
+		}
+		return true;
+	}
+
+	//nearest original vertex to a point, through a uniform grid over the original positions
+	class VertexSnapper
+	{
+	public:
+		VertexSnapper( const osg::Vec3Array& vertices, const osg::Vec3Array* normals, const osg::Vec2Array* texCoords )
+			: _vertices( vertices ), _normals( normals ), _texCoords( texCoords )
+		{
+			osg::BoundingBox box;
+			for ( unsigned int i = 0; i < vertices.size(); ++i ) box.expandBy( vertices[i] );
+			float diagonal = vertices.empty() ? 1.0f : ( box._max - box._min ).length();
+			_cellSize = std::max( diagonal / std::max( std::cbrt( (float)vertices.size() ), 1.0f ), 1e-6f );
+			_maxRing = (int)( diagonal / _cellSize ) + 2;
+			for ( unsigned int i = 0; i < vertices.size(); ++i )
+			{
+				int x, y, z;
+				cellOf( vertices[i], x, y, z );
+				_cells[key( x, y, z )].push_back( i );
+			}
+		}
+
+		//normal and texCoord (may be 0) break ties between vertices at the same place
+		unsigned int snap( const osg::Vec3& p, const osg::Vec3* normal, const osg::Vec2* texCoord ) const
+		{
+			int cx, cy, cz;
+			cellOf( p, cx, cy, cz );
+			float best = FLT_MAX;
+			std::vector<unsigned int> ties;
+			for ( int r = 0; r <= _maxRing; ++r )
+			{
+				for ( int dx = -r; dx <= r; ++dx )
+				for ( int dy = -r; dy <= r; ++dy )
+				for ( int dz = -r; dz <= r; ++dz )
+				{
+					if ( std::max( std::abs( dx ), std::max( std::abs( dy ), std::abs( dz ) ) ) != r ) continue;
+					std::unordered_map<unsigned long long, std::vector<unsigned int> >::const_iterator cell = _cells.find( key( cx + dx, cy + dy, cz + dz ) );
+					if ( cell == _cells.end() ) continue;
+					for ( unsigned int i = 0; i < cell -> second.size(); ++i )
+					{
+						unsigned int v = cell -> second[i];
+						float d = ( _vertices[v] - p ).length2();
+						if ( d < best * ( 1.0f - 1e-6f ) - 1e-12f ) ties.clear();
+						if ( d <= best * ( 1.0f + 1e-6f ) + 1e-12f ) ties.push_back( v );
+						best = std::min( best, d );
+					}
+				}
+				//everything outside the searched block is at least r cells away
+				if ( !ties.empty() && best <= ( r * _cellSize ) * ( r * _cellSize ) ) break;
+			}
+			return ties.size() == 1 ? ties[0] : closestAttributes( ties, normal, texCoord );
+		}
+
+	protected:
+		unsigned int closestAttributes( const std::vector<unsigned int>& ties, const osg::Vec3* normal, const osg::Vec2* texCoord ) const
+		{
+			unsigned int best = ties[0];
+			float bestScore = FLT_MAX;
+			for ( unsigned int i = 0; i < ties.size(); ++i )
+			{
+				float score = 0.0f;
+				if ( texCoord && _texCoords ) score += ( ( *_texCoords )[ties[i]] - *texCoord ).length2();
+				if ( normal && _normals ) score += 1.0f - ( *_normals )[ties[i]] * *normal;
+				if ( score < bestScore )
+				{
+					bestScore = score;
+					best = ties[i];
+				}
+			}
+			return best;
+		}
+
+		void cellOf( const osg::Vec3& p, int& x, int& y, int& z ) const
+		{
+			x = (int)std::floor( p.x() / _cellSize );
+			y = (int)std::floor( p.y() / _cellSize );
+			z = (int)std::floor( p.z() / _cellSize );
+		}
+
+		static unsigned long long key( int x, int y, int z )
+		{
+			return ( (unsigned long long)( x & 0x1fffff ) << 42 ) | ( (unsigned long long)( y & 0x1fffff ) << 21 ) | (unsigned long long)( z & 0x1fffff );
+		}
+
+		const osg::Vec3Array& _vertices;
+		const osg::Vec3Array* _normals;
+		const osg::Vec2Array* _texCoords;
+		float _cellSize;
+		int _maxRing;
+		std::unordered_map<unsigned long long, std::vector<unsigned int> > _cells;
+	};
+
+	struct TriangleCollector
+	{
+		void operator()( unsigned int a, unsigned int b, unsigned int c )
+		{
+			corners -> push_back( a );
+			corners -> push_back( b );
+			corners -> push_back( c );
+		}
+		std::vector<unsigned int>* corners;
+	};
+
+	//simplify a geometry that shares its arrays: only its primitive sets are replaced, by one
+	//triangle list into the original vertices. returns how far snapping moved a vertex of the
+	//triangles kept, at most; the simplifier does not tell which vertices a collapse merged,
+	//so the snap cannot be limited to those
+	inline double simplifyShared( osg::Geometry& geometry, double ratio, double maximumError )
+	{
+		osg::ref_ptr<osg::Geometry> work = new osg::Geometry( geometry, osg::CopyOp::DEEP_COPY_ARRAYS | osg::CopyOp::DEEP_COPY_PRIMITIVES );
+		osgUtil::Simplifier simplifier( ratio, maximumError );
+		simplifier.simplify( *work );
+
+		const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>( geometry.getVertexArray() );
+		const osg::Vec3Array* normals = dynamic_cast<const osg::Vec3Array*>( geometry.getNormalArray() );
+		const osg::Vec2Array* texCoords = dynamic_cast<const osg::Vec2Array*>( geometry.getTexCoordArray( 0 ) );
+		if ( normals && normals -> size() != vertices -> size() ) normals = 0;
+		if ( texCoords && texCoords -> size() != vertices -> size() ) texCoords = 0;
+
+		const osg::Vec3Array* workVertices = dynamic_cast<const osg::Vec3Array*>( work -> getVertexArray() );
+		const osg::Vec3Array* workNormals = normals ? dynamic_cast<const osg::Vec3Array*>( work -> getNormalArray() ) : 0;
+		const osg::Vec2Array* workTexCoords = texCoords ? dynamic_cast<const osg::Vec2Array*>( work -> getTexCoordArray( 0 ) ) : 0;
+		unsigned int numWork = workVertices ? workVertices -> size() : 0;
+		if ( workNormals && workNormals -> size() != numWork ) workNormals = 0;
+		if ( workTexCoords && workTexCoords -> size() != numWork ) workTexCoords = 0;
+
+		VertexSnapper snapper( *vertices, normals, texCoords );
+		std::vector<unsigned int> remap( numWork );
+		for ( unsigned int i = 0; i < numWork; ++i )
+			remap[i] = snapper.snap( ( *workVertices )[i], workNormals ? &( *workNormals )[i] : 0, workTexCoords ? &( *workTexCoords )[i] : 0 );
+
+		std::vector<unsigned int> corners;
+		osg::TriangleIndexFunctor<TriangleCollector> collector;
+		collector.corners = &corners;
+		work -> accept( collector );
+
+		osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt( GL_TRIANGLES );
+		triangles -> reserve( corners.size() );
+		float snapped = 0.0f;
+		for ( unsigned int t = 0; t + 2 < corners.size(); t += 3 )
+		{
+			unsigned int a = remap[corners[t]], b = remap[corners[t + 1]], c = remap[corners[t + 2]];
+			if ( a == b || b == c || a == c ) continue;
+			triangles -> push_back( a );
+			triangles -> push_back( b );
+			triangles -> push_back( c );
+			for ( unsigned int k = 0; k < 3; ++k )
+				snapped = std::max( snapped, ( ( *workVertices )[corners[t + k]] - ( *vertices )[remap[corners[t + k]]] ).length2() );
+		}
+
+		geometry.removePrimitiveSet( 0, geometry.getNumPrimitiveSets() );
+		if ( triangles -> empty() ) return 0.0;
+		osg::ref_ptr<osg::DrawElements> narrow = IndexNarrowing::narrow( *triangles );
+		geometry.addPrimitiveSet( narrow.valid() ? narrow.get() : triangles.get() );
+		return std::sqrt( snapped );
+	}
+
+	//copy on write: gives the geometry its own copy of every array, primitive set and (unless
+	//state is false) state set it still shares with another level, so it can be edited without
+	//touching the others
+	inline void detachShared( osg::Geometry& geometry, bool state = true )
+	{
+		osg::CopyOp copyop( osg::CopyOp::DEEP_COPY_ARRAYS );
+		if ( geometry.getVertexArray() && geometry.getVertexArray() -> referenceCount() > 1 )
+			geometry.setVertexArray( copyop( geometry.getVertexArray() ) );
+		if ( geometry.getNormalArray() && geometry.getNormalArray() -> referenceCount() > 1 )
+			geometry.setNormalArray( copyop( geometry.getNormalArray() ) );
+		if ( geometry.getColorArray() && geometry.getColorArray() -> referenceCount() > 1 )
+			geometry.setColorArray( copyop( geometry.getColorArray() ) );
+		if ( geometry.getSecondaryColorArray() && geometry.getSecondaryColorArray() -> referenceCount() > 1 )
+			geometry.setSecondaryColorArray( copyop( geometry.getSecondaryColorArray() ) );
+		if ( geometry.getFogCoordArray() && geometry.getFogCoordArray() -> referenceCount() > 1 )
+			geometry.setFogCoordArray( copyop( geometry.getFogCoordArray() ) );
+		for ( unsigned int i = 0; i < geometry.getNumTexCoordArrays(); ++i )
+			if ( geometry.getTexCoordArray( i ) && geometry.getTexCoordArray( i ) -> referenceCount() > 1 )
+				geometry.setTexCoordArray( i, copyop( geometry.getTexCoordArray( i ) ) );
+		for ( unsigned int i = 0; i < geometry.getNumVertexAttribArrays(); ++i )
+			if ( geometry.getVertexAttribArray( i ) && geometry.getVertexAttribArray( i ) -> referenceCount() > 1 )
+				geometry.setVertexAttribArray( i, copyop( geometry.getVertexAttribArray( i ) ) );
+
+		osg::CopyOp primitives( osg::CopyOp::DEEP_COPY_PRIMITIVES );
+		for ( unsigned int p = 0; p < geometry.getNumPrimitiveSets(); ++p )
+			if ( geometry.getPrimitiveSet( p ) -> referenceCount() > 1 )
+				geometry.setPrimitiveSet( p, primitives( geometry.getPrimitiveSet( p ) ) );
+
+		if ( state && geometry.getStateSet() && geometry.getStateSet() -> referenceCount() > 1 )
+			geometry.setStateSet( osg::clone( geometry.getStateSet(), osg::CopyOp::DEEP_COPY_STATESETS ) );
+		geometry.dirtyBound();
+	}
+
+	//bytes of the vertex arrays, primitive sets and texture images below a node
+	inline unsigned long long countBytes( osg::Node* node )
+	{
+		MemoryCounter counter;
+		node -> accept( counter );
+		return counter.getTotalBytes();
+	}
+
+	//eye distance from which an error in model units covers at most options.pixelError pixels
+	inline double switchDistance( double error, const Options& options )
+	{
+		double pixelsPerUnitAtOne = options.viewportHeight / ( 2.0 * std::tan( osg::DegreesToRadians( options.fovy ) * 0.5 ) );
+		return error * pixelsPerUnitAtOne / std::max( options.pixelError, 1e-6 );
+	}
+
+	//an LOD with the model itself as finest level and its simplified copies behind it
+	inline osg::LOD* build( osg::Node* model, const Options& options = Options() )
+	{
+		double radius = model -> getBound().radius();
+
+		//one copy of the nodes and geometries per level, sharing arrays and state with the model;
+		//every geometry of every copy is one task
+		std::vector< osg::ref_ptr<osg::Node> > copies;
+		std::vector<osg::Geometry*> geometries;
+		std::vector<double> maximumErrors;
+		std::vector<unsigned int> firstGeometry;	//of each level, and the end of the last
+		for ( unsigned int l = 0; l < options.errors.size(); ++l )
+		{
+			osg::ref_ptr<osg::Node> copy = static_cast<osg::Node*>( model -> clone( osg::CopyOp::DEEP_COPY_NODES | osg::CopyOp::DEEP_COPY_DRAWABLES ) );
+			GeometryCollector collector;
+			copy -> accept( collector );
+			firstGeometry.push_back( geometries.size() );
+			geometries.insert( geometries.end(), collector.geometries.begin(), collector.geometries.end() );
+			maximumErrors.resize( geometries.size(), options.errors[l] * radius );
+			copies.push_back( copy );
+		}
+		firstGeometry.push_back( geometries.size() );
+
+		std::vector<double> snapErrors( geometries.size(), 0.0 );
+		parallelFor( geometries.size(), [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int i = begin; i < end; ++i )
+			{
+				//the ratio is only a floor, the error is what stops the collapses
+				if ( options.shareVertices && canShare( *geometries[i] ) )
+				{
+					snapErrors[i] = simplifyShared( *geometries[i], options.minimumRatio, maximumErrors[i] );
+					continue;
+				}
+				detachShared( *geometries[i], false );
+				osgUtil::Simplifier simplifier( options.minimumRatio, maximumErrors[i] );
+				simplifier.simplify( *geometries[i] );
+			}
+		}, options.numThreads, 1 );
+
+		osg::ref_ptr<osg::LOD> lod = new osg::LOD;
+		model -> setUserValue( "geometricError", 0.0 );
+		lod -> addChild( model );
+		std::vector<double> levelErrors( 1, 0.0 );
+		unsigned long long previous = countTriangles( model );
+		for ( unsigned int l = 0; l < copies.size(); ++l )
+		{
+			unsigned long long triangles = countTriangles( copies[l].get() );
+			if ( triangles == 0 || triangles > options.maximumKept * previous ) continue;
+			//the simplifier's error plus how far snapping moved it; never below the finer level's
+			double snapped = 0.0;
+			for ( unsigned int i = firstGeometry[l]; i < firstGeometry[l + 1]; ++i )
+				snapped = std::max( snapped, snapErrors[i] );
+			double error = std::max( options.errors[l] * radius + snapped, levelErrors.back() );
+			copies[l] -> setUserValue( "geometricError", error );
+			lod -> addChild( copies[l].get() );
+			levelErrors.push_back( error );
+			previous = triangles;
+		}
+
+		//each level from where its error is small enough to where the next one's is
+		for ( unsigned int l = 0; l < levelErrors.size(); ++l )
+		{
+			float minRange = l == 0 ? 0.0f : switchDistance( levelErrors[l], options );
+			float maxRange = l + 1 < levelErrors.size() ? switchDistance( levelErrors[l + 1], options ) : FLT_MAX;
+			lod -> setRange( l, minRange, maxRange );
+		}
+		return lod.release();
+	}
+
+	//where the levels of source are cached: next to it, or in the cache directory
+	inline std::string getCacheFileName( const std::string& source, const Options& options, bool nextToSource )
+	{
+		unsigned long long hash;
+		if ( !SceneCache::hashFile( source, hash ) ) return std::string();
+		std::string key = options.key();
+		hash = SceneCache::hashBytes( key.c_str(), key.size(), hash );
+
+		char name[40];
+		std::snprintf( name, sizeof(name), ".lod-%016llx.osgb", hash );
+		std::string directory = nextToSource ? osgDB::getFilePath( source ) : SceneCache::getCacheDirectory();
+		return ( directory.empty() ? std::string() : directory + "/" ) + osgDB::getStrippedName( source ) + name;
+	}
+
+	//write under a private name and rename, so a reader never sees a half-written file
+	inline bool writeCacheFile( osg::Node& node, const std::string& cacheFile, const osgDB::Options* options = 0 )
+	{
+		char suffix[32];
+		std::snprintf( suffix, sizeof(suffix), ".%llx.osgb", (unsigned long long)OpenThreads::Thread::CurrentThreadId() );
+		std::string tempFile = osgDB::getNameLessExtension( cacheFile ) + suffix;
+		if ( osgDB::writeNodeFile( node, tempFile, options ) && std::rename( tempFile.c_str(), cacheFile.c_str() ) == 0 ) return true;
+		std::remove( tempFile.c_str() );
+		return false;
+	}
+}
+
+inline osg::LOD* readLODFileCached( const std::string& filename, const LodBuilder::Options& options = LodBuilder::Options() )
+{
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+
+	std::string source = osgDB::findDataFile( filename );
+	if ( source.empty() )
+	{
+		OSG_WARN << "readLODFileCached: cannot find " << filename << std::endl;
+		return 0;
+	}
+
+	std::string nextToSource = LodBuilder::getCacheFileName( source, options, true );
+	std::string inCacheDirectory = LodBuilder::getCacheFileName( source, options, false );
+
+	//the cache may sit in the cache directory: images go into it, references resolve next to source
+	osg::ref_ptr<osgDB::Options> fileOptions = SceneCache::createOptions( source );
+	osg::ref_ptr<osg::LOD> lod;
+	std::string cacheFile;
+	if ( osgDB::fileExists( nextToSource ) ) cacheFile = nextToSource;
+	else if ( osgDB::fileExists( inCacheDirectory ) ) cacheFile = inCacheDirectory;
+	if ( !cacheFile.empty() ) lod = dynamic_cast<osg::LOD*>( osgDB::readNodeFile( cacheFile, fileOptions.get() ) );
+	bool warm = lod.valid();
+
+	if ( !lod )
+	{
+		osg::ref_ptr<osg::Node> model = osgDB::readNodeFile( source );
+		if ( !model ) return 0;
+		lod = LodBuilder::build( model.get(), options );
+
+		cacheFile = nextToSource;
+		if ( !LodBuilder::writeCacheFile( *lod, cacheFile, fileOptions.get() ) )
+		{
+			cacheFile = inCacheDirectory;
+			osgDB::makeDirectory( SceneCache::getCacheDirectory() );
+			if ( !LodBuilder::writeCacheFile( *lod, cacheFile, fileOptions.get() ) )
+				OSG_WARN << "readLODFileCached: could not write " << nextToSource << " or " << inCacheDirectory << std::endl;
+		}
+	}
+
+	OSG_NOTICE << "readLODFileCached: " << filename << ", " << lod -> getNumChildren() << " levels"
+	           << ( warm ? " (warm, from " + cacheFile + ")" : " (cold, simplified)" ) << " in "
+	           << osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() ) << " ms" << std::endl;
+	return lod.release();
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef MEMORY_COUNTER_H
+#define MEMORY_COUNTER_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/NodeVisitor>
+#include <osg/StateSet>
+#include <osg/Texture>
+
+#include <set>
+
+//MemoryCounter
+//bytes of the vertex arrays, primitive sets and texture images below a node, each
+//counted once however often it is shared. one counter can visit several nodes, data they
+//share is still counted once.
+//
+//	MemoryCounter counter;
+//	scene -> accept( counter );
+//	std::cout << counter.getTotalBytes() << std::endl;
+
+class MemoryCounter : public osg::NodeVisitor
+{
+public:
+	MemoryCounter() : osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), arrayBytes( 0 ), indexBytes( 0 ), imageBytes( 0 )
+	{
+		//hidden subtrees are loaded all the same
+		setNodeMaskOverride( ~0u );
+	}
+
+	virtual void apply( osg::Node& node )
+	{
+		countState( node.getStateSet() );
+		traverse( node );
+	}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		countState( geode.getStateSet() );
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+		{
+			osg::Drawable* drawable = geode.getDrawable( i );
+			countState( drawable -> getStateSet() );
+			osg::Geometry* geometry = drawable -> asGeometry();
+			if ( !geometry ) continue;
+
+			osg::Geometry::ArrayList arrays;
+			geometry -> getArrayList( arrays );
+			for ( unsigned int a = 0; a < arrays.size(); ++a )
+				if ( _seen.insert( arrays[a].get() ).second ) arrayBytes += arrays[a] -> getTotalDataSize();
+			for ( unsigned int p = 0; p < geometry -> getNumPrimitiveSets(); ++p )
+				if ( _seen.insert( geometry -> getPrimitiveSet( p ) ).second ) indexBytes += geometry -> getPrimitiveSet( p ) -> getTotalDataSize();
+		}
+		traverse( geode );
+	}
+
+	unsigned long long getTotalBytes() const { return arrayBytes + indexBytes + imageBytes; }
+
+	unsigned long long arrayBytes;
+	unsigned long long indexBytes;
+	unsigned long long imageBytes;
+
+protected:
+	void countState( osg::StateSet* stateSet )
+	{
+		if ( !stateSet ) return;
+		const osg::StateSet::TextureAttributeList& units = stateSet -> getTextureAttributeList();
+		for ( unsigned int u = 0; u < units.size(); ++u )
+		{
+			for ( osg::StateSet::AttributeList::const_iterator it = units[u].begin(); it != units[u].end(); ++it )
+			{
+				osg::Texture* texture = dynamic_cast<osg::Texture*>( it -> second.first.get() );
+				for ( unsigned int i = 0; texture && i < texture -> getNumImages(); ++i )
+				{
+					osg::Image* image = texture -> getImage( i );
+					if ( image && _seen.insert( image ).second ) imageBytes += image -> getTotalSizeInBytes();
+				}
+			}
+		}
+	}
+
+	std::set<const osg::Referenced*> _seen;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+#include <vector>
+
+//parallelFor
+//splits [0, count) into one contiguous range per thread and calls function( begin, end )
+//for each range on OpenThreads workers; the calling thread takes the first range itself.
+//returns when every range is done. small counts (below minPerThread items per thread)
+//use fewer threads, down to a plain call on the calling thread.
+//
+//	parallelFor( triangles.size(), [&]( unsigned int begin, unsigned int end ) { ... } );
+
+template<class Function>
+class ParallelForThread : public OpenThreads::Thread
+{
+public:
+	ParallelForThread( const Function& function, unsigned int begin, unsigned int end )
+		: _function( function ), _begin( begin ), _end( end ) {}
+
+	virtual void run() { _function( _begin, _end ); }
+
+protected:
+	const Function& _function;
+	unsigned int _begin, _end;
+};
+
+template<class Function>
+void parallelFor( unsigned int count, const Function& function, unsigned int numThreads = 0, unsigned int minPerThread = 4096 )
+{
+	if ( numThreads == 0 ) numThreads = OpenThreads::GetNumberOfProcessors();
+	numThreads = std::max( 1u, std::min( numThreads, count / std::max( minPerThread, 1u ) ) );
+	if ( numThreads == 1 )
+	{
+		if ( count > 0 ) function( 0u, count );
+		return;
+	}
+
+	unsigned int chunk = ( count + numThreads - 1 ) / numThreads;
+	std::vector< ParallelForThread<Function>* > workers;
+	for ( unsigned int begin = chunk; begin < count; begin += chunk )
+	{
+		workers.push_back( new ParallelForThread<Function>( function, begin, std::min( begin + chunk, count ) ) );
+		workers.back() -> start();
+	}
+
+	function( 0u, std::min( chunk, count ) );
+
+	for ( unsigned int i = 0; i < workers.size(); ++i )
+	{
+		workers[i] -> join();
+		delete workers[i];
+	}
+}
+
+//ParallelForPool
+//parallelFor on threads that stay: the workers are started by the first call that needs them
+//and then sleep on a condition between calls, for loops run every frame where starting and
+//joining threads each time would cost more than the work. one caller at a time.
+//
+//	ParallelForPool pool;
+//	pool.run( count, [&]( unsigned int begin, unsigned int end ) { ... } );
+
+class ParallelForPool
+{
+public:
+	ParallelForPool( unsigned int numThreads = 0 )
+		: _numThreads( numThreads ? numThreads : std::max( 1, OpenThreads::GetNumberOfProcessors() ) ),
+		  _range( 0 ), _count( 0 ), _chunk( 0 ), _numRanges( 0 ), _next( 0 ), _pending( 0 ), _generation( 0 ), _done( false ) {}
+
+	~ParallelForPool()
+	{
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			_done = true;
+			_start.broadcast();
+		}
+		for ( unsigned int i = 0; i < _workers.size(); ++i )
+		{
+			_workers[i] -> join();
+			delete _workers[i];
+		}
+	}
+
+	unsigned int getNumThreads() const { return _numThreads; }
+
+	template<class Function>
+	void run( unsigned int count, const Function& function, unsigned int minPerThread = 4096 )
+	{
+		unsigned int numThreads = std::max( 1u, std::min( _numThreads, count / std::max( minPerThread, 1u ) ) );
+		if ( numThreads == 1 )
+		{
+			if ( count > 0 ) function( 0u, count );
+			return;
+		}
+
+		while ( _workers.size() + 1 < _numThreads )
+		{
+			_workers.push_back( new Worker( *this ) );
+			_workers.back() -> start();
+		}
+
+		RangeFunction<Function> range( function );
+		unsigned int chunk = ( count + numThreads - 1 ) / numThreads;
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			_range = &range;
+			_count = count;
+			_chunk = chunk;
+			_numRanges = ( count + chunk - 1 ) / chunk;
+			_next = 1;
+			_pending = _numRanges - 1;
+			++_generation;
+			_start.broadcast();
+		}
+
+		function( 0u, std::min( chunk, count ) );
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		while ( _pending > 0 ) _finished.wait( &_mutex );
+		_range = 0;
+	}
+
+protected:
+	struct Range
+	{
+		virtual ~Range() {}
+		virtual void operator()( unsigned int begin, unsigned int end ) = 0;
+	};
+
+	template<class Function>
+	struct RangeFunction : public Range
+	{
+		RangeFunction( const Function& function ) : _function( function ) {}
+		virtual void operator()( unsigned int begin, unsigned int end ) { _function( begin, end ); }
+		const Function& _function;
+	};
+
+	class Worker : public OpenThreads::Thread
+	{
+	public:
+		Worker( ParallelForPool& pool ) : _pool( pool ) {}
+		virtual void run() { _pool.work(); }
+
+	protected:
+		ParallelForPool& _pool;
+	};
+
+	//a worker: wait for a new call, take ranges of it until none are left
+	void work()
+	{
+		_mutex.lock();
+		unsigned int generation = 0;
+		while ( true )
+		{
+			while ( !_done && _generation == generation ) _start.wait( &_mutex );
+			if ( _done ) break;
+			generation = _generation;
+
+			while ( _next < _numRanges )
+			{
+				unsigned int begin = _next++ * _chunk, end = std::min( begin + _chunk, _count );
+				Range* range = _range;
+				_mutex.unlock();
+				( *range )( begin, end );
+				_mutex.lock();
+				if ( --_pending == 0 ) _finished.signal();
+			}
+		}
+		_mutex.unlock();
+	}
+
+	unsigned int _numThreads;
+	std::vector<Worker*> _workers;
+
+	OpenThreads::Mutex _mutex;
+	OpenThreads::Condition _start, _finished;
+	Range* _range;
+	unsigned int _count, _chunk, _numRanges, _next, _pending;
+	unsigned int _generation;
+	bool _done;
+};
+
+#endif
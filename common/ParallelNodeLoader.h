@@ -0,0 +1,168 @@
+#ifndef PARALLEL_NODE_LOADER_H
+#define PARALLEL_NODE_LOADER_H
+
+#include <osg/ArgumentParser>
+#include <osg/Group>
+#include <osg/Timer>
+#include <osgDB/ReadFile>
+#include <OpenThreads/Thread>
+
+#include "SceneCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//ParallelNodeLoader
+//drop-in replacement for osgDB::readNodeFiles( arguments ) when many models are given
+//on the command line. the files are parsed concurrently by a pool of OpenThreads workers,
+//each worker pulls the next file index until all are done, files go through the scene cache.
+//results are stored by index, so the children of the returned group are always in
+//command-line order no matter which file finished first.
+//
+//	osg::ref_ptr<osg::Node> root = readNodeFilesParallel( arguments );
+
+class ParallelNodeLoader
+{
+public:
+	struct Result
+	{
+		Result() : seconds( 0.0 ) {}
+
+		std::string filename;
+		osg::ref_ptr<osg::Node> node;
+		double seconds;		//parse time of this file on its worker
+	};
+
+	ParallelNodeLoader( unsigned int numThreads = 0 )
+		: _numThreads( numThreads ? numThreads : OpenThreads::GetNumberOfProcessors() ), _numWorkers( 0 ), _next( 0 ) {}
+
+	//load all files, returns when the last one is done
+	void load( const std::vector<std::string>& filenames )
+	{
+		_results.clear();
+		_results.resize( filenames.size() );
+		for ( unsigned int i = 0; i < filenames.size(); ++i )
+			_results[i].filename = filenames[i];
+		_next.store( 0 );
+
+		_numWorkers = std::min<unsigned int>( std::max( _numThreads, 1u ), filenames.size() );
+		std::vector<LoaderThread*> workers;
+		for ( unsigned int i = 1; i < _numWorkers; ++i )
+		{
+			workers.push_back( new LoaderThread( this ) );
+			workers.back() -> start();
+		}
+
+		//the calling thread works as well instead of just waiting
+		loadRemaining();
+
+		for ( unsigned int i = 0; i < workers.size(); ++i )
+		{
+			workers[i] -> join();
+			delete workers[i];
+		}
+	}
+
+	const std::vector<Result>& getResults() const { return _results; }
+
+	//the loaded nodes under one group in the original order, failed files are skipped.
+	//like osgDB::readNodeFiles() a single node is returned as it is.
+	osg::Node* createScene() const
+	{
+		osg::ref_ptr<osg::Group> group = new osg::Group;
+		for ( unsigned int i = 0; i < _results.size(); ++i )
+		{
+			if ( _results[i].node.valid() )
+				group -> addChild( _results[i].node.get() );
+		}
+
+		if ( group -> getNumChildren() == 0 ) return 0;
+		if ( group -> getNumChildren() == 1 )
+		{
+			osg::ref_ptr<osg::Node> node = group -> getChild( 0 );
+			group = 0;
+			return node.release();
+		}
+		return group.release();
+	}
+
+	void report( std::ostream& out ) const
+	{
+		double total = 0.0;
+		for ( unsigned int i = 0; i < _results.size(); ++i )
+		{
+			out << "  " << _results[i].filename << ": " << _results[i].seconds * 1000.0 << " ms"
+			    << ( _results[i].node.valid() ? "" : " (failed)" ) << std::endl;
+			total += _results[i].seconds;
+		}
+		out << "  sum of parse times: " << total * 1000.0 << " ms on " << _numWorkers << " threads" << std::endl;
+	}
+
+protected:
+	class LoaderThread : public OpenThreads::Thread
+	{
+	public:
+		LoaderThread( ParallelNodeLoader* loader ) : _loader( loader ) {}
+		virtual void run() { _loader -> loadRemaining(); }
+
+	protected:
+		ParallelNodeLoader* _loader;
+	};
+
+	void loadRemaining()
+	{
+		unsigned int index;
+		while ( ( index = _next.fetch_add( 1 ) ) < _results.size() )
+		{
+			Result& result = _results[index];
+			osg::Timer_t start = osg::Timer::instance() -> tick();
+			result.node = readNodeFileCached( result.filename );
+			result.seconds = osg::Timer::instance() -> delta_s( start, osg::Timer::instance() -> tick() );
+		}
+	}
+
+	unsigned int _numThreads;
+	unsigned int _numWorkers;	//threads the last load() used, the caller included
+	std::atomic<unsigned int> _next;
+	std::vector<Result> _results;
+};
+
+//the parallel counterpart of osgDB::readNodeFiles( arguments ):
+//every argument that is not an option is treated as a model file and removed from arguments.
+//--load-threads N overrides the number of workers, timings are printed with OSG_NOTICE.
+inline osg::Node* readNodeFilesParallel( osg::ArgumentParser& arguments )
+{
+	unsigned int numThreads = 0;
+	arguments.read( "--load-threads", numThreads );
+
+	std::vector<std::string> filenames;
+	for ( int pos = 1; pos < arguments.argc(); )
+	{
+		if ( !arguments.isOption( pos ) )
+		{
+			filenames.push_back( arguments[pos] );
+			arguments.remove( pos );
+		}
+		else
+			++pos;
+	}
+	if ( filenames.empty() ) return 0;
+
+	ParallelNodeLoader loader( numThreads );
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+	loader.load( filenames );
+	double wall = osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() );
+
+	if ( osg::isNotifyEnabled( osg::NOTICE ) )
+	{
+		osg::notify( osg::NOTICE ) << "readNodeFilesParallel: " << filenames.size() << " files in "
+		                           << wall << " ms" << std::endl;
+		loader.report( osg::notify( osg::NOTICE ) );
+	}
+	return loader.createScene();
+}
+
+#endif
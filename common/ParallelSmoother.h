@@ -0,0 +1,474 @@
+#ifndef PARALLEL_SMOOTHER_H
+#define PARALLEL_SMOOTHER_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/TriangleIndexFunctor>
+#include <osgUtil/SmoothingVisitor>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define PARALLEL_SMOOTHER_SSE
+#endif
+
+#include "ParallelFor.h"
+
+//ParallelSmoother
+//drop-in replacement for osgUtil::SmoothingVisitor::smooth( geometry ) on big meshes:
+//	1. vertices at the same position (or within weldTolerance of each other) are welded
+//	   into groups with a hash grid, instead of SmoothingVisitor's std::multiset
+//	2. the triangles of all primitive sets are collected and their face normals computed
+//	   in parallel
+//	3. every weld group gathers the face normals of its triangles (no atomics, no locks),
+//	   accumulating and normalising four floats at a time with SSE
+//	4. every vertex gets the normal of its group
+//
+//without a crease angle the result is the same as SmoothingVisitor's: area weighted face
+//normals summed per position, in the same order. with a crease angle below PI only faces
+//within that angle of each other are averaged, and vertices on a crease are duplicated
+//so each side keeps its own normal, like SmoothingVisitor::smooth( geometry, creaseAngle ).
+//
+//	ParallelSmoother::smooth( *geometry );
+//	ParallelSmoother( 0.001f, osg::DegreesToRadians( 60.0f ) ).apply( *scannedMesh );
+
+class ParallelSmoother
+{
+public:
+	ParallelSmoother( float weldTolerance = 0.0f, float creaseAngle = osg::PI, unsigned int numThreads = 0 )
+		: _weldTolerance( weldTolerance ), _creaseAngle( creaseAngle ), _numThreads( numThreads ) {}
+
+	void setWeldTolerance( float tolerance ) { _weldTolerance = tolerance; }
+	float getWeldTolerance() const { return _weldTolerance; }
+
+	void setCreaseAngle( float angle ) { _creaseAngle = angle; }
+	float getCreaseAngle() const { return _creaseAngle; }
+
+	void setNumThreads( unsigned int numThreads ) { _numThreads = numThreads; }
+
+	//per-vertex normals replace whatever normals the geometry had
+	void apply( osg::Geometry& geometry ) const
+	{
+		osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>( geometry.getVertexArray() );
+		if ( !vertices || vertices -> empty() )
+		{
+			osgUtil::SmoothingVisitor::smooth( geometry, _creaseAngle );
+			return;
+		}
+
+		std::vector<unsigned int> corners, setOffsets;
+		collectTriangles( geometry, corners, setOffsets );
+		unsigned int numTriangles = corners.size() / 3;
+
+		std::vector<FaceNormal> faces( numTriangles );
+		const osg::Vec3* v = &vertices -> front();
+		parallelFor( numTriangles, [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int t = begin; t < end; ++t )
+			{
+				const unsigned int* c = &corners[t * 3];
+				faces[t].set( ( v[c[1]] - v[c[0]] ) ^ ( v[c[2]] - v[c[0]] ) );
+			}
+		}, _numThreads );
+
+		std::vector<unsigned int> groupOf;
+		unsigned int numGroups = _weldTolerance > 0.0f ? weldWithTolerance( *vertices, _weldTolerance, groupOf )
+		                                               : weldExact( *vertices, groupOf );
+
+		//triangles of every group, in triangle order (CSR layout)
+		std::vector<unsigned int> groupStart( numGroups + 1, 0 ), groupTriangles( corners.size() );
+		for ( unsigned int i = 0; i < corners.size(); ++i )
+			++groupStart[groupOf[corners[i]] + 1];
+		for ( unsigned int g = 0; g < numGroups; ++g )
+			groupStart[g + 1] += groupStart[g];
+		{
+			std::vector<unsigned int> fill( groupStart.begin(), groupStart.end() - 1 );
+			for ( unsigned int i = 0; i < corners.size(); ++i )
+				groupTriangles[fill[groupOf[corners[i]]]++] = i / 3;
+		}
+
+		if ( _creaseAngle >= osg::PI )
+			smoothGroups( geometry, *vertices, faces, groupOf, groupStart, groupTriangles );
+		else
+			smoothWithCreases( geometry, *vertices, corners, setOffsets, faces, groupOf, groupStart, groupTriangles );
+	}
+
+	//same signature as osgUtil::SmoothingVisitor::smooth()
+	static void smooth( osg::Geometry& geometry, double creaseAngle = osg::PI )
+	{
+		ParallelSmoother( 0.0f, creaseAngle ).apply( geometry );
+	}
+
+protected:
+	//a face normal padded to four floats, so it adds and normalises as one SSE register.
+	//loaded unaligned: a std::vector only honours over-alignment with C++17's aligned new
+	struct FaceNormal
+	{
+		void set( const osg::Vec3& n ) { v[0] = n.x(); v[1] = n.y(); v[2] = n.z(); v[3] = 0.0f; }
+		float v[4];
+	};
+
+	struct TriangleCollector
+	{
+		TriangleCollector() : corners( 0 ) {}
+		void operator()( unsigned int a, unsigned int b, unsigned int c )
+		{
+			corners -> push_back( a );
+			corners -> push_back( b );
+			corners -> push_back( c );
+		}
+		std::vector<unsigned int>* corners;
+	};
+
+	//triangle corners of all primitive sets, set i owns the triangles [setOffsets[i], setOffsets[i + 1])
+	void collectTriangles( osg::Geometry& geometry, std::vector<unsigned int>& corners, std::vector<unsigned int>& setOffsets ) const
+	{
+		unsigned int numSets = geometry.getNumPrimitiveSets();
+		std::vector< std::vector<unsigned int> > perSet( numSets );
+		parallelFor( numSets, [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int i = begin; i < end; ++i )
+			{
+				osg::TriangleIndexFunctor<TriangleCollector> collector;
+				collector.corners = &perSet[i];
+				geometry.getPrimitiveSet( i ) -> accept( collector );
+			}
+		}, _numThreads, 1 );
+
+		setOffsets.assign( 1, 0 );
+		for ( unsigned int i = 0; i < numSets; ++i )
+			setOffsets.push_back( setOffsets.back() + perSet[i].size() / 3 );
+
+		corners.resize( setOffsets.back() * 3 );
+		parallelFor( numSets, [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int i = begin; i < end; ++i )
+			{
+				if ( !perSet[i].empty() )
+					std::memcpy( &corners[setOffsets[i] * 3], &perSet[i].front(), perSet[i].size() * sizeof(unsigned int) );
+			}
+		}, _numThreads, 1 );
+	}
+
+	static unsigned int hashInts( int x, int y, int z )
+	{
+		unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u;
+		return h * 2654435761u;
+	}
+
+	static unsigned int hashCell( long long x, long long y, long long z )
+	{
+		unsigned long long h = (unsigned long long)x * 0x9E3779B97F4A7C15ull ^ (unsigned long long)y * 0xC2B2AE3D27D4EB4Full
+		                     ^ (unsigned long long)z * 0x165667B19E3779F9ull;
+		return (unsigned int)( h ^ ( h >> 32 ) );
+	}
+
+	//the weld grid cell of a coordinate; 64 bit, since large world coordinates over a small
+	//tolerance overflow an int, and clamped so even a float's range fits
+	static long long cellOf( float coordinate, double invCell )
+	{
+		double cell = std::floor( coordinate * invCell );
+		if ( !( cell == cell ) ) return 0;
+		return (long long)std::max( -4e18, std::min( cell, 4e18 ) );
+	}
+
+	static unsigned int tableSize( unsigned int numVertices )
+	{
+		unsigned int size = 1024;
+		while ( size < numVertices * 2 ) size <<= 1;
+		return size;
+	}
+
+	//vertices with bit-identical positions (-0 and +0 count as equal) share a group
+	static unsigned int weldExact( const osg::Vec3Array& vertices, std::vector<unsigned int>& groupOf )
+	{
+		unsigned int mask = tableSize( vertices.size() ) - 1;
+		std::vector<unsigned int> slots( mask + 1, ~0u );
+		groupOf.resize( vertices.size() );
+
+		unsigned int numGroups = 0;
+		for ( unsigned int i = 0; i < vertices.size(); ++i )
+		{
+			const osg::Vec3& p = vertices[i];
+			int bits[3];
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				float f = p[k] + 0.0f;
+				std::memcpy( &bits[k], &f, sizeof(float) );
+			}
+
+			unsigned int slot = hashInts( bits[0], bits[1], bits[2] ) & mask;
+			while ( slots[slot] != ~0u && !( vertices[slots[slot]] == p ) )
+				slot = ( slot + 1 ) & mask;
+
+			if ( slots[slot] == ~0u )
+			{
+				slots[slot] = i;
+				groupOf[i] = numGroups++;
+			}
+			else
+				groupOf[i] = groupOf[slots[slot]];
+		}
+		return numGroups;
+	}
+
+	//vertices closer than tolerance to the first vertex of a group join that group.
+	//the grid cells are tolerance wide, so a match is always in one of the 27 neighbour cells.
+	static unsigned int weldWithTolerance( const osg::Vec3Array& vertices, float tolerance, std::vector<unsigned int>& groupOf )
+	{
+		struct Slot { long long x, y, z; unsigned int vertex; };
+		unsigned int mask = tableSize( vertices.size() ) - 1;
+		std::vector<Slot> slots( mask + 1 );
+		for ( unsigned int s = 0; s <= mask; ++s ) slots[s].vertex = ~0u;
+		groupOf.resize( vertices.size() );
+
+		double invCell = 1.0 / tolerance;
+		float tolerance2 = tolerance * tolerance;
+		unsigned int numGroups = 0;
+		for ( unsigned int i = 0; i < vertices.size(); ++i )
+		{
+			const osg::Vec3& p = vertices[i];
+			long long cx = cellOf( p.x(), invCell ), cy = cellOf( p.y(), invCell ), cz = cellOf( p.z(), invCell );
+
+			unsigned int match = ~0u;
+			for ( int dx = -1; dx <= 1 && match == ~0u; ++dx )
+			for ( int dy = -1; dy <= 1 && match == ~0u; ++dy )
+			for ( int dz = -1; dz <= 1 && match == ~0u; ++dz )
+			{
+				long long x = cx + dx, y = cy + dy, z = cz + dz;
+				for ( unsigned int slot = hashCell( x, y, z ) & mask; slots[slot].vertex != ~0u; slot = ( slot + 1 ) & mask )
+				{
+					const Slot& s = slots[slot];
+					if ( s.x == x && s.y == y && s.z == z && ( vertices[s.vertex] - p ).length2() <= tolerance2 )
+					{
+						match = s.vertex;
+						break;
+					}
+				}
+			}
+
+			if ( match != ~0u )
+			{
+				groupOf[i] = groupOf[match];
+				continue;
+			}
+
+			unsigned int slot = hashCell( cx, cy, cz ) & mask;
+			while ( slots[slot].vertex != ~0u ) slot = ( slot + 1 ) & mask;
+			Slot& s = slots[slot];
+			s.x = cx; s.y = cy; s.z = cz; s.vertex = i;
+			groupOf[i] = numGroups++;
+		}
+		return numGroups;
+	}
+
+	//sum and normalise the face normals of one list of triangles
+	static osg::Vec3 sumNormals( const std::vector<FaceNormal>& faces, const unsigned int* triangles, unsigned int count )
+	{
+#ifdef PARALLEL_SMOOTHER_SSE
+		__m128 sum = _mm_setzero_ps();
+		for ( unsigned int i = 0; i < count; ++i )
+			sum = _mm_add_ps( sum, _mm_loadu_ps( faces[triangles[i]].v ) );
+
+		//( x*x + y*y ) + z*z, the order osg::Vec3::length() uses
+		__m128 sq = _mm_mul_ps( sum, sum );
+		__m128 len = _mm_sqrt_ss( _mm_add_ss( _mm_add_ss( sq, _mm_shuffle_ps( sq, sq, 1 ) ), _mm_shuffle_ps( sq, sq, 2 ) ) );
+		float length = _mm_cvtss_f32( len );
+		if ( length > 0.0f )
+			sum = _mm_mul_ps( sum, _mm_set1_ps( 1.0f / length ) );
+
+		alignas(16) float n[4];
+		_mm_store_ps( n, sum );
+		return osg::Vec3( n[0], n[1], n[2] );
+#else
+		osg::Vec3 sum;
+		for ( unsigned int i = 0; i < count; ++i )
+		{
+			const float* f = faces[triangles[i]].v;
+			sum += osg::Vec3( f[0], f[1], f[2] );
+		}
+		sum.normalize();
+		return sum;
+#endif
+	}
+
+	void smoothGroups( osg::Geometry& geometry, const osg::Vec3Array& vertices, const std::vector<FaceNormal>& faces,
+	                   const std::vector<unsigned int>& groupOf, const std::vector<unsigned int>& groupStart,
+	                   const std::vector<unsigned int>& groupTriangles ) const
+	{
+		unsigned int numGroups = groupStart.size() - 1;
+		std::vector<osg::Vec3> groupNormals( numGroups );
+		parallelFor( numGroups, [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int g = begin; g < end; ++g )
+				groupNormals[g] = sumNormals( faces, groupTriangles.empty() ? 0 : &groupTriangles[groupStart[g]], groupStart[g + 1] - groupStart[g] );
+		}, _numThreads );
+
+		osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array( vertices.size() );
+		parallelFor( vertices.size(), [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int i = begin; i < end; ++i )
+				( *normals )[i] = groupNormals[groupOf[i]];
+		}, _numThreads );
+
+		geometry.setNormalArray( normals.get(), osg::Array::BIND_PER_VERTEX );
+		geometry.dirtyDisplayList();
+	}
+
+	void smoothWithCreases( osg::Geometry& geometry, osg::Vec3Array& vertices, std::vector<unsigned int>& corners,
+	                        const std::vector<unsigned int>& setOffsets, const std::vector<FaceNormal>& faces,
+	                        const std::vector<unsigned int>& groupOf, const std::vector<unsigned int>& groupStart,
+	                        const std::vector<unsigned int>& groupTriangles ) const
+	{
+		unsigned int numTriangles = faces.size();
+		std::vector<osg::Vec3> units( numTriangles );
+		parallelFor( numTriangles, [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int t = begin; t < end; ++t )
+			{
+				units[t].set( faces[t].v[0], faces[t].v[1], faces[t].v[2] );
+				units[t].normalize();
+			}
+		}, _numThreads );
+
+		//each corner averages the faces around its position that are within the crease angle of its own face
+		float cosCrease = cosf( _creaseAngle );
+		std::vector<osg::Vec3> cornerNormals( corners.size() );
+		parallelFor( corners.size(), [&]( unsigned int begin, unsigned int end )
+		{
+			std::vector<unsigned int> smooth;
+			for ( unsigned int c = begin; c < end; ++c )
+			{
+				unsigned int t = c / 3, g = groupOf[corners[c]];
+				smooth.clear();
+				for ( unsigned int i = groupStart[g]; i < groupStart[g + 1]; ++i )
+				{
+					if ( units[t] * units[groupTriangles[i]] >= cosCrease )
+						smooth.push_back( groupTriangles[i] );
+				}
+				cornerNormals[c] = sumNormals( faces, smooth.empty() ? 0 : &smooth.front(), smooth.size() );
+			}
+		}, _numThreads );
+
+		//a vertex keeps its index for the first normal it meets, any other normal gets a copy of the vertex
+		unsigned int numVertices = vertices.size();
+		std::vector<unsigned int> nextVariant( numVertices, ~0u ), copiedFrom;
+		std::vector<osg::Vec3> normals( numVertices );
+		std::vector<bool> used( numVertices, false );
+		for ( unsigned int c = 0; c < corners.size(); ++c )
+		{
+			unsigned int v = corners[c];
+			const osg::Vec3& n = cornerNormals[c];
+			if ( !used[v] )
+			{
+				used[v] = true;
+				normals[v] = n;
+				continue;
+			}
+
+			unsigned int variant = v, last = v;
+			while ( variant != ~0u && normals[variant] * n < 1.0f - 1e-5f )
+			{
+				last = variant;
+				variant = nextVariant[variant];
+			}
+			if ( variant == ~0u )
+			{
+				variant = numVertices + copiedFrom.size();
+				copiedFrom.push_back( v );
+				normals.push_back( n );
+				nextVariant.push_back( ~0u );
+				nextVariant[last] = variant;
+			}
+			corners[c] = variant;
+		}
+
+		//vertices no triangle uses still get the normal of their position, like SmoothingVisitor
+		for ( unsigned int v = 0; v < numVertices; ++v )
+		{
+			if ( !used[v] )
+				normals[v] = sumNormals( faces, groupTriangles.empty() ? 0 : &groupTriangles[groupStart[groupOf[v]]],
+				                         groupStart[groupOf[v] + 1] - groupStart[groupOf[v]] );
+		}
+
+		//nothing split: the original primitive sets already index the right vertices
+		if ( !copiedFrom.empty() )
+			duplicateVertices( geometry, numVertices, copiedFrom );
+
+		//triangle primitive sets are replaced by index lists over the split vertices, lines and points stay
+		for ( unsigned int i = 0; !copiedFrom.empty() && i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			if ( setOffsets[i] == setOffsets[i + 1] ) continue;
+			osg::ref_ptr<osg::DrawElementsUInt> elements = new osg::DrawElementsUInt( GL_TRIANGLES,
+				corners.begin() + setOffsets[i] * 3, corners.begin() + setOffsets[i + 1] * 3 );
+			geometry.setPrimitiveSet( i, elements.get() );
+		}
+
+		geometry.setNormalArray( new osg::Vec3Array( normals.begin(), normals.end() ), osg::Array::BIND_PER_VERTEX );
+		geometry.dirtyDisplayList();
+		geometry.dirtyBound();
+	}
+
+	template<class ArrayType>
+	static bool appendCopies( osg::Array* array, const std::vector<unsigned int>& copiedFrom )
+	{
+		ArrayType* typed = dynamic_cast<ArrayType*>( array );
+		if ( !typed ) return false;
+		typed -> reserve( typed -> size() + copiedFrom.size() );
+		for ( unsigned int i = 0; i < copiedFrom.size(); ++i )
+			typed -> push_back( ( *typed )[copiedFrom[i]] );
+		typed -> dirty();
+		return true;
+	}
+
+	//append the copied vertices to every per-vertex array of the geometry
+	static void duplicateVertices( osg::Geometry& geometry, unsigned int numVertices, const std::vector<unsigned int>& copiedFrom )
+	{
+		osg::Geometry::ArrayList arrays;
+		geometry.getArrayList( arrays );
+		for ( unsigned int i = 0; i < arrays.size(); ++i )
+		{
+			osg::Array* array = arrays[i].get();
+			if ( array == geometry.getNormalArray() || array -> getNumElements() != numVertices ) continue;
+
+			if ( !appendCopies<osg::Vec3Array>( array, copiedFrom ) && !appendCopies<osg::Vec2Array>( array, copiedFrom ) &&
+			     !appendCopies<osg::Vec4Array>( array, copiedFrom ) && !appendCopies<osg::Vec4ubArray>( array, copiedFrom ) &&
+			     !appendCopies<osg::FloatArray>( array, copiedFrom ) && !appendCopies<osg::Vec3dArray>( array, copiedFrom ) )
+			{
+				OSG_WARN << "ParallelSmoother: cannot split vertices of a " << array -> className() << std::endl;
+			}
+		}
+	}
+
+	float _weldTolerance;
+	float _creaseAngle;
+	unsigned int _numThreads;
+};
+
+//ParallelSmoothingVisitor
+//the visitor form: smooths every geometry below the node it is applied to.
+
+class ParallelSmoothingVisitor : public osg::NodeVisitor
+{
+public:
+	ParallelSmoothingVisitor( const ParallelSmoother& smoother = ParallelSmoother() )
+		: osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), _smoother( smoother ) {}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+		{
+			osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+			if ( geometry ) _smoother.apply( *geometry );
+		}
+	}
+
+protected:
+	ParallelSmoother _smoother;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef PARALLEL_TRIANGLE_FUNCTOR_H
+#define PARALLEL_TRIANGLE_FUNCTOR_H
+
+#include <OpenThreads/Thread>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/PrimitiveSet>
+#include <osg/TriangleFunctor>
+
+#include <algorithm>
+#include <vector>
+
+#include "ParallelFor.h"
+#include "TriangleExtractor.h"
+
+//ParallelTriangleFunctor
+//runs an osg::TriangleFunctor<T> over many geometries on all cores. the primitive sets are
+//cut into chunks of about grainSize triangles (big DrawArrays/DrawElements of triangles,
+//strips, quads and quad strips are split, fans, polygons and single DrawArrayLengths parts
+//are not), the chunks are dealt out as contiguous runs of about equal triangle counts, one
+//run per worker, and every worker has its own T copied from the prototype.
+//
+//traverse() returns the workers' T in traversal order: concatenated, they have seen exactly
+//the triangles a serial accept() would have given them, in the same order. reduce() folds
+//them into one with T::merge( const T& ), which is then deterministic as well.
+//coordinates are the geometries' own, like osg::TriangleFunctor; only Vec3Array vertices.
+//
+//	ParallelTriangleFunctor<FaceCollector> functor;
+//	functor.addScene( *scene );
+//	FaceCollector faces = functor.reduce( FaceCollector() );
+
+template<class T>
+class ParallelTriangleFunctor
+{
+public:
+	ParallelTriangleFunctor( unsigned int numThreads = 0, unsigned int grainSize = 65536 )
+		: _numThreads( numThreads ), _grainSize( std::max( grainSize, 2u ) & ~1u ) {}
+
+	void addGeometry( const osg::Geometry& geometry ) { _geometries.push_back( &geometry ); }
+
+	//every geometry below node
+	void addScene( osg::Node& node )
+	{
+		GeometryCollector collector( _geometries );
+		node.accept( collector );
+	}
+
+	void clear() { _geometries.clear(); }
+
+	unsigned int getNumGeometries() const { return _geometries.size(); }
+
+	//one T per worker, in traversal order
+	std::vector<T> traverse( const T& prototype ) const
+	{
+		std::vector<Chunk> chunks;
+		unsigned long long numTriangles = 0;
+		for ( unsigned int g = 0; g < _geometries.size(); ++g )
+			addChunks( g, chunks, numTriangles );
+
+		//contiguous runs of chunks with about the same number of triangles
+		unsigned int numWorkers = _numThreads ? _numThreads : OpenThreads::GetNumberOfProcessors();
+		numWorkers = (unsigned int)std::max( 1ull, std::min( (unsigned long long)numWorkers, numTriangles / _grainSize ) );
+		std::vector<unsigned int> runs( 1, 0 );
+		unsigned long long done = 0;
+		for ( unsigned int c = 0; c < chunks.size(); ++c )
+		{
+			done += chunks[c].numTriangles;
+			if ( runs.size() < numWorkers && done * numWorkers >= numTriangles * runs.size() && c + 1 < chunks.size() )
+				runs.push_back( c + 1 );
+		}
+		runs.push_back( chunks.size() );
+
+		std::vector<T> results( runs.size() - 1, prototype );
+		parallelFor( results.size(), [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int w = begin; w < end; ++w )
+			{
+				osg::TriangleFunctor<T> functor;
+				static_cast<T&>( functor ) = results[w];
+				for ( unsigned int c = runs[w]; c < runs[w + 1]; ++c )
+					run( chunks[c], functor );
+				results[w] = functor;
+			}
+		}, results.size(), 1 );
+		return results;
+	}
+
+	//traverse() merged into one T with T::merge( const T& ), in traversal order
+	T reduce( const T& prototype ) const
+	{
+		std::vector<T> results = traverse( prototype );
+		T result = prototype;
+		for ( unsigned int w = 0; w < results.size(); ++w )
+			result.merge( results[w] );
+		return result;
+	}
+
+protected:
+	//[begin, end) of a primitive set's vertices or indices, or of a DrawArrayLengths' parts
+	struct Chunk
+	{
+		unsigned int geometry;
+		unsigned int set;
+		unsigned int begin, end;
+		unsigned int first;			//DrawArrayLengths: vertices before part begin
+		unsigned int numTriangles;
+	};
+
+	class GeometryCollector : public osg::NodeVisitor
+	{
+	public:
+		GeometryCollector( std::vector<const osg::Geometry*>& geometries )
+			: osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), _geometries( geometries ) {}
+
+		virtual void apply( osg::Geode& geode )
+		{
+			for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+			{
+				const osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+				if ( geometry ) _geometries.push_back( geometry );
+			}
+		}
+
+	protected:
+		std::vector<const osg::Geometry*>& _geometries;
+	};
+
+	void addChunks( unsigned int g, std::vector<Chunk>& chunks, unsigned long long& numTriangles ) const
+	{
+		const osg::Geometry& geometry = *_geometries[g];
+		if ( !dynamic_cast<const osg::Vec3Array*>( geometry.getVertexArray() ) ) return;
+		for ( unsigned int s = 0; s < geometry.getNumPrimitiveSets(); ++s )
+		{
+			const osg::PrimitiveSet& primitives = *geometry.getPrimitiveSet( s );
+			GLenum mode = primitives.getMode();
+			Chunk chunk = { g, s, 0, 0, 0, 0 };
+
+			if ( primitives.getType() == osg::PrimitiveSet::DrawArrayLengthsPrimitiveType )
+			{
+				//whole parts, as many as fit into a grain
+				const osg::DrawArrayLengths& lengths = static_cast<const osg::DrawArrayLengths&>( primitives );
+				unsigned int first = 0;
+				for ( unsigned int part = 0; part < lengths.size(); ++part )
+				{
+					chunk.numTriangles += TriangleExtractor::numTriangles( mode, lengths[part] );
+					chunk.end = part + 1;
+					first += lengths[part];
+					if ( chunk.numTriangles >= _grainSize || chunk.end == lengths.size() )
+					{
+						if ( chunk.numTriangles ) chunks.push_back( chunk );
+						numTriangles += chunk.numTriangles;
+						chunk.begin = chunk.end;
+						chunk.first = first;
+						chunk.numTriangles = 0;
+					}
+				}
+				continue;
+			}
+
+			unsigned int count;
+			if ( primitives.getType() == osg::PrimitiveSet::DrawArraysPrimitiveType )
+				count = static_cast<const osg::DrawArrays&>( primitives ).getCount();
+			else if ( primitives.getDrawElements() )
+				count = primitives.getNumIndices();
+			else
+				continue;
+			unsigned int total = TriangleExtractor::numTriangles( mode, count );
+			if ( total == 0 ) continue;
+			numTriangles += total;
+
+			//first and last vertex of triangles [t, t + n), cut only where the winding of
+			//strips stays the same; fans and polygons share their first vertex, they stay whole
+			bool split = mode == GL_TRIANGLES || mode == GL_TRIANGLE_STRIP || mode == GL_QUADS || mode == GL_QUAD_STRIP;
+			unsigned int step = split ? _grainSize : total;
+			for ( unsigned int t = 0; t < total; t += step )
+			{
+				unsigned int n = std::min( step, total - t );
+				switch ( mode )
+				{
+				case GL_TRIANGLES:		chunk.begin = 3 * t;	chunk.end = 3 * ( t + n );	break;
+				case GL_TRIANGLE_STRIP:	chunk.begin = t;		chunk.end = t + n + 2;		break;
+				case GL_QUADS:			chunk.begin = 2 * t;	chunk.end = 2 * ( t + n );	break;
+				case GL_QUAD_STRIP:		chunk.begin = t;		chunk.end = t + n + 2;		break;
+				default:				chunk.begin = 0;		chunk.end = count;			break;
+				}
+				chunk.numTriangles = n;
+				chunks.push_back( chunk );
+			}
+		}
+	}
+
+	void run( const Chunk& chunk, osg::TriangleFunctor<T>& functor ) const
+	{
+		const osg::Geometry& geometry = *_geometries[chunk.geometry];
+		const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>( geometry.getVertexArray() );
+		const osg::PrimitiveSet& primitives = *geometry.getPrimitiveSet( chunk.set );
+		GLenum mode = primitives.getMode();
+		functor.setVertexArray( vertices -> size(), vertices -> empty() ? 0 : &vertices -> front() );
+
+		GLsizei count = chunk.end - chunk.begin;
+		switch ( primitives.getType() )
+		{
+		case osg::PrimitiveSet::DrawArraysPrimitiveType:
+			functor.drawArrays( mode, static_cast<const osg::DrawArrays&>( primitives ).getFirst() + chunk.begin, count );
+			break;
+		case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+		{
+			const osg::DrawArrayLengths& lengths = static_cast<const osg::DrawArrayLengths&>( primitives );
+			GLint first = lengths.getFirst() + chunk.first;
+			for ( unsigned int part = chunk.begin; part < chunk.end; ++part )
+			{
+				functor.drawArrays( mode, first, lengths[part] );
+				first += lengths[part];
+			}
+			break;
+		}
+		case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+			functor.drawElements( mode, count, static_cast<const GLubyte*>( primitives.getDataPointer() ) + chunk.begin );
+			break;
+		case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+			functor.drawElements( mode, count, static_cast<const GLushort*>( primitives.getDataPointer() ) + chunk.begin );
+			break;
+		case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+			functor.drawElements( mode, count, static_cast<const GLuint*>( primitives.getDataPointer() ) + chunk.begin );
+			break;
+		default:
+			break;
+		}
+	}
+
+	std::vector<const osg::Geometry*> _geometries;
+	unsigned int _numThreads;
+	unsigned int _grainSize;	//triangles per chunk, even so strips split on their own winding
+};
+
+#endif
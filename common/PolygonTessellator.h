@@ -0,0 +1,581 @@
+#ifndef POLYGON_TESSELLATOR_H
+#define POLYGON_TESSELLATOR_H
+
+#include <osg/Geometry>
+#include <osg/PrimitiveSet>
+#include <osgUtil/Tessellator>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ParallelFor.h"
+
+//PolygonTessellator
+//ear-clipping replacement for osgUtil::Tessellator::retessellatePolygons() on simple polygons
+//with holes, the bulk of what imported footprints and outlines are. the GL_POLYGON primitive
+//sets of a geometry are turned into one GL_TRIANGLES DrawElementsUInt over the existing
+//vertices, no vertex is added or moved, so the other arrays stay as they are.
+//
+//	TESS_TYPE_POLYGONS  every GL_POLYGON is its own polygon (osgUtil's default)
+//	TESS_TYPE_GEOMETRY  all GL_POLYGON contours of the geometry form one shape, contours inside
+//	                    an odd number of others are holes (TESS_TYPE_GEOMETRY + TESS_WINDING_ODD)
+//
+//every contour is projected onto the plane of the largest one, holes are bridged into their
+//outer contour (Eberly, "Triangulation by ear clipping") and the result is ear clipped.
+//self-intersecting or touching contours, and anything else ear clipping cannot handle, go to
+//osgUtil::Tessellator with the same settings.
+//
+//	PolygonTessellator().tessellate( *geometry );
+//	PolygonTessellator( PolygonTessellator::TESS_TYPE_GEOMETRY ).tessellate( footprints );	//in parallel
+
+class PolygonTessellator
+{
+public:
+	enum TessellationType
+	{
+		TESS_TYPE_POLYGONS,
+		TESS_TYPE_GEOMETRY
+	};
+
+	struct Statistics
+	{
+		Statistics() : numGeometries( 0 ), numFallbacks( 0 ), numTriangles( 0 ) {}
+
+		unsigned int numGeometries;	//geometries tessellated
+		unsigned int numFallbacks;	//of those, how many went to osgUtil::Tessellator
+		unsigned int numTriangles;	//triangles the ear clipping produced
+	};
+
+	PolygonTessellator( TessellationType type = TESS_TYPE_POLYGONS, unsigned int numThreads = 0 )
+		: _type( type ), _numThreads( numThreads ) {}
+
+	void setTessellationType( TessellationType type ) { _type = type; }
+	TessellationType getTessellationType() const { return _type; }
+
+	//false if the geometry had to go through osgUtil::Tessellator
+	bool tessellate( osg::Geometry& geometry ) const
+	{
+		unsigned int numTriangles = 0;
+		if ( earClip( geometry, numTriangles ) ) return true;
+		fallback( geometry );
+		return false;
+	}
+
+	//ear clip all geometries in parallel, then run the fallbacks one after the other
+	Statistics tessellate( const std::vector<osg::Geometry*>& geometries ) const
+	{
+		std::vector<unsigned int> triangles( geometries.size(), 0 );
+		std::vector<char> failed( geometries.size(), 0 );
+		parallelFor( geometries.size(), [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int i = begin; i < end; ++i )
+				failed[i] = !earClip( *geometries[i], triangles[i] );
+		}, _numThreads, 64 );
+
+		Statistics stats;
+		stats.numGeometries = geometries.size();
+		for ( unsigned int i = 0; i < geometries.size(); ++i )
+		{
+			stats.numTriangles += triangles[i];
+			if ( !failed[i] ) continue;
+			fallback( *geometries[i] );
+			++stats.numFallbacks;
+		}
+		return stats;
+	}
+
+protected:
+	struct Point
+	{
+		double x, y;
+		unsigned int index;	//into the vertex array
+	};
+
+	typedef std::vector<Point> Ring;
+
+	//the polygon as a circular doubly linked list, holes get spliced into it
+	struct Node
+	{
+		double x, y;
+		unsigned int index;
+		unsigned int prev, next;
+	};
+
+	bool earClip( osg::Geometry& geometry, unsigned int& numTriangles ) const
+	{
+		const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>( geometry.getVertexArray() );
+		if ( !vertices ) return false;
+
+		std::vector< std::vector<unsigned int> > contours;
+		std::vector<unsigned int> polygonSets;
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			const osg::PrimitiveSet* primitives = geometry.getPrimitiveSet( i );
+			if ( primitives -> getMode() != GL_POLYGON ) continue;
+			polygonSets.push_back( i );
+
+			const osg::DrawArrayLengths* lengths = dynamic_cast<const osg::DrawArrayLengths*>( primitives );
+			if ( lengths )
+			{
+				unsigned int first = lengths -> getFirst();
+				for ( unsigned int j = 0; j < lengths -> size(); ++j )
+				{
+					contours.push_back( std::vector<unsigned int>() );
+					for ( int k = 0; k < ( *lengths )[j]; ++k )
+						contours.back().push_back( first++ );
+				}
+				continue;
+			}
+			contours.push_back( std::vector<unsigned int>( primitives -> getNumIndices() ) );
+			for ( unsigned int j = 0; j < primitives -> getNumIndices(); ++j )
+				contours.back()[j] = primitives -> index( j );
+		}
+		if ( polygonSets.empty() ) return true;
+
+		for ( unsigned int c = 0; c < contours.size(); ++c )
+		{
+			for ( unsigned int j = 0; j < contours[c].size(); ++j )
+			{
+				if ( contours[c][j] >= vertices -> size() ) return false;
+			}
+		}
+
+		std::vector<unsigned int> triangles;
+		if ( _type == TESS_TYPE_POLYGONS )
+		{
+			for ( unsigned int c = 0; c < contours.size(); ++c )
+			{
+				if ( !triangulate( *vertices, std::vector< std::vector<unsigned int> >( 1, contours[c] ), triangles ) ) return false;
+			}
+		}
+		else if ( !triangulate( *vertices, contours, triangles ) )
+			return false;
+
+		//the polygons make way for one triangle list where the first of them was
+		for ( unsigned int i = polygonSets.size(); i-- > 1; )
+			geometry.removePrimitiveSet( polygonSets[i] );
+		geometry.setPrimitiveSet( polygonSets[0], new osg::DrawElementsUInt( GL_TRIANGLES, triangles.begin(), triangles.end() ) );
+		geometry.dirtyDisplayList();
+		numTriangles = triangles.size() / 3;
+		return true;
+	}
+
+	void fallback( osg::Geometry& geometry ) const
+	{
+		osg::ref_ptr<osgUtil::Tessellator> tessellator = new osgUtil::Tessellator;
+		if ( _type == TESS_TYPE_GEOMETRY )
+		{
+			tessellator -> setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
+			tessellator -> setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
+		}
+		tessellator -> retessellatePolygons( geometry );
+	}
+
+	//triangles of one shape made of the given contours, false if it needs the fallback
+	static bool triangulate( const osg::Vec3Array& vertices, const std::vector< std::vector<unsigned int> >& contours,
+	                         std::vector<unsigned int>& triangles )
+	{
+		//project onto the plane of the contour with the largest area, keeping its winding counterclockwise
+		osg::Vec3d normal;
+		for ( unsigned int c = 0; c < contours.size(); ++c )
+		{
+			osg::Vec3d n = newellNormal( vertices, contours[c] );
+			if ( n.length2() > normal.length2() ) normal = n;
+		}
+		if ( normal.length2() == 0.0 ) return false;	//no plane to project onto, a line or lobes cancelling out
+
+		static const int nextAxis[3] = { 1, 2, 0 };
+		int k = std::fabs( normal.x() ) > std::fabs( normal.y() ) ? 0 : 1;
+		if ( std::fabs( normal.z() ) > std::fabs( normal[k] ) ) k = 2;
+		int u = nextAxis[k], v = nextAxis[u];
+		if ( normal[k] < 0.0 ) std::swap( u, v );
+
+		std::vector<Ring> rings;
+		for ( unsigned int c = 0; c < contours.size(); ++c )
+		{
+			Ring ring;
+			for ( unsigned int j = 0; j < contours[c].size(); ++j )
+			{
+				const osg::Vec3& p = vertices[contours[c][j]];
+				Point point = { p[u], p[v], contours[c][j] };
+				if ( ring.empty() || point.x != ring.back().x || point.y != ring.back().y ) ring.push_back( point );
+			}
+			while ( ring.size() > 1 && ring.front().x == ring.back().x && ring.front().y == ring.back().y ) ring.pop_back();
+			if ( ring.size() >= 3 ) rings.push_back( ring );
+		}
+		if ( intersecting( rings ) ) return false;
+
+		//what is left without area (all points on a line) draws nothing
+		for ( unsigned int r = rings.size(); r-- > 0; )
+		{
+			if ( signedArea( rings[r] ) == 0.0 ) rings.erase( rings.begin() + r );
+		}
+		if ( rings.empty() ) return true;
+
+		//contours inside an odd number of others are holes of the smallest outer contour around them
+		std::vector<int> outerOf( rings.size(), -1 );
+		std::vector<double> areas( rings.size() );
+		for ( unsigned int r = 0; r < rings.size(); ++r )
+			areas[r] = std::fabs( signedArea( rings[r] ) );
+		for ( unsigned int r = 0; r < rings.size(); ++r )
+		{
+			unsigned int depth = 0;
+			int parent = -1;
+			for ( unsigned int o = 0; o < rings.size(); ++o )
+			{
+				if ( o == r || !inside( rings[o], rings[r][0] ) ) continue;
+				++depth;
+				if ( parent < 0 || areas[o] < areas[parent] ) parent = o;
+			}
+			if ( depth % 2 ) outerOf[r] = parent;
+		}
+
+		for ( unsigned int r = 0; r < rings.size(); ++r )
+		{
+			bool hole = outerOf[r] >= 0;
+			if ( ( signedArea( rings[r] ) > 0.0 ) == hole ) std::reverse( rings[r].begin(), rings[r].end() );
+		}
+
+		for ( unsigned int r = 0; r < rings.size(); ++r )
+		{
+			if ( outerOf[r] >= 0 ) continue;
+
+			std::vector<Node> nodes;
+			unsigned int start = addRing( rings[r], nodes );
+
+			//bridge the holes from right to left, so each bridge only crosses finished area
+			std::vector< std::pair<double, unsigned int> > holes;
+			for ( unsigned int h = 0; h < rings.size(); ++h )
+			{
+				if ( outerOf[h] != (int)r ) continue;
+				unsigned int first = addRing( rings[h], nodes );
+				unsigned int rightmost = first;
+				for ( unsigned int n = nodes[first].next; n != first; n = nodes[n].next )
+				{
+					if ( nodes[n].x > nodes[rightmost].x ) rightmost = n;
+				}
+				holes.push_back( std::make_pair( -nodes[rightmost].x, rightmost ) );
+			}
+			std::sort( holes.begin(), holes.end() );
+			for ( unsigned int h = 0; h < holes.size(); ++h )
+			{
+				if ( !bridgeHole( nodes, start, holes[h].second ) ) return false;
+			}
+
+			if ( !clipEars( nodes, start, triangles ) ) return false;
+		}
+		return true;
+	}
+
+	static osg::Vec3d newellNormal( const osg::Vec3Array& vertices, const std::vector<unsigned int>& contour )
+	{
+		osg::Vec3d n;
+		for ( unsigned int j = 0; j < contour.size(); ++j )
+		{
+			osg::Vec3d a = vertices[contour[j]], b = vertices[contour[( j + 1 ) % contour.size()]];
+			n += osg::Vec3d( ( a.y() - b.y() ) * ( a.z() + b.z() ), ( a.z() - b.z() ) * ( a.x() + b.x() ), ( a.x() - b.x() ) * ( a.y() + b.y() ) );
+		}
+		return n;
+	}
+
+	static double signedArea( const Ring& ring )
+	{
+		double area = 0.0;
+		for ( unsigned int j = 0, i = ring.size() - 1; j < ring.size(); i = j++ )
+			area += ( ring[i].x - ring[j].x ) * ( ring[i].y + ring[j].y );
+		return area * 0.5;
+	}
+
+	//even-odd test of a point against a ring
+	static bool inside( const Ring& ring, const Point& p )
+	{
+		bool result = false;
+		for ( unsigned int j = 0, i = ring.size() - 1; j < ring.size(); i = j++ )
+		{
+			if ( ( ring[i].y > p.y ) != ( ring[j].y > p.y ) &&
+			     p.x < ( ring[j].x - ring[i].x ) * ( p.y - ring[i].y ) / ( ring[j].y - ring[i].y ) + ring[i].x )
+				result = !result;
+		}
+		return result;
+	}
+
+	static double cross( double ax, double ay, double bx, double by, double cx, double cy )
+	{
+		return ( bx - ax ) * ( cy - ay ) - ( by - ay ) * ( cx - ax );
+	}
+
+	static bool onSegment( const Point& a, const Point& b, const Point& p )
+	{
+		return std::min( a.x, b.x ) <= p.x && p.x <= std::max( a.x, b.x ) && std::min( a.y, b.y ) <= p.y && p.y <= std::max( a.y, b.y );
+	}
+
+	//do the segments share any point, touching included
+	static bool segmentsMeet( const Point& a, const Point& b, const Point& c, const Point& d )
+	{
+		double d1 = cross( c.x, c.y, d.x, d.y, a.x, a.y ), d2 = cross( c.x, c.y, d.x, d.y, b.x, b.y );
+		double d3 = cross( a.x, a.y, b.x, b.y, c.x, c.y ), d4 = cross( a.x, a.y, b.x, b.y, d.x, d.y );
+		if ( ( ( d1 > 0 && d2 < 0 ) || ( d1 < 0 && d2 > 0 ) ) && ( ( d3 > 0 && d4 < 0 ) || ( d3 < 0 && d4 > 0 ) ) ) return true;
+		return ( d1 == 0 && onSegment( c, d, a ) ) || ( d2 == 0 && onSegment( c, d, b ) ) ||
+		       ( d3 == 0 && onSegment( a, b, c ) ) || ( d4 == 0 && onSegment( a, b, d ) );
+	}
+
+	//any two edges crossing or touching, other than neighbours meeting at their shared vertex.
+	//edges are swept in x order, so only edges with overlapping x ranges are compared.
+	static bool intersecting( const std::vector<Ring>& rings )
+	{
+		struct Edge { double minX, maxX; unsigned int ring, i; };
+		std::vector<Edge> edges;
+		for ( unsigned int r = 0; r < rings.size(); ++r )
+		{
+			for ( unsigned int i = 0; i < rings[r].size(); ++i )
+			{
+				const Point& a = rings[r][i];
+				const Point& b = rings[r][( i + 1 ) % rings[r].size()];
+				Edge edge = { std::min( a.x, b.x ), std::max( a.x, b.x ), r, i };
+				edges.push_back( edge );
+			}
+		}
+		std::sort( edges.begin(), edges.end(), []( const Edge& l, const Edge& r ) { return l.minX < r.minX; } );
+
+		for ( unsigned int e = 0; e < edges.size(); ++e )
+		{
+			const Ring& ring = rings[edges[e].ring];
+			const Point& a = ring[edges[e].i];
+			const Point& b = ring[( edges[e].i + 1 ) % ring.size()];
+			for ( unsigned int f = e + 1; f < edges.size() && edges[f].minX <= edges[e].maxX; ++f )
+			{
+				const Ring& other = rings[edges[f].ring];
+				const Point& c = other[edges[f].i];
+				const Point& d = other[( edges[f].i + 1 ) % other.size()];
+				if ( edges[e].ring == edges[f].ring )
+				{
+					//neighbours share a vertex, they only overlap if they fold back onto each other
+					unsigned int n = ring.size();
+					if ( ( edges[e].i + 1 ) % n == edges[f].i )
+					{
+						if ( cross( a.x, a.y, b.x, b.y, d.x, d.y ) == 0 && onSegment( a, b, d ) ) return true;
+						continue;
+					}
+					if ( ( edges[f].i + 1 ) % n == edges[e].i )
+					{
+						if ( cross( c.x, c.y, d.x, d.y, b.x, b.y ) == 0 && onSegment( c, d, b ) ) return true;
+						continue;
+					}
+				}
+				if ( segmentsMeet( a, b, c, d ) ) return true;
+			}
+		}
+		return false;
+	}
+
+	static unsigned int addRing( const Ring& ring, std::vector<Node>& nodes )
+	{
+		unsigned int first = nodes.size(), size = ring.size();
+		for ( unsigned int i = 0; i < size; ++i )
+		{
+			Node node = { ring[i].x, ring[i].y, ring[i].index, first + ( i + size - 1 ) % size, first + ( i + 1 ) % size };
+			nodes.push_back( node );
+		}
+		return first;
+	}
+
+	static bool inTriangle( const Node& a, const Node& b, const Node& c, const Node& p )
+	{
+		return cross( a.x, a.y, b.x, b.y, p.x, p.y ) >= 0 && cross( b.x, b.y, c.x, c.y, p.x, p.y ) >= 0 &&
+		       cross( c.x, c.y, a.x, a.y, p.x, p.y ) >= 0;
+	}
+
+	static bool samePosition( const Node& a, const Node& b ) { return a.x == b.x && a.y == b.y; }
+
+	static double corner( const std::vector<Node>& nodes, unsigned int n )
+	{
+		const Node& a = nodes[nodes[n].prev];
+		const Node& c = nodes[nodes[n].next];
+		return cross( a.x, a.y, nodes[n].x, nodes[n].y, c.x, c.y );
+	}
+
+	//does the direction from node n towards p lie inside the polygon's corner at n
+	static bool locallyInside( const std::vector<Node>& nodes, unsigned int n, const Node& p )
+	{
+		const Node& a = nodes[n];
+		const Node& prev = nodes[a.prev];
+		const Node& next = nodes[a.next];
+		if ( corner( nodes, n ) > 0 )
+			return cross( a.x, a.y, p.x, p.y, next.x, next.y ) <= 0 && cross( a.x, a.y, prev.x, prev.y, p.x, p.y ) <= 0;
+		return cross( a.x, a.y, p.x, p.y, prev.x, prev.y ) > 0 || cross( a.x, a.y, next.x, next.y, p.x, p.y ) > 0;
+	}
+
+	//connect the hole (counterclockwise outer, clockwise hole) through a visible vertex of the outer
+	//contour: duplicate both ends of the bridge and splice the hole in between
+	static bool bridgeHole( std::vector<Node>& nodes, unsigned int outer, unsigned int hole )
+	{
+		const Node m = nodes[hole];
+
+		//closest edge to the right of the hole's rightmost vertex
+		double closest = 1e300;
+		unsigned int candidate = ~0u;
+		unsigned int n = outer;
+		do
+		{
+			const Node& p = nodes[n];
+			const Node& q = nodes[p.next];
+			if ( p.y != q.y && ( p.y <= m.y ) == ( m.y <= q.y ) )
+			{
+				double x = p.x + ( m.y - p.y ) * ( q.x - p.x ) / ( q.y - p.y );
+				if ( x >= m.x && x < closest )
+				{
+					closest = x;
+					candidate = p.x > q.x ? n : p.next;
+				}
+			}
+			n = p.next;
+		} while ( n != outer );
+		if ( candidate == ~0u ) return false;
+
+		//a reflex vertex inside the triangle hole - hit point - candidate would block the bridge,
+		//take the one closest in angle to the ray instead
+		if ( closest != nodes[candidate].x || m.y != nodes[candidate].y )
+		{
+			Node hit = m;
+			hit.x = closest;
+			const Node& c = nodes[candidate];
+			bool above = c.y > m.y;
+			double bestTangent = 1e300;
+			unsigned int best = candidate;
+			n = outer;
+			do
+			{
+				const Node& p = nodes[n];
+				bool blocking = !samePosition( p, c ) && corner( nodes, n ) <= 0 &&
+				                ( above ? inTriangle( m, hit, c, p ) : inTriangle( m, c, hit, p ) ) && !samePosition( p, m );
+				if ( blocking && p.x > m.x )
+				{
+					double tangent = std::fabs( p.y - m.y ) / ( p.x - m.x );
+					if ( tangent < bestTangent || ( tangent == bestTangent && p.x < nodes[best].x ) )
+					{
+						bestTangent = tangent;
+						best = n;
+					}
+				}
+				n = p.next;
+			} while ( n != outer );
+			candidate = best;
+		}
+
+		//earlier bridges may have duplicated the candidate, use the copy whose corner the bridge enters
+		n = outer;
+		do
+		{
+			if ( samePosition( nodes[n], nodes[candidate] ) && locallyInside( nodes, n, m ) )
+			{
+				candidate = n;
+				break;
+			}
+			n = nodes[n].next;
+		} while ( n != outer );
+
+		unsigned int a2 = nodes.size(), b2 = a2 + 1;
+		nodes.push_back( nodes[candidate] );
+		nodes.push_back( nodes[hole] );
+		unsigned int an = nodes[candidate].next, bp = nodes[hole].prev;
+
+		nodes[candidate].next = hole;	nodes[hole].prev = candidate;
+		nodes[a2].next = an;			nodes[an].prev = a2;
+		nodes[b2].next = a2;			nodes[a2].prev = b2;
+		nodes[bp].next = b2;			nodes[b2].prev = bp;
+		return true;
+	}
+
+	static void unlink( std::vector<Node>& nodes, unsigned int n )
+	{
+		nodes[nodes[n].prev].next = nodes[n].next;
+		nodes[nodes[n].next].prev = nodes[n].prev;
+	}
+
+	static bool isEar( const std::vector<Node>& nodes, unsigned int ear )
+	{
+		const Node& a = nodes[nodes[ear].prev];
+		const Node& b = nodes[ear];
+		const Node& c = nodes[b.next];
+		if ( cross( a.x, a.y, b.x, b.y, c.x, c.y ) <= 0 ) return false;
+
+		//only reflex vertices can lie inside a convex corner's triangle
+		for ( unsigned int n = c.next; n != b.prev; n = nodes[n].next )
+		{
+			const Node& p = nodes[n];
+			if ( samePosition( p, a ) || samePosition( p, b ) || samePosition( p, c ) ) continue;
+			if ( corner( nodes, n ) <= 0 && inTriangle( a, b, c, p ) ) return false;
+		}
+		return true;
+	}
+
+	//drop duplicate and collinear vertices, returns a node still in the ring
+	static unsigned int removeDegenerate( std::vector<Node>& nodes, unsigned int start, unsigned int& count )
+	{
+		unsigned int n = start, unchanged = 0;
+		while ( count > 3 && unchanged < count )
+		{
+			unsigned int next = nodes[n].next;
+			if ( samePosition( nodes[n], nodes[next] ) || corner( nodes, n ) == 0 )
+			{
+				unlink( nodes, n );
+				--count;
+				unchanged = 0;
+			}
+			else
+				++unchanged;
+			n = next;
+		}
+		return n;
+	}
+
+	static bool clipEars( std::vector<Node>& nodes, unsigned int start, std::vector<unsigned int>& triangles )
+	{
+		unsigned int count = 1;
+		for ( unsigned int n = nodes[start].next; n != start; n = nodes[n].next )
+			++count;
+
+		unsigned int ear = removeDegenerate( nodes, start, count );
+		unsigned int stop = ear;
+		bool cleaned = false;
+		while ( count > 3 )
+		{
+			unsigned int prev = nodes[ear].prev, next = nodes[ear].next;
+			if ( isEar( nodes, ear ) )
+			{
+				triangles.push_back( nodes[prev].index );
+				triangles.push_back( nodes[ear].index );
+				triangles.push_back( nodes[next].index );
+				unlink( nodes, ear );
+				--count;
+				ear = stop = nodes[next].next;
+				cleaned = false;
+				continue;
+			}
+
+			ear = next;
+			if ( ear == stop )
+			{
+				//a whole round without an ear: clean up once more, then give up
+				if ( cleaned ) return false;
+				ear = stop = removeDegenerate( nodes, ear, count );
+				cleaned = true;
+			}
+		}
+
+		unsigned int prev = nodes[ear].prev, next = nodes[ear].next;
+		if ( corner( nodes, ear ) > 0 )
+		{
+			triangles.push_back( nodes[prev].index );
+			triangles.push_back( nodes[ear].index );
+			triangles.push_back( nodes[next].index );
+		}
+		return true;
+	}
+
+	TessellationType _type;
+	unsigned int _numThreads;
+};
+
+#endif
@@ -0,0 +1,475 @@
+#ifndef PROXY_LOADER_H
+#define PROXY_LOADER_H
+
+#include <osg/FrameStamp>
+#include <osg/NodeCallback>
+#include <osg/observer_ptr>
+#include <osg/ProxyNode>
+#include <osg/Timer>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+#include <osgUtil/CullVisitor>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "MemoryCounter.h"
+#include "SceneCache.h"
+
+class ManagedProxyNode;
+
+//ProxyLoader
+//loads the files of many ManagedProxyNodes on a pool of worker threads, most important
+//first, and keeps what is loaded under a memory budget.
+//
+//every cull that reaches a proxy with files missing requests the next one, with a priority:
+//its size on screen in pixels (or, by distance, the nearer the higher). requests live in a
+//priority queue the workers take from, and sleep on while it is empty; a proxy that has not
+//been culled since the last frame is no longer visible, and its request is cancelled, whether
+//it is still queued or comes up next (a load already running is finished and kept). finished
+//loads are added to their proxies in update(), which also evicts the proxies that were not
+//visible for the longest time while the loaded data is over budget. evicted proxies load
+//again when seen. a file that failed to load is not asked for again until a delay has
+//passed: one second after the first failure, twice as long after each further one, at most
+//a minute.
+//
+//	osg::ref_ptr<ProxyLoader> loader = new ProxyLoader( 4, 512 * 1024 * 1024 );
+//	osg::ref_ptr<ManagedProxyNode> proxy = new ManagedProxyNode( loader.get() );
+//	proxy -> setFileName( 0, "cow.osg" );
+//	proxy -> setCenter( position ); proxy -> setRadius( 10.0f );
+//	root -> addUpdateCallback( new ProxyLoader::UpdateCallback( loader.get() ) );
+
+class ProxyLoader : public osg::Referenced
+{
+public:
+	enum Priority
+	{
+		BY_SCREEN_SIZE,
+		BY_DISTANCE
+	};
+
+	struct Statistics
+	{
+		Statistics() : queued( 0 ), loading( 0 ), numLoaded( 0 ), numFailed( 0 ), numCancelled( 0 ), numEvicted( 0 ),
+		               residentBytes( 0 ), totalLatency( 0.0 ), maximumLatency( 0.0 ) {}
+
+		double getMeanLatency() const { return numLoaded ? totalLatency / numLoaded : 0.0; }
+
+		void report( std::ostream& out ) const
+		{
+			out << "proxy loader: " << queued << " queued, " << loading << " loading, " << numLoaded << " loaded, "
+			    << numFailed << " failed, " << numCancelled << " cancelled, " << numEvicted << " evicted" << std::endl
+			    << "  latency mean " << getMeanLatency() * 1000.0 << " ms, max " << maximumLatency * 1000.0 << " ms, resident "
+			    << residentBytes / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+		}
+
+		unsigned int queued;			//requests waiting for a worker
+		unsigned int loading;			//requests a worker is reading
+		unsigned int numLoaded;
+		unsigned int numFailed;
+		unsigned int numCancelled;
+		unsigned int numEvicted;
+		unsigned long long residentBytes;	//of the loaded proxies' data, as MemoryCounter counts it
+		double totalLatency;			//seconds from first request to added to the proxy
+		double maximumLatency;
+	};
+
+	ProxyLoader( unsigned int numThreads = 0, unsigned long long budgetBytes = 256ull * 1024 * 1024, Priority priority = BY_SCREEN_SIZE )
+		: _priority( priority ), _budget( budgetBytes ), _frameNumber( 0 ), _done( false )
+	{
+		numThreads = numThreads ? numThreads : std::max( OpenThreads::GetNumberOfProcessors() - 1, 1 );
+		for ( unsigned int i = 0; i < numThreads; ++i )
+		{
+			_workers.push_back( new WorkerThread( this ) );
+			_workers.back() -> start();
+		}
+	}
+
+	void setBudget( unsigned long long bytes ) { _budget = bytes; }
+	unsigned long long getBudget() const { return _budget; }
+
+	Priority getPriority() const { return _priority; }
+
+	//called from cull: file index of proxy is wanted with this priority in this frame
+	void request( ManagedProxyNode* proxy, unsigned int index, const std::string& filename, float priority, unsigned int frameNumber )
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		FailureMap::const_iterator failed = _failed.find( filename );
+		if ( failed != _failed.end() && osg::Timer::instance() -> time_s() < failed -> second.retryTime ) return;
+
+		Request& request = _requests[proxy];
+		if ( !request.proxy.valid() )
+		{
+			request.proxy = proxy;
+			request.requested = osg::Timer::instance() -> tick();
+		}
+		//several cameras in one frame: the highest priority counts
+		if ( request.frameNumber == frameNumber && priority <= request.priority ) return;
+		request.frameNumber = frameNumber;
+		request.index = index;
+		request.filename = filename;
+		request.priority = priority;
+		if ( request.loading ) return;
+		_queue.push( Entry( priority, ++request.serial, proxy ) );
+		_wakeUp.signal();
+	}
+
+	//in the update traversal: cancel what was not seen, add finished loads, evict over budget
+	void update( unsigned int frameNumber );
+
+	Statistics getStatistics() const
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		Statistics statistics = _statistics;
+		statistics.queued = 0;
+		statistics.loading = 0;
+		for ( RequestMap::const_iterator it = _requests.begin(); it != _requests.end(); ++it )
+			++( it -> second.loading ? statistics.loading : statistics.queued );
+		return statistics;
+	}
+
+	class UpdateCallback : public osg::NodeCallback
+	{
+	public:
+		UpdateCallback( ProxyLoader* loader ) : _loader( loader ) {}
+
+		virtual void operator()( osg::Node* node, osg::NodeVisitor* nv )
+		{
+			if ( nv -> getFrameStamp() ) _loader -> update( nv -> getFrameStamp() -> getFrameNumber() );
+			traverse( node, nv );
+		}
+
+	protected:
+		osg::ref_ptr<ProxyLoader> _loader;
+	};
+
+protected:
+	virtual ~ProxyLoader()
+	{
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			_done = true;
+			_wakeUp.broadcast();
+		}
+		for ( unsigned int i = 0; i < _workers.size(); ++i )
+		{
+			_workers[i] -> join();
+			delete _workers[i];
+		}
+	}
+
+	struct Request
+	{
+		//no frame yet, so the first request() of any frame and priority is taken
+		Request() : index( 0 ), priority( 0.0f ), serial( 0 ), frameNumber( ~0u ), loading( false ), requested( 0 ) {}
+
+		osg::observer_ptr<ManagedProxyNode> proxy;
+		unsigned int index;
+		std::string filename;
+		float priority;
+		unsigned int serial;		//of the queue entry that is current, older ones are stale
+		unsigned int frameNumber;	//last frame the proxy was seen wanting it
+		bool loading;
+		osg::Timer_t requested;
+	};
+
+	//priority queue entry; re-prioritising pushes a new one rather than searching the heap
+	struct Entry
+	{
+		Entry( float priority_, unsigned int serial_, ManagedProxyNode* key_ ) : priority( priority_ ), serial( serial_ ), key( key_ ) {}
+		bool operator<( const Entry& other ) const { return priority < other.priority; }
+
+		float priority;
+		unsigned int serial;
+		ManagedProxyNode* key;
+	};
+
+	struct Finished
+	{
+		ManagedProxyNode* key;
+		osg::ref_ptr<osg::Node> node;
+		unsigned long long bytes;
+	};
+
+	struct Resident
+	{
+		osg::observer_ptr<ManagedProxyNode> proxy;
+		unsigned long long bytes;
+	};
+
+	typedef std::map<ManagedProxyNode*, Request> RequestMap;
+
+	//a file that could not be read, and when it may be tried again
+	struct Failure
+	{
+		Failure() : numFailures( 0 ), retryTime( 0.0 ) {}
+
+		unsigned int numFailures;
+		double retryTime;		//osg::Timer::time_s()
+	};
+
+	typedef std::map<std::string, Failure> FailureMap;
+
+	class WorkerThread : public OpenThreads::Thread
+	{
+	public:
+		WorkerThread( ProxyLoader* loader ) : _loader( loader ) {}
+
+		virtual void run()
+		{
+			while ( _loader -> loadNext() ) {}
+		}
+
+	protected:
+		ProxyLoader* _loader;
+	};
+
+	//requests that were not renewed last frame belong to proxies nobody sees any more
+	bool isStale( const Request& request ) const
+	{
+		return request.frameNumber + 1 < _frameNumber.load( std::memory_order_relaxed );
+	}
+
+	//on a worker: sleep until a file is wanted and read the most important one; false once
+	//the loader is being destroyed
+	bool loadNext()
+	{
+		ManagedProxyNode* key = 0;
+		std::string filename;
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+			while ( !key )
+			{
+				while ( _queue.empty() && !_done ) _wakeUp.wait( &_mutex );
+				if ( _done ) return false;
+
+				Entry entry = _queue.top();
+				_queue.pop();
+				RequestMap::iterator it = _requests.find( entry.key );
+				if ( it == _requests.end() || it -> second.serial != entry.serial || it -> second.loading ) continue;
+				if ( isStale( it -> second ) || !it -> second.proxy.valid() )
+				{
+					_requests.erase( it );
+					++_statistics.numCancelled;
+					continue;
+				}
+				it -> second.loading = true;
+				key = entry.key;
+				filename = it -> second.filename;
+			}
+		}
+
+		Finished finished;
+		finished.key = key;
+		finished.node = readNodeFileCached( filename );
+		finished.bytes = 0;
+		if ( finished.node.valid() )
+		{
+			MemoryCounter counter;
+			finished.node -> accept( counter );
+			finished.bytes = counter.getTotalBytes();
+		}
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		_finished.push_back( finished );
+		return true;
+	}
+
+	Priority _priority;
+	unsigned long long _budget;
+	std::atomic<unsigned int> _frameNumber;
+	std::vector<WorkerThread*> _workers;
+
+	mutable OpenThreads::Mutex _mutex;
+	OpenThreads::Condition _wakeUp;		//signalled for every queued request
+	bool _done;
+	RequestMap _requests;
+	std::priority_queue<Entry> _queue;
+	std::vector<Finished> _finished;
+	FailureMap _failed;
+	Statistics _statistics;
+
+	//only touched in update()
+	std::vector<Resident> _resident;
+};
+
+//ManagedProxyNode
+//an osg::ProxyNode whose files are loaded by a ProxyLoader instead of the database pager.
+//give it a centre and radius (setCenter(), setRadius()): an unloaded proxy has no bound
+//otherwise, so it is never culled and always counts as visible.
+
+class ManagedProxyNode : public osg::ProxyNode
+{
+public:
+	ManagedProxyNode( ProxyLoader* loader = 0 )
+		: _loader( loader ), _lastVisibleFrame( 0 ), _loadedChildren( 0 )
+	{
+		setLoadingExternalReferenceMode( NO_AUTOMATIC_LOADING );
+	}
+
+	ManagedProxyNode( const ManagedProxyNode& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::ProxyNode( copy, copyop ), _loader( copy._loader ), _lastVisibleFrame( 0 ), _loadedChildren( 0 ) {}
+
+	META_Node( osg, ManagedProxyNode );
+
+	void setLoader( ProxyLoader* loader ) { _loader = loader; }
+	ProxyLoader* getLoader() { return _loader.get(); }
+
+	//frame number of the last cull that reached this proxy
+	unsigned int getLastVisibleFrame() const { return _lastVisibleFrame.load( std::memory_order_relaxed ); }
+
+	virtual void traverse( osg::NodeVisitor& nv )
+	{
+		osgUtil::CullVisitor* cv = nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR ? dynamic_cast<osgUtil::CullVisitor*>( &nv ) : 0;
+		if ( cv && nv.getFrameStamp() )
+		{
+			unsigned int frameNumber = nv.getFrameStamp() -> getFrameNumber();
+			_lastVisibleFrame.store( frameNumber, std::memory_order_relaxed );
+			unsigned int index = getNumChildren();
+			if ( _loader.valid() && index < getNumFileNames() )
+				_loader -> request( this, index, getDatabasePath() + getFileName( index ), computePriority( *cv ), frameNumber );
+		}
+		osg::Group::traverse( nv );
+	}
+
+protected:
+	friend class ProxyLoader;
+
+	virtual ~ManagedProxyNode() {}
+
+	float computePriority( osgUtil::CullVisitor& cv ) const
+	{
+		osg::Vec3 center = getCenterMode() == USER_DEFINED_CENTER ? getCenter() : getBound().center();
+		if ( _loader -> getPriority() == ProxyLoader::BY_SCREEN_SIZE && getRadius() > 0.0f )
+			return cv.clampedPixelSize( center, getRadius() );
+		return -cv.getDistanceToViewPoint( center, true );
+	}
+
+	osg::ref_ptr<ProxyLoader> _loader;
+	std::atomic<unsigned int> _lastVisibleFrame;
+	unsigned int _loadedChildren;	//children added by the loader, what eviction removes
+};
+
+inline void ProxyLoader::update( unsigned int frameNumber )
+{
+	_frameNumber.store( frameNumber, std::memory_order_relaxed );
+	osg::Timer_t now = osg::Timer::instance() -> tick();
+
+	std::vector<Finished> finished;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+		finished.swap( _finished );
+
+		//cancel queued requests of proxies that went out of sight; their heap entries go stale
+		for ( RequestMap::iterator it = _requests.begin(); it != _requests.end(); )
+		{
+			if ( !it -> second.loading && ( isStale( it -> second ) || !it -> second.proxy.valid() ) )
+			{
+				_requests.erase( it++ );
+				++_statistics.numCancelled;
+			}
+			else
+				++it;
+		}
+
+		//re-prioritising leaves stale entries behind, rebuild before they dominate the heap
+		if ( _queue.size() > 2 * _requests.size() + 64 )
+		{
+			std::priority_queue<Entry> queue;
+			for ( RequestMap::iterator it = _requests.begin(); it != _requests.end(); ++it )
+				if ( !it -> second.loading ) queue.push( Entry( it -> second.priority, it -> second.serial, it -> first ) );
+			_queue.swap( queue );
+		}
+
+		//the scene graph is only changed here, in the update traversal
+		for ( unsigned int i = 0; i < finished.size(); ++i )
+		{
+			RequestMap::iterator it = _requests.find( finished[i].key );
+			if ( it == _requests.end() ) continue;
+			osg::ref_ptr<ManagedProxyNode> proxy;
+			it -> second.proxy.lock( proxy );
+			if ( !finished[i].node )
+			{
+				++_statistics.numFailed;
+				Failure& failure = _failed[it -> second.filename];
+				++failure.numFailures;
+				double delay = std::min( std::ldexp( 1.0, (int)std::min( failure.numFailures - 1, 6u ) ), 60.0 );
+				failure.retryTime = osg::Timer::instance() -> time_s() + delay;
+			}
+			else if ( proxy.valid() && proxy -> getNumChildren() == it -> second.index )
+			{
+				proxy -> addChild( finished[i].node.get() );
+				++proxy -> _loadedChildren;
+				Resident resident;
+				resident.proxy = proxy.get();
+				resident.bytes = finished[i].bytes;
+				_resident.push_back( resident );
+				_statistics.residentBytes += finished[i].bytes;
+
+				double latency = osg::Timer::instance() -> delta_s( it -> second.requested, now );
+				++_statistics.numLoaded;
+				_statistics.totalLatency += latency;
+				_statistics.maximumLatency = std::max( _statistics.maximumLatency, latency );
+				_failed.erase( it -> second.filename );
+			}
+			_requests.erase( it );
+		}
+	}
+
+	//over budget: unload the proxies unseen for the longest time, never the ones seen last frame
+	if ( _statistics.residentBytes <= _budget ) return;
+	std::vector< std::pair<unsigned int, unsigned int> > order;
+	for ( unsigned int i = 0; i < _resident.size(); ++i )
+	{
+		osg::ref_ptr<ManagedProxyNode> proxy;
+		_resident[i].proxy.lock( proxy );
+		order.push_back( std::make_pair( proxy.valid() ? proxy -> getLastVisibleFrame() : 0u, i ) );
+	}
+	std::sort( order.begin(), order.end() );
+
+	std::vector<bool> evicted( _resident.size(), false );
+	unsigned long long resident = _statistics.residentBytes;
+	for ( unsigned int n = 0; n < order.size() && resident > _budget; ++n )
+	{
+		if ( order[n].first + 1 >= frameNumber ) break;
+		Resident& entry = _resident[order[n].second];
+		osg::ref_ptr<ManagedProxyNode> proxy;
+		entry.proxy.lock( proxy );
+		if ( proxy.valid() && proxy -> _loadedChildren > 0 )
+		{
+			//a proxy's loaded children go together, so all of its entries are released;
+			//osg::ProxyNode::removeChildren() would drop the file names with them
+			proxy -> osg::Group::removeChildren( 0, proxy -> getNumChildren() );
+			proxy -> _loadedChildren = 0;
+			++_statistics.numEvicted;
+		}
+		resident -= entry.bytes;
+		evicted[order[n].second] = true;
+	}
+
+	//entries whose proxy was emptied by an earlier one in this pass are released as well
+	std::vector<Resident> kept;
+	resident = 0;
+	for ( unsigned int i = 0; i < _resident.size(); ++i )
+	{
+		osg::ref_ptr<ManagedProxyNode> proxy;
+		_resident[i].proxy.lock( proxy );
+		if ( evicted[i] || !proxy.valid() || proxy -> _loadedChildren == 0 ) continue;
+		kept.push_back( _resident[i] );
+		resident += _resident[i].bytes;
+	}
+	_resident.swap( kept );
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+	_statistics.residentBytes = resident;
+}
+
+#endif
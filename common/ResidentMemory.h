@@ -0,0 +1,26 @@
+#ifndef RESIDENT_MEMORY_H
+#define RESIDENT_MEMORY_H
+
+#include <cstdio>
+
+//residentMB
+//resident set size of this process in MB, from /proc/self/statm; 0 where there is no /proc.
+//the benchmarks print it to show heap growth or fragmentation next to their own counts.
+//
+//	double before = residentMB();
+//	...
+//	std::cout << residentMB() - before << " MB" << std::endl;
+
+inline double residentMB()
+{
+	long pages = 0, resident = 0;
+	FILE* file = std::fopen( "/proc/self/statm", "r" );
+	if ( file )
+	{
+		if ( std::fscanf( file, "%ld %ld", &pages, &resident ) != 2 ) resident = 0;
+		std::fclose( file );
+	}
+	return resident * 4096.0 / ( 1024.0 * 1024.0 );
+}
+
+#endif
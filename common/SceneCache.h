@@ -0,0 +1,154 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include <osg/Node>
+#include <osg/Timer>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/Options>
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <OpenThreads/Thread>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+//readNodeFileCached
+//transparent load cache for ASCII models such as cessna.osg, cow.osg or lz.osg.
+//the first read parses the text file as usual and stores the scene in OSG's native binary
+//format (.osgb), which is read back without any text parsing on every later launch.
+//
+//the cache file name carries a key built from the resolved source path, its mtime and size
+//and a hash of its content, so an edited or replaced model is never served from a stale cache.
+//the cache lives in $OSG_SCENE_CACHE_DIR, or in .osgcache next to the working directory.
+//images are written into the cache file, and the source's directory stays on the database
+//path when it is read back, so textures and external files still resolve from the cache.
+//
+//every load reports whether it was a cold (parsed) or warm (cached) read, how long it took,
+//and the peak resident memory of the process so far.
+
+namespace SceneCache
+{
+	//FNV-1a, good enough to tell two versions of a model file apart
+	inline unsigned long long hashBytes( const char* data, size_t size, unsigned long long hash = 14695981039346656037ULL )
+	{
+		for ( size_t i = 0; i < size; ++i )
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	inline bool hashFile( const std::string& path, unsigned long long& hash )
+	{
+		std::ifstream file( path.c_str(), std::ios::in | std::ios::binary );
+		if ( !file ) return false;
+
+		char buffer[64 * 1024];
+		hash = 14695981039346656037ULL;
+		while ( file )
+		{
+			file.read( buffer, sizeof(buffer) );
+			hash = hashBytes( buffer, file.gcount(), hash );
+		}
+		return true;
+	}
+
+	inline std::string getCacheDirectory()
+	{
+		const char* dir = std::getenv( "OSG_SCENE_CACHE_DIR" );
+		return dir ? std::string( dir ) : std::string( ".osgcache" );
+	}
+
+	//peak resident set size of this process in MB
+	inline double peakResidentMB()
+	{
+		struct rusage usage;
+		if ( getrusage( RUSAGE_SELF, &usage ) != 0 ) return 0.0;
+		return usage.ru_maxrss / 1024.0;
+	}
+
+	//for writing and reading the cached copy of source: the file lives elsewhere, so relative
+	//references must resolve against the source's directory, and images go into the file
+	inline osgDB::Options* createOptions( const std::string& source )
+	{
+		osg::ref_ptr<osgDB::Options> options = new osgDB::Options( "WriteImageHint=IncludeData" );
+		std::string directory = osgDB::getFilePath( source );
+		if ( !directory.empty() ) options -> setDatabasePath( directory );
+		return options.release();
+	}
+
+	//path of the cached copy of source, empty if the source cannot be found
+	inline std::string getCacheFileName( const std::string& source )
+	{
+		struct stat info;
+		unsigned long long contentHash;
+		if ( stat( source.c_str(), &info ) != 0 || !hashFile( source, contentHash ) )
+			return std::string();
+
+		std::string path = osgDB::getRealPath( source );
+		char key[128];
+		std::snprintf( key, sizeof(key), "%lld-%lld-%016llx", (long long)info.st_mtime, (long long)info.st_size, contentHash );
+		unsigned long long keyHash = hashBytes( key, std::strlen( key ), hashBytes( path.c_str(), path.size() ) );
+
+		char name[32];
+		std::snprintf( name, sizeof(name), "-%016llx.osgb", keyHash );
+		return getCacheDirectory() + "/" + osgDB::getStrippedName( source ) + name;
+	}
+}
+
+inline osg::Node* readNodeFileCached( const std::string& filename )
+{
+	osg::Timer_t start = osg::Timer::instance() -> tick();
+
+	std::string source = osgDB::findDataFile( filename );
+	std::string cacheFile = source.empty() ? std::string() : SceneCache::getCacheFileName( source );
+
+	//models that already are binary, or cannot be found, just go through the normal path
+	std::string ext = osgDB::getLowerCaseFileExtension( filename );
+	if ( cacheFile.empty() || ext == "osgb" || ext == "ive" )
+		return osgDB::readNodeFile( filename );
+
+	osg::ref_ptr<osgDB::Options> options = SceneCache::createOptions( source );
+	osg::ref_ptr<osg::Node> node;
+	bool warm = false;
+	if ( osgDB::fileExists( cacheFile ) )
+	{
+		node = osgDB::readNodeFile( cacheFile, options.get() );
+		warm = node.valid();
+	}
+
+	if ( !node )
+	{
+		node = osgDB::readNodeFile( source );
+		if ( node.valid() )
+		{
+			//write under a private name and rename, so a concurrent or interrupted
+			//writer never leaves a half-written cache file behind
+			char suffix[32];
+			std::snprintf( suffix, sizeof(suffix), ".%llx.osgb", (unsigned long long)OpenThreads::Thread::CurrentThreadId() );
+			std::string tempFile = osgDB::getNameLessExtension( cacheFile ) + suffix;
+
+			osgDB::makeDirectory( SceneCache::getCacheDirectory() );
+			if ( !osgDB::writeNodeFile( *node, tempFile, options.get() ) || std::rename( tempFile.c_str(), cacheFile.c_str() ) != 0 )
+			{
+				OSG_WARN << "readNodeFileCached: could not write " << cacheFile << std::endl;
+				std::remove( tempFile.c_str() );
+			}
+		}
+	}
+
+	OSG_NOTICE << "readNodeFileCached: " << filename << ( warm ? " (warm, from " + cacheFile + ")" : " (cold, parsed)" )
+	           << " in " << osg::Timer::instance() -> delta_m( start, osg::Timer::instance() -> tick() ) << " ms, peak RSS "
+	           << SceneCache::peakResidentMB() << " MB" << std::endl;
+	return node.release();
+}
+
+#endif
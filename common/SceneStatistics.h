@@ -0,0 +1,370 @@
+#ifndef SCENE_STATISTICS_H
+#define SCENE_STATISTICS_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/NodeVisitor>
+#include <osg/StateSet>
+#include <osg/Texture>
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ParallelFor.h"
+
+//SceneStatistics
+//what a (part of a) scene holds: nodes, drawables, state sets, vertices, primitives by mode,
+//bytes of the vertex arrays by what they are for, index bytes, texture image bytes, how
+//many of those objects are shared, and how many nodes there are at each depth.
+//
+//vertices and primitives are counted per use, what gets drawn; bytes per object, what is
+//in memory, however often it is shared. every object seen is kept with its bytes and the
+//number of times it was reached, so statistics of disjoint visits merge() into exactly what
+//one visit of everything would have counted, shared data included.
+//
+//	std::vector<SceneStatistics> subtrees;
+//	SceneStatistics total = collectSceneStatistics( root.get(), subtrees );
+//	total.writeJSON( std::cout, subtrees );
+
+class SceneStatistics
+{
+public:
+	enum Kind
+	{
+		NODE,
+		DRAWABLE,
+		STATE_SET,
+		ARRAY,
+		PRIMITIVE_SET,
+		IMAGE,
+		numKinds
+	};
+
+	enum ArrayRole
+	{
+		VERTICES,
+		NORMALS,
+		COLORS,
+		SECONDARY_COLORS,
+		FOG_COORDS,
+		TEX_COORDS,
+		VERTEX_ATTRIBS,
+		numRoles,
+		noRole = numRoles
+	};
+
+	//GL_POINTS (0) up to GL_PATCHES (14)
+	enum { numModes = 15 };
+
+	struct Object
+	{
+		Object() : kind( NODE ), role( noRole ), bytes( 0 ), references( 0 ) {}
+
+		Kind kind;
+		ArrayRole role;
+		unsigned long long bytes;
+		unsigned int references;
+	};
+
+	typedef std::unordered_map<const osg::Referenced*, Object> ObjectMap;
+
+	SceneStatistics() : vertices( 0 ), numNodesVisited( 0 ), numDrawablesVisited( 0 )
+	{
+		for ( unsigned int m = 0; m < numModes; ++m ) primitives[m] = 0;
+	}
+
+	//one more use of object; its bytes are only taken the first time
+	void record( const osg::Referenced* object, Kind kind, unsigned long long bytes = 0, ArrayRole role = noRole )
+	{
+		Object& entry = objects[object];
+		if ( entry.references++ == 0 )
+		{
+			entry.kind = kind;
+			entry.role = role;
+			entry.bytes = bytes;
+		}
+	}
+
+	void addDepth( unsigned int depth )
+	{
+		if ( depth >= depths.size() ) depths.resize( depth + 1, 0 );
+		++depths[depth];
+	}
+
+	void merge( const SceneStatistics& other )
+	{
+		vertices += other.vertices;
+		numNodesVisited += other.numNodesVisited;
+		numDrawablesVisited += other.numDrawablesVisited;
+		for ( unsigned int m = 0; m < numModes; ++m ) primitives[m] += other.primitives[m];
+		if ( other.depths.size() > depths.size() ) depths.resize( other.depths.size(), 0 );
+		for ( unsigned int d = 0; d < other.depths.size(); ++d ) depths[d] += other.depths[d];
+		for ( ObjectMap::const_iterator it = other.objects.begin(); it != other.objects.end(); ++it )
+		{
+			Object& entry = objects[it -> first];
+			if ( entry.references == 0 ) entry = it -> second;
+			else entry.references += it -> second.references;
+		}
+	}
+
+	struct Totals
+	{
+		Totals() : textureBytes( 0 ), indexBytes( 0 )
+		{
+			for ( unsigned int k = 0; k < numKinds; ++k ) unique[k] = shared[k] = references[k] = 0;
+			for ( unsigned int r = 0; r < numRoles; ++r ) arrayBytes[r] = 0;
+		}
+
+		unsigned long long unique[numKinds];		//distinct objects
+		unsigned long long shared[numKinds];		//distinct objects reached more than once
+		unsigned long long references[numKinds];	//times objects were reached
+		unsigned long long arrayBytes[numRoles];
+		unsigned long long textureBytes;
+		unsigned long long indexBytes;
+	};
+
+	//sums over the objects, one pass over the map
+	Totals getTotals() const
+	{
+		Totals totals;
+		for ( ObjectMap::const_iterator it = objects.begin(); it != objects.end(); ++it )
+		{
+			const Object& object = it -> second;
+			++totals.unique[object.kind];
+			if ( object.references > 1 ) ++totals.shared[object.kind];
+			totals.references[object.kind] += object.references;
+			if ( object.kind == ARRAY && object.role < numRoles ) totals.arrayBytes[object.role] += object.bytes;
+			else if ( object.kind == PRIMITIVE_SET ) totals.indexBytes += object.bytes;
+			else if ( object.kind == IMAGE ) totals.textureBytes += object.bytes;
+		}
+		return totals;
+	}
+
+	//one JSON object; indent is the indentation of its members
+	void writeJSON( std::ostream& out, const std::string& indent = "  " ) const
+	{
+		static const char* kindNames[numKinds] = { "nodes", "drawables", "stateSets", "arrays", "primitiveSets", "images" };
+		static const char* roleNames[numRoles] = { "vertices", "normals", "colors", "secondaryColors", "fogCoords", "texCoords", "vertexAttribs" };
+		static const char* modeNames[numModes] = { "points", "lines", "lineLoop", "lineStrip", "triangles", "triangleStrip", "triangleFan",
+		                                           "quads", "quadStrip", "polygon", "linesAdjacency", "lineStripAdjacency",
+		                                           "trianglesAdjacency", "triangleStripAdjacency", "patches" };
+		Totals totals = getTotals();
+		unsigned long long arrayBytes = 0;
+		for ( unsigned int r = 0; r < numRoles; ++r ) arrayBytes += totals.arrayBytes[r];
+
+		out << "{" << std::endl;
+		if ( !name.empty() || !className.empty() )
+		{
+			out << indent << "\"name\": \"" << escape( name ) << "\"," << std::endl;
+			out << indent << "\"class\": \"" << escape( className ) << "\"," << std::endl;
+		}
+		out << indent << "\"nodes\": " << numNodesVisited << "," << std::endl;
+		out << indent << "\"drawables\": " << numDrawablesVisited << "," << std::endl;
+		out << indent << "\"stateSets\": " << totals.references[STATE_SET] << "," << std::endl;
+		out << indent << "\"vertices\": " << vertices << "," << std::endl;
+
+		out << indent << "\"primitives\": {";
+		const char* separator = "";
+		for ( unsigned int m = 0; m < numModes; ++m )
+		{
+			if ( !primitives[m] ) continue;
+			out << separator << " \"" << modeNames[m] << "\": " << primitives[m];
+			separator = ",";
+		}
+		out << " }," << std::endl;
+
+		out << indent << "\"bytes\": { \"total\": " << arrayBytes + totals.indexBytes + totals.textureBytes
+		    << ", \"arrays\": " << arrayBytes << ", \"indices\": " << totals.indexBytes << ", \"textures\": " << totals.textureBytes << " }," << std::endl;
+		out << indent << "\"arrayBytes\": {";
+		for ( unsigned int r = 0; r < numRoles; ++r )
+			out << ( r ? ", \"" : " \"" ) << roleNames[r] << "\": " << totals.arrayBytes[r];
+		out << " }," << std::endl;
+
+		out << indent << "\"objects\": {" << std::endl;
+		for ( unsigned int k = 0; k < numKinds; ++k )
+		{
+			out << indent << "  \"" << kindNames[k] << "\": { \"unique\": " << totals.unique[k] << ", \"shared\": " << totals.shared[k]
+			    << ", \"references\": " << totals.references[k] << " }" << ( k + 1 < numKinds ? "," : "" ) << std::endl;
+		}
+		out << indent << "}," << std::endl;
+
+		out << indent << "\"depthHistogram\": [";
+		for ( unsigned int d = 0; d < depths.size(); ++d )
+			out << ( d ? ", " : " " ) << depths[d];
+		out << " ]" << std::endl;
+		out << indent.substr( 0, indent.size() >= 2 ? indent.size() - 2 : 0 ) << "}";
+	}
+
+	//{ "total": {...}, "subtrees": [ {...}, ... ] }
+	void writeJSON( std::ostream& out, const std::vector<SceneStatistics>& subtrees ) const
+	{
+		out << "{" << std::endl << "  \"total\": ";
+		writeJSON( out, "    " );
+		out << "," << std::endl << "  \"subtrees\": [";
+		for ( unsigned int i = 0; i < subtrees.size(); ++i )
+		{
+			out << ( i ? ", " : " " );
+			subtrees[i].writeJSON( out, "      " );
+		}
+		out << " ]" << std::endl << "}" << std::endl;
+	}
+
+	static std::string escape( const std::string& text )
+	{
+		static const char* hex = "0123456789abcdef";
+		std::string escaped;
+		for ( unsigned int i = 0; i < text.size(); ++i )
+		{
+			unsigned char c = text[i];
+			if ( c == '"' || c == '\\' ) escaped += std::string( "\\" ) + (char)c;
+			else if ( c < 0x20 ) escaped += std::string( "\\u00" ) + hex[c >> 4] + hex[c & 15];
+			else escaped += (char)c;
+		}
+		return escaped;
+	}
+
+	std::string name;
+	std::string className;
+	unsigned long long vertices;
+	unsigned long long primitives[numModes];
+	unsigned long long numNodesVisited;		//drawables not included
+	unsigned long long numDrawablesVisited;
+	std::vector<unsigned long long> depths;	//nodes per depth below the root
+	ObjectMap objects;
+};
+
+//SceneStatisticsVisitor
+//fills a SceneStatistics with what it visits, the first node at depth. with TRAVERSE_NONE
+//it only takes the node it is applied to.
+
+class SceneStatisticsVisitor : public osg::NodeVisitor
+{
+public:
+	SceneStatisticsVisitor( SceneStatistics& statistics, unsigned int depth = 0, TraversalMode mode = TRAVERSE_ALL_CHILDREN )
+		: osg::NodeVisitor( mode ), _statistics( statistics ), _depth( depth )
+	{
+		//hidden subtrees still take memory
+		setNodeMaskOverride( ~0u );
+	}
+
+	virtual void apply( osg::Node& node )
+	{
+		_statistics.record( &node, SceneStatistics::NODE );
+		++_statistics.numNodesVisited;
+		_statistics.addDepth( _depth );
+		countState( node.getStateSet() );
+
+		++_depth;
+		traverse( node );
+		--_depth;
+	}
+
+	//drawables are children of their geodes since OSG 3.4, they come here rather than to apply( Node& )
+	virtual void apply( osg::Drawable& drawable )
+	{
+		_statistics.record( &drawable, SceneStatistics::DRAWABLE );
+		++_statistics.numDrawablesVisited;
+		countState( drawable.getStateSet() );
+
+		osg::Geometry* geometry = drawable.asGeometry();
+		if ( !geometry ) return;
+
+		if ( geometry -> getVertexArray() ) _statistics.vertices += geometry -> getVertexArray() -> getNumElements();
+		countArray( geometry -> getVertexArray(), SceneStatistics::VERTICES );
+		countArray( geometry -> getNormalArray(), SceneStatistics::NORMALS );
+		countArray( geometry -> getColorArray(), SceneStatistics::COLORS );
+		countArray( geometry -> getSecondaryColorArray(), SceneStatistics::SECONDARY_COLORS );
+		countArray( geometry -> getFogCoordArray(), SceneStatistics::FOG_COORDS );
+		for ( unsigned int i = 0; i < geometry -> getNumTexCoordArrays(); ++i )
+			countArray( geometry -> getTexCoordArray( i ), SceneStatistics::TEX_COORDS );
+		for ( unsigned int i = 0; i < geometry -> getNumVertexAttribArrays(); ++i )
+			countArray( geometry -> getVertexAttribArray( i ), SceneStatistics::VERTEX_ATTRIBS );
+
+		for ( unsigned int p = 0; p < geometry -> getNumPrimitiveSets(); ++p )
+		{
+			osg::PrimitiveSet* primitiveSet = geometry -> getPrimitiveSet( p );
+			_statistics.record( primitiveSet, SceneStatistics::PRIMITIVE_SET, primitiveSet -> getTotalDataSize() );
+			if ( primitiveSet -> getMode() < (GLenum)SceneStatistics::numModes )
+				_statistics.primitives[primitiveSet -> getMode()] += primitiveSet -> getNumPrimitives();
+		}
+	}
+
+protected:
+	void countArray( osg::Array* array, SceneStatistics::ArrayRole role )
+	{
+		if ( array ) _statistics.record( array, SceneStatistics::ARRAY, array -> getTotalDataSize(), role );
+	}
+
+	void countState( osg::StateSet* stateSet )
+	{
+		if ( !stateSet ) return;
+		_statistics.record( stateSet, SceneStatistics::STATE_SET );
+		const osg::StateSet::TextureAttributeList& units = stateSet -> getTextureAttributeList();
+		for ( unsigned int u = 0; u < units.size(); ++u )
+		{
+			for ( osg::StateSet::AttributeList::const_iterator it = units[u].begin(); it != units[u].end(); ++it )
+			{
+				osg::Texture* texture = dynamic_cast<osg::Texture*>( it -> second.first.get() );
+				for ( unsigned int i = 0; texture && i < texture -> getNumImages(); ++i )
+				{
+					osg::Image* image = texture -> getImage( i );
+					if ( image ) _statistics.record( image, SceneStatistics::IMAGE, image -> getTotalSizeInBytes() );
+				}
+			}
+		}
+	}
+
+	SceneStatistics& _statistics;
+	unsigned int _depth;
+};
+
+//collectSceneStatistics
+//statistics of everything below root, and of each independent subtree: the children of the
+//first node below root with more than one child (files loaded together, tiles of a site). the
+//subtrees are visited in parallel, one visitor each, and merged into the total afterwards.
+//the scene is only read, but must not change while this runs.
+
+inline SceneStatistics collectSceneStatistics( osg::Node* root, std::vector<SceneStatistics>& subtrees, unsigned int numThreads = 0 )
+{
+	SceneStatistics total;
+	subtrees.clear();
+	if ( !root ) return total;
+
+	//the single-child chain above the split, and the split node itself, without their children
+	osg::Node* split = root;
+	unsigned int depth = 0;
+	for ( ;; )
+	{
+		SceneStatisticsVisitor visitor( total, depth, osg::NodeVisitor::TRAVERSE_NONE );
+		split -> accept( visitor );
+		osg::Group* group = split -> asGroup();
+		if ( !group || group -> getNumChildren() != 1 ) break;
+		split = group -> getChild( 0 );
+		++depth;
+	}
+
+	osg::Group* group = split -> asGroup();
+	if ( !group ) return total;
+
+	subtrees.resize( group -> getNumChildren() );
+	parallelFor( subtrees.size(), [&]( unsigned int begin, unsigned int end )
+	{
+		for ( unsigned int i = begin; i < end; ++i )
+		{
+			osg::Node* child = group -> getChild( i );
+			subtrees[i].name = child -> getName();
+			subtrees[i].className = std::string( child -> libraryName() ) + "::" + child -> className();
+			SceneStatisticsVisitor visitor( subtrees[i], depth + 1 );
+			child -> accept( visitor );
+		}
+	}, numThreads, 1 );
+
+	for ( unsigned int i = 0; i < subtrees.size(); ++i )
+		total.merge( subtrees[i] );
+	return total;
+}
+
+#endif
@@ -0,0 +1,319 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <osg/Matrixd>
+#include <osg/NodeCallback>
+#include <osg/Quat>
+#include <osg/Transform>
+#include <osg/Vec3d>
+
+#include <vector>
+
+#include "ParallelFor.h"
+
+class HierarchyTransform;
+
+//TransformHierarchy
+//the local transforms of many nodes (position, attitude, scale, as a PositionAttitudeTransform
+//has them) in flat arrays, one slot per transform, with the parent slot, the depth and a
+//dirty flag next to them. update() turns them into world matrices once per frame: the slots
+//are ordered by depth, every depth is one parallel batch (all parents are done by then), and
+//only slots whose own transform or whose parent's world matrix changed are recomputed. the
+//batches run on a pool of threads the hierarchy keeps, not on threads started every frame.
+//
+//the nodes are HierarchyTransforms; they read their world matrix from here instead of
+//building a matrix in every traversal. the parenting lives in the hierarchy, so the nodes
+//all hang directly below one group whose world matrix is the hierarchy's frame:
+//
+//	osg::ref_ptr<TransformHierarchy> hierarchy = new TransformHierarchy;
+//	osg::ref_ptr<HierarchyTransform> formation = new HierarchyTransform( hierarchy.get() );
+//	osg::ref_ptr<HierarchyTransform> plane = new HierarchyTransform( hierarchy.get(), formation.get() );
+//	plane -> setPosition( osg::Vec3d( 10.0, 0.0, 0.0 ) );
+//	root -> addChild( formation.get() );
+//	root -> addChild( plane.get() );
+//	root -> addUpdateCallback( new TransformHierarchy::UpdateCallback( hierarchy.get() ) );
+
+class TransformHierarchy : public osg::Referenced
+{
+public:
+	TransformHierarchy( unsigned int numThreads = 0 )
+		: _pool( numThreads ), _numUpdated( 0 ), _orderDirty( false ), _dirty( false ) {}
+
+	//a new slot below parent (or a root for -1), identity transform
+	unsigned int addSlot( int parent, HierarchyTransform* node )
+	{
+		unsigned int slot;
+		if ( _free.empty() )
+		{
+			slot = _parents.size();
+			_px.push_back( 0.0 ); _py.push_back( 0.0 ); _pz.push_back( 0.0 );
+			_qx.push_back( 0.0 ); _qy.push_back( 0.0 ); _qz.push_back( 0.0 ); _qw.push_back( 1.0 );
+			_sx.push_back( 1.0 ); _sy.push_back( 1.0 ); _sz.push_back( 1.0 );
+			_parents.push_back( parent );
+			_depths.push_back( 0 );
+			_localDirty.push_back( 1 );
+			_worldChanged.push_back( 0 );
+			_locals.push_back( osg::Matrixd() );
+			_worlds.push_back( osg::Matrixd() );
+			_nodes.push_back( node );
+		}
+		else
+		{
+			slot = _free.back();
+			_free.pop_back();
+			_px[slot] = _py[slot] = _pz[slot] = 0.0;
+			_qx[slot] = _qy[slot] = _qz[slot] = 0.0; _qw[slot] = 1.0;
+			_sx[slot] = _sy[slot] = _sz[slot] = 1.0;
+			_parents[slot] = parent;
+			_localDirty[slot] = 1;
+			_nodes[slot] = node;
+		}
+		_depths[slot] = parent < 0 ? 0 : _depths[parent] + 1;
+		_worlds[slot] = parent < 0 ? osg::Matrixd() : _worlds[parent];
+		_orderDirty = _dirty = true;
+		return slot;
+	}
+
+	//the slot is reused later; its children must be gone already
+	void removeSlot( unsigned int slot )
+	{
+		_nodes[slot] = 0;
+		_parents[slot] = -1;
+		_free.push_back( slot );
+		_orderDirty = true;
+	}
+
+	void setPosition( unsigned int slot, const osg::Vec3d& p )
+	{
+		_px[slot] = p.x(); _py[slot] = p.y(); _pz[slot] = p.z();
+		markDirty( slot );
+	}
+
+	osg::Vec3d getPosition( unsigned int slot ) const { return osg::Vec3d( _px[slot], _py[slot], _pz[slot] ); }
+
+	void setAttitude( unsigned int slot, const osg::Quat& q )
+	{
+		_qx[slot] = q.x(); _qy[slot] = q.y(); _qz[slot] = q.z(); _qw[slot] = q.w();
+		markDirty( slot );
+	}
+
+	osg::Quat getAttitude( unsigned int slot ) const { return osg::Quat( _qx[slot], _qy[slot], _qz[slot], _qw[slot] ); }
+
+	void setScale( unsigned int slot, const osg::Vec3d& s )
+	{
+		_sx[slot] = s.x(); _sy[slot] = s.y(); _sz[slot] = s.z();
+		markDirty( slot );
+	}
+
+	osg::Vec3d getScale( unsigned int slot ) const { return osg::Vec3d( _sx[slot], _sy[slot], _sz[slot] ); }
+
+	int getParent( unsigned int slot ) const { return _parents[slot]; }
+
+	//as of the last update()
+	const osg::Matrixd& getWorldMatrix( unsigned int slot ) const { return _worlds[slot]; }
+
+	unsigned int getNumSlots() const { return _parents.size() - _free.size(); }
+
+	//slots recomputed by the last update()
+	unsigned int getNumUpdated() const { return _numUpdated; }
+
+	//recompute the world matrices of everything that moved, then dirty the bounds of those nodes
+	void update();
+
+	//runs update() before the rest of the update traversal below the node it is attached to
+	class UpdateCallback : public osg::NodeCallback
+	{
+	public:
+		UpdateCallback( TransformHierarchy* hierarchy ) : _hierarchy( hierarchy ) {}
+
+		virtual void operator()( osg::Node* node, osg::NodeVisitor* nv )
+		{
+			_hierarchy -> update();
+			traverse( node, nv );
+		}
+
+	protected:
+		osg::ref_ptr<TransformHierarchy> _hierarchy;
+	};
+
+protected:
+	virtual ~TransformHierarchy() {}
+
+	void markDirty( unsigned int slot )
+	{
+		_localDirty[slot] = 1;
+		_dirty = true;
+	}
+
+	//slots sorted by depth, _levels[d] is where depth d starts
+	void sortByDepth()
+	{
+		std::vector<unsigned int> counts;
+		for ( unsigned int s = 0; s < _parents.size(); ++s )
+		{
+			if ( !_nodes[s] ) continue;
+			if ( counts.size() <= _depths[s] ) counts.resize( _depths[s] + 1, 0 );
+			++counts[_depths[s]];
+		}
+		_levels.assign( counts.size() + 1, 0 );
+		for ( unsigned int d = 0; d < counts.size(); ++d )
+			_levels[d + 1] = _levels[d] + counts[d];
+
+		_order.resize( _levels.back() );
+		std::vector<unsigned int> next( _levels.begin(), _levels.end() - 1 );
+		for ( unsigned int s = 0; s < _parents.size(); ++s )
+			if ( _nodes[s] ) _order[next[_depths[s]]++] = s;
+		_orderDirty = false;
+	}
+
+	void updateSlot( unsigned int s )
+	{
+		int parent = _parents[s];
+		bool parentChanged = parent >= 0 && _worldChanged[parent];
+		if ( !_localDirty[s] && !parentChanged )
+		{
+			_worldChanged[s] = 0;
+			return;
+		}
+		if ( _localDirty[s] )
+		{
+			//what PositionAttitudeTransform builds: scale, then rotate, then translate
+			osg::Matrixd& local = _locals[s];
+			local.makeRotate( osg::Quat( _qx[s], _qy[s], _qz[s], _qw[s] ) );
+			local.preMultScale( osg::Vec3d( _sx[s], _sy[s], _sz[s] ) );
+			local.postMultTranslate( osg::Vec3d( _px[s], _py[s], _pz[s] ) );
+			_localDirty[s] = 0;
+		}
+		if ( parent >= 0 )
+			_worlds[s].mult( _locals[s], _worlds[parent] );
+		else
+			_worlds[s] = _locals[s];
+		_worldChanged[s] = 1;
+	}
+
+	//structure of arrays, indexed by slot
+	std::vector<double> _px, _py, _pz;
+	std::vector<double> _qx, _qy, _qz, _qw;
+	std::vector<double> _sx, _sy, _sz;
+	std::vector<int> _parents;
+	std::vector<unsigned int> _depths;
+	std::vector<unsigned char> _localDirty;
+	std::vector<unsigned char> _worldChanged;
+	std::vector<osg::Matrixd> _locals;
+	std::vector<osg::Matrixd> _worlds;
+	std::vector<HierarchyTransform*> _nodes;
+	std::vector<unsigned int> _free;
+
+	std::vector<unsigned int> _order;
+	std::vector<unsigned int> _levels;
+	ParallelForPool _pool;
+	unsigned int _numUpdated;
+	bool _orderDirty;
+	bool _dirty;
+};
+
+//HierarchyTransform
+//a transform node with the PositionAttitudeTransform API whose matrix is a slot of a
+//TransformHierarchy. the parent passed in is the parent in the hierarchy, not in the scene
+//graph: the node itself goes below the hierarchy's frame group, next to its parent. one made
+//without a hierarchy (by cloneType() or a reader) is an identity transform and ignores set*().
+
+class HierarchyTransform : public osg::Transform
+{
+public:
+	HierarchyTransform() : _slot( 0 ) {}
+
+	HierarchyTransform( TransformHierarchy* hierarchy, HierarchyTransform* parent = 0 )
+		: _hierarchy( hierarchy ), _parentTransform( parent )
+	{
+		_slot = _hierarchy -> addSlot( parent ? (int)parent -> getSlot() : -1, this );
+	}
+
+	//a copy is a new slot with the same transform and parent
+	HierarchyTransform( const HierarchyTransform& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY )
+		: osg::Transform( copy, copyop ), _hierarchy( copy._hierarchy ), _parentTransform( copy._parentTransform ), _slot( 0 )
+	{
+		if ( !_hierarchy.valid() ) return;
+		_slot = _hierarchy -> addSlot( _hierarchy -> getParent( copy._slot ), this );
+		setPosition( copy.getPosition() );
+		setAttitude( copy.getAttitude() );
+		setScale( copy.getScale() );
+	}
+
+	META_Node( osg, HierarchyTransform );
+
+	void setPosition( const osg::Vec3d& pos ) { if ( _hierarchy.valid() ) _hierarchy -> setPosition( _slot, pos ); }
+	osg::Vec3d getPosition() const { return _hierarchy.valid() ? _hierarchy -> getPosition( _slot ) : osg::Vec3d(); }
+
+	void setAttitude( const osg::Quat& quat ) { if ( _hierarchy.valid() ) _hierarchy -> setAttitude( _slot, quat ); }
+	osg::Quat getAttitude() const { return _hierarchy.valid() ? _hierarchy -> getAttitude( _slot ) : osg::Quat(); }
+
+	void setScale( const osg::Vec3d& scale ) { if ( _hierarchy.valid() ) _hierarchy -> setScale( _slot, scale ); }
+	osg::Vec3d getScale() const { return _hierarchy.valid() ? _hierarchy -> getScale( _slot ) : osg::Vec3d( 1.0, 1.0, 1.0 ); }
+
+	TransformHierarchy* getHierarchy() { return _hierarchy.get(); }
+	HierarchyTransform* getParentTransform() { return _parentTransform.get(); }
+	unsigned int getSlot() const { return _slot; }
+
+	virtual bool computeLocalToWorldMatrix( osg::Matrix& matrix, osg::NodeVisitor* ) const
+	{
+		osg::Matrixd world = _hierarchy.valid() ? _hierarchy -> getWorldMatrix( _slot ) : osg::Matrixd();
+		if ( _referenceFrame == RELATIVE_RF )
+			matrix.preMult( world );
+		else
+			matrix = world;
+		return true;
+	}
+
+	virtual bool computeWorldToLocalMatrix( osg::Matrix& matrix, osg::NodeVisitor* ) const
+	{
+		osg::Matrixd inverse = _hierarchy.valid() ? osg::Matrixd::inverse( _hierarchy -> getWorldMatrix( _slot ) ) : osg::Matrixd();
+		if ( _referenceFrame == RELATIVE_RF )
+			matrix.postMult( inverse );
+		else
+			matrix = inverse;
+		return true;
+	}
+
+protected:
+	virtual ~HierarchyTransform()
+	{
+		if ( _hierarchy.valid() ) _hierarchy -> removeSlot( _slot );
+	}
+
+	osg::ref_ptr<TransformHierarchy> _hierarchy;
+	osg::ref_ptr<HierarchyTransform> _parentTransform;	//keeps the parent slot alive
+	unsigned int _slot;
+};
+
+inline void TransformHierarchy::update()
+{
+	_numUpdated = 0;
+	if ( !_dirty && !_orderDirty ) return;
+	if ( _orderDirty ) sortByDepth();
+
+	//one batch per depth, the parents of a batch are all in the batches before it
+	for ( unsigned int d = 0; d + 1 < _levels.size(); ++d )
+	{
+		const unsigned int* slots = &_order[_levels[d]];
+		_pool.run( _levels[d + 1] - _levels[d], [&]( unsigned int begin, unsigned int end )
+		{
+			for ( unsigned int i = begin; i < end; ++i )
+				updateSlot( slots[i] );
+		} );
+	}
+
+	//bounds are dirtied here, on one thread, because they walk up into shared parents
+	for ( unsigned int i = 0; i < _order.size(); ++i )
+	{
+		unsigned int s = _order[i];
+		if ( _worldChanged[s] )
+		{
+			_nodes[s] -> dirtyBound();
+			++_numUpdated;
+		}
+	}
+	_dirty = false;
+}
+
+#endif
@@ -0,0 +1,350 @@
+#ifndef TRIANGLE_EXTRACTOR_H
+#define TRIANGLE_EXTRACTOR_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/PrimitiveSet>
+#include <osg/Transform>
+
+#include <algorithm>
+#include <vector>
+
+//TriangleExtractor
+//bulk replacement for osg::TriangleFunctor collectors: instead of one call per triangle,
+//read() fills caller-owned structure-of-arrays buffers with as many triangles as they hold
+//and remembers where it stopped, so any amount of geometry streams through a fixed block.
+//
+//every primitive set osg::TriangleFunctor understands is decoded (triangles, strips, fans,
+//polygons, quads, quad strips; DrawArrays, DrawArrayLengths and all DrawElements types) with
+//the same corner order, so results match a TriangleFunctor. points and lines are skipped.
+//geometries can carry a matrix (a scene added with addScene() gets its world matrices) that
+//is baked into the positions once per geometry, not once per triangle corner.
+//the geometries must stay alive and unchanged while they are being read.
+//
+//	TriangleExtractor extractor;
+//	extractor.addScene( *scene );
+//	std::vector<float> x( 3 * 65536 ), y( 3 * 65536 ), z( 3 * 65536 );
+//	TriangleExtractor::Buffers buffers( &x[0], &y[0], &z[0], 65536 );
+//	while ( unsigned int n = extractor.read( buffers ) )
+//		consume( n );	//corners of triangle t at [3t], [3t + 1], [3t + 2]
+
+class TriangleExtractor
+{
+public:
+	//a block of triangles, corner c of triangle t is element 3 * t + c of every array.
+	//indices (optional) receives the corners' vertex indices within their geometry,
+	//geometries (optional, one per triangle) the number of the geometry the triangle is from.
+	struct Buffers
+	{
+		Buffers( float* x_, float* y_, float* z_, unsigned int capacity_, unsigned int* indices_ = 0, unsigned int* geometries_ = 0 )
+			: x( x_ ), y( y_ ), z( z_ ), indices( indices_ ), geometries( geometries_ ), capacity( capacity_ ) {}
+
+		float* x;
+		float* y;
+		float* z;
+		unsigned int* indices;
+		unsigned int* geometries;
+		unsigned int capacity;	//in triangles
+	};
+
+	TriangleExtractor() { reset(); }
+
+	//the matrix (if any) is applied to the positions of this geometry
+	void addGeometry( const osg::Geometry& geometry, const osg::Matrix* matrix = 0 )
+	{
+		Source source;
+		source.geometry = &geometry;
+		source.transformed = matrix && !matrix -> isIdentity();
+		if ( source.transformed ) source.matrix = *matrix;
+		_sources.push_back( source );
+	}
+
+	//every geometry below node, with the world matrix of its path from node unless world is false
+	void addScene( osg::Node& node, bool world = true )
+	{
+		SceneCollector collector( *this, world );
+		node.accept( collector );
+	}
+
+	void clear()
+	{
+		_sources.clear();
+		reset();
+	}
+
+	//start reading from the first geometry again
+	void reset()
+	{
+		_source = _set = _part = _partFirst = _triangle = 0;
+		_prepared = ~0u;
+		_current = 0;
+	}
+
+	unsigned int getNumGeometries() const { return _sources.size(); }
+
+	//how many triangles read() will deliver in total, without decoding any
+	unsigned long long getNumTriangles() const
+	{
+		unsigned long long total = 0;
+		for ( unsigned int s = 0; s < _sources.size(); ++s )
+		{
+			const osg::Geometry& geometry = *_sources[s].geometry;
+			if ( !positionsOf( geometry ) ) continue;
+			for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+			{
+				const osg::PrimitiveSet& primitives = *geometry.getPrimitiveSet( i );
+				switch ( primitives.getType() )
+				{
+				case osg::PrimitiveSet::DrawArraysPrimitiveType:
+					total += numTriangles( primitives.getMode(), static_cast<const osg::DrawArrays&>( primitives ).getCount() );
+					break;
+				case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+				{
+					const osg::DrawArrayLengths& lengths = static_cast<const osg::DrawArrayLengths&>( primitives );
+					for ( unsigned int part = 0; part < lengths.size(); ++part )
+						total += numTriangles( primitives.getMode(), lengths[part] );
+					break;
+				}
+				case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+				case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+				case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+					total += numTriangles( primitives.getMode(), primitives.getNumIndices() );
+					break;
+				default:
+					break;
+				}
+			}
+		}
+		return total;
+	}
+
+	//fills buffers with up to buffers.capacity triangles and returns how many, 0 once all are read
+	unsigned int read( const Buffers& buffers )
+	{
+		unsigned int written = 0;
+		while ( written < buffers.capacity && _source < _sources.size() )
+		{
+			const osg::Geometry& geometry = *_sources[_source].geometry;
+			const osg::Vec3* positions = prepare();
+			if ( !positions || _set >= geometry.getNumPrimitiveSets() )
+			{
+				++_source;
+				_set = _part = _partFirst = _triangle = 0;
+				continue;
+			}
+
+			unsigned int begin = written;
+			if ( readSet( *geometry.getPrimitiveSet( _set ), positions, buffers, written ) )
+			{
+				++_set;
+				_part = _partFirst = _triangle = 0;
+			}
+			if ( buffers.geometries ) std::fill( buffers.geometries + begin, buffers.geometries + written, _source );
+		}
+		return written;
+	}
+
+	//triangles a primitive of this mode and vertex count decodes into
+	static unsigned int numTriangles( GLenum mode, unsigned int count )
+	{
+		switch ( mode )
+		{
+		case GL_TRIANGLES: return count / 3;
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN:
+		case GL_POLYGON: return count >= 3 ? count - 2 : 0;
+		case GL_QUADS: return count / 4 * 2;
+		case GL_QUAD_STRIP: return count >= 4 ? ( count - 2 ) / 2 * 2 : 0;
+		default: return 0;
+		}
+	}
+
+protected:
+	struct Source
+	{
+		const osg::Geometry* geometry;
+		osg::Matrix matrix;
+		bool transformed;
+	};
+
+	struct ArrayIndex
+	{
+		ArrayIndex( unsigned int first_ ) : first( first_ ) {}
+		unsigned int operator() ( unsigned int i ) const { return first + i; }
+		unsigned int first;
+	};
+
+	template<typename T>
+	struct ElementIndex
+	{
+		ElementIndex( const T* data_ ) : data( data_ ) {}
+		unsigned int operator() ( unsigned int i ) const { return data[i]; }
+		const T* data;
+	};
+
+	class SceneCollector : public osg::NodeVisitor
+	{
+	public:
+		SceneCollector( TriangleExtractor& extractor, bool world )
+			: osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), _extractor( extractor ), _world( world ) {}
+
+		virtual void apply( osg::Geode& geode )
+		{
+			osg::Matrix matrix;
+			if ( _world ) matrix = osg::computeLocalToWorld( getNodePath() );
+			for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+			{
+				const osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+				if ( geometry ) _extractor.addGeometry( *geometry, &matrix );
+			}
+		}
+
+	protected:
+		TriangleExtractor& _extractor;
+		bool _world;
+	};
+
+	static const osg::Array* positionsOf( const osg::Geometry& geometry )
+	{
+		const osg::Array* vertices = geometry.getVertexArray();
+		if ( dynamic_cast<const osg::Vec3Array*>( vertices ) || dynamic_cast<const osg::Vec3dArray*>( vertices ) ) return vertices;
+		return 0;
+	}
+
+	//the positions of the current geometry, converted and transformed if needed
+	const osg::Vec3* prepare()
+	{
+		if ( _prepared == _source ) return _current;
+		_prepared = _source;
+		_current = 0;
+
+		const Source& source = _sources[_source];
+		const osg::Array* vertices = positionsOf( *source.geometry );
+		if ( !vertices || vertices -> getNumElements() == 0 ) return 0;
+		const osg::Vec3Array* floats = dynamic_cast<const osg::Vec3Array*>( vertices );
+		if ( floats && !source.transformed ) return _current = &floats -> front();
+
+		const osg::Vec3dArray* doubles = dynamic_cast<const osg::Vec3dArray*>( vertices );
+		_positions.resize( vertices -> getNumElements() );
+		for ( unsigned int i = 0; i < _positions.size(); ++i )
+		{
+			osg::Vec3d p = floats ? osg::Vec3d( ( *floats )[i] ) : ( *doubles )[i];
+			_positions[i] = source.transformed ? p * source.matrix : p;
+		}
+		return _current = &_positions.front();
+	}
+
+	//decodes the set from where the last read stopped, true once all of it is read
+	bool readSet( const osg::PrimitiveSet& primitives, const osg::Vec3* positions, const Buffers& buffers, unsigned int& written )
+	{
+		GLenum mode = primitives.getMode();
+		switch ( primitives.getType() )
+		{
+		case osg::PrimitiveSet::DrawArraysPrimitiveType:
+		{
+			const osg::DrawArrays& arrays = static_cast<const osg::DrawArrays&>( primitives );
+			return readRange( mode, ArrayIndex( arrays.getFirst() ), arrays.getCount(), positions, buffers, written );
+		}
+		case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+		{
+			//polygon soups have many short parts, they are walked here rather than one per read() round
+			const osg::DrawArrayLengths& lengths = static_cast<const osg::DrawArrayLengths&>( primitives );
+			for ( ; _part < lengths.size(); ++_part )
+			{
+				if ( !readRange( mode, ArrayIndex( lengths.getFirst() + _partFirst ), lengths[_part], positions, buffers, written ) ) return false;
+				_partFirst += lengths[_part];
+				_triangle = 0;
+			}
+			return true;
+		}
+		case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+			return readRange( mode, ElementIndex<GLubyte>( static_cast<const GLubyte*>( primitives.getDataPointer() ) ),
+			                  primitives.getNumIndices(), positions, buffers, written );
+		case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+			return readRange( mode, ElementIndex<GLushort>( static_cast<const GLushort*>( primitives.getDataPointer() ) ),
+			                  primitives.getNumIndices(), positions, buffers, written );
+		case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+			return readRange( mode, ElementIndex<GLuint>( static_cast<const GLuint*>( primitives.getDataPointer() ) ),
+			                  primitives.getNumIndices(), positions, buffers, written );
+		default:
+			return true;
+		}
+	}
+
+	//one primitive of count vertices, true once all of it is read
+	template<class Index>
+	bool readRange( GLenum mode, const Index& index, unsigned int count, const osg::Vec3* positions, const Buffers& buffers, unsigned int& written )
+	{
+		unsigned int total = numTriangles( mode, count );
+		unsigned int n = std::min( total - std::min( _triangle, total ), buffers.capacity - written );
+		decode( mode, index, positions, n, buffers, written );
+		_triangle += n;
+		written += n;
+		return _triangle >= total;
+	}
+
+	//n triangles starting at _triangle of the current range, written from triangle offset on
+	template<class Index>
+	void decode( GLenum mode, const Index& index, const osg::Vec3* positions, unsigned int n, const Buffers& buffers, unsigned int offset ) const
+	{
+		unsigned int begin = _triangle, end = _triangle + n;
+		unsigned int out = offset * 3;
+		switch ( mode )
+		{
+		case GL_TRIANGLES:
+			for ( unsigned int t = begin; t < end; ++t, out += 3 )
+				emit( index( 3 * t ), index( 3 * t + 1 ), index( 3 * t + 2 ), positions, buffers, out );
+			break;
+		case GL_TRIANGLE_STRIP:
+			for ( unsigned int t = begin; t < end; ++t, out += 3 )
+			{
+				if ( t % 2 ) emit( index( t ), index( t + 2 ), index( t + 1 ), positions, buffers, out );
+				else emit( index( t ), index( t + 1 ), index( t + 2 ), positions, buffers, out );
+			}
+			break;
+		case GL_TRIANGLE_FAN:
+		case GL_POLYGON:
+			for ( unsigned int t = begin; t < end; ++t, out += 3 )
+				emit( index( 0 ), index( t + 1 ), index( t + 2 ), positions, buffers, out );
+			break;
+		case GL_QUADS:
+			for ( unsigned int t = begin; t < end; ++t, out += 3 )
+			{
+				unsigned int q = t / 2 * 4;
+				if ( t % 2 ) emit( index( q ), index( q + 2 ), index( q + 3 ), positions, buffers, out );
+				else emit( index( q ), index( q + 1 ), index( q + 2 ), positions, buffers, out );
+			}
+			break;
+		case GL_QUAD_STRIP:
+			for ( unsigned int t = begin; t < end; ++t, out += 3 )
+			{
+				unsigned int q = t / 2 * 2;
+				if ( t % 2 ) emit( index( q + 1 ), index( q + 3 ), index( q + 2 ), positions, buffers, out );
+				else emit( index( q ), index( q + 1 ), index( q + 2 ), positions, buffers, out );
+			}
+			break;
+		}
+	}
+
+	static void emit( unsigned int a, unsigned int b, unsigned int c, const osg::Vec3* positions, const Buffers& buffers, unsigned int out )
+	{
+		//copies, so the stores below cannot make the compiler load the positions again
+		const osg::Vec3 pa = positions[a], pb = positions[b], pc = positions[c];
+		buffers.x[out] = pa.x(); buffers.x[out + 1] = pb.x(); buffers.x[out + 2] = pc.x();
+		buffers.y[out] = pa.y(); buffers.y[out + 1] = pb.y(); buffers.y[out + 2] = pc.y();
+		buffers.z[out] = pa.z(); buffers.z[out + 1] = pb.z(); buffers.z[out + 2] = pc.z();
+		if ( buffers.indices )
+		{
+			buffers.indices[out] = a; buffers.indices[out + 1] = b; buffers.indices[out + 2] = c;
+		}
+	}
+
+	std::vector<Source> _sources;
+	std::vector<osg::Vec3> _positions;	//converted or transformed positions of geometry _prepared
+	const osg::Vec3* _current;			//positions of geometry _prepared, 0 if it has none
+	unsigned int _prepared;
+	unsigned int _source, _set, _part, _partFirst, _triangle;	//where the next read() continues
+};
+
+#endif
@@ -0,0 +1,621 @@
+#ifndef VERTEX_CACHE_OPTIMIZER_H
+#define VERTEX_CACHE_OPTIMIZER_H
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Notify>
+#include <osg/TriangleIndexFunctor>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+//VertexCacheOptimizer
+//reorders the GL_TRIANGLES index lists of a geometry for the GPU:
+//	VERTEX_CACHE  triangles are reordered with Tom Forsyth's linear-speed vertex cache
+//	              optimisation, so consecutive triangles share already transformed vertices
+//	OVERDRAW      the cache-ordered triangles are cut into clusters where the cache restarts
+//	              anyway, and the clusters sorted so outward facing ones are drawn first
+//	              (Sander et al., "Fast triangle reordering for vertex locality and reduced overdraw")
+//	VERTEX_FETCH  the vertices are renumbered in the order the index lists first use them and
+//	              every per-vertex array is permuted to match, so fetches walk memory forward
+//
+//arrays and index lists another geometry (or anything else) holds a reference to are not
+//renumbered behind its back: VERTEX_FETCH is skipped for that geometry with a notice, or,
+//with setCopyShared( true ), the geometry is given its own copies of them first. drop local
+//ref_ptrs to the arrays of a freshly built geometry before apply(), they count as sharing.
+//
+//measure() gives ACMR (cache misses per triangle, 0.5 at best, 3 at worst) and ATVR (cache
+//misses per vertex, 1 at best) for a simulated FIFO post-transform cache.
+//
+//	VertexCacheOptimizer().apply( *geometry );
+//	VertexCacheOptimizer( VertexCacheOptimizer::ALL ).apply( *geometry );
+
+class VertexCacheOptimizer
+{
+public:
+	enum Passes
+	{
+		VERTEX_CACHE = 1 << 0,
+		OVERDRAW = 1 << 1,
+		VERTEX_FETCH = 1 << 2,
+		DEFAULT = VERTEX_CACHE | VERTEX_FETCH,
+		ALL = VERTEX_CACHE | OVERDRAW | VERTEX_FETCH
+	};
+
+	struct Statistics
+	{
+		Statistics() : numTriangles( 0 ), numVertices( 0 ), numMisses( 0 ) {}
+
+		float getACMR() const { return numTriangles ? (float)numMisses / numTriangles : 0.0f; }
+		float getATVR() const { return numVertices ? (float)numMisses / numVertices : 0.0f; }
+
+		Statistics& operator += ( const Statistics& rhs )
+		{
+			numTriangles += rhs.numTriangles;
+			numVertices += rhs.numVertices;
+			numMisses += rhs.numMisses;
+			return *this;
+		}
+
+		unsigned int numTriangles;	//triangles drawn
+		unsigned int numVertices;	//distinct vertices the triangles use
+		unsigned int numMisses;		//vertices the simulated cache had to transform
+	};
+
+	//overdrawThreshold: how much worse than the cache order (as an ACMR ratio) a cluster may get
+	//for the freedom to sort it, 1.0 keeps only the clusters the cache order already has
+	VertexCacheOptimizer( unsigned int passes = DEFAULT, float overdrawThreshold = 1.05f )
+		: _passes( passes ), _overdrawThreshold( overdrawThreshold ), _copyShared( false ) {}
+
+	void setPasses( unsigned int passes ) { _passes = passes; }
+	unsigned int getPasses() const { return _passes; }
+
+	//VERTEX_FETCH on shared arrays and index lists: copy them onto the geometry, or skip it
+	void setCopyShared( bool copyShared ) { _copyShared = copyShared; }
+	bool getCopyShared() const { return _copyShared; }
+
+	void apply( osg::Geometry& geometry ) const
+	{
+		const osg::Array* vertexArray = geometry.getVertexArray();
+		if ( !vertexArray || vertexArray -> getNumElements() == 0 ) return;
+		unsigned int numVertices = vertexArray -> getNumElements();
+		const osg::Vec3Array* positions = dynamic_cast<const osg::Vec3Array*>( vertexArray );
+
+		if ( _passes & ( VERTEX_CACHE | OVERDRAW ) )
+		{
+			for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+			{
+				osg::DrawElements* elements = geometry.getPrimitiveSet( i ) -> getDrawElements();
+				if ( !elements || elements -> getMode() != GL_TRIANGLES || elements -> getNumIndices() < 6 ) continue;
+
+				std::vector<unsigned int> indices;
+				readIndices( *elements, indices );
+				if ( _passes & VERTEX_CACHE )
+					optimizeVertexCache( indices, numVertices );
+				if ( ( _passes & OVERDRAW ) && positions )
+					optimizeOverdraw( indices, *positions, _overdrawThreshold );
+				writeIndices( indices, *elements );
+			}
+		}
+
+		if ( _passes & VERTEX_FETCH )
+		{
+			if ( !_copyShared && isShared( geometry ) )
+			{
+				OSG_NOTICE << "VertexCacheOptimizer: vertices of geometry \"" << geometry.getName()
+				           << "\" not renumbered, its arrays or index lists are shared" << std::endl;
+			}
+			else
+				optimizeVertexFetch( geometry, _copyShared );
+		}
+
+		geometry.dirtyDisplayList();
+	}
+
+	//Forsyth: greedily emit the triangle whose vertices score best, scores favour vertices
+	//in the (LRU) cache and vertices with few triangles left, so fans get finished
+	//index lists with an index past the vertices are left alone
+	static void optimizeVertexCache( std::vector<unsigned int>& indices, unsigned int numVertices )
+	{
+		const unsigned int cacheSize = 32;
+		unsigned int numTriangles = indices.size() / 3;
+		if ( numTriangles < 2 || !indicesInRange( indices, numVertices ) ) return;
+
+		static const ScoreTables tables;
+
+		//triangles of every vertex, live ones first (CSR layout)
+		std::vector<unsigned int> start( numVertices + 1, 0 ), live( numVertices, 0 ), adjacent( indices.size() );
+		for ( unsigned int i = 0; i < indices.size(); ++i )
+			++start[indices[i] + 1];
+		for ( unsigned int v = 0; v < numVertices; ++v )
+			start[v + 1] += start[v];
+		for ( unsigned int i = 0; i < indices.size(); ++i )
+			adjacent[start[indices[i]] + live[indices[i]]++] = i / 3;
+
+		std::vector<int> cachePosition( numVertices, -1 );
+		std::vector<float> vertexScores( numVertices );
+		for ( unsigned int v = 0; v < numVertices; ++v )
+			vertexScores[v] = tables.score( -1, live[v] );
+
+		//start with the best scoring triangle, the one in the emptiest corner of the mesh
+		unsigned int best = 0;
+		float bestScore = -1.0f;
+		for ( unsigned int t = 0; t < numTriangles; ++t )
+		{
+			float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+			if ( score > bestScore )
+			{
+				bestScore = score;
+				best = t;
+			}
+		}
+
+		std::vector<unsigned int> output, cache, newCache;
+		output.reserve( indices.size() );
+		std::vector<bool> emitted( numTriangles, false );
+		unsigned int deadEndCursor = 0;
+		while ( output.size() < indices.size() )
+		{
+			if ( best == ~0u )
+			{
+				//nothing left around the cached vertices, continue with the next triangle in input order
+				while ( emitted[deadEndCursor] ) ++deadEndCursor;
+				best = deadEndCursor;
+			}
+
+			const unsigned int* tri = &indices[best * 3];
+			emitted[best] = true;
+			newCache.assign( tri, tri + 3 );
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				output.push_back( tri[k] );
+
+				//drop the triangle from the live list of its vertex
+				unsigned int* list = &adjacent[start[tri[k]]];
+				unsigned int* last = list + live[tri[k]] - 1;
+				*std::find( list, last, best ) = *last;
+				*last = best;
+				--live[tri[k]];
+			}
+			for ( unsigned int i = 0; i < cache.size(); ++i )
+			{
+				if ( cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2] )
+					newCache.push_back( cache[i] );
+			}
+
+			for ( unsigned int i = 0; i < newCache.size(); ++i )
+			{
+				unsigned int v = newCache[i];
+				cachePosition[v] = i < cacheSize ? (int)i : -1;
+				vertexScores[v] = tables.score( cachePosition[v], live[v] );
+			}
+			if ( newCache.size() > cacheSize ) newCache.resize( cacheSize );
+			cache.swap( newCache );
+
+			//rescore the live triangles around the cache and pick the best of them
+			best = ~0u;
+			bestScore = -1.0f;
+			for ( unsigned int i = 0; i < cache.size(); ++i )
+			{
+				unsigned int v = cache[i];
+				for ( unsigned int a = start[v]; a < start[v] + live[v]; ++a )
+				{
+					unsigned int t = adjacent[a];
+					float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+					if ( score > bestScore )
+					{
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+		}
+		indices.swap( output );
+	}
+
+	//cut the triangle order into clusters that start from a cold cache, and draw the clusters
+	//facing away from the mesh centre first; within a cluster the cache order is kept
+	static void optimizeOverdraw( std::vector<unsigned int>& indices, const osg::Vec3Array& positions, float threshold = 1.05f )
+	{
+		const unsigned int cacheSize = 16;
+		unsigned int numTriangles = indices.size() / 3;
+		if ( numTriangles < 2 || !indicesInRange( indices, positions.size() ) ) return;
+
+		//hard boundaries: triangles where all three vertices miss, the cache restarts there
+		std::vector<unsigned int> clusters;
+		{
+			FifoCache cache( positions.size(), cacheSize );
+			for ( unsigned int t = 0; t < numTriangles; ++t )
+			{
+				if ( cache.add( &indices[t * 3] ) == 3 || t == 0 )
+					clusters.push_back( t );
+			}
+		}
+		clusters.push_back( numTriangles );
+
+		//soft boundaries: split a cluster once its ACMR so far is within threshold of the whole cluster's
+		std::vector<unsigned int> softClusters;
+		for ( unsigned int c = 0; c + 1 < clusters.size(); ++c )
+		{
+			unsigned int begin = clusters[c], end = clusters[c + 1];
+			FifoCache whole( positions.size(), cacheSize );
+			unsigned int clusterMisses = 0;
+			for ( unsigned int t = begin; t < end; ++t )
+				clusterMisses += whole.add( &indices[t * 3] );
+			float limit = threshold * clusterMisses / ( end - begin );
+
+			FifoCache cache( positions.size(), cacheSize );
+			unsigned int misses = 0, clusterStart = begin;
+			softClusters.push_back( begin );
+			for ( unsigned int t = begin; t < end; ++t )
+			{
+				misses += cache.add( &indices[t * 3] );
+				if ( t + 1 < end && t + 1 - clusterStart >= 8 && (float)misses / ( t + 1 - clusterStart ) <= limit )
+				{
+					softClusters.push_back( t + 1 );
+					clusterStart = t + 1;
+					misses = 0;
+					cache.clear();
+				}
+			}
+		}
+		softClusters.push_back( numTriangles );
+
+		//sort key: how far the cluster's area weighted centre lies out along its area weighted normal
+		osg::Vec3 meshCentre;
+		float meshArea = 0.0f;
+		unsigned int numClusters = softClusters.size() - 1;
+		std::vector<osg::Vec3> centres( numClusters ), normals( numClusters );
+		for ( unsigned int c = 0; c < numClusters; ++c )
+		{
+			float area = 0.0f;
+			for ( unsigned int t = softClusters[c]; t < softClusters[c + 1]; ++t )
+			{
+				const osg::Vec3& a = positions[indices[t * 3]];
+				const osg::Vec3& b = positions[indices[t * 3 + 1]];
+				const osg::Vec3& d = positions[indices[t * 3 + 2]];
+				osg::Vec3 n = ( b - a ) ^ ( d - a );
+				float triangleArea = n.length();
+				centres[c] += ( a + b + d ) * ( triangleArea / 3.0f );
+				normals[c] += n;
+				area += triangleArea;
+			}
+			meshCentre += centres[c];
+			meshArea += area;
+			if ( area > 0.0f ) centres[c] /= area;
+			normals[c].normalize();
+		}
+		if ( meshArea > 0.0f ) meshCentre /= meshArea;
+
+		std::vector< std::pair<float, unsigned int> > order( numClusters );
+		for ( unsigned int c = 0; c < numClusters; ++c )
+			order[c] = std::make_pair( -( ( centres[c] - meshCentre ) * normals[c] ), c );
+		std::stable_sort( order.begin(), order.end() );
+
+		std::vector<unsigned int> output;
+		output.reserve( indices.size() );
+		for ( unsigned int i = 0; i < numClusters; ++i )
+		{
+			unsigned int c = order[i].second;
+			output.insert( output.end(), indices.begin() + softClusters[c] * 3, indices.begin() + softClusters[c + 1] * 3 );
+		}
+		indices.swap( output );
+	}
+
+	//renumber the vertices in first-use order over all primitive sets. only done when every
+	//primitive set is a DrawElements, DrawArrays ranges would no longer mean the same vertices.
+	//arrays or index lists that are shared (LOD levels over one vertex array, shallow copies
+	//of a cached mesh) would be scrambled for their other users: with copyShared the geometry
+	//gets its own copies of them first, otherwise nothing is done
+	static bool optimizeVertexFetch( osg::Geometry& geometry, bool copyShared = false )
+	{
+		std::vector<osg::Array*> arrays;
+		std::vector<osg::DrawElements*> elementsList;
+		if ( !collectFetchData( geometry, arrays, elementsList ) ) return false;
+		if ( isShared( arrays, elementsList ) )
+		{
+			if ( !copyShared ) return false;
+			detachShared( geometry, arrays, elementsList );
+			collectFetchData( geometry, arrays, elementsList );
+		}
+		arrays.erase( std::unique( arrays.begin(), arrays.end() ), arrays.end() );
+		elementsList.erase( std::unique( elementsList.begin(), elementsList.end() ), elementsList.end() );
+		unsigned int numVertices = geometry.getVertexArray() -> getNumElements();
+
+		std::vector<unsigned int> remap( numVertices, ~0u );
+		unsigned int next = 0;
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			const osg::PrimitiveSet* primitives = geometry.getPrimitiveSet( i );
+			for ( unsigned int j = 0; j < primitives -> getNumIndices(); ++j )
+			{
+				unsigned int v = primitives -> index( j );
+				if ( v < numVertices && remap[v] == ~0u ) remap[v] = next++;
+			}
+		}
+		//unused vertices keep their relative order at the end
+		for ( unsigned int v = 0; v < numVertices; ++v )
+		{
+			if ( remap[v] == ~0u ) remap[v] = next++;
+		}
+
+		std::vector<char> scratch;
+		for ( unsigned int i = 0; i < arrays.size(); ++i )
+		{
+			//every osg array stores its elements contiguously, so any type permutes bytewise
+			osg::Array* array = arrays[i];
+			unsigned int size = array -> getElementSize();
+			char* data = (char*)array -> getDataPointer();
+			scratch.assign( data, data + size * numVertices );
+			for ( unsigned int v = 0; v < numVertices; ++v )
+				std::memcpy( data + remap[v] * size, &scratch[v * size], size );
+			array -> dirty();
+		}
+
+		for ( unsigned int i = 0; i < elementsList.size(); ++i )
+		{
+			osg::DrawElements* elements = elementsList[i];
+			for ( unsigned int j = 0; j < elements -> getNumIndices(); ++j )
+			{
+				unsigned int v = elements -> index( j );
+				if ( v < numVertices ) elements -> setElement( j, remap[v] );
+			}
+			elements -> dirty();
+		}
+		return true;
+	}
+
+	//whether VERTEX_FETCH would have to touch arrays or index lists held outside the geometry
+	static bool isShared( osg::Geometry& geometry )
+	{
+		std::vector<osg::Array*> arrays;
+		std::vector<osg::DrawElements*> elementsList;
+		return collectFetchData( geometry, arrays, elementsList ) && isShared( arrays, elementsList );
+	}
+
+	//ACMR and ATVR of all triangles of the geometry, whatever primitive sets they come from
+	static Statistics measure( const osg::Geometry& geometry, unsigned int cacheSize = 16 )
+	{
+		Statistics stats;
+		const osg::Array* vertexArray = geometry.getVertexArray();
+		if ( !vertexArray ) return stats;
+
+		osg::TriangleIndexFunctor<TriangleCollector> collector;
+		std::vector<unsigned int> indices;
+		collector.indices = &indices;
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+			geometry.getPrimitiveSet( i ) -> accept( collector );
+		return measure( indices, vertexArray -> getNumElements(), cacheSize );
+	}
+
+	static Statistics measure( const std::vector<unsigned int>& indices, unsigned int numVertices, unsigned int cacheSize = 16 )
+	{
+		Statistics stats;
+		stats.numTriangles = indices.size() / 3;
+
+		std::vector<bool> seen( numVertices, false );
+		FifoCache cache( numVertices, cacheSize );
+		for ( unsigned int t = 0; t < stats.numTriangles; ++t )
+		{
+			stats.numMisses += cache.add( &indices[t * 3] );
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				unsigned int v = indices[t * 3 + k];
+				if ( v < numVertices && !seen[v] )
+				{
+					seen[v] = true;
+					++stats.numVertices;
+				}
+			}
+		}
+		return stats;
+	}
+
+protected:
+	//the per-vertex arrays and the index lists VERTEX_FETCH renumbers, sorted, each as often
+	//as the geometry binds it; false if the geometry has none or draws with DrawArrays
+	static bool collectFetchData( osg::Geometry& geometry, std::vector<osg::Array*>& arrays, std::vector<osg::DrawElements*>& elementsList )
+	{
+		arrays.clear();
+		elementsList.clear();
+		osg::Array* vertexArray = geometry.getVertexArray();
+		unsigned int numVertices = vertexArray ? vertexArray -> getNumElements() : 0;
+		if ( numVertices == 0 ) return false;
+		for ( unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i )
+		{
+			osg::DrawElements* elements = geometry.getPrimitiveSet( i ) -> getDrawElements();
+			if ( !elements ) return false;
+			elementsList.push_back( elements );
+		}
+
+		osg::Geometry::ArrayList arrayList;
+		geometry.getArrayList( arrayList );
+		for ( unsigned int i = 0; i < arrayList.size(); ++i )
+		{
+			osg::Array* array = arrayList[i].get();
+			if ( array -> getNumElements() != numVertices ) continue;
+			if ( array != vertexArray && array -> getBinding() != osg::Array::BIND_PER_VERTEX ) continue;
+			arrays.push_back( array );
+		}
+		std::sort( arrays.begin(), arrays.end() );
+		std::sort( elementsList.begin(), elementsList.end() );
+		return true;
+	}
+
+	//the entries of a sorted list held by anything but the geometry: it references each once
+	//per slot binding it, which is how often the entry is in the list
+	template<class T>
+	static std::vector<T*> findShared( const std::vector<T*>& sorted )
+	{
+		std::vector<T*> shared;
+		for ( unsigned int i = 0; i < sorted.size(); )
+		{
+			unsigned int bound = 1;
+			while ( i + bound < sorted.size() && sorted[i + bound] == sorted[i] ) ++bound;
+			if ( sorted[i] -> referenceCount() > (int)bound ) shared.push_back( sorted[i] );
+			i += bound;
+		}
+		return shared;
+	}
+
+	static bool isShared( const std::vector<osg::Array*>& arrays, const std::vector<osg::DrawElements*>& elementsList )
+	{
+		return !findShared( arrays ).empty() || !findShared( elementsList ).empty();
+	}
+
+	//copy on write: every slot of the geometry that binds a shared array or index list gets
+	//one private copy of it
+	static void detachShared( osg::Geometry& geometry, const std::vector<osg::Array*>& allArrays, const std::vector<osg::DrawElements*>& allElements )
+	{
+		std::vector<osg::Array*> arrays = findShared( allArrays );
+		std::vector<osg::DrawElements*> elementsList = findShared( allElements );
+
+		osg::CopyOp copyArrays( osg::CopyOp::DEEP_COPY_ARRAYS );
+		for ( unsigned int i = 0; i < arrays.size(); ++i )
+		{
+			osg::ref_ptr<osg::Array> shared = arrays[i];
+			osg::ref_ptr<osg::Array> copy = copyArrays( shared.get() );
+			if ( geometry.getVertexArray() == shared ) geometry.setVertexArray( copy.get() );
+			if ( geometry.getNormalArray() == shared ) geometry.setNormalArray( copy.get() );
+			if ( geometry.getColorArray() == shared ) geometry.setColorArray( copy.get() );
+			if ( geometry.getSecondaryColorArray() == shared ) geometry.setSecondaryColorArray( copy.get() );
+			if ( geometry.getFogCoordArray() == shared ) geometry.setFogCoordArray( copy.get() );
+			for ( unsigned int t = 0; t < geometry.getNumTexCoordArrays(); ++t )
+				if ( geometry.getTexCoordArray( t ) == shared ) geometry.setTexCoordArray( t, copy.get() );
+			for ( unsigned int a = 0; a < geometry.getNumVertexAttribArrays(); ++a )
+				if ( geometry.getVertexAttribArray( a ) == shared ) geometry.setVertexAttribArray( a, copy.get() );
+		}
+
+		osg::CopyOp copyPrimitives( osg::CopyOp::DEEP_COPY_PRIMITIVES );
+		for ( unsigned int i = 0; i < elementsList.size(); ++i )
+		{
+			osg::ref_ptr<osg::PrimitiveSet> copy = copyPrimitives( elementsList[i] );
+			for ( unsigned int p = 0; p < geometry.getNumPrimitiveSets(); ++p )
+				if ( geometry.getPrimitiveSet( p ) -> getDrawElements() == elementsList[i] ) geometry.setPrimitiveSet( p, copy.get() );
+		}
+	}
+
+	struct TriangleCollector
+	{
+		TriangleCollector() : indices( 0 ) {}
+		void operator()( unsigned int a, unsigned int b, unsigned int c )
+		{
+			indices -> push_back( a );
+			indices -> push_back( b );
+			indices -> push_back( c );
+		}
+		std::vector<unsigned int>* indices;
+	};
+
+	//FIFO post-transform cache, a vertex is in it while fewer than size misses happened since it was loaded
+	struct FifoCache
+	{
+		FifoCache( unsigned int numVertices, unsigned int size ) : loadedAt( numVertices, 0 ), misses( 0 ), cacheSize( size ) {}
+
+		unsigned int add( const unsigned int* triangle )
+		{
+			unsigned int before = misses;
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				unsigned int v = triangle[k];
+				if ( v >= loadedAt.size() ) continue;
+				if ( loadedAt[v] == 0 || misses - loadedAt[v] >= cacheSize )
+					loadedAt[v] = ++misses;
+			}
+			return misses - before;
+		}
+
+		//forget everything, as if the cache had been flushed
+		void clear() { misses += cacheSize; }
+
+		std::vector<unsigned int> loadedAt;
+		unsigned int misses;
+		unsigned int cacheSize;
+	};
+
+	//Forsyth's scores: the three newest cache entries 0.75, older ones falling off to 0,
+	//plus a bonus for vertices with few triangles left
+	struct ScoreTables
+	{
+		ScoreTables()
+		{
+			for ( unsigned int i = 0; i < 32; ++i )
+				cache[i] = i < 3 ? 0.75f : powf( 1.0f - ( i - 3.0f ) / ( 32 - 3.0f ), 1.5f );
+			valence[0] = 0.0f;
+			for ( unsigned int i = 1; i < 64; ++i )
+				valence[i] = 2.0f / sqrtf( (float)i );
+		}
+
+		float score( int cachePosition, unsigned int liveTriangles ) const
+		{
+			if ( liveTriangles == 0 ) return -1.0f;
+			return ( cachePosition < 0 ? 0.0f : cache[cachePosition] ) + valence[std::min( liveTriangles, 63u )];
+		}
+
+		float cache[32];
+		float valence[64];
+	};
+
+	static bool indicesInRange( const std::vector<unsigned int>& indices, unsigned int numVertices )
+	{
+		for ( unsigned int i = 0; i < indices.size(); ++i )
+			if ( indices[i] >= numVertices ) return false;
+		return true;
+	}
+
+	static void readIndices( const osg::DrawElements& elements, std::vector<unsigned int>& indices )
+	{
+		indices.resize( elements.getNumIndices() / 3 * 3 );
+		for ( unsigned int i = 0; i < indices.size(); ++i )
+			indices[i] = elements.index( i );
+	}
+
+	static void writeIndices( const std::vector<unsigned int>& indices, osg::DrawElements& elements )
+	{
+		for ( unsigned int i = 0; i < indices.size(); ++i )
+			elements.setElement( i, indices[i] );
+		elements.dirty();
+	}
+
+	unsigned int _passes;
+	float _overdrawThreshold;
+	bool _copyShared;
+};
+
+//VertexCacheVisitor
+//optimises every geometry below a node and sums the cache statistics before and after.
+
+class VertexCacheVisitor : public osg::NodeVisitor
+{
+public:
+	VertexCacheVisitor( const VertexCacheOptimizer& optimizer = VertexCacheOptimizer(), unsigned int cacheSize = 16 )
+		: osg::NodeVisitor( TRAVERSE_ALL_CHILDREN ), _optimizer( optimizer ), _cacheSize( cacheSize ), _numGeometries( 0 ) {}
+
+	virtual void apply( osg::Geode& geode )
+	{
+		for ( unsigned int i = 0; i < geode.getNumDrawables(); ++i )
+		{
+			osg::Geometry* geometry = geode.getDrawable( i ) -> asGeometry();
+			if ( !geometry ) continue;
+			_before += VertexCacheOptimizer::measure( *geometry, _cacheSize );
+			_optimizer.apply( *geometry );
+			_after += VertexCacheOptimizer::measure( *geometry, _cacheSize );
+			++_numGeometries;
+		}
+	}
+
+	const VertexCacheOptimizer::Statistics& getBefore() const { return _before; }
+	const VertexCacheOptimizer::Statistics& getAfter() const { return _after; }
+	unsigned int getNumGeometries() const { return _numGeometries; }
+
+protected:
+	VertexCacheOptimizer _optimizer;
+	unsigned int _cacheSize;
+	unsigned int _numGeometries;
+	VertexCacheOptimizer::Statistics _before, _after;
+};
+
+#endif
@@ -1,9 +1,12 @@
 #include <osgDB/ReadFile>
 #include <osgViewer/Viewer>
 
+#include "SceneCache.h"
+
 int main( int argc, char** argv )
 {
 	osgViewer::Viewer viewer;
-	viewer.setSceneData ( osgDB::readNodeFile("cessna.osg") );
+	//parsed once, later launches read the binary copy from the scene cache
+	viewer.setSceneData ( readNodeFileCached("cessna.osg") );
 	return viewer.run();
 }